@@ -0,0 +1,173 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QThread>
+#include <QTime>
+
+// CTK includes
+#include "ctkErrorLogFDMessageHandler.h"
+
+// STL includes
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#ifdef Q_OS_WIN32
+# include <io.h>
+#else
+# include <unistd.h>
+#endif
+
+namespace
+{
+//-----------------------------------------------------------------------------
+// Write lines of 100 characters to stdout, one write() per line, and record
+// the longest time spent in write(), i.e. waiting for the capture thread to
+// empty the pipe. A negative line count writes until stopped.
+class WriterThread : public QThread
+{
+public:
+  WriterThread(int lineCount)
+    : LineCount(lineCount), MaxStallInMSecs(0), DurationInMSecs(0){}
+
+  void stop()
+  {
+    this->Stopped.fetchAndStoreOrdered(1);
+  }
+
+  virtual void run()
+  {
+    QByteArray line(99, 'x');
+    line.append('\n');
+    int fd = fileno(stdout);
+
+    QTime total;
+    total.start();
+    for (int i = 0; (this->LineCount < 0 || i < this->LineCount) && !this->Stopped; ++i)
+      {
+      QByteArray counter = QByteArray::number(i);
+      memcpy(line.data(), counter.constData(), counter.size());
+
+      QTime stall;
+      stall.start();
+#ifdef Q_OS_WIN32
+      _write(fd, line.constData(), line.size());
+#else
+      if (write(fd, line.constData(), line.size()) == -1)
+        {
+        break;
+        }
+#endif
+      this->MaxStallInMSecs = qMax(this->MaxStallInMSecs, stall.elapsed());
+      }
+    this->DurationInMSecs = total.elapsed();
+  }
+
+  int LineCount;
+  QAtomicInt Stopped;
+  int MaxStallInMSecs;
+  int DurationInMSecs;
+};
+
+}
+
+//-----------------------------------------------------------------------------
+int ctkErrorLogFDMessageHandlerThroughputTest1(int argc, char * argv [])
+{
+  QCoreApplication app(argc, argv);
+
+  // Megabytes of output to capture, 2 by default. Pass e.g. 100 as argument
+  // to measure the throughput.
+  int sizeInMBytes = 2;
+  if (app.arguments().count() > 1)
+    {
+    sizeInMBytes = app.arguments().at(1).toInt();
+    }
+  const int lineCount = sizeInMBytes * 1024 * 1024 / 100;
+
+  ctkErrorLogModel model;
+  model.setTerminalOutputs(ctkErrorLogModel::None);
+  model.registerMsgHandler(new ctkErrorLogFDMessageHandler);
+  model.setMsgHandlerEnabled(ctkErrorLogFDMessageHandler::HandlerName, true);
+
+  QTime total;
+  total.start();
+
+  WriterThread writer(lineCount);
+  writer.start();
+
+  // The model is regularly emptied to keep the memory usage bounded
+  int entryCount = 0;
+  int maxBatchTimeInMSecs = 0;
+  while (entryCount < lineCount && total.elapsed() < 120000)
+    {
+    QTime batch;
+    batch.start();
+    QCoreApplication::processEvents();
+    maxBatchTimeInMSecs = qMax(maxBatchTimeInMSecs, batch.elapsed());
+
+    entryCount += model.rowCount();
+    model.clear();
+    }
+  const int totalInMSecs = total.elapsed();
+
+  writer.wait();
+
+  // Disabling the handler must not wait for a thread that keeps writing
+  WriterThread flooder(-1);
+  flooder.start();
+  QTime flood;
+  flood.start();
+  while (flood.elapsed() < 100)
+    {
+    QCoreApplication::processEvents();
+    model.clear();
+    }
+  QTime disable;
+  disable.start();
+  model.disableAllMsgHandler();
+  const int disableInMSecs = disable.elapsed();
+  flooder.stop();
+  flooder.wait();
+
+  std::cout << "Captured " << entryCount << "/" << lineCount << " lines ("
+            << sizeInMBytes << " MB) in " << totalInMSecs << " ms" << std::endl;
+  std::cout << "  writer: " << writer.DurationInMSecs << " ms, longest write stall: "
+            << writer.MaxStallInMSecs << " ms" << std::endl;
+  std::cout << "  longest model update: " << maxBatchTimeInMSecs << " ms" << std::endl;
+
+  if (entryCount != lineCount)
+    {
+    std::cerr << "Line " << __LINE__ << " - Expected " << lineCount
+              << " entries, got " << entryCount << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  if (disableInMSecs > 5000)
+    {
+    std::cerr << "Line " << __LINE__ << " - Disabling the handler took "
+              << disableInMSecs << " ms" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,140 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+
+// CTK includes
+#include "ctkErrorLogModel.h"
+
+// STL includes
+#include <cstdlib>
+#include <iostream>
+
+// Helper functions
+#include "Testing/Cpp/ctkErrorLogModelTestHelper.cpp"
+
+namespace
+{
+//-----------------------------------------------------------------------------
+void addMessages(ctkErrorLogModel& model, int first, int last)
+{
+  for (int i = first; i <= last; ++i)
+    {
+    model.addEntry(QDateTime::currentDateTime(), "Thread", ctkErrorLogLevel::Info,
+                   "Origin", QString::number(i));
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Check that the model lists exactly the messages first to last, in order
+QString checkMessages(int line, const ctkErrorLogModel& model, int first, int last)
+{
+  QString errorMsg = checkRowCount(line, model.rowCount(), last - first + 1);
+  if (!errorMsg.isEmpty())
+    {
+    return errorMsg;
+    }
+  for (int row = 0; row < model.rowCount(); ++row)
+    {
+    QString text = model.index(row, ctkErrorLogModel::DescriptionColumn)
+      .data(ctkErrorLogModel::DescriptionTextRole).toString();
+    if (text != QString::number(first + row))
+      {
+      errorMsg = QString("Line %1 - Expected message [%2] at row %3 - Current message: [%4]\n");
+      return errorMsg.arg(line).arg(first + row).arg(row).arg(text);
+      }
+    }
+  return QString();
+}
+
+}
+
+//-----------------------------------------------------------------------------
+int ctkErrorLogModelMaximumEntryCountTest1(int argc, char * argv [])
+{
+  QCoreApplication app(argc, argv);
+  Q_UNUSED(app);
+  ctkErrorLogModel model;
+  QString errorMsg;
+
+  // Wrap around: the oldest entry is not the first one of the ring buffer
+  model.setMaximumEntryCount(5);
+  addMessages(model, 0, 6);
+  errorMsg = checkMessages(__LINE__, model, 2, 6);
+  if (!errorMsg.isEmpty())
+    {
+    printErrorMessage(errorMsg);
+    return EXIT_FAILURE;
+    }
+
+  // Grow: the entries are kept and new ones are appended after them
+  model.setMaximumEntryCount(10);
+  errorMsg = checkMessages(__LINE__, model, 2, 6);
+  if (!errorMsg.isEmpty())
+    {
+    printErrorMessage(errorMsg);
+    return EXIT_FAILURE;
+    }
+  addMessages(model, 7, 11);
+  errorMsg = checkMessages(__LINE__, model, 2, 11);
+  if (!errorMsg.isEmpty())
+    {
+    printErrorMessage(errorMsg);
+    return EXIT_FAILURE;
+    }
+
+  // Wrap around again
+  addMessages(model, 12, 14);
+  errorMsg = checkMessages(__LINE__, model, 5, 14);
+  if (!errorMsg.isEmpty())
+    {
+    printErrorMessage(errorMsg);
+    return EXIT_FAILURE;
+    }
+
+  // Shrink: the oldest entries are discarded
+  model.setMaximumEntryCount(4);
+  errorMsg = checkMessages(__LINE__, model, 11, 14);
+  if (!errorMsg.isEmpty())
+    {
+    printErrorMessage(errorMsg);
+    return EXIT_FAILURE;
+    }
+  addMessages(model, 15, 17);
+  errorMsg = checkMessages(__LINE__, model, 14, 17);
+  if (!errorMsg.isEmpty())
+    {
+    printErrorMessage(errorMsg);
+    return EXIT_FAILURE;
+    }
+
+  // Grow while partially filled after a wrap around
+  model.setMaximumEntryCount(6);
+  addMessages(model, 18, 19);
+  errorMsg = checkMessages(__LINE__, model, 14, 19);
+  if (!errorMsg.isEmpty())
+    {
+    printErrorMessage(errorMsg);
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,170 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QFile>
+#include <QTime>
+
+// CTK includes
+#include "ctkErrorLogModel.h"
+
+// STL includes
+#include <cstdlib>
+#include <iostream>
+#ifndef Q_OS_WIN32
+# include <unistd.h>
+#endif
+
+// Helper functions
+#include "Testing/Cpp/ctkErrorLogModelTestHelper.cpp"
+
+namespace
+{
+//-----------------------------------------------------------------------------
+// Resident memory of the process in bytes, -1 if unknown
+qint64 residentMemory()
+{
+#if defined(Q_OS_LINUX)
+  QFile statm("/proc/self/statm");
+  if (!statm.open(QIODevice::ReadOnly))
+    {
+    return -1;
+    }
+  QList<QByteArray> fields = statm.readAll().split(' ');
+  if (fields.count() < 2)
+    {
+    return -1;
+    }
+  return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+#else
+  return -1;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+QString message(int index)
+{
+  return QString("Message %1 - The quick brown fox jumps over the lazy dog").arg(index);
+}
+
+}
+
+//-----------------------------------------------------------------------------
+int ctkErrorLogModelPerformanceTest1(int argc, char * argv [])
+{
+  QCoreApplication app(argc, argv);
+  Q_UNUSED(app);
+
+  const int entryCount = 200000;
+  const int batchSize = 1000;
+  QDateTime now = QDateTime::currentDateTime();
+  QString errorMsg;
+
+  // --------------------------------------------------------------------------
+  // One entry at a time
+  {
+  ctkErrorLogModel model;
+  model.setMaximumEntryCount(entryCount);
+
+  qint64 memoryBefore = residentMemory();
+  QTime time;
+  time.start();
+  for (int i = 0; i < entryCount; ++i)
+    {
+    model.addEntry(now, "Thread", i % 2 ? ctkErrorLogLevel::Warning : ctkErrorLogLevel::Info,
+                   "Origin", message(i));
+    }
+  int elapsed = qMax(1, time.elapsed());
+  qint64 memoryAfter = residentMemory();
+
+  std::cout << "addEntry: " << entryCount << " entries in " << elapsed << " ms, "
+            << static_cast<qint64>(entryCount) * 1000 / elapsed << " entries/s" << std::endl;
+  if (memoryBefore >= 0 && memoryAfter >= 0)
+    {
+    std::cout << "  memory: " << (memoryAfter - memoryBefore) / entryCount
+              << " bytes/entry (" << message(0).size() << " characters per message)" << std::endl;
+    }
+
+  errorMsg = checkRowCount(__LINE__, model.rowCount(), /* expected = */ entryCount);
+  if (!errorMsg.isEmpty())
+    {
+    printErrorMessage(errorMsg);
+    return EXIT_FAILURE;
+    }
+
+  // Filtering lists the warnings only
+  time.start();
+  model.filterEntry(ctkErrorLogLevel::Warning);
+  std::cout << "filterEntry: " << time.elapsed() << " ms" << std::endl;
+
+  errorMsg = checkRowCount(__LINE__, model.rowCount(), /* expected = */ entryCount / 2);
+  if (!errorMsg.isEmpty())
+    {
+    printErrorMessage(errorMsg);
+    return EXIT_FAILURE;
+    }
+  errorMsg = checkTextMessages(__LINE__, model, QStringList() << message(1) << message(3));
+  if (!errorMsg.isEmpty())
+    {
+    printErrorMessage(errorMsg);
+    return EXIT_FAILURE;
+    }
+  }
+
+  // --------------------------------------------------------------------------
+  // Batches of entries, more than the model keeps
+  {
+  ctkErrorLogModel model;
+  model.setMaximumEntryCount(entryCount / 4);
+
+  QTime time;
+  time.start();
+  for (int i = 0; i < entryCount; i += batchSize)
+    {
+    QStringList texts;
+    for (int j = i; j < i + batchSize; ++j)
+      {
+      texts << message(j);
+      }
+    model.addEntries(now, "Thread", ctkErrorLogLevel::Info, "Origin", texts);
+    }
+  int elapsed = qMax(1, time.elapsed());
+
+  std::cout << "addEntries: " << entryCount << " entries in " << elapsed << " ms, "
+            << static_cast<qint64>(entryCount) * 1000 / elapsed << " entries/s" << std::endl;
+
+  // The oldest entries are discarded
+  errorMsg = checkRowCount(__LINE__, model.rowCount(), /* expected = */ entryCount / 4);
+  if (!errorMsg.isEmpty())
+    {
+    printErrorMessage(errorMsg);
+    return EXIT_FAILURE;
+    }
+  errorMsg = checkTextMessages(__LINE__, model, QStringList() << message(entryCount - entryCount / 4));
+  if (!errorMsg.isEmpty())
+    {
+    printErrorMessage(errorMsg);
+    return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
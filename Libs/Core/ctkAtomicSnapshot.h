@@ -0,0 +1,137 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+#ifndef __ctkAtomicSnapshot_h
+#define __ctkAtomicSnapshot_h
+
+// Qt includes
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QThread>
+
+//-----------------------------------------------------------------------------
+/// \ingroup Core
+/// Read-mostly state read without locking.
+///
+/// A snapshot is never modified once published: writers publish a modified
+/// copy of current() instead. Readers count themselves in the counter of
+/// the current epoch while they use the snapshot, publish() starts a new
+/// epoch and waits for the readers of the previous one before deleting the
+/// replaced snapshot. Writers must be serialized by the caller.
+///
+/// \code
+/// ctkAtomicSnapshot<State>::Reader reader(snapshot);
+/// reader->lookup();
+/// \endcode
+template <class T>
+class ctkAtomicSnapshot
+{
+public:
+  explicit ctkAtomicSnapshot(T* initial = 0)
+    : Snapshot(initial)
+  {
+  }
+
+  /// Waits for the readers, then deletes the current snapshot
+  ~ctkAtomicSnapshot()
+  {
+    this->publish(0);
+  }
+
+  /// The current snapshot, for the writers
+  T* current()const
+  {
+    return this->Snapshot;
+  }
+
+  /// Replace the current snapshot with \a next and delete it once no
+  /// reader uses it anymore. Blocks while there are such readers.
+  void publish(T* next)
+  {
+    T* previous = this->Snapshot.fetchAndStoreOrdered(next);
+
+    // New readers count themselves in the other counter and read the new
+    // snapshot, wait for the ones that may still read the previous one.
+    const int epoch = this->ReadEpoch;
+    this->ReadEpoch.fetchAndStoreOrdered(epoch + 1);
+    while (this->Readers[epoch & 1].fetchAndAddOrdered(0) != 0)
+      {
+      QThread::yieldCurrentThread();
+      }
+
+    delete previous;
+  }
+
+  /// Gives access to the current snapshot until destroyed
+  class Reader
+  {
+  public:
+    explicit Reader(const ctkAtomicSnapshot& snapshot)
+      : Owner(snapshot)
+    {
+      forever
+        {
+        this->Epoch = snapshot.ReadEpoch;
+        // ref() is a full memory barrier: if the epoch is still the same,
+        // the writers see this reader and the snapshot read below is not
+        // deleted before the reader is done.
+        snapshot.Readers[this->Epoch & 1].ref();
+        if (snapshot.ReadEpoch == this->Epoch)
+          {
+          break;
+          }
+        snapshot.Readers[this->Epoch & 1].deref();
+        }
+      this->Data = snapshot.Snapshot;
+    }
+
+    ~Reader()
+    {
+      this->Owner.Readers[this->Epoch & 1].deref();
+    }
+
+    const T* operator->()const
+    {
+      return this->Data;
+    }
+
+    const T* data()const
+    {
+      return this->Data;
+    }
+
+  private:
+    Q_DISABLE_COPY(Reader);
+
+    const ctkAtomicSnapshot& Owner;
+    const T* Data;
+    int Epoch;
+  };
+
+private:
+  Q_DISABLE_COPY(ctkAtomicSnapshot);
+
+  QAtomicPointer<T> Snapshot;
+  /// Readers in progress, counted for each parity of ReadEpoch
+  mutable QAtomicInt ReadEpoch;
+  mutable QAtomicInt Readers[2];
+};
+
+#endif
@@ -20,6 +20,7 @@
 
 // Qt includes
 #include <QDebug>
+#include <QStringList>
 
 // CTK includes
 #include "ctkErrorLogFDMessageHandler.h"
@@ -31,10 +32,23 @@
 #ifdef Q_OS_WIN32
 # include <fcntl.h>  // For _O_TEXT
 # include <io.h>     // For _pipe, _dup and _dup2
+# include <windows.h> // For PeekNamedPipe
 #else
+# include <cerrno>
+# include <poll.h>   // For poll
 # include <unistd.h> // For pipe, dup and dup2
 #endif
 
+namespace
+{
+// Size of the blocks read from the pipe
+const int ReadBlockSize = 64 * 1024;
+
+// Maximum amount of output gathered before delivering its lines, a line
+// longer than that is split.
+const int MaxBatchSize = 1024 * 1024;
+}
+
 // --------------------------------------------------------------------------
 // ctkFDHandler methods
 // See http://stackoverflow.com/questions/5419356/redirect-stdout-stderr-to-a-string
@@ -142,10 +156,10 @@ void ctkFDHandler::setEnabled(bool value)
     write(fileno(this->terminalOutputFile()), qPrintable(newline), newline.size());
 #endif
 
-    // Wait the polling thread graciously terminates
-    this->wait();
-
-    // Close files and restore standard output to stdout or stderr - which should be the terminal
+    // Close files and restore standard output to stdout or stderr - which should be the terminal.
+    // This is done before waiting for the polling thread: it drains the pipe and
+    // other threads may keep writing, only the writes already started still go
+    // to the pipe.
 #ifdef Q_OS_WIN32
     _dup2(this->SavedFDNumber, _fileno(this->terminalOutputFile()));
     _close(this->SavedFDNumber);
@@ -153,6 +167,10 @@ void ctkFDHandler::setEnabled(bool value)
     dup2(this->SavedFDNumber, fileno(this->terminalOutputFile()));
     close(this->SavedFDNumber);
 #endif
+
+    // Wait the polling thread graciously terminates
+    this->wait();
+
     clearerr(this->terminalOutputFile());
     fsetpos(this->terminalOutputFile(), &this->SavedFDPos);
 
@@ -179,40 +197,101 @@ bool ctkFDHandler::enabled()const
 }
 
 // --------------------------------------------------------------------------
-void ctkFDHandler::run()
+int ctkFDHandler::readPipe(char* buffer, int size)
 {
-  while(true)
+  forever
     {
-    char c = '\0';
-    QString line;
-    while(c != '\n')
+#ifdef Q_OS_WIN32
+    int res = _read(this->Pipe[0], buffer, size); // When used with pipe, read() is blocking
+#else
+    ssize_t res = read(this->Pipe[0], buffer, size); // When used with pipe, read() is blocking
+    if (res == -1 && errno == EINTR)
       {
+      continue;
+      }
+#endif
+    return static_cast<int>(res);
+    }
+}
+
+// --------------------------------------------------------------------------
+bool ctkFDHandler::pipeReadable()const
+{
 #ifdef Q_OS_WIN32
-      int res = _read(this->Pipe[0], &c, 1); // When used with pipe, read() is blocking
+  DWORD available = 0;
+  HANDLE handle = reinterpret_cast<HANDLE>(_get_osfhandle(this->Pipe[0]));
+  return PeekNamedPipe(handle, 0, 0, 0, &available, 0) && available > 0;
 #else
-      ssize_t res = read(this->Pipe[0], &c, 1); // When used with pipe, read() is blocking
+  struct pollfd pollFD;
+  pollFD.fd = this->Pipe[0];
+  pollFD.events = POLLIN;
+  pollFD.revents = 0;
+  return poll(&pollFD, 1, 0) > 0 && (pollFD.revents & POLLIN);
 #endif
-      if (res == -1)
+}
+
+// --------------------------------------------------------------------------
+void ctkFDHandler::run()
+{
+  Q_ASSERT(this->MessageHandler);
+  const QString threadId = ctk::qtHandleToString(QThread::currentThreadId());
+  const QString origin = this->MessageHandler->handlerPrettyName();
+
+  QByteArray block;
+  block.resize(ReadBlockSize);
+  QByteArray pending;
+
+  bool stopping = false;
+  while(!stopping)
+    {
+    // Wait for some output, then take what is already available so that a
+    // burst of lines is delivered at once.
+    int res = this->readPipe(block.data(), block.size());
+    if (res > 0)
+      {
+      pending.append(block.constData(), res);
+      }
+    while (res > 0 && pending.size() < MaxBatchSize && this->pipeReadable())
+      {
+      res = this->readPipe(block.data(), block.size());
+      if (res > 0)
         {
-        break;
+        pending.append(block.constData(), res);
         }
-      if (c != '\n')
+      }
+
+    // setEnabled(false) writes a newline to wake up the thread once the
+    // handler is disabled, the output written before is still delivered.
+    // The pipe is not written anymore once the output is restored, the drain
+    // is bounded even if other threads keep writing.
+    stopping = res <= 0 || (!this->enabled() && !this->pipeReadable());
+
+    QStringList lines;
+    int lineStart = 0;
+    int lineEnd = pending.indexOf('\n');
+    while (lineEnd != -1)
+      {
+      int lineSize = lineEnd - lineStart;
+      if (lineSize > 0 && pending.at(lineEnd - 1) == '\r')
         {
-        line += c;
+        --lineSize;
         }
+      lines << QString::fromLocal8Bit(pending.constData() + lineStart, lineSize);
+      lineStart = lineEnd + 1;
+      lineEnd = pending.indexOf('\n', lineStart);
       }
-
-    if (!this->enabled())
+    pending.remove(0, lineStart);
+    if (pending.size() >= MaxBatchSize || (stopping && !pending.isEmpty()))
+      {
+      lines << QString::fromLocal8Bit(pending.constData(), pending.size());
+      pending.clear();
+      }
+    if (stopping && !lines.isEmpty() && lines.last().isEmpty())
       {
-      break;
+      lines.removeLast();
       }
 
-    Q_ASSERT(this->MessageHandler);
-    this->MessageHandler->handleMessage(
-      ctk::qtHandleToString(QThread::currentThreadId()),
-      this->LogLevel,
-      this->MessageHandler->handlerPrettyName(),
-      line);
+    this->MessageHandler->handleMessages(threadId, this->LogLevel, origin, lines);
     }
 }
 
@@ -63,8 +63,16 @@ public:
 protected:
   void init();
 
+  /// Read the captured output by blocks and deliver all the complete lines
+  /// of a block at once, see ctkErrorLogAbstractMessageHandler::handleMessages()
   void run();
 
+  /// Blocking read from the pipe, retried if interrupted by a signal.
+  int readPipe(char* buffer, int size);
+
+  /// Return true if the pipe can be read without blocking.
+  bool pipeReadable()const;
+
 private:
   ctkErrorLogFDMessageHandler * MessageHandler;
   ctkErrorLogLevel::LogLevel LogLevel;
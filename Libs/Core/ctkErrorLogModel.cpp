@@ -23,13 +23,14 @@
 #include <QDateTime>
 #include <QDebug>
 #include <QFile>
+#include <QHash>
 #include <QMainWindow>
 #include <QMetaEnum>
 #include <QMetaType>
 #include <QMutexLocker>
 #include <QPointer>
-#include <QStandardItem>
 #include <QStatusBar>
+#include <QVector>
 
 // CTK includes
 #include "ctkErrorLogModel.h"
@@ -172,6 +173,25 @@ void ctkErrorLogTerminalOutput::output(const QString& text)
   }
 }
 
+// --------------------------------------------------------------------------
+// ctkErrorLogModelEntry
+
+// --------------------------------------------------------------------------
+/// \ingroup Core
+/// Entry of the ring buffer of ctkErrorLogModel. The thread id and the
+/// origin are indices into ctkErrorLogModelPrivate::Strings.
+struct ctkErrorLogModelEntry
+{
+  /// Milliseconds since the epoch
+  qint64 Time;
+  QString Text;
+  /// Size of the first message of Text, the others are grouped with it.
+  int FirstMessageSize;
+  int ThreadId;
+  int Origin;
+  ctkErrorLogLevel::LogLevel LogLevel;
+};
+
 // --------------------------------------------------------------------------
 // ctkErrorLogModelPrivate
 
@@ -185,18 +205,54 @@ public:
   ctkErrorLogModelPrivate(ctkErrorLogModel& object);
   ~ctkErrorLogModelPrivate();
 
-  void init();
-
   /// Convenient method that could be used for debugging purposes.
   void appendToFile(const QString& fileName, const QString& text);
 
   void setMessageHandlerConnection(ctkErrorLogAbstractMessageHandler * msgHandler, bool asynchronous);
 
-  QStandardItemModel StandardItemModel;
+  /// Index of \a value in Strings, added if needed
+  int intern(const QString& value);
 
-  QHash<QString, ctkErrorLogAbstractMessageHandler*> RegisteredHandlers;
+  /// Entry with the given sequence number, it must not be discarded yet.
+  const ctkErrorLogModelEntry& entry(qint64 sequence)const;
+  ctkErrorLogModelEntry& entry(qint64 sequence);
+
+  /// Sequence number of the entry listed at \a row
+  qint64 rowSequence(int row)const;
+
+  bool accepts(ctkErrorLogLevel::LogLevel logLevel)const;
+
+  /// Discard the \a count oldest entries
+  void discardEntries(int count);
+
+  /// Append entries with the same time, thread, level and origin, or a
+  /// single entry grouping all the \a texts if \a group is true.
+  void appendEntries(qint64 time, int threadId, ctkErrorLogLevel::LogLevel logLevel,
+                     int origin, const QStringList& texts, bool group);
 
-  ctkErrorLogLevel::LogLevels CurrentLogLevelFilter;
+  /// Resize the ring buffer to \a capacity entries and move the oldest entry first.
+  void reallocate(int capacity);
+
+  /// Ring buffer, grown up to MaximumEntryCount entries
+  QVector<ctkErrorLogModelEntry> Entries;
+  /// Position of the oldest entry in Entries
+  int   Start;
+  int   Count;
+  /// Sequence number of the oldest entry, incremented for each discarded entry
+  qint64 FirstSequence;
+  int   MaximumEntryCount;
+
+  /// Thread ids and origins of the entries
+  QVector<QString> Strings;
+  QHash<QString, int> StringIndices;
+
+  /// If filtered, the model lists the entries whose level is set in
+  /// LogLevelFilter, by increasing sequence number in FilteredSequences.
+  bool Filtered;
+  ctkErrorLogLevel::LogLevels LogLevelFilter;
+  QList<qint64> FilteredSequences;
+
+  QHash<QString, ctkErrorLogAbstractMessageHandler*> RegisteredHandlers;
 
   bool LogEntryGrouping;
   bool AsynchronousLogging;
@@ -217,6 +273,12 @@ public:
 ctkErrorLogModelPrivate::ctkErrorLogModelPrivate(ctkErrorLogModel& object)
   : q_ptr(&object)
 {
+  this->Start = 0;
+  this->Count = 0;
+  this->FirstSequence = 0;
+  this->MaximumEntryCount = 100000;
+  this->Filtered = false;
+  this->LogLevelFilter = ~ctkErrorLogLevel::LogLevels(ctkErrorLogLevel::None);
   this->LogEntryGrouping = false;
   this->AsynchronousLogging = true;
   this->AddingEntry = false;
@@ -236,15 +298,169 @@ ctkErrorLogModelPrivate::~ctkErrorLogModelPrivate()
 }
 
 // --------------------------------------------------------------------------
-void ctkErrorLogModelPrivate::init()
+int ctkErrorLogModelPrivate::intern(const QString& value)
+{
+  QHash<QString, int>::const_iterator it = this->StringIndices.constFind(value);
+  if (it != this->StringIndices.constEnd())
+    {
+    return it.value();
+    }
+  int index = this->Strings.size();
+  this->Strings.append(value);
+  this->StringIndices.insert(value, index);
+  return index;
+}
+
+// --------------------------------------------------------------------------
+const ctkErrorLogModelEntry& ctkErrorLogModelPrivate::entry(qint64 sequence)const
+{
+  Q_ASSERT(sequence >= this->FirstSequence && sequence < this->FirstSequence + this->Count);
+  return this->Entries.at((this->Start + static_cast<int>(sequence - this->FirstSequence)) % this->Entries.size());
+}
+
+// --------------------------------------------------------------------------
+ctkErrorLogModelEntry& ctkErrorLogModelPrivate::entry(qint64 sequence)
+{
+  Q_ASSERT(sequence >= this->FirstSequence && sequence < this->FirstSequence + this->Count);
+  return this->Entries[(this->Start + static_cast<int>(sequence - this->FirstSequence)) % this->Entries.size()];
+}
+
+// --------------------------------------------------------------------------
+qint64 ctkErrorLogModelPrivate::rowSequence(int row)const
+{
+  return this->Filtered ? this->FilteredSequences.at(row) : this->FirstSequence + row;
+}
+
+// --------------------------------------------------------------------------
+bool ctkErrorLogModelPrivate::accepts(ctkErrorLogLevel::LogLevel logLevel)const
+{
+  return !this->Filtered || (this->LogLevelFilter & logLevel);
+}
+
+// --------------------------------------------------------------------------
+void ctkErrorLogModelPrivate::discardEntries(int count)
+{
+  Q_Q(ctkErrorLogModel);
+  count = qMin(count, this->Count);
+  if (count <= 0)
+    {
+    return;
+    }
+
+  int removedRows = count;
+  if (this->Filtered)
+    {
+    removedRows = 0;
+    while (removedRows < this->FilteredSequences.size() &&
+           this->FilteredSequences.at(removedRows) < this->FirstSequence + count)
+      {
+      ++removedRows;
+      }
+    }
+
+  if (removedRows > 0)
+    {
+    q->beginRemoveRows(QModelIndex(), 0, removedRows - 1);
+    }
+  for (int i = 0; i < count; ++i)
+    {
+    // Release the text now rather than when the entry is overwritten
+    this->entry(this->FirstSequence + i).Text = QString();
+    }
+  this->Start = (this->Start + count) % this->Entries.size();
+  this->Count -= count;
+  this->FirstSequence += count;
+  if (this->Filtered)
+    {
+    this->FilteredSequences.erase(this->FilteredSequences.begin(),
+                                  this->FilteredSequences.begin() + removedRows);
+    }
+  if (removedRows > 0)
+    {
+    q->endRemoveRows();
+    }
+}
+
+// --------------------------------------------------------------------------
+void ctkErrorLogModelPrivate::appendEntries(qint64 time, int threadId,
+                                            ctkErrorLogLevel::LogLevel logLevel,
+                                            int origin, const QStringList& texts, bool group)
 {
   Q_Q(ctkErrorLogModel);
-  q->setDynamicSortFilter(true);
-  //
-  // WARNING - Using a QSortFilterProxyModel slows down the insertion of rows by a factor 10
-  //
-  q->setSourceModel(&this->StandardItemModel);
-  q->setFilterKeyColumn(ctkErrorLogModel::LogLevelColumn);
+
+  const QStringList entryTexts = group ? QStringList() << texts.join("\n") : texts;
+
+  // Only the last MaximumEntryCount entries would be kept
+  int first = qMax(0, entryTexts.size() - this->MaximumEntryCount);
+  int count = entryTexts.size() - first;
+  if (count <= 0)
+    {
+    return;
+    }
+
+  if (this->Count + count > this->MaximumEntryCount)
+    {
+    // Entries are full from now on, wrap around
+    this->reallocate(this->MaximumEntryCount);
+    this->discardEntries(this->Count + count - this->MaximumEntryCount);
+    }
+
+  bool accepted = this->accepts(logLevel);
+  int row = q->rowCount();
+  if (accepted)
+    {
+    q->beginInsertRows(QModelIndex(), row, row + count - 1);
+    }
+
+  ctkErrorLogModelEntry newEntry;
+  newEntry.Time = time;
+  newEntry.ThreadId = threadId;
+  newEntry.Origin = origin;
+  newEntry.LogLevel = logLevel;
+  for (int i = first; i < entryTexts.size(); ++i)
+    {
+    newEntry.Text = entryTexts.at(i);
+    newEntry.FirstMessageSize = group ? texts.first().size() : newEntry.Text.size();
+    if (this->Count == this->Entries.size())
+      {
+      Q_ASSERT(this->Start == 0);
+      this->Entries.append(newEntry);
+      }
+    else
+      {
+      this->Entries[(this->Start + this->Count) % this->Entries.size()] = newEntry;
+      }
+    if (accepted && this->Filtered)
+      {
+      this->FilteredSequences.append(this->FirstSequence + this->Count);
+      }
+    ++this->Count;
+    }
+
+  if (accepted)
+    {
+    q->endInsertRows();
+    }
+}
+
+// --------------------------------------------------------------------------
+void ctkErrorLogModelPrivate::reallocate(int capacity)
+{
+  Q_ASSERT(capacity >= this->Count);
+  if (this->Start == 0)
+    {
+    this->Entries.resize(capacity);
+    return;
+    }
+  // Even with the same capacity, the entries must be moved: appendEntries()
+  // appends to Entries while Count is its size and expects Start to be 0.
+  QVector<ctkErrorLogModelEntry> entries(capacity);
+  for (int i = 0; i < this->Count; ++i)
+    {
+    entries[i] = this->entry(this->FirstSequence + i);
+    }
+  this->Entries = entries;
+  this->Start = 0;
 }
 
 // --------------------------------------------------------------------------
@@ -270,6 +486,11 @@ void ctkErrorLogModelPrivate::setMessageHandlerConnection(
         SIGNAL(messageHandled(QDateTime,QString,ctkErrorLogLevel::LogLevel,QString,QString)),
         q, SLOT(addEntry(QDateTime,QString,ctkErrorLogLevel::LogLevel,QString,QString)),
         asynchronous ? Qt::QueuedConnection : Qt::BlockingQueuedConnection);
+
+  QObject::connect(msgHandler,
+        SIGNAL(messagesHandled(QDateTime,QString,ctkErrorLogLevel::LogLevel,QString,QStringList)),
+        q, SLOT(addEntries(QDateTime,QString,ctkErrorLogLevel::LogLevel,QString,QStringList)),
+        asynchronous ? Qt::QueuedConnection : Qt::BlockingQueuedConnection);
 }
 
 // --------------------------------------------------------------------------
@@ -280,9 +501,6 @@ ctkErrorLogModel::ctkErrorLogModel(QObject * parentObject)
   : Superclass(parentObject)
   , d_ptr(new ctkErrorLogModelPrivate(*this))
 {
-  Q_D(ctkErrorLogModel);
-
-  d->init();
 }
 
 //------------------------------------------------------------------------------
@@ -412,113 +630,63 @@ void ctkErrorLogModel::setTerminalOutputs(
 void ctkErrorLogModel::addEntry(const QDateTime& currentDateTime, const QString& threadId,
                                 ctkErrorLogLevel::LogLevel logLevel,
                                 const QString& origin, const QString& text)
+{
+  this->addEntries(currentDateTime, threadId, logLevel, origin, QStringList() << text);
+}
+
+//------------------------------------------------------------------------------
+void ctkErrorLogModel::addEntries(const QDateTime& currentDateTime, const QString& threadId,
+                                  ctkErrorLogLevel::LogLevel logLevel,
+                                  const QString& origin, const QStringList& texts)
 {
   Q_D(ctkErrorLogModel);
 
 //  d->appendToFile("/tmp/ctkErrorLogModel-appendToFile.txt",
 //                  QString("addEntry: %1").arg(QThread::currentThreadId()));
 
-  if (d->AddingEntry)
+  if (d->AddingEntry || texts.isEmpty())
     {
-//    QString str;
-//    QTextStream s(&str);
-//    s << "----------------------------------\n";
-//    s << "text=>" << text << "\n";
-//    s << "\tlogLevel:" << qPrintable(d->ErrorLogLevel(logLevel)) << "\n";
-//    s << "\torigin:" << qPrintable(origin) << "\n";
-//    d->appendToFile("/tmp/ctkErrorLogModel-AddingEntry-true.txt", str);
     return;
     }
 
   d->AddingEntry = true;
 
-  QString timeFormat("dd.MM.yyyy hh:mm:ss");
+  qint64 time = static_cast<qint64>(currentDateTime.toTime_t()) * 1000 + currentDateTime.time().msec();
+  int threadIdIndex = d->intern(threadId);
+  int originIndex = d->intern(origin);
 
   bool groupEntry = false;
-  if (d->LogEntryGrouping)
+  if (d->LogEntryGrouping && d->Count > 0)
     {
-    // Retrieve threadId associated with last row
-    QModelIndex lastRowThreadIdIndex =
-        d->StandardItemModel.index(d->StandardItemModel.rowCount() - 1, ctkErrorLogModel::ThreadIdColumn);
-
-    bool threadIdMatched = threadId == lastRowThreadIdIndex.data().toString();
-
-    // Retrieve logLevel associated with last row
-    QModelIndex lastRowLogLevelIndex =
-        d->StandardItemModel.index(d->StandardItemModel.rowCount() - 1, ctkErrorLogModel::LogLevelColumn);
-
-    bool logLevelMatched = d->ErrorLogLevel(logLevel) == lastRowLogLevelIndex.data().toString();
-
-    // Retrieve origin associated with last row
-    QModelIndex lastRowOriginIndex =
-        d->StandardItemModel.index(d->StandardItemModel.rowCount() - 1, ctkErrorLogModel::OriginColumn);
-
-    bool originMatched = origin == lastRowOriginIndex.data().toString();
-
-    // Retrieve time associated with last row
-    QModelIndex lastRowTimeIndex =
-            d->StandardItemModel.index(d->StandardItemModel.rowCount() - 1, ctkErrorLogModel::TimeColumn);
-    QDateTime lastRowDateTime = QDateTime::fromString(lastRowTimeIndex.data().toString(), timeFormat);
-
+    const ctkErrorLogModelEntry& lastEntry = d->entry(d->FirstSequence + d->Count - 1);
     int groupingIntervalInMsecs = 1000;
-    bool withinGroupingInterval = lastRowDateTime.time().msecsTo(currentDateTime.time()) <= groupingIntervalInMsecs;
-
-    groupEntry = threadIdMatched && logLevelMatched && originMatched && withinGroupingInterval;
+    groupEntry = lastEntry.ThreadId == threadIdIndex
+        && lastEntry.LogLevel == logLevel
+        && lastEntry.Origin == originIndex
+        && time - lastEntry.Time <= groupingIntervalInMsecs;
     }
 
-  if (!groupEntry)
+  if (groupEntry)
     {
-    QList<QStandardItem*> itemList;
-
-    // Time item
-    QStandardItem * timeItem = new QStandardItem(currentDateTime.toString(timeFormat));
-    timeItem->setEditable(false);
-    itemList << timeItem;
-
-    // ThreadId item
-    QStandardItem * threadIdItem = new QStandardItem(threadId);
-    threadIdItem->setEditable(false);
-    itemList << threadIdItem;
-
-    // LogLevel item
-    QStandardItem * logLevelItem = new QStandardItem(d->ErrorLogLevel(logLevel));
-    logLevelItem->setEditable(false);
-    itemList << logLevelItem;
-
-    // Origin item
-    QStandardItem * originItem = new QStandardItem(origin);
-    originItem->setEditable(false);
-    itemList << originItem;
-
-    // Description item
-    QStandardItem * descriptionItem = new QStandardItem();
-    QString descriptionText(text);
-    descriptionItem->setData(descriptionText.left(160).append((descriptionText.size() > 160) ? "..." : ""), Qt::DisplayRole);
-    descriptionItem->setData(descriptionText, ctkErrorLogModel::DescriptionTextRole);
-    descriptionItem->setEditable(false);
-    itemList << descriptionItem;
-
-    d->StandardItemModel.invisibleRootItem()->appendRow(itemList);
+    qint64 lastSequence = d->FirstSequence + d->Count - 1;
+    ctkErrorLogModelEntry& lastEntry = d->entry(lastSequence);
+    lastEntry.Text.append("\n").append(texts.join("\n"));
+    if (d->accepts(logLevel))
+      {
+      int row = d->Filtered ? d->FilteredSequences.size() - 1 : d->Count - 1;
+      QModelIndex index = this->index(row, ctkErrorLogModel::DescriptionColumn);
+      emit this->dataChanged(index, index);
+      }
+    }
+  else if (d->LogEntryGrouping)
+    {
+    // All the lines share the same thread, level, origin and time: they
+    // are grouped with each other.
+    d->appendEntries(time, threadIdIndex, logLevel, originIndex, texts, /* group= */ true);
     }
   else
     {
-    // Retrieve description associated with last row
-    QModelIndex lastRowDescriptionIndex =
-        d->StandardItemModel.index(d->StandardItemModel.rowCount() - 1, ctkErrorLogModel::DescriptionColumn);
-
-    QStringList updatedDescription;
-    updatedDescription << lastRowDescriptionIndex.data(ctkErrorLogModel::DescriptionTextRole).toString();
-    updatedDescription << text;
-
-    d->StandardItemModel.setData(lastRowDescriptionIndex, updatedDescription.join("\n"),
-                                 ctkErrorLogModel::DescriptionTextRole);
-
-    // Append '...' to displayText if needed
-    QString displayText = lastRowDescriptionIndex.data().toString();
-    if (!displayText.endsWith("..."))
-      {
-      d->StandardItemModel.setData(lastRowDescriptionIndex, displayText.append("..."), Qt::DisplayRole);
-      }
+    d->appendEntries(time, threadIdIndex, logLevel, originIndex, texts, /* group= */ false);
     }
 
   d->AddingEntry = false;
@@ -528,90 +696,159 @@ void ctkErrorLogModel::addEntry(const QDateTime& currentDateTime, const QString&
 void ctkErrorLogModel::clear()
 {
   Q_D(ctkErrorLogModel);
-  d->StandardItemModel.invisibleRootItem()->removeRows(0, d->StandardItemModel.rowCount());
+  this->beginResetModel();
+  d->FirstSequence += d->Count;
+  d->Entries.clear();
+  d->Start = 0;
+  d->Count = 0;
+  d->FilteredSequences.clear();
+  this->endResetModel();
 }
 
 //------------------------------------------------------------------------------
-void ctkErrorLogModel::filterEntry(const ctkErrorLogLevel::LogLevels& logLevel,
-                                   bool disableFilter)
+int ctkErrorLogModel::maximumEntryCount()const
+{
+  Q_D(const ctkErrorLogModel);
+  return d->MaximumEntryCount;
+}
+
+//------------------------------------------------------------------------------
+void ctkErrorLogModel::setMaximumEntryCount(int count)
 {
   Q_D(ctkErrorLogModel);
+  count = qMax(1, count);
+  if (count == d->MaximumEntryCount)
+    {
+    return;
+    }
+  d->discardEntries(d->Count - count);
+  d->reallocate(qMin(count, d->Count));
+  d->MaximumEntryCount = count;
+}
 
-  QStringList patterns;
-  if (!this->filterRegExp().pattern().isEmpty())
+//------------------------------------------------------------------------------
+int ctkErrorLogModel::rowCount(const QModelIndex& parent)const
+{
+  Q_D(const ctkErrorLogModel);
+  if (parent.isValid())
     {
-    patterns << this->filterRegExp().pattern().split("|");
+    return 0;
     }
-  patterns.removeAll(d->ErrorLogLevel(ctkErrorLogLevel::None));
+  return d->Filtered ? d->FilteredSequences.size() : d->Count;
+}
 
-//  foreach(QString s, patterns)
-//    {
-//    std::cout << "pattern:" << qPrintable(s) << std::endl;
-//    }
+//------------------------------------------------------------------------------
+int ctkErrorLogModel::columnCount(const QModelIndex& parent)const
+{
+  return parent.isValid() ? 0 : ctkErrorLogModel::DescriptionColumn + 1;
+}
+
+//------------------------------------------------------------------------------
+QVariant ctkErrorLogModel::data(const QModelIndex& index, int role)const
+{
+  Q_D(const ctkErrorLogModel);
+  if (!index.isValid() || index.row() >= this->rowCount())
+    {
+    return QVariant();
+    }
+  const ctkErrorLogModelEntry& entry = d->entry(d->rowSequence(index.row()));
+
+  if (role == ctkErrorLogModel::DescriptionTextRole)
+    {
+    return index.column() == ctkErrorLogModel::DescriptionColumn ? entry.Text : QVariant();
+    }
+  if (role != Qt::DisplayRole && role != Qt::EditRole)
+    {
+    return QVariant();
+    }
+
+  switch(index.column())
+    {
+    case ctkErrorLogModel::TimeColumn:
+      {
+      QDateTime dateTime = QDateTime::fromTime_t(static_cast<uint>(entry.Time / 1000));
+      return dateTime.toString("dd.MM.yyyy hh:mm:ss");
+      }
+    case ctkErrorLogModel::ThreadIdColumn:
+      return d->Strings.at(entry.ThreadId);
+    case ctkErrorLogModel::LogLevelColumn:
+      return d->ErrorLogLevel.logLevelAsString(entry.LogLevel);
+    case ctkErrorLogModel::OriginColumn:
+      return d->Strings.at(entry.Origin);
+    case ctkErrorLogModel::DescriptionColumn:
+      {
+      // Grouped messages are elided
+      int displayedSize = qMin(160, entry.FirstMessageSize);
+      QString displayText = entry.Text.left(displayedSize);
+      if (displayedSize < entry.Text.size())
+        {
+        displayText.append("...");
+        }
+      return displayText;
+      }
+    default:
+      return QVariant();
+    }
+}
+
+//------------------------------------------------------------------------------
+void ctkErrorLogModel::filterEntry(const ctkErrorLogLevel::LogLevels& logLevel,
+                                   bool disableFilter)
+{
+  Q_D(ctkErrorLogModel);
 
   QMetaEnum logLevelEnum = d->ErrorLogLevel.metaObject()->enumerator(0);
   Q_ASSERT(QString("LogLevel").compare(logLevelEnum.name()) == 0);
 
-  // Loop over enum values and append associated name to 'patterns' if
-  // it has been specified within 'logLevel'
+  // Until filtered, all levels are listed. The first call only lists the
+  // levels it enables.
+  ctkErrorLogLevel::LogLevels filter =
+      d->Filtered ? d->LogLevelFilter : ctkErrorLogLevel::LogLevels(ctkErrorLogLevel::None);
+
+  // Loop over enum values, skipping None
   for (int i = 1; i < logLevelEnum.keyCount(); ++i)
     {
     int aLogLevel = logLevelEnum.value(i);
     if (logLevel & aLogLevel)
       {
-      QString logLevelAsString = d->ErrorLogLevel(static_cast<ctkErrorLogLevel::LogLevel>(aLogLevel));
       if (!disableFilter)
         {
-        patterns << logLevelAsString;
-        d->CurrentLogLevelFilter |= static_cast<ctkErrorLogLevel::LogLevels>(aLogLevel);
+        filter |= static_cast<ctkErrorLogLevel::LogLevels>(aLogLevel);
         }
       else
         {
-        patterns.removeAll(logLevelAsString);
-        d->CurrentLogLevelFilter ^= static_cast<ctkErrorLogLevel::LogLevels>(aLogLevel);
+        filter &= ~static_cast<ctkErrorLogLevel::LogLevels>(aLogLevel);
         }
       }
     }
 
-  if (patterns.isEmpty())
+  bool filterChanged = !d->Filtered || filter != d->LogLevelFilter;
+  if (!filterChanged)
     {
-    // If there are no patterns, let's filter with the None level so that
-    // all entries are filtered out.
-    patterns << d->ErrorLogLevel(ctkErrorLogLevel::None);
+    return;
     }
 
-  bool filterChanged = true;
-  QStringList currentPatterns = this->filterRegExp().pattern().split("|");
-  if (currentPatterns.count() == patterns.count())
+  this->beginResetModel();
+  d->Filtered = true;
+  d->LogLevelFilter = filter;
+  d->FilteredSequences.clear();
+  for (qint64 sequence = d->FirstSequence; sequence < d->FirstSequence + d->Count; ++sequence)
     {
-    foreach(const QString& p, patterns)
+    if (d->LogLevelFilter & d->entry(sequence).LogLevel)
       {
-      currentPatterns.removeAll(p);
+      d->FilteredSequences.append(sequence);
       }
-    filterChanged = currentPatterns.count() > 0;
     }
+  this->endResetModel();
 
-  this->setFilterRegExp(patterns.join("|"));
-
-  if (filterChanged)
-    {
-    emit this->logLevelFilterChanged();
-    }
+  emit this->logLevelFilterChanged();
 }
 
 //------------------------------------------------------------------------------
 ctkErrorLogLevel::LogLevels ctkErrorLogModel::logLevelFilter()const
 {
   Q_D(const ctkErrorLogModel);
-  QMetaEnum logLevelEnum = d->ErrorLogLevel.metaObject()->enumerator(0);
-  Q_ASSERT(QString("LogLevel").compare(logLevelEnum.name()) == 0);
-
-  ctkErrorLogLevel::LogLevels filter = ctkErrorLogLevel::Unknown;
-  foreach(const QString& filterAsString, this->filterRegExp().pattern().split("|"))
-    {
-    filter |= static_cast<ctkErrorLogLevel::LogLevels>(logLevelEnum.keyToValue(filterAsString.toLatin1()));
-    }
-  return filter;
+  return d->LogLevelFilter;
 }
 
 //------------------------------------------------------------------------------
@@ -760,6 +997,25 @@ void ctkErrorLogAbstractMessageHandler::handleMessage(const QString& threadId,
   emit this->messageHandled(QDateTime::currentDateTime(), threadId, logLevel, origin, text);
 }
 
+// --------------------------------------------------------------------------
+void ctkErrorLogAbstractMessageHandler::handleMessages(const QString& threadId,
+                                                       ctkErrorLogLevel::LogLevel logLevel,
+                                                       const QString& origin, const QStringList& texts)
+{
+  Q_D(ctkErrorLogAbstractMessageHandler);
+  if (texts.isEmpty())
+    {
+    return;
+    }
+  ctkErrorLogModel::TerminalOutput terminalOutputType =
+      logLevel <= ctkErrorLogLevel::Info ? ctkErrorLogModel::StandardOutput : ctkErrorLogModel::StandardError;
+  if(d->TerminalOutputs.contains(terminalOutputType))
+    {
+    d->TerminalOutputs.value(terminalOutputType)->output(texts.join("\n"));
+    }
+  emit this->messagesHandled(QDateTime::currentDateTime(), threadId, logLevel, origin, texts);
+}
+
 // --------------------------------------------------------------------------
 ctkErrorLogTerminalOutput* ctkErrorLogAbstractMessageHandler::terminalOutput(
     ctkErrorLogModel::TerminalOutput terminalOutputType)const
@@ -22,8 +22,9 @@
 #define __ctkErrorLogModel_h
 
 // Qt includes
+#include <QAbstractTableModel>
 #include <QPointer>
-#include <QSortFilterProxyModel>
+#include <QStringList>
 
 // CTK includes
 #include "ctkCoreExport.h"
@@ -91,15 +92,20 @@ class ctkErrorLogModelPrivate;
 
 //------------------------------------------------------------------------------
 /// \ingroup Core
-class CTK_CORE_EXPORT ctkErrorLogModel : public QSortFilterProxyModel
+/// Table of the messages logged by the registered handlers.
+/// Entries are kept in a ring buffer: once maximumEntryCount() entries are
+/// logged, the oldest ones are discarded. The rows are the entries whose
+/// level passes logLevelFilter().
+class CTK_CORE_EXPORT ctkErrorLogModel : public QAbstractTableModel
 {
   Q_OBJECT
   Q_FLAGS(TerminalOutput)
   Q_PROPERTY(bool logEntryGrouping READ logEntryGrouping WRITE setLogEntryGrouping)
   Q_PROPERTY(TerminalOutput terminalOutputs READ terminalOutputs WRITE  setTerminalOutputs)
   Q_PROPERTY(bool asynchronousLogging READ asynchronousLogging WRITE  setAsynchronousLogging)
+  Q_PROPERTY(int maximumEntryCount READ maximumEntryCount WRITE setMaximumEntryCount)
 public:
-  typedef QSortFilterProxyModel Superclass;
+  typedef QAbstractTableModel Superclass;
   typedef ctkErrorLogModel Self;
   explicit ctkErrorLogModel(QObject* parentObject = 0);
   virtual ~ctkErrorLogModel();
@@ -159,10 +165,23 @@ public:
   /// Remove all message from model
   void clear();
 
+  /// Levels of the entries listed by the model, all of them until
+  /// filterEntry() is called.
   ctkErrorLogLevel::LogLevels logLevelFilter()const;
 
+  /// Show (or hide if \a disableFilter is true) the entries of the levels
+  /// set in \a logLevel. The first call hides the levels not set in \a logLevel.
   void filterEntry(const ctkErrorLogLevel::LogLevels& logLevel = ctkErrorLogLevel::Unknown, bool disableFilter = false);
 
+  /// Number of entries kept by the model, 100000 by default. The oldest
+  /// entries are discarded first.
+  int maximumEntryCount()const;
+  void setMaximumEntryCount(int count);
+
+  virtual int rowCount(const QModelIndex& parent = QModelIndex())const;
+  virtual int columnCount(const QModelIndex& parent = QModelIndex())const;
+  virtual QVariant data(const QModelIndex& index, int role = Qt::DisplayRole)const;
+
   bool logEntryGrouping()const;
   void setLogEntryGrouping(bool value);
 
@@ -173,6 +192,13 @@ public Q_SLOTS:
   void addEntry(const QDateTime& currentDateTime, const QString& threadId,
                 ctkErrorLogLevel::LogLevel logLevel, const QString& origin, const QString& text);
 
+  /// Add one entry per line of \a texts, all of them sharing the same time,
+  /// thread, level and origin. With log entry grouping, the lines are
+  /// appended to a single entry.
+  /// \sa ctkErrorLogAbstractMessageHandler::handleMessages()
+  void addEntries(const QDateTime& currentDateTime, const QString& threadId,
+                  ctkErrorLogLevel::LogLevel logLevel, const QString& origin, const QStringList& texts);
+
 Q_SIGNALS:
   void logLevelFilterChanged();
 
@@ -209,6 +235,12 @@ public:
   void handleMessage(const QString& threadId, ctkErrorLogLevel::LogLevel logLevel,
                      const QString& origin, const QString& text);
 
+  /// Handle a burst of messages at once: they are written to the terminal
+  /// with a single write and reach the model with a single messagesHandled()
+  /// signal instead of one messageHandled() signal per message.
+  void handleMessages(const QString& threadId, ctkErrorLogLevel::LogLevel logLevel,
+                      const QString& origin, const QStringList& texts);
+
   ctkErrorLogTerminalOutput* terminalOutput(ctkErrorLogModel::TerminalOutput terminalOutputType)const;
   void setTerminalOutput(ctkErrorLogModel::TerminalOutput terminalOutputType,
                          ctkErrorLogTerminalOutput * terminalOutput);
@@ -218,6 +250,10 @@ Q_SIGNALS:
                       ctkErrorLogLevel::LogLevel logLevel, const QString& origin,
                       const QString& text);
 
+  void messagesHandled(const QDateTime& currentDateTime, const QString& threadId,
+                       ctkErrorLogLevel::LogLevel logLevel, const QString& origin,
+                       const QStringList& texts);
+
 protected:
   void setHandlerPrettyName(const QString& newHandlerPrettyName);
 
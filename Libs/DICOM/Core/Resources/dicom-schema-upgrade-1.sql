@@ -0,0 +1,19 @@
+-- 
+-- Upgrade a DICOM database without schema version (version 0) to version 1:
+-- adds the schema version table and the secondary indexes.
+-- 
+-- Note: the semicolon at the end is necessary for the simple parser to separate
+--       the statements since the SQlite driver does not handle multiple
+--       commands per QSqlQuery::exec call!
+-- ;
+
+CREATE TABLE IF NOT EXISTS 'SchemaInfo' (
+  'Version' INT NOT NULL );
+DELETE FROM 'SchemaInfo' ;
+INSERT INTO 'SchemaInfo' ('Version') VALUES (1) ;
+
+CREATE INDEX IF NOT EXISTS 'ImagesFilenameIndex' ON 'Images' ('Filename') ;
+CREATE INDEX IF NOT EXISTS 'ImagesSeriesIndex' ON 'Images' ('SeriesInstanceUID') ;
+CREATE INDEX IF NOT EXISTS 'SeriesStudyIndex' ON 'Series' ('StudyInstanceUID') ;
+CREATE INDEX IF NOT EXISTS 'StudiesPatientIndex' ON 'Studies' ('PatientsUID') ;
+CREATE INDEX IF NOT EXISTS 'PatientsIDNameIndex' ON 'Patients' ('PatientID', 'PatientsName') ;
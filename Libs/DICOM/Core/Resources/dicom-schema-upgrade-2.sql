@@ -0,0 +1,15 @@
+-- 
+-- Upgrade a DICOM database from schema version 1 to version 2:
+-- records the size, modification time and inode of the image files
+-- to detect changes on disk (see ctkDICOMIndexer::refreshDatabase()).
+-- The columns of the existing images are left NULL until the next refresh.
+-- 
+-- Note: the semicolon at the end is necessary for the simple parser to separate
+--       the statements since the SQlite driver does not handle multiple
+--       commands per QSqlQuery::exec call!
+-- ;
+
+ALTER TABLE 'Images' ADD COLUMN 'FileSize' INT NULL ;
+ALTER TABLE 'Images' ADD COLUMN 'FileModified' INT NULL ;
+ALTER TABLE 'Images' ADD COLUMN 'FileInode' INT NULL ;
+UPDATE 'SchemaInfo' SET 'Version' = 2 ;
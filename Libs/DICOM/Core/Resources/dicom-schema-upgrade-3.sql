@@ -0,0 +1,13 @@
+-- 
+-- Upgrade a DICOM database from schema version 2 to version 3:
+-- case insensitive indexes on the text columns searched by ctkDICOMModel.
+-- 
+-- Note: the semicolon at the end is necessary for the simple parser to separate
+--       the statements since the SQlite driver does not handle multiple
+--       commands per QSqlQuery::exec call!
+-- ;
+
+CREATE INDEX IF NOT EXISTS 'PatientsNameIndex' ON 'Patients' ('PatientsName' COLLATE NOCASE) ;
+CREATE INDEX IF NOT EXISTS 'StudiesDescriptionIndex' ON 'Studies' ('StudyDescription' COLLATE NOCASE) ;
+CREATE INDEX IF NOT EXISTS 'SeriesDescriptionIndex' ON 'Series' ('SeriesDescription' COLLATE NOCASE) ;
+UPDATE 'SchemaInfo' SET 'Version' = 3 ;
@@ -0,0 +1,20 @@
+-- 
+-- Upgrade a DICOM database from schema version 3 to version 4:
+-- records the files that could not be inserted, e.g. not DICOM, so that
+-- ctkDICOMIndexer::refreshDatabase() doesn't parse them again while they
+-- are unchanged. The modification times are now in milliseconds, the file
+-- states of the existing images are recorded again on the next refresh.
+-- 
+-- Note: the semicolon at the end is necessary for the simple parser to separate
+--       the statements since the SQlite driver does not handle multiple
+--       commands per QSqlQuery::exec call!
+-- ;
+
+CREATE TABLE IF NOT EXISTS 'RejectedFiles' (
+  'Filename' VARCHAR(1024) NOT NULL ,
+  'FileSize' INT NULL ,
+  'FileModified' INT NULL ,
+  'FileInode' INT NULL ,
+  PRIMARY KEY ('Filename') );
+UPDATE 'Images' SET 'FileSize' = NULL, 'FileModified' = NULL, 'FileInode' = NULL ;
+UPDATE 'SchemaInfo' SET 'Version' = 4 ;
@@ -0,0 +1,14 @@
+-- 
+-- Upgrade a DICOM database from schema version 4 to version 5:
+-- ctkDICOMModel searches the text columns anywhere again, which can't use
+-- the case insensitive indexes added by version 3.
+-- 
+-- Note: the semicolon at the end is necessary for the simple parser to separate
+--       the statements since the SQlite driver does not handle multiple
+--       commands per QSqlQuery::exec call!
+-- ;
+
+DROP INDEX IF EXISTS 'PatientsNameIndex' ;
+DROP INDEX IF EXISTS 'StudiesDescriptionIndex' ;
+DROP INDEX IF EXISTS 'SeriesDescriptionIndex' ;
+UPDATE 'SchemaInfo' SET 'Version' = 5 ;
@@ -11,12 +11,21 @@ DROP TABLE IF EXISTS 'Patients' ;
 DROP TABLE IF EXISTS 'Series' ;
 DROP TABLE IF EXISTS 'Studies' ;
 DROP TABLE IF EXISTS 'Directories' ;
+DROP TABLE IF EXISTS 'RejectedFiles' ;
+DROP TABLE IF EXISTS 'SchemaInfo' ;
+
+CREATE TABLE 'SchemaInfo' (
+  'Version' INT NOT NULL );
+INSERT INTO 'SchemaInfo' ('Version') VALUES (5) ;
 
 CREATE TABLE 'Images' (
   'SOPInstanceUID' VARCHAR(64) NOT NULL,
   'Filename' VARCHAR(1024) NOT NULL ,
   'SeriesInstanceUID' VARCHAR(64) NOT NULL ,
   'InsertTimestamp' VARCHAR(20) NOT NULL ,
+  'FileSize' INT NULL ,
+  'FileModified' INT NULL ,
+  'FileInode' INT NULL ,
   PRIMARY KEY ('SOPInstanceUID') );
 CREATE TABLE 'Patients' (
   'UID' INTEGER PRIMARY KEY AUTOINCREMENT,
@@ -59,3 +68,16 @@ CREATE TABLE 'Studies' (
 CREATE TABLE 'Directories' (
   'Dirname' VARCHAR(1024) ,
   PRIMARY KEY ('Dirname') );
+
+CREATE TABLE 'RejectedFiles' (
+  'Filename' VARCHAR(1024) NOT NULL ,
+  'FileSize' INT NULL ,
+  'FileModified' INT NULL ,
+  'FileInode' INT NULL ,
+  PRIMARY KEY ('Filename') );
+
+CREATE INDEX 'ImagesFilenameIndex' ON 'Images' ('Filename') ;
+CREATE INDEX 'ImagesSeriesIndex' ON 'Images' ('SeriesInstanceUID') ;
+CREATE INDEX 'SeriesStudyIndex' ON 'Series' ('StudyInstanceUID') ;
+CREATE INDEX 'StudiesPatientIndex' ON 'Studies' ('PatientsUID') ;
+CREATE INDEX 'PatientsIDNameIndex' ON 'Patients' ('PatientID', 'PatientsName') ;
@@ -0,0 +1,127 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QTime>
+
+// ctkCore includes
+#include "ctkUtils.h"
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
+#include "ctkDICOMTester.h"
+
+// STD includes
+#include <iostream>
+#include <cstdlib>
+
+namespace
+{
+//------------------------------------------------------------------------------
+int countImages(ctkDICOMDatabase& database)
+{
+  QStringList result = database.runQuery("SELECT COUNT(*) FROM Images");
+  return result.isEmpty() ? 0 : result.first().toInt();
+}
+}
+
+//------------------------------------------------------------------------------
+// Compare the insert throughput of single inserts with batch inserts.
+// Usage: ctkDICOMDatabaseTest2 [studies] [seriesPerStudy] [imagesPerSeries]
+int ctkDICOMDatabaseTest2( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  QStringList arguments = app.arguments();
+  arguments.pop_front();
+  int studies = arguments.count() > 0 ? arguments.at(0).toInt() : 10;
+  int seriesPerStudy = arguments.count() > 1 ? arguments.at(1).toInt() : 2;
+  int imagesPerSeries = arguments.count() > 2 ? arguments.at(2).toInt() : 10;
+
+  QDir tempDirectory(QDir::tempPath() + "/ctkDICOMDatabaseTest2");
+  ctk::removeDirRecursively(tempDirectory.absolutePath());
+  tempDirectory.mkpath(".");
+
+  ctkDICOMTester tester;
+  QStringList files = tester.createSyntheticData(
+    tempDirectory.absoluteFilePath("data"), studies, seriesPerStudy, imagesPerSeries);
+  if (files.count() != studies * seriesPerStudy * imagesPerSeries)
+    {
+    std::cerr << "ctkDICOMTester::createSyntheticData() failed: "
+              << files.count() << " files written" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Single inserts, one implicit transaction per statement
+  ctkDICOMDatabase singleDatabase;
+  singleDatabase.openDatabase(tempDirectory.absoluteFilePath("single.sql"), "single");
+  QTime timer;
+  timer.start();
+  foreach(const QString& file, files)
+    {
+    singleDatabase.insert(file, false, false);
+    }
+  int singleElapsed = qMax(1, timer.elapsed());
+
+  // Batch inserts
+  ctkDICOMDatabase batchDatabase;
+  batchDatabase.openDatabase(tempDirectory.absoluteFilePath("batch.sql"), "batch");
+  timer.start();
+  batchDatabase.insert(files, false, false);
+  int batchElapsed = qMax(1, timer.elapsed());
+
+  if (batchDatabase.isBatchInsert())
+    {
+    std::cerr << "ctkDICOMDatabase::insert(QStringList) failed: "
+              << "batch is not closed" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  std::cout << "single insert: " << files.count() * 1000.0 / singleElapsed
+            << " files/sec" << std::endl;
+  std::cout << "batch insert:  " << files.count() * 1000.0 / batchElapsed
+            << " files/sec" << std::endl;
+
+  if (countImages(singleDatabase) != files.count() ||
+      countImages(batchDatabase) != files.count())
+    {
+    std::cerr << "ctkDICOMDatabase::insert() failed: "
+              << countImages(singleDatabase) << " images (single), "
+              << countImages(batchDatabase) << " images (batch), "
+              << files.count() << " expected" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (singleDatabase.patients().count() != batchDatabase.patients().count() ||
+      batchDatabase.patients().count() != studies)
+    {
+    std::cerr << "ctkDICOMDatabase::insert() failed: "
+              << batchDatabase.patients().count() << " patients" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  singleDatabase.closeDatabase();
+  batchDatabase.closeDatabase();
+  ctk::removeDirRecursively(tempDirectory.absolutePath());
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,264 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QTime>
+#include <QVariant>
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
+
+// STD includes
+#include <iostream>
+#include <cstdlib>
+
+namespace
+{
+const int ImagesPerSeries = 100;
+const int SeriesPerStudy = 5;
+const int Repeat = 100;
+
+//------------------------------------------------------------------------------
+void populate(const QSqlDatabase& sqlDatabase, int numberOfImages)
+{
+  QSqlDatabase db = sqlDatabase;
+  db.transaction();
+  QSqlQuery insertPatient(db);
+  insertPatient.prepare("INSERT INTO Patients ('UID', 'PatientsName', 'PatientID') VALUES ( ?, ?, ? )");
+  QSqlQuery insertStudy(db);
+  insertStudy.prepare("INSERT INTO Studies ('StudyInstanceUID', 'PatientsUID') VALUES ( ?, ? )");
+  QSqlQuery insertSeries(db);
+  insertSeries.prepare("INSERT INTO Series ('SeriesInstanceUID', 'StudyInstanceUID') VALUES ( ?, ? )");
+  QSqlQuery insertImage(db);
+  insertImage.prepare("INSERT INTO Images ('SOPInstanceUID', 'Filename', 'SeriesInstanceUID', 'InsertTimestamp') VALUES ( ?, ?, ?, ? )");
+  QString timestamp = QDateTime::currentDateTime().toString(Qt::ISODate);
+  for (int image = 0; image < numberOfImages; ++image)
+    {
+    int series = image / ImagesPerSeries;
+    int study = series / SeriesPerStudy;
+    if (image % (ImagesPerSeries * SeriesPerStudy) == 0)
+      {
+      insertPatient.bindValue(0, study + 1);
+      insertPatient.bindValue(1, QString("Patient^%1").arg(study));
+      insertPatient.bindValue(2, QString("ID%1").arg(study));
+      insertPatient.exec();
+      insertStudy.bindValue(0, QString("1.2.3.%1").arg(study));
+      insertStudy.bindValue(1, study + 1);
+      insertStudy.exec();
+      }
+    if (image % ImagesPerSeries == 0)
+      {
+      insertSeries.bindValue(0, QString("1.2.3.%1.%2").arg(study).arg(series));
+      insertSeries.bindValue(1, QString("1.2.3.%1").arg(study));
+      insertSeries.exec();
+      }
+    insertImage.bindValue(0, QString("1.2.3.%1.%2.%3").arg(study).arg(series).arg(image));
+    insertImage.bindValue(1, QString("/data/%1/%2/%3.dcm").arg(study).arg(series).arg(image));
+    insertImage.bindValue(2, QString("1.2.3.%1.%2").arg(study).arg(series));
+    insertImage.bindValue(3, timestamp);
+    insertImage.exec();
+    }
+  db.commit();
+}
+
+//------------------------------------------------------------------------------
+// Create a database with the schema used before schema versioning.
+bool createLegacyDatabase(const QString& fileName, int numberOfImages)
+{
+  bool res = true;
+  {
+  QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "legacy");
+  db.setDatabaseName(fileName);
+  if (!db.open())
+    {
+    return false;
+    }
+  QSqlQuery query(db);
+  res = query.exec("CREATE TABLE 'Images' ( 'SOPInstanceUID' VARCHAR(64) NOT NULL, "
+                   "'Filename' VARCHAR(1024) NOT NULL, 'SeriesInstanceUID' VARCHAR(64) NOT NULL, "
+                   "'InsertTimestamp' VARCHAR(20) NOT NULL, PRIMARY KEY ('SOPInstanceUID') )") && res;
+  res = query.exec("CREATE TABLE 'Patients' ( 'UID' INTEGER PRIMARY KEY AUTOINCREMENT, "
+                   "'PatientsName' VARCHAR(255) NULL, 'PatientID' VARCHAR(255) NULL, "
+                   "'PatientsBirthDate' DATE NULL, 'PatientsBirthTime' TIME NULL, "
+                   "'PatientsSex' varchar(1) NULL, 'PatientsAge' varchar(10) NULL, "
+                   "'PatientsComments' VARCHAR(255) NULL )") && res;
+  res = query.exec("CREATE TABLE 'Series' ( 'SeriesInstanceUID' VARCHAR(64) NOT NULL, "
+                   "'StudyInstanceUID' VARCHAR(64) NOT NULL, 'SeriesNumber' INT NULL, "
+                   "'SeriesDate' DATE NULL, 'SeriesTime' VARCHAR(20) NULL, "
+                   "'SeriesDescription' VARCHAR(255) NULL, 'BodyPartExamined' VARCHAR(255) NULL, "
+                   "'FrameOfReferenceUID' VARCHAR(64) NULL, 'AcquisitionNumber' INT NULL, "
+                   "'ContrastAgent' VARCHAR(255) NULL, 'ScanningSequence' VARCHAR(45) NULL, "
+                   "'EchoNumber' INT NULL, 'TemporalPosition' INT NULL, "
+                   "PRIMARY KEY ('SeriesInstanceUID') )") && res;
+  res = query.exec("CREATE TABLE 'Studies' ( 'StudyInstanceUID' VARCHAR(64) NOT NULL, "
+                   "'PatientsUID' INT NOT NULL, 'StudyID' VARCHAR(255) NULL, 'StudyDate' DATE NULL, "
+                   "'StudyTime' VARCHAR(20) NULL, 'AccessionNumber' VARCHAR(255) NULL, "
+                   "'ModalitiesInStudy' VARCHAR(255) NULL, 'InstitutionName' VARCHAR(255) NULL, "
+                   "'ReferringPhysician' VARCHAR(255) NULL, 'PerformingPhysiciansName' VARCHAR(255) NULL, "
+                   "'StudyDescription' VARCHAR(255) NULL, PRIMARY KEY ('StudyInstanceUID') )") && res;
+  res = query.exec("CREATE TABLE 'Directories' ( 'Dirname' VARCHAR(1024), PRIMARY KEY ('Dirname') )") && res;
+  if (res)
+    {
+    populate(db, numberOfImages);
+    }
+  db.close();
+  }
+  QSqlDatabase::removeDatabase("legacy");
+  return res;
+}
+
+//------------------------------------------------------------------------------
+void timeLookups(ctkDICOMDatabase& database, int numberOfImages, const char* label)
+{
+  int numberOfSeries = numberOfImages / ImagesPerSeries;
+  int numberOfStudies = qMax(1, numberOfSeries / SeriesPerStudy);
+  QTime timer;
+
+  // Look up the last rows, the worst case of a table scan
+  int study = numberOfStudies - 1;
+  int series = numberOfSeries - 1;
+
+  timer.start();
+  for (int i = 0; i < Repeat; ++i)
+    {
+    database.studiesForPatient(QString::number(study + 1));
+    }
+  std::cout << label << " studiesForPatient:      "
+            << static_cast<double>(timer.elapsed()) / Repeat << " ms" << std::endl;
+
+  timer.start();
+  for (int i = 0; i < Repeat; ++i)
+    {
+    database.seriesForStudy(QString("1.2.3.%1").arg(study));
+    }
+  std::cout << label << " seriesForStudy:         "
+            << static_cast<double>(timer.elapsed()) / Repeat << " ms" << std::endl;
+
+  timer.start();
+  for (int i = 0; i < Repeat; ++i)
+    {
+    database.filesForSeries(QString("1.2.3.%1.%2").arg(series / SeriesPerStudy).arg(series));
+    }
+  std::cout << label << " filesForSeries:         "
+            << static_cast<double>(timer.elapsed()) / Repeat << " ms" << std::endl;
+
+  timer.start();
+  for (int i = 0; i < Repeat; ++i)
+    {
+    database.fileExistsAndUpToDate(QString("/data/%1/%2/%3.dcm").arg(study).arg(series).arg(numberOfImages - 1));
+    }
+  std::cout << label << " fileExistsAndUpToDate:  "
+            << static_cast<double>(timer.elapsed()) / Repeat << " ms" << std::endl;
+
+  timer.start();
+  for (int i = 0; i < Repeat; ++i)
+    {
+    database.runQuery(QString("SELECT UID FROM Patients WHERE PatientID = 'ID%1' AND PatientsName = 'Patient^%1'").arg(study));
+    }
+  std::cout << label << " patient lookup:         "
+            << static_cast<double>(timer.elapsed()) / Repeat << " ms" << std::endl;
+
+  timer.start();
+  database.patients();
+  std::cout << label << " patients:               " << timer.elapsed() << " ms" << std::endl;
+}
+
+}
+
+//------------------------------------------------------------------------------
+// Time the public lookups of ctkDICOMDatabase on a large synthetic database
+// created with the schema used before schema versioning, once upgraded by
+// ctkDICOMDatabase::openDatabase() and then without the indexes.
+// Usage: ctkDICOMDatabaseTest3 [numberOfImages]
+// 1000 images by default, run with 1000000 for a meaningful benchmark.
+int ctkDICOMDatabaseTest3( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  QStringList arguments = app.arguments();
+  arguments.pop_front();
+  int numberOfImages = arguments.count() > 0 ? arguments.at(0).toInt() : 1000;
+
+  QFileInfo databaseFile(QDir::temp(), QString("ctkDICOMDatabaseTest3.sql"));
+  QFile::remove(databaseFile.absoluteFilePath());
+
+  QTime timer;
+  timer.start();
+  if (!createLegacyDatabase(databaseFile.absoluteFilePath(), numberOfImages))
+    {
+    std::cerr << "Failed to create the legacy database" << std::endl;
+    return EXIT_FAILURE;
+    }
+  std::cout << "populated " << numberOfImages << " images in "
+            << timer.elapsed() << " ms" << std::endl;
+
+  ctkDICOMDatabase database;
+  timer.start();
+  database.openDatabase(databaseFile.absoluteFilePath(), "upgraded");
+  std::cout << "upgraded schema in " << timer.elapsed() << " ms" << std::endl;
+  if (!database.lastError().isEmpty() ||
+      database.schemaVersionLoaded() != ctkDICOMDatabase::schemaVersion())
+    {
+    std::cerr << "ctkDICOMDatabase::openDatabase() failed to upgrade the schema: "
+              << qPrintable(database.lastError()) << std::endl;
+    return EXIT_FAILURE;
+    }
+  int numberOfSeries = numberOfImages / ImagesPerSeries;
+  if (database.filesForSeries(QString("1.2.3.0.0")).count() != qMin(numberOfImages, ImagesPerSeries) ||
+      database.seriesForStudy(QString("1.2.3.0")).count() != qMin(numberOfSeries, SeriesPerStudy))
+    {
+    std::cerr << "ctkDICOMDatabase::upgradeSchema() lost data" << std::endl;
+    return EXIT_FAILURE;
+    }
+  timeLookups(database, numberOfImages, "[indexed] ");
+
+  // Compare with the same database without the indexes
+  QSqlQuery dropIndex(database.database());
+  dropIndex.exec("DROP INDEX ImagesFilenameIndex");
+  dropIndex.exec("DROP INDEX ImagesSeriesIndex");
+  dropIndex.exec("DROP INDEX SeriesStudyIndex");
+  dropIndex.exec("DROP INDEX StudiesPatientIndex");
+  dropIndex.exec("DROP INDEX PatientsIDNameIndex");
+  timeLookups(database, numberOfImages, "[no index]");
+
+  // A database written by a newer version is opened as is
+  QSqlQuery newerSchema(database.database());
+  newerSchema.exec(QString("UPDATE SchemaInfo SET Version = %1")
+                   .arg(ctkDICOMDatabase::schemaVersion() + 1));
+  database.closeDatabase();
+  ctkDICOMDatabase newerDatabase;
+  newerDatabase.openDatabase(databaseFile.absoluteFilePath(), "newer");
+  if (!newerDatabase.isOpen() ||
+      newerDatabase.schemaVersionLoaded() != ctkDICOMDatabase::schemaVersion() + 1)
+    {
+    std::cerr << "Failed to open a database with a newer schema" << std::endl;
+    return EXIT_FAILURE;
+    }
+  newerDatabase.closeDatabase();
+
+  QFile::remove(databaseFile.absoluteFilePath());
+  return EXIT_SUCCESS;
+}
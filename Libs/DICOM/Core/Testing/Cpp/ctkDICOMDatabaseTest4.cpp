@@ -0,0 +1,196 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QTime>
+
+// ctkCore includes
+#include "ctkUtils.h"
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
+#include "ctkDICOMDataset.h"
+#include "ctkDICOMTester.h"
+
+// DCMTK includes
+#include <dcmtk/dcmdata/dcdeftag.h>
+
+// STD includes
+#include <iostream>
+#include <cstdlib>
+
+namespace
+{
+//------------------------------------------------------------------------------
+int countStoredFiles(const QString& databaseDirectory)
+{
+  int count = 0;
+  QDirIterator it(databaseDirectory + "/dicom", QDir::Files, QDirIterator::Subdirectories);
+  while (it.hasNext())
+    {
+    it.next();
+    ++count;
+    }
+  return count;
+}
+
+//------------------------------------------------------------------------------
+qint64 totalSize(const QStringList& files)
+{
+  qint64 size = 0;
+  foreach(const QString& file, files)
+    {
+    size += QFileInfo(file).size();
+    }
+  return size;
+}
+}
+
+//------------------------------------------------------------------------------
+// Compare the import throughput of the storage policies.
+// Usage: ctkDICOMDatabaseTest4 [studies] [imagesPerSeries] [pixelDataSize]
+int ctkDICOMDatabaseTest4( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  QStringList arguments = app.arguments();
+  arguments.pop_front();
+  int studies = arguments.count() > 0 ? arguments.at(0).toInt() : 2;
+  int imagesPerSeries = arguments.count() > 1 ? arguments.at(1).toInt() : 20;
+  int pixelDataSize = arguments.count() > 2 ? arguments.at(2).toInt() : 512 * 1024;
+
+  QDir tempDirectory(QDir::tempPath() + "/ctkDICOMDatabaseTest4");
+  ctk::removeDirRecursively(tempDirectory.absolutePath());
+  tempDirectory.mkpath(".");
+
+  const char* policyNames[] = {"copy", "hard link", "reflink", "move"};
+  ctkDICOMTester tester;
+  QStringList files;
+  for (int policy = ctkDICOMDatabase::CopyFiles;
+       policy <= ctkDICOMDatabase::MoveFiles; ++policy)
+    {
+    // Moving consumes the input files
+    if (files.isEmpty() || !QFile::exists(files.first()))
+      {
+      files = tester.createSyntheticData(
+        tempDirectory.absoluteFilePath("data"), studies, 1, imagesPerSeries, pixelDataSize);
+      if (files.count() != studies * imagesPerSeries)
+        {
+        std::cerr << "ctkDICOMTester::createSyntheticData() failed: "
+                  << files.count() << " files written" << std::endl;
+        return EXIT_FAILURE;
+        }
+      }
+    qint64 size = totalSize(files);
+
+    QString databaseDirectory =
+      tempDirectory.absoluteFilePath(QString("database%1").arg(policy));
+    QDir().mkpath(databaseDirectory);
+    ctkDICOMDatabase database;
+    database.openDatabase(databaseDirectory + "/ctkDICOM.sql",
+                          QString("ctkDICOMDatabaseTest4-%1").arg(policy));
+    database.setStoragePolicy(static_cast<ctkDICOMDatabase::StoragePolicy>(policy));
+    if (database.storagePolicy() != policy)
+      {
+      std::cerr << "ctkDICOMDatabase::setStoragePolicy() failed" << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    QTime timer;
+    timer.start();
+    database.insert(files, true, false);
+    int elapsed = qMax(1, timer.elapsed());
+
+    std::cout << policyNames[policy] << ": "
+              << size / 1048576.0 * 1000.0 / elapsed << " MB/sec" << std::endl;
+
+    int storedFiles = countStoredFiles(database.databaseDirectory());
+    if (storedFiles != files.count())
+      {
+      std::cerr << "ctkDICOMDatabase::insert() failed with policy "
+                << policyNames[policy] << ": " << storedFiles
+                << " files stored, " << files.count() << " expected" << std::endl;
+      return EXIT_FAILURE;
+      }
+    bool sourceExists = QFile::exists(files.first());
+    if (sourceExists == (policy == ctkDICOMDatabase::MoveFiles))
+      {
+      std::cerr << "ctkDICOMDatabase::insert() failed with policy "
+                << policyNames[policy] << ": source file "
+                << (sourceExists ? "not removed" : "removed") << std::endl;
+      return EXIT_FAILURE;
+      }
+    database.closeDatabase();
+    }
+
+  // The values longer than what InitializeFromFileHeader() reads are still
+  // available once the file is moved
+  files = tester.createSyntheticData(
+    tempDirectory.absoluteFilePath("comments"), 1, 1, 1, 1024);
+  if (files.count() != 1)
+    {
+    std::cerr << "ctkDICOMTester::createSyntheticData() failed: "
+              << files.count() << " files written" << std::endl;
+    return EXIT_FAILURE;
+    }
+  QString comments(1000, 'x');
+  {
+  ctkDICOMDataset fullDataset;
+  fullDataset.InitializeFromFile(files[0]);
+  if (!fullDataset.SetElementAsString(DCM_ImageComments, comments) ||
+      !fullDataset.SaveToFile(files[0]))
+    {
+    std::cerr << "ctkDICOMDataset::SaveToFile() failed" << std::endl;
+    return EXIT_FAILURE;
+    }
+  }
+  ctkDICOMDataset headerDataset;
+  headerDataset.InitializeFromFileHeader(files[0]);
+
+  QString databaseDirectory = tempDirectory.absoluteFilePath("commentsDatabase");
+  QDir().mkpath(databaseDirectory);
+  ctkDICOMDatabase database;
+  database.openDatabase(databaseDirectory + "/ctkDICOM.sql",
+                        "ctkDICOMDatabaseTest4-comments");
+  database.setStoragePolicy(ctkDICOMDatabase::MoveFiles);
+  database.insert(files[0], headerDataset, true, false);
+  if (QFile::exists(files[0]) || countStoredFiles(database.databaseDirectory()) != 1)
+    {
+    std::cerr << "ctkDICOMDatabase::insert() failed to move "
+              << qPrintable(files[0]) << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (headerDataset.GetElementAsString(DCM_ImageComments) != comments)
+    {
+    std::cerr << "ctkDICOMDatabase::insert() failed: the image comments "
+              << "can't be read once the file is moved" << std::endl;
+    return EXIT_FAILURE;
+    }
+  database.closeDatabase();
+
+  ctk::removeDirRecursively(tempDirectory.absolutePath());
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,101 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QDir>
+#include <QTime>
+
+// ctkCore includes
+#include "ctkUtils.h"
+
+// ctkDICOMCore includes
+#include "ctkDICOMDataset.h"
+#include "ctkDICOMTester.h"
+
+// DCMTK includes
+#include <dcmtk/dcmdata/dcdeftag.h>
+
+// STD includes
+#include <iostream>
+#include <cstdlib>
+
+//------------------------------------------------------------------------------
+// Compare ctkDICOMDataset::InitializeFromFile() and InitializeFromFileHeader()
+// on a file with a large pixel data.
+// Usage: ctkDICOMDatasetTest2 [pixelDataSize]
+int ctkDICOMDatasetTest2( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  QStringList arguments = app.arguments();
+  arguments.pop_front();
+  int pixelDataSize = arguments.count() > 0 ? arguments.at(0).toInt() : 64 * 1024 * 1024;
+
+  QDir tempDirectory(QDir::tempPath() + "/ctkDICOMDatasetTest2");
+  ctk::removeDirRecursively(tempDirectory.absolutePath());
+
+  ctkDICOMTester tester;
+  QStringList files = tester.createSyntheticData(tempDirectory.absolutePath(), 1, 1, 1, pixelDataSize);
+  if (files.count() != 1)
+    {
+    std::cerr << "ctkDICOMTester::createSyntheticData() failed" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  QTime timer;
+  timer.start();
+  ctkDICOMDataset fullDataset;
+  fullDataset.InitializeFromFile(files[0], EXS_Unknown, EGL_noChange, 0xffffffff);
+  int fullElapsed = timer.elapsed();
+
+  timer.start();
+  ctkDICOMDataset headerDataset;
+  headerDataset.InitializeFromFileHeader(files[0]);
+  int headerElapsed = timer.elapsed();
+
+  std::cout << "InitializeFromFile():       " << fullElapsed << " ms" << std::endl;
+  std::cout << "InitializeFromFileHeader(): " << headerElapsed << " ms" << std::endl;
+
+  if (!headerDataset.IsInitialized() ||
+      headerDataset.GetSOPInstanceUID() != fullDataset.GetSOPInstanceUID() ||
+      headerDataset.GetSeriesInstanceUID() != fullDataset.GetSeriesInstanceUID() ||
+      headerDataset.GetElementAsString(DCM_PatientName) != fullDataset.GetElementAsString(DCM_PatientName))
+    {
+    std::cerr << "ctkDICOMDataset::InitializeFromFileHeader() failed: "
+              << "header attributes differ" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // The pixel data is still available, loaded on demand
+  DcmElement* pixelData = 0;
+  Uint8* pixels = 0;
+  if (!ctkDICOMDataset::CheckCondition(headerDataset.findAndGetElement(DCM_PixelData, pixelData)) ||
+      pixelData->getUint8Array(pixels).bad() || !pixels ||
+      static_cast<int>(pixelData->getLength()) < pixelDataSize)
+    {
+    std::cerr << "ctkDICOMDataset::InitializeFromFileHeader() failed: "
+              << "pixel data can't be loaded" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  ctk::removeDirRecursively(tempDirectory.absolutePath());
+  return EXIT_SUCCESS;
+}
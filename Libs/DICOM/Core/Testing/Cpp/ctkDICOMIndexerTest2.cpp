@@ -0,0 +1,104 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QDir>
+#include <QThread>
+#include <QTime>
+
+// ctkCore includes
+#include "ctkUtils.h"
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
+#include "ctkDICOMIndexer.h"
+#include "ctkDICOMTester.h"
+
+// STD includes
+#include <iostream>
+#include <cstdlib>
+
+//------------------------------------------------------------------------------
+// Index a generated directory of synthetic DICOM files with an increasing
+// number of threads and report the throughput.
+// Usage: ctkDICOMIndexerTest2 [numberOfFiles] [pixelDataSize]
+int ctkDICOMIndexerTest2( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  QStringList arguments = app.arguments();
+  arguments.pop_front();
+  int numberOfFiles = arguments.count() > 0 ? arguments.at(0).toInt() : 500;
+  int pixelDataSize = arguments.count() > 1 ? arguments.at(1).toInt() : 512 * 512 * 2;
+
+  QDir tempDirectory(QDir::tempPath() + "/ctkDICOMIndexerTest2");
+  ctk::removeDirRecursively(tempDirectory.absolutePath());
+  tempDirectory.mkpath(".");
+
+  const int imagesPerSeries = 100;
+  ctkDICOMTester tester;
+  QStringList files = tester.createSyntheticData(
+    tempDirectory.absoluteFilePath("data"),
+    qMax(1, numberOfFiles / imagesPerSeries), 1,
+    qMin(numberOfFiles, imagesPerSeries), pixelDataSize);
+  if (files.isEmpty())
+    {
+    std::cerr << "ctkDICOMTester::createSyntheticData() failed" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  QList<int> threadCounts;
+  for (int threads = 1; threads < QThread::idealThreadCount(); threads *= 2)
+    {
+    threadCounts << threads;
+    }
+  threadCounts << qMax(2, QThread::idealThreadCount());
+
+  foreach(int threads, threadCounts)
+    {
+    ctkDICOMDatabase database;
+    QString databaseFile = tempDirectory.absoluteFilePath(QString("threads%1.sql").arg(threads));
+    database.openDatabase(databaseFile, QString("threads%1").arg(threads));
+
+    ctkDICOMIndexer indexer;
+    indexer.setNumberOfThreads(threads);
+    QTime timer;
+    timer.start();
+    indexer.addDirectory(database, tempDirectory.absoluteFilePath("data"));
+    int elapsed = qMax(1, timer.elapsed());
+
+    std::cout << threads << " thread(s): "
+              << files.count() * 1000.0 / elapsed << " files/sec" << std::endl;
+
+    QStringList count = database.runQuery("SELECT COUNT(*) FROM Images");
+    if (count.isEmpty() || count.first().toInt() != files.count())
+      {
+      std::cerr << "ctkDICOMIndexer::addDirectory() failed with " << threads
+                << " threads: " << (count.isEmpty() ? 0 : count.first().toInt())
+                << " images indexed, " << files.count() << " expected" << std::endl;
+      return EXIT_FAILURE;
+      }
+    database.closeDatabase();
+    }
+
+  ctk::removeDirRecursively(tempDirectory.absolutePath());
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,228 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+// ctkCore includes
+#include "ctkUtils.h"
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
+#include "ctkDICOMIndexer.h"
+#include "ctkDICOMTester.h"
+
+// STD includes
+#include <iostream>
+#include <cstdlib>
+
+namespace
+{
+//------------------------------------------------------------------------------
+int countImages(ctkDICOMDatabase& database)
+{
+  QStringList result = database.runQuery("SELECT COUNT(*) FROM Images");
+  return result.isEmpty() ? 0 : result.first().toInt();
+}
+
+//------------------------------------------------------------------------------
+QString imageValue(ctkDICOMDatabase& database, const QString& column, const QString& fileName)
+{
+  QStringList result = database.runQuery(
+    QString("SELECT %1 FROM Images WHERE Filename = '%2'").arg(column).arg(fileName));
+  return result.isEmpty() ? QString() : result.first();
+}
+
+//------------------------------------------------------------------------------
+QString sopInstanceUID(ctkDICOMDatabase& database, const QString& fileName)
+{
+  return imageValue(database, "SOPInstanceUID", fileName);
+}
+
+//------------------------------------------------------------------------------
+int countRows(ctkDICOMDatabase& database, const QString& table)
+{
+  QStringList result = database.runQuery(QString("SELECT COUNT(*) FROM %1").arg(table));
+  return result.isEmpty() ? 0 : result.first().toInt();
+}
+
+//------------------------------------------------------------------------------
+int countOrphanStudies(ctkDICOMDatabase& database)
+{
+  QStringList result = database.runQuery(
+    "SELECT COUNT(*) FROM Studies WHERE PatientsUID NOT IN (SELECT UID FROM Patients)");
+  return result.isEmpty() ? -1 : result.first().toInt();
+}
+}
+
+//------------------------------------------------------------------------------
+// Test the incremental update of ctkDICOMIndexer::refreshDatabase()
+int ctkDICOMIndexerTest3( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  QDir tempDirectory(QDir::tempPath() + "/ctkDICOMIndexerTest3");
+  ctk::removeDirRecursively(tempDirectory.absolutePath());
+  tempDirectory.mkpath(".");
+  QString dataDirectory = tempDirectory.absoluteFilePath("data");
+
+  ctkDICOMTester tester;
+  QStringList files = tester.createSyntheticData(dataDirectory, 1, 1, 5);
+
+  ctkDICOMDatabase database;
+  database.openDatabase(tempDirectory.absoluteFilePath("database.sql"), "refresh");
+  ctkDICOMIndexer indexer;
+  indexer.addDirectory(database, dataDirectory);
+  if (countImages(database) != 5 ||
+      database.indexedDirectories() != QStringList(QDir(dataDirectory).absolutePath()))
+    {
+    std::cerr << "ctkDICOMIndexer::addDirectory() failed: "
+              << countImages(database) << " images" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Nothing changed: nothing is inserted again
+  QString insertTimestamp = imageValue(database, "InsertTimestamp", files[2]);
+  indexer.refreshDatabase(database, QString());
+  if (countImages(database) != 5 ||
+      imageValue(database, "InsertTimestamp", files[2]) != insertTimestamp)
+    {
+    std::cerr << "ctkDICOMIndexer::refreshDatabase() failed: unchanged "
+              << "directory reindexed" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // One file removed, two added and one replaced
+  QFile::remove(files[0]);
+  tester.createSyntheticData(dataDirectory + "/new", 1, 1, 2);
+  // different size: the modification time has a one second resolution and
+  // the inode of the removed file may be reused
+  QStringList replacement = tester.createSyntheticData(tempDirectory.absoluteFilePath("other"), 1, 1, 1, 16);
+  QString replacedUID = sopInstanceUID(database, files[1]);
+  QFile::remove(files[1]);
+  QFile::copy(replacement[0], files[1]);
+
+  indexer.refreshDatabase(database, QString());
+  if (countImages(database) != 6)
+    {
+    std::cerr << "ctkDICOMIndexer::refreshDatabase() failed: "
+              << countImages(database) << " images instead of 6" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (!sopInstanceUID(database, files[0]).isEmpty() ||
+      sopInstanceUID(database, files[1]).isEmpty() ||
+      sopInstanceUID(database, files[1]) == replacedUID ||
+      imageValue(database, "InsertTimestamp", files[2]) != insertTimestamp)
+    {
+    std::cerr << "ctkDICOMIndexer::refreshDatabase() failed to update "
+              << "removed or modified files" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // A file that is not DICOM is only parsed again once it changed
+  QFile notDicom(dataDirectory + "/readme.txt");
+  if (!notDicom.open(QIODevice::WriteOnly) || notDicom.write("not DICOM\n") < 0)
+    {
+    std::cerr << "Failed to write " << qPrintable(notDicom.fileName()) << std::endl;
+    return EXIT_FAILURE;
+    }
+  notDicom.close();
+  indexer.refreshDatabase(database, QString());
+  QStringList newFiles;
+  QStringList modifiedFiles;
+  QStringList removedFiles;
+  database.compareFiles(dataDirectory, newFiles, modifiedFiles, removedFiles);
+  if (countRows(database, "RejectedFiles") != 1 || countImages(database) != 6 ||
+      !newFiles.isEmpty() || !modifiedFiles.isEmpty() || !removedFiles.isEmpty())
+    {
+    std::cerr << "ctkDICOMDatabase::compareFiles() failed: "
+              << newFiles.count() << " new files" << std::endl;
+    return EXIT_FAILURE;
+    }
+  notDicom.open(QIODevice::Append);
+  notDicom.write("changed\n");
+  notDicom.close();
+  database.compareFiles(dataDirectory, newFiles, modifiedFiles, removedFiles);
+  if (newFiles != QStringList(QFileInfo(notDicom).absoluteFilePath()))
+    {
+    std::cerr << "ctkDICOMDatabase::compareFiles() missed a changed rejected file" << std::endl;
+    return EXIT_FAILURE;
+    }
+  QFile::remove(notDicom.fileName());
+
+  // All the images of the patient removed then inserted again: the
+  // patient removed by cleanup() is not reused
+  QStringList allFiles = database.runQuery("SELECT Filename FROM Images");
+  database.removeFileEntries(allFiles);
+  if (countImages(database) != 0 || countRows(database, "Patients") != 0)
+    {
+    std::cerr << "ctkDICOMDatabase::removeFileEntries() failed" << std::endl;
+    return EXIT_FAILURE;
+    }
+  database.insert(files[2], false, false);
+  if (countImages(database) != 1 ||
+      countRows(database, "Series") != 1 ||
+      countRows(database, "Studies") != 1 ||
+      countRows(database, "Patients") != 1 ||
+      countOrphanStudies(database) != 0)
+    {
+    std::cerr << "ctkDICOMDatabase::insert() reused a removed patient, study or series" << std::endl;
+    return EXIT_FAILURE;
+    }
+  database.closeDatabase();
+
+  // Copied files are refreshed in the database directory
+  tempDirectory.mkpath("copy");
+  ctkDICOMDatabase copyDatabase;
+  copyDatabase.openDatabase(tempDirectory.absoluteFilePath("copy/database.sql"), "copy");
+  indexer.addDirectory(copyDatabase, dataDirectory, copyDatabase.databaseDirectory());
+  QString storageDirectory = QDir(copyDatabase.databaseDirectory() + "/dicom").absolutePath();
+  const int copiedImages = countImages(copyDatabase);
+  if (copiedImages != 6 ||
+      copyDatabase.indexedDirectories() != QStringList(storageDirectory))
+    {
+    std::cerr << "ctkDICOMIndexer::addDirectory() failed to copy: "
+              << copiedImages << " images" << std::endl;
+    return EXIT_FAILURE;
+    }
+  QString copiedFile = copyDatabase.runQuery("SELECT Filename FROM Images").first();
+  insertTimestamp = imageValue(copyDatabase, "InsertTimestamp", copiedFile);
+  indexer.refreshDatabase(copyDatabase, QString());
+  if (countImages(copyDatabase) != copiedImages ||
+      imageValue(copyDatabase, "InsertTimestamp", copiedFile) != insertTimestamp)
+    {
+    std::cerr << "ctkDICOMIndexer::refreshDatabase() reindexed copied files" << std::endl;
+    return EXIT_FAILURE;
+    }
+  QFile::remove(copiedFile);
+  indexer.refreshDatabase(copyDatabase, QString());
+  if (countImages(copyDatabase) != copiedImages - 1)
+    {
+    std::cerr << "ctkDICOMIndexer::refreshDatabase() missed a removed copied file" << std::endl;
+    return EXIT_FAILURE;
+    }
+  copyDatabase.closeDatabase();
+
+  ctk::removeDirRecursively(tempDirectory.absolutePath());
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,149 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QDir>
+#include <QSqlQuery>
+#include <QTime>
+
+// ctkCore includes
+#include "ctkUtils.h"
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
+#include "ctkDICOMModel.h"
+
+// STD includes
+#include <iostream>
+#include <cstdlib>
+
+namespace
+{
+//------------------------------------------------------------------------------
+QString patientName(int index)
+{
+  static const char* syllables[] = {"ba", "ke", "li", "mo", "nu", "ra", "si", "to"};
+  QString name;
+  for (int i = 0; i < 6; ++i, index /= 8)
+    {
+    name += syllables[index % 8];
+    }
+  name[0] = name[0].toUpper();
+  return name + "^John";
+}
+}
+
+//------------------------------------------------------------------------------
+// Measure the time to filter the patients by name, one keystroke at a time.
+// Usage: ctkDICOMModelTest3 [patients]
+int ctkDICOMModelTest3( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  QStringList arguments = app.arguments();
+  arguments.pop_front();
+  int patients = arguments.count() > 0 ? arguments.at(0).toInt() : 100000;
+
+  QDir tempDirectory(QDir::tempPath() + "/ctkDICOMModelTest3");
+  ctk::removeDirRecursively(tempDirectory.absolutePath());
+  tempDirectory.mkpath(".");
+
+  ctkDICOMDatabase database;
+  database.openDatabase(tempDirectory.absoluteFilePath("ctkDICOM.sql"), "ctkDICOMModelTest3");
+
+  QSqlDatabase db = database.database();
+  db.transaction();
+  QSqlQuery insertPatient(db);
+  insertPatient.prepare("INSERT INTO Patients ('PatientsName', 'PatientID') VALUES (?, ?)");
+  for (int i = 0; i < patients; ++i)
+    {
+    insertPatient.bindValue(0, patientName(i));
+    insertPatient.bindValue(1, QString::number(i));
+    insertPatient.exec();
+    }
+  db.commit();
+
+  ctkDICOMModel model;
+  model.setDatabase(db);
+
+  // Type the name of the last patient, in lower case
+  QString name = patientName(patients - 1).section('^', 0, 0).toLower();
+  QMap<QString, QVariant> parameters;
+  int maxElapsed = 0;
+  int totalElapsed = 0;
+  for (int i = 1; i <= name.size(); ++i)
+    {
+    QString prefix = name.left(i);
+    parameters["Name"] = prefix;
+    QTime timer;
+    timer.start();
+    model.setDatabase(db, parameters);
+    // what a view would display
+    int visibleRows = qMin(model.rowCount(), 40);
+    for (int row = 0; row < visibleRows; ++row)
+      {
+      for (int column = 0; column < model.columnCount(); ++column)
+        {
+        model.data(model.index(row, column));
+        }
+      model.hasChildren(model.index(row, 0));
+      }
+    int elapsed = timer.elapsed();
+    maxElapsed = qMax(maxElapsed, elapsed);
+    totalElapsed += elapsed;
+
+    for (int row = 0; row < visibleRows; ++row)
+      {
+      QString matchedName = model.data(model.index(row, 0)).toString();
+      if (!matchedName.contains(prefix, Qt::CaseInsensitive))
+        {
+        std::cerr << "ctkDICOMModel::setDatabase() failed: " << qPrintable(matchedName)
+                  << " doesn't match " << qPrintable(prefix) << std::endl;
+        return EXIT_FAILURE;
+        }
+      }
+    if (model.rowCount() == 0)
+      {
+      std::cerr << "ctkDICOMModel::setDatabase() failed: no patient matches "
+                << qPrintable(prefix) << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+  std::cout << patients << " patients: " << totalElapsed / name.size()
+            << " ms per keystroke on average, " << maxElapsed << " ms at most" << std::endl;
+
+  // The name is searched anywhere, not only at the beginning
+  parameters["Name"] = "JOHN";
+  model.setDatabase(db, parameters);
+  if (model.rowCount() == 0 ||
+      !model.data(model.index(0, 0)).toString().endsWith("^John"))
+    {
+    std::cerr << "ctkDICOMModel::setDatabase() failed: no patient matches JOHN"
+              << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  model.setDatabase(QSqlDatabase());
+  database.closeDatabase();
+  ctk::removeDirRecursively(tempDirectory.absolutePath());
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,146 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QDir>
+#include <QPersistentModelIndex>
+#include <QSqlQuery>
+#include <QTime>
+
+// ctkCore includes
+#include "ctkUtils.h"
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
+#include "ctkDICOMModel.h"
+
+// STD includes
+#include <iostream>
+#include <cstdlib>
+
+//------------------------------------------------------------------------------
+// Sort a model with expanded items and check that the items and persistent
+// indexes are kept.
+// Usage: ctkDICOMModelTest4 [patients]
+int ctkDICOMModelTest4( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  QStringList arguments = app.arguments();
+  arguments.pop_front();
+  int patients = arguments.count() > 0 ? arguments.at(0).toInt() : 10000;
+
+  QDir tempDirectory(QDir::tempPath() + "/ctkDICOMModelTest4");
+  ctk::removeDirRecursively(tempDirectory.absolutePath());
+  tempDirectory.mkpath(".");
+
+  ctkDICOMDatabase database;
+  database.openDatabase(tempDirectory.absoluteFilePath("ctkDICOM.sql"), "ctkDICOMModelTest4");
+
+  QSqlDatabase db = database.database();
+  db.transaction();
+  QSqlQuery insertPatient(db);
+  insertPatient.prepare("INSERT INTO Patients ('UID', 'PatientsName') VALUES (?, ?)");
+  QSqlQuery insertStudy(db);
+  insertStudy.prepare("INSERT INTO Studies ('StudyInstanceUID', 'PatientsUID', 'StudyDescription') VALUES (?, ?, ?)");
+  QSqlQuery insertSeries(db);
+  insertSeries.prepare("INSERT INTO Series ('SeriesInstanceUID', 'StudyInstanceUID', 'SeriesDescription') VALUES (?, ?, ?)");
+  for (int i = 1; i <= patients; ++i)
+    {
+    insertPatient.bindValue(0, i);
+    insertPatient.bindValue(1, QString("Patient%1").arg(i, 6, 10, QChar('0')));
+    insertPatient.exec();
+    for (int study = 0; study < 2; ++study)
+      {
+      QString studyUID = QString("1.2.%1.%2").arg(i).arg(study);
+      insertStudy.bindValue(0, studyUID);
+      insertStudy.bindValue(1, i);
+      insertStudy.bindValue(2, QString("Study%1").arg(study));
+      insertStudy.exec();
+      for (int series = 0; series < 2; ++series)
+        {
+        insertSeries.bindValue(0, studyUID + QString(".%1").arg(series));
+        insertSeries.bindValue(1, studyUID);
+        insertSeries.bindValue(2, QString("Series%1").arg(series));
+        insertSeries.exec();
+        }
+      }
+    }
+  db.commit();
+
+  ctkDICOMModel model;
+  model.setDatabase(db);
+
+  // Expand the first patient and its first study
+  QModelIndex patientIndex = model.index(0, 0);
+  model.fetchMore(patientIndex);
+  QModelIndex studyIndex = model.index(0, 0, patientIndex);
+  model.fetchMore(studyIndex);
+  QModelIndex seriesIndex = model.index(1, 0, studyIndex);
+
+  QPersistentModelIndex persistentPatient(patientIndex);
+  QPersistentModelIndex persistentSeries(seriesIndex);
+  QString patientUID = model.data(patientIndex, ctkDICOMModel::UIDRole).toString();
+  QString seriesUID = model.data(seriesIndex, ctkDICOMModel::UIDRole).toString();
+
+  QTime timer;
+  timer.start();
+  model.sort(0, Qt::DescendingOrder);
+  std::cout << "sort: " << timer.elapsed() << " ms" << std::endl;
+
+  if (!persistentPatient.isValid() || !persistentSeries.isValid() ||
+      model.data(persistentPatient, ctkDICOMModel::UIDRole).toString() != patientUID ||
+      model.data(persistentSeries, ctkDICOMModel::UIDRole).toString() != seriesUID)
+    {
+    std::cerr << "ctkDICOMModel::sort() failed: the persistent indexes are not kept"
+              << std::endl;
+    return EXIT_FAILURE;
+    }
+  // The first patient is now the last one
+  if (persistentPatient.row() != patients - 1 ||
+      model.rowCount() != patients)
+    {
+    std::cerr << "ctkDICOMModel::sort() failed: first patient at row "
+              << persistentPatient.row() << ", " << model.rowCount()
+              << " rows" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (persistentSeries.row() != 0 ||
+      model.data(persistentSeries).toString() != "Series1")
+    {
+    std::cerr << "ctkDICOMModel::sort() failed: series at row "
+              << persistentSeries.row() << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (model.data(model.index(0, 0)).toString() <
+      model.data(model.index(1, 0)).toString())
+    {
+    std::cerr << "ctkDICOMModel::sort() failed: patients are not sorted"
+              << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  model.setDatabase(QSqlDatabase());
+  database.closeDatabase();
+  ctk::removeDirRecursively(tempDirectory.absolutePath());
+
+  return EXIT_SUCCESS;
+}
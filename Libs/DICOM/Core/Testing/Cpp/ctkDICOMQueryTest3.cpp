@@ -0,0 +1,269 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+// Qt includes
+#include <QCoreApplication>
+#include <QDir>
+#include <QPair>
+#include <QQueue>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QThread>
+#include <QTime>
+
+// ctkCore includes
+#include "ctkUtils.h"
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
+#include "ctkDICOMQuery.h"
+#include "ctkDICOMTester.h"
+
+// STD includes
+#include <iostream>
+#include <cstdlib>
+
+namespace
+{
+//------------------------------------------------------------------------------
+// Forward the data of a connection to dcmqrscp and back, each chunk of data
+// being delayed by Latency ms.
+class LatencyConnection : public QThread
+{
+public:
+  LatencyConnection(int socketDescriptor, int port, int latency)
+    : SocketDescriptor(socketDescriptor), Port(port), Latency(latency) {}
+
+protected:
+  typedef QQueue<QPair<int, QByteArray> > Chunks;
+
+  void receive(QTcpSocket& from, Chunks& chunks, const QTime& clock)
+  {
+    if (from.bytesAvailable() || from.waitForReadyRead(1))
+      {
+      chunks.enqueue(qMakePair(clock.elapsed() + this->Latency, from.readAll()));
+      }
+  }
+
+  void send(QTcpSocket& to, Chunks& chunks, const QTime& clock)
+  {
+    while (!chunks.isEmpty() && chunks.head().first <= clock.elapsed())
+      {
+      to.write(chunks.dequeue().second);
+      to.flush();
+      }
+  }
+
+  virtual void run()
+  {
+    QTcpSocket client;
+    client.setSocketDescriptor(this->SocketDescriptor);
+    QTcpSocket server;
+    server.connectToHost("localhost", this->Port);
+    if (!server.waitForConnected())
+      {
+      return;
+      }
+    QTime clock;
+    clock.start();
+    Chunks toServer;
+    Chunks toClient;
+    while ((client.state() == QAbstractSocket::ConnectedState &&
+            server.state() == QAbstractSocket::ConnectedState) ||
+           client.bytesAvailable() || server.bytesAvailable() ||
+           !toServer.isEmpty() || !toClient.isEmpty())
+      {
+      this->receive(client, toServer, clock);
+      this->receive(server, toClient, clock);
+      this->send(server, toServer, clock);
+      this->send(client, toClient, clock);
+      }
+    server.disconnectFromHost();
+    client.disconnectFromHost();
+  }
+
+  int SocketDescriptor;
+  int Port;
+  int Latency;
+};
+
+//------------------------------------------------------------------------------
+// Proxy adding latency to the associations with dcmqrscp
+class LatencyProxy : public QTcpServer
+{
+public:
+  LatencyProxy(int port, int latency) : Port(port), Latency(latency) {}
+  virtual ~LatencyProxy()
+  {
+    foreach(LatencyConnection* connection, this->Connections)
+      {
+      connection->wait();
+      }
+    qDeleteAll(this->Connections);
+  }
+
+protected:
+  virtual void incomingConnection(int socketDescriptor)
+  {
+    this->Connections << new LatencyConnection(socketDescriptor, this->Port, this->Latency);
+    this->Connections.last()->start();
+  }
+
+  int Port;
+  int Latency;
+  QList<LatencyConnection*> Connections;
+};
+
+//------------------------------------------------------------------------------
+// Accept the connections while the main thread is blocked in query()
+class LatencyProxyThread : public QThread
+{
+public:
+  LatencyProxyThread(int port, int latency)
+    : Port(port), Latency(latency), ProxyPort(0), Stopped(false) {}
+
+  int proxyPort()
+  {
+    while (this->isRunning() && !this->ProxyPort)
+      {
+      QThread::yieldCurrentThread();
+      }
+    return this->ProxyPort;
+  }
+  void stop() { this->Stopped = true; this->wait(); }
+
+protected:
+  virtual void run()
+  {
+    LatencyProxy proxy(this->Port, this->Latency);
+    if (!proxy.listen(QHostAddress::LocalHost))
+      {
+      return;
+      }
+    this->ProxyPort = proxy.serverPort();
+    while (!this->Stopped)
+      {
+      proxy.waitForNewConnection(100);
+      }
+  }
+
+  int Port;
+  int Latency;
+  volatile int  ProxyPort;
+  volatile bool Stopped;
+};
+}
+
+//------------------------------------------------------------------------------
+// Compare the time taken by a query at 1, 4 and 8 associations for the
+// series level C-FINDs, through a proxy delaying each exchange with
+// dcmqrscp. The default size only checks the results, e.g.
+// "ctkDICOMQueryTest3 300" gives meaningful timings.
+// Usage: ctkDICOMQueryTest3 [studies] [latency in ms]
+int ctkDICOMQueryTest3( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  QStringList arguments = app.arguments();
+  arguments.pop_front();
+  int studies = arguments.count() > 0 ? arguments.at(0).toInt() : 20;
+  int latency = arguments.count() > 1 ? arguments.at(1).toInt() : 10;
+
+  QDir tempDirectory(QDir::tempPath() + "/ctkDICOMQueryTest3");
+  ctk::removeDirRecursively(tempDirectory.absolutePath());
+  tempDirectory.mkpath(".");
+
+  ctkDICOMTester tester;
+  QStringList files = tester.createSyntheticData(
+    tempDirectory.absoluteFilePath("data"), studies, 1, 1);
+  if (files.count() != studies)
+    {
+    std::cerr << "ctkDICOMTester::createSyntheticData() failed: "
+              << files.count() << " files written" << std::endl;
+    return EXIT_FAILURE;
+    }
+  tester.startDCMQRSCP();
+  // keep the storescu command lines short
+  for (int i = 0; i < files.count(); i += 500)
+    {
+    if (!tester.storeData(files.mid(i, 500)))
+      {
+      std::cerr << "ctkDICOMTester::storeData() failed" << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  LatencyProxyThread proxy(tester.dcmqrscpPort(), latency);
+  proxy.start();
+  int proxyPort = proxy.proxyPort();
+  if (!proxyPort)
+    {
+    std::cerr << "Can't start the latency proxy" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  int associations[] = {1, 4, 8};
+  int seriesFound = -1;
+  for (int i = 0; i < 3; ++i)
+    {
+    ctkDICOMDatabase database;
+    database.openDatabase(":memory:", QString("ctkDICOMQueryTest3-%1").arg(i));
+
+    ctkDICOMQuery query;
+    query.setCallingAETitle("CTK_AE");
+    query.setCalledAETitle("CTK_AE");
+    query.setHost("localhost");
+    query.setPort(proxyPort);
+    query.setNumberOfAssociations(associations[i]);
+    if (query.numberOfAssociations() != associations[i])
+      {
+      std::cerr << "ctkDICOMQuery::setNumberOfAssociations() failed" << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    QTime timer;
+    timer.start();
+    if (!query.query(database))
+      {
+      std::cerr << "ctkDICOMQuery::query() failed with "
+                << associations[i] << " associations" << std::endl;
+      return EXIT_FAILURE;
+      }
+    int elapsed = timer.elapsed();
+
+    // the archive may also contain the studies stored by other tests
+    int series = database.runQuery("SELECT SeriesInstanceUID FROM Series").count();
+    std::cout << associations[i] << " associations: " << elapsed << " ms, "
+              << query.studyInstanceUIDQueried().count() << " studies, "
+              << series << " series" << std::endl;
+    if (series < studies || (seriesFound >= 0 && series != seriesFound))
+      {
+      std::cerr << "ctkDICOMQuery::query() failed with " << associations[i]
+                << " associations: " << series << " series found" << std::endl;
+      return EXIT_FAILURE;
+      }
+    seriesFound = series;
+    database.closeDatabase();
+    }
+  proxy.stop();
+
+  ctk::removeDirRecursively(tempDirectory.absolutePath());
+
+  return EXIT_SUCCESS;
+}
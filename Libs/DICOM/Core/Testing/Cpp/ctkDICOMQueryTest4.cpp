@@ -0,0 +1,99 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+// Qt includes
+#include <QCoreApplication>
+#include <QDir>
+
+// ctkCore includes
+#include "ctkUtils.h"
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
+#include "ctkDICOMQuery.h"
+#include "ctkDICOMTester.h"
+
+// STD includes
+#include <iostream>
+#include <cstdlib>
+
+//------------------------------------------------------------------------------
+// Check that the study level C-FIND is canceled once the maximum number
+// of results is reached.
+int ctkDICOMQueryTest4( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  const int studies = 20;
+  const int maximumNumberOfResults = 5;
+
+  QDir tempDirectory(QDir::tempPath() + "/ctkDICOMQueryTest4");
+  ctk::removeDirRecursively(tempDirectory.absolutePath());
+  tempDirectory.mkpath(".");
+
+  ctkDICOMTester tester;
+  QStringList files = tester.createSyntheticData(
+    tempDirectory.absoluteFilePath("data"), studies, 2, 1);
+  tester.startDCMQRSCP();
+  if (files.count() != studies * 2 || !tester.storeData(files))
+    {
+    std::cerr << "Failed to store the synthetic data" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  ctkDICOMDatabase database;
+  database.openDatabase(":memory:", "ctkDICOMQueryTest4");
+
+  ctkDICOMQuery query;
+  query.setCallingAETitle("CTK_AE");
+  query.setCalledAETitle("CTK_AE");
+  query.setHost("localhost");
+  query.setPort(tester.dcmqrscpPort());
+  if (query.maximumNumberOfResults() != 0)
+    {
+    std::cerr << "ctkDICOMQuery::maximumNumberOfResults() failed: "
+              << query.maximumNumberOfResults() << std::endl;
+    return EXIT_FAILURE;
+    }
+  query.setMaximumNumberOfResults(maximumNumberOfResults);
+
+  if (!query.query(database))
+    {
+    std::cerr << "ctkDICOMQuery::query() failed" << std::endl;
+    return EXIT_FAILURE;
+    }
+  int studiesFound = query.studyInstanceUIDQueried().count();
+  int studiesInserted = database.runQuery("SELECT StudyInstanceUID FROM Studies").count();
+  int seriesInserted = database.runQuery("SELECT SeriesInstanceUID FROM Series").count();
+  if (studiesFound != maximumNumberOfResults ||
+      studiesInserted != maximumNumberOfResults ||
+      // the archive may also contain the studies stored by other tests
+      seriesInserted < maximumNumberOfResults)
+    {
+    std::cerr << "ctkDICOMQuery::setMaximumNumberOfResults() failed: "
+              << studiesFound << " studies found, "
+              << studiesInserted << " studies and "
+              << seriesInserted << " series inserted" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  ctk::removeDirRecursively(tempDirectory.absolutePath());
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,178 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+// Qt includes
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QStringList>
+#include <QTime>
+
+// ctkCore includes
+#include "ctkUtils.h"
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
+#include "ctkDICOMQuery.h"
+#include "ctkDICOMRetrieve.h"
+#include "ctkDICOMTester.h"
+
+// STD includes
+#include <iostream>
+#include <cstdlib>
+
+namespace
+{
+//------------------------------------------------------------------------------
+// Peak resident set size of the process in kB, -1 if unknown
+int peakMemory()
+{
+  QFile status("/proc/self/status");
+  if (!status.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+    return -1;
+    }
+  foreach(const QByteArray& line, status.readAll().split('\n'))
+    {
+    if (line.startsWith("VmHWM:"))
+      {
+      return line.mid(6).trimmed().split(' ').first().toInt();
+      }
+    }
+  return -1;
+}
+}
+
+//------------------------------------------------------------------------------
+// Retrieve with C-GET the studies stored into a local dcmqrscp and report
+// the number of instances received and indexed per second.
+// Usage: ctkDICOMRetrieveTest3 [studies] [imagesPerSeries] [pixelDataSize]
+int ctkDICOMRetrieveTest3( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  QStringList arguments = app.arguments();
+  arguments.pop_front();
+  // 5000 instances by default
+  int studies = arguments.count() > 0 ? arguments.at(0).toInt() : 10;
+  int imagesPerSeries = arguments.count() > 1 ? arguments.at(1).toInt() : 100;
+  int pixelDataSize = arguments.count() > 2 ? arguments.at(2).toInt() : 32 * 1024;
+  const int seriesPerStudy = 5;
+
+  QDir tempDirectory(QDir::tempPath() + "/ctkDICOMRetrieveTest3");
+  ctk::removeDirRecursively(tempDirectory.absolutePath());
+  tempDirectory.mkpath(".");
+
+  ctkDICOMTester tester;
+  QStringList files = tester.createSyntheticData(
+    tempDirectory.absoluteFilePath("data"), studies, seriesPerStudy,
+    imagesPerSeries, pixelDataSize);
+  int instances = studies * seriesPerStudy * imagesPerSeries;
+  if (files.count() != instances)
+    {
+    std::cerr << "ctkDICOMTester::createSyntheticData() failed: "
+              << files.count() << " files written" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  tester.startDCMQRSCP();
+  // keep the storescu command lines short
+  for (int i = 0; i < files.count(); i += 500)
+    {
+    if (!tester.storeData(files.mid(i, 500)))
+      {
+      std::cerr << "ctkDICOMTester::storeData() failed" << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  ctkDICOMDatabase queryDatabase;
+  ctkDICOMQuery query;
+  query.setCallingAETitle("CTK_AE");
+  query.setCalledAETitle("CTK_AE");
+  query.setHost("localhost");
+  query.setPort(tester.dcmqrscpPort());
+  // the archive may also contain the studies stored by other tests
+  if (!query.query(queryDatabase) ||
+      query.studyInstanceUIDQueried().count() < studies)
+    {
+    std::cerr << "ctkDICOMQuery::query() failed: "
+              << query.studyInstanceUIDQueried().count() << " studies found, "
+              << "at least " << studies << " expected" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  QSharedPointer<ctkDICOMDatabase> retrieveDatabase(new ctkDICOMDatabase);
+  retrieveDatabase->openDatabase(tempDirectory.absoluteFilePath("ctkDICOM.sql"),
+                                 "ctkDICOMRetrieveTest3");
+
+  ctkDICOMRetrieve retrieve;
+  retrieve.setCallingAETitle("CTK_AE");
+  retrieve.setCalledAETitle("CTK_AE");
+  retrieve.setPort(tester.dcmqrscpPort());
+  retrieve.setHost("localhost");
+  retrieve.setDatabase(retrieveDatabase);
+
+  int memoryBefore = peakMemory();
+  QTime timer;
+  timer.start();
+  foreach(const QString& study, query.studyInstanceUIDQueried())
+    {
+    if (!retrieve.getStudy(study))
+      {
+      std::cerr << "ctkDICOMRetrieve::getStudy() failed. "
+                << "Study " << qPrintable(study) << " can't be retrieved"
+                << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+  int elapsed = qMax(1, timer.elapsed());
+
+  QStringList retrievedFiles =
+    retrieveDatabase->runQuery("SELECT Filename FROM Images");
+  instances = retrievedFiles.count();
+  std::cout << instances << " instances retrieved in " << elapsed << " ms: "
+            << instances * 1000.0 / elapsed << " instances/sec" << std::endl;
+  if (memoryBefore >= 0)
+    {
+    std::cout << "peak memory: " << peakMemory() << " kB ("
+              << memoryBefore << " kB before the retrieve)" << std::endl;
+    }
+
+  if (instances < files.count())
+    {
+    std::cerr << "ctkDICOMRetrieve::getStudy() failed: "
+              << instances << " instances in the database, at least "
+              << files.count() << " expected" << std::endl;
+    return EXIT_FAILURE;
+    }
+  foreach(const QString& file, retrievedFiles)
+    {
+    if (!QFile::exists(file))
+      {
+      std::cerr << "Retrieved file " << qPrintable(file) << " missing" << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  retrieveDatabase->closeDatabase();
+  ctk::removeDirRecursively(tempDirectory.absolutePath());
+
+  return EXIT_SUCCESS;
+}
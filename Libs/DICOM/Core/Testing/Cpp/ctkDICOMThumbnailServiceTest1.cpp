@@ -0,0 +1,273 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QDir>
+#include <QFileInfo>
+#include <QImage>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QTime>
+
+// ctkCore includes
+#include "ctkUtils.h"
+
+// ctkDICOMCore includes
+#include "ctkDICOMAbstractThumbnailGenerator.h"
+#include "ctkDICOMDatabase.h"
+#include "ctkDICOMTester.h"
+#include "ctkDICOMThumbnailService.h"
+
+// DCMTK includes
+#include <dcmtk/dcmimgle/dcmimage.h>
+
+// STD includes
+#include <iostream>
+#include <cstdlib>
+
+namespace
+{
+//------------------------------------------------------------------------------
+class ctkDICOMTestThumbnailGenerator : public ctkDICOMAbstractThumbnailGenerator
+{
+public:
+  virtual bool generateThumbnail(DicomImage* dcmImage, const QString& path)
+    {
+    QImage thumbnail;
+    return this->generateThumbnail(dcmImage, thumbnail) && thumbnail.save(path, "PNG");
+    }
+  virtual bool generateThumbnail(DicomImage* dcmImage, QImage& thumbnail)
+    {
+    if (dcmImage->getStatus() != EIS_Normal)
+      {
+      return false;
+      }
+    thumbnail = QImage(qMin<int>(dcmImage->getWidth(), 128),
+                       qMin<int>(dcmImage->getHeight(), 128), QImage::Format_RGB32);
+    thumbnail.fill(0xff808080);
+    return true;
+    }
+};
+
+//------------------------------------------------------------------------------
+bool waitForThumbnails(ctkDICOMThumbnailService& service, const QStringList& seriesUIDs)
+{
+  QTime timer;
+  timer.start();
+  while (timer.elapsed() < 60000)
+    {
+    QCoreApplication::processEvents(QEventLoop::AllEvents, 100);
+    bool done = true;
+    foreach(const QString& seriesUID, seriesUIDs)
+      {
+      done = done && !service.seriesThumbnail(seriesUID).isNull();
+      }
+    if (done)
+      {
+      return true;
+      }
+    }
+  return false;
+}
+
+//------------------------------------------------------------------------------
+int countCachedThumbnails(const QString& cacheFile)
+{
+  int count = -1;
+  {
+  QSqlDatabase cache = QSqlDatabase::addDatabase("QSQLITE", "countCachedThumbnails");
+  cache.setDatabaseName(cacheFile);
+  QSqlQuery query(cache);
+  if (cache.open() && query.exec("SELECT COUNT(*) FROM Thumbnails") && query.next())
+    {
+    count = query.value(0).toInt();
+    }
+  }
+  QSqlDatabase::removeDatabase("countCachedThumbnails");
+  return count;
+}
+
+//------------------------------------------------------------------------------
+QStringList instancesForSeries(ctkDICOMDatabase& database, const QString& seriesUID)
+{
+  QStringList sopInstanceUIDs;
+  QSqlQuery query(database.database());
+  query.prepare("SELECT SOPInstanceUID FROM Images WHERE SeriesInstanceUID = ?");
+  query.bindValue(0, seriesUID);
+  if (query.exec())
+    {
+    while (query.next())
+      {
+      sopInstanceUIDs << query.value(0).toString();
+      }
+    }
+  return sopInstanceUIDs;
+}
+}
+
+//------------------------------------------------------------------------------
+// Request the thumbnails of many series, check that they are generated in
+// the background and read back from the cache.
+// Usage: ctkDICOMThumbnailServiceTest1 [studies] [seriesPerStudy]
+int ctkDICOMThumbnailServiceTest1( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  QStringList arguments = app.arguments();
+  arguments.pop_front();
+  int studies = arguments.count() > 0 ? arguments.at(0).toInt() : 4;
+  int seriesPerStudy = arguments.count() > 1 ? arguments.at(1).toInt() : 50;
+
+  QDir tempDirectory(QDir::tempPath() + "/ctkDICOMThumbnailServiceTest1");
+  ctk::removeDirRecursively(tempDirectory.absolutePath());
+  tempDirectory.mkpath(".");
+
+  ctkDICOMTester tester;
+  QStringList files = tester.createSyntheticData(
+    tempDirectory.absoluteFilePath("data"), studies, seriesPerStudy, 3, 64 * 64);
+
+  QSharedPointer<ctkDICOMDatabase> database(new ctkDICOMDatabase);
+  database->openDatabase(tempDirectory.absoluteFilePath("ctkDICOM.sql"), "ctkDICOMThumbnailServiceTest1");
+  database->insert(files, false, false);
+
+  QStringList seriesUIDs;
+  foreach(const QString& patient, database->patients())
+    {
+    foreach(const QString& study, database->studiesForPatient(patient))
+      {
+      seriesUIDs << database->seriesForStudy(study);
+      }
+    }
+  if (seriesUIDs.count() != studies * seriesPerStudy)
+    {
+    std::cerr << "ctkDICOMDatabase::insert() failed: " << seriesUIDs.count()
+              << " series" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  ctkDICOMTestThumbnailGenerator generator;
+  {
+  ctkDICOMThumbnailService service;
+  service.setThumbnailGenerator(&generator);
+  service.setDatabase(database);
+
+  // Requesting is immediate, nothing is rendered in this thread
+  QTime timer;
+  timer.start();
+  for (int i = 0; i < seriesUIDs.count(); ++i)
+    {
+    // the last series are "visible"
+    if (!service.seriesThumbnail(seriesUIDs[i], i < seriesUIDs.count() - 10 ? 0 : 1).isNull())
+      {
+      std::cerr << "ctkDICOMThumbnailService::seriesThumbnail() failed: "
+                << "thumbnail generated synchronously" << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+  std::cout << "requests: " << timer.elapsed() << " ms" << std::endl;
+
+  timer.start();
+  if (!waitForThumbnails(service, seriesUIDs))
+    {
+    std::cerr << "ctkDICOMThumbnailService failed: thumbnails not generated, "
+              << service.pendingRequests() << " pending requests" << std::endl;
+    return EXIT_FAILURE;
+    }
+  std::cout << "generation: " << timer.elapsed() << " ms" << std::endl;
+  }
+
+  if (!QFileInfo(tempDirectory.absoluteFilePath("thumbs.db")).exists())
+    {
+    std::cerr << "ctkDICOMThumbnailService failed: no thumbnail cache" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // A new service reads the thumbnails from the cache
+  ctkDICOMThumbnailService cachedService;
+  cachedService.setThumbnailGenerator(&generator);
+  cachedService.setDatabase(database);
+  foreach(const QString& seriesUID, seriesUIDs)
+    {
+    if (cachedService.seriesThumbnail(seriesUID).isNull())
+      {
+      std::cerr << "ctkDICOMThumbnailService::seriesThumbnail() failed: "
+                << "thumbnail not cached" << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  if (cachedService.setRequestPriority(seriesUIDs[0], 1))
+    {
+    std::cerr << "ctkDICOMThumbnailService::setRequestPriority() failed: "
+              << "no request is pending" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Removed images have no thumbnail anymore, in memory and on disk
+  database->removeSeries(seriesUIDs[0]);
+  const int cachedThumbnails = countCachedThumbnails(tempDirectory.absoluteFilePath("thumbs.db"));
+  if (!cachedService.seriesThumbnail(seriesUIDs[0]).isNull() ||
+      cachedThumbnails != seriesUIDs.count() - 1)
+    {
+    std::cerr << "ctkDICOMThumbnailService failed: thumbnail of a removed "
+              << "series still cached, " << cachedThumbnails << " thumbnails" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Thumbnails being rendered when their images are removed are not stored
+  {
+  ctkDICOMThumbnailService service;
+  service.setThumbnailGenerator(&generator);
+  service.setNumberOfThreads(1);
+  service.setDatabase(database);
+  QStringList removedSeriesUIDs = seriesUIDs.mid(1, 10);
+  QString lastSeriesUID = seriesUIDs.last();
+  foreach(const QString& seriesUID, QStringList(removedSeriesUIDs) << lastSeriesUID)
+    {
+    service.removeThumbnails(instancesForSeries(*database, seriesUID));
+    }
+  foreach(const QString& seriesUID, removedSeriesUIDs)
+    {
+    service.seriesThumbnail(seriesUID, 1);
+    }
+  foreach(const QString& seriesUID, removedSeriesUIDs)
+    {
+    database->removeSeries(seriesUID);
+    }
+  // the single worker renders the last series after the removed ones
+  service.seriesThumbnail(lastSeriesUID, 0);
+  const bool lastRendered = waitForThumbnails(service, QStringList() << lastSeriesUID);
+  const int remainingThumbnails = countCachedThumbnails(tempDirectory.absoluteFilePath("thumbs.db"));
+  if (!lastRendered ||
+      remainingThumbnails != seriesUIDs.count() - 1 - removedSeriesUIDs.count())
+    {
+    std::cerr << "ctkDICOMThumbnailService failed: thumbnails of removed "
+              << "series stored, " << remainingThumbnails << " thumbnails" << std::endl;
+    return EXIT_FAILURE;
+    }
+  }
+
+  cachedService.setDatabase(QSharedPointer<ctkDICOMDatabase>());
+  database->closeDatabase();
+  ctk::removeDirRecursively(tempDirectory.absolutePath());
+
+  return EXIT_SUCCESS;
+}
@@ -19,6 +19,10 @@
 
 =========================================================================*/
 
+// Qt includes
+#include <QImage>
+#include <QTemporaryFile>
+
 // ctkDICOMCore includes
 #include "ctkDICOMAbstractThumbnailGenerator.h"
 #include "ctkLogger.h"
@@ -62,3 +66,17 @@ ctkDICOMAbstractThumbnailGenerator::ctkDICOMAbstractThumbnailGenerator(QObject*
 ctkDICOMAbstractThumbnailGenerator::~ctkDICOMAbstractThumbnailGenerator()
 {
 }
+
+//------------------------------------------------------------------------------
+bool ctkDICOMAbstractThumbnailGenerator::generateThumbnail(DicomImage* dcmImage, QImage& thumbnail)
+{
+  QTemporaryFile file;
+  if (!file.open())
+    {
+    logger.error("Can't create temporary file for thumbnail: " + file.errorString());
+    return false;
+    }
+  file.close();
+  return this->generateThumbnail(dcmImage, file.fileName()) &&
+         thumbnail.load(file.fileName(), "PNG");
+}
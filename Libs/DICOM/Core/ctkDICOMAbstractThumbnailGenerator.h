@@ -29,6 +29,7 @@
 
 class ctkDICOMAbstractThumbnailGeneratorPrivate;
 class DicomImage;
+class QImage;
 
 /// \ingroup DICOM_Core
 ///
@@ -45,6 +46,12 @@ public:
 
   virtual bool generateThumbnail(DicomImage* dcmImage, const QString& path ) = 0;
 
+  /// Render the thumbnail of @a dcmImage into @a thumbnail. It is called
+  /// from the worker threads of ctkDICOMThumbnailService and must be
+  /// reentrant. The default implementation goes through a temporary file
+  /// written by generateThumbnail(DicomImage*, const QString&).
+  virtual bool generateThumbnail(DicomImage* dcmImage, QImage& thumbnail );
+
 protected:
   QScopedPointer<ctkDICOMAbstractThumbnailGeneratorPrivate> d_ptr;
 
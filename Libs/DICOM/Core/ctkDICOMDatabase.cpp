@@ -33,6 +33,23 @@
 #include <QFileInfo>
 #include <QDebug>
 #include <QFileSystemWatcher>
+#include <QSharedPointer>
+
+// STD includes
+#include <cerrno>
+#include <cstring>
+#include <sys/stat.h>
+#ifdef Q_OS_WIN
+# include <windows.h>
+#else
+# include <cstdio>
+# include <unistd.h>
+#endif
+#ifdef Q_OS_LINUX
+# include <sys/ioctl.h>
+# include <fcntl.h>
+# include <linux/fs.h>
+#endif
 
 // ctkDICOM includes
 #include "ctkDICOMDatabase.h"
@@ -60,6 +77,83 @@
 static ctkLogger logger("org.commontk.dicom.DICOMDatabase" );
 //------------------------------------------------------------------------------
 
+// Must match the version in Resources/dicom-schema.sql. Bumping it requires
+// a Resources/dicom-schema-upgrade-<version>.sql script.
+static const int DICOMDatabaseSchemaVersion = 5;
+
+// Values longer than this are not read by loadFileHeader()
+static const Uint32 HeaderMaxValueLength = 256;
+
+// How long SQLite waits for the lock of another connection, in ms. It is
+// doubled on each retry of a COMMIT.
+static const int BusyTimeout = 5000;
+
+//------------------------------------------------------------------------------
+namespace
+{
+/// Size, modification time in ms and inode of a file, as recorded in the
+/// Images and RejectedFiles tables to detect files changed on disk.
+struct ctkDICOMFileState
+{
+  ctkDICOMFileState() : Size(-1), Modified(-1), Inode(0) {}
+  qint64 Size;
+  qint64 Modified;
+  qint64 Inode;
+  bool operator==(const ctkDICOMFileState& other)const
+  {
+    return this->Size == other.Size && this->Modified == other.Modified
+      && this->Inode == other.Inode;
+  }
+};
+
+//------------------------------------------------------------------------------
+ctkDICOMFileState fileState(const QFileInfo& fileInfo)
+{
+  ctkDICOMFileState state;
+  state.Size = fileInfo.size();
+  // QDateTime::toMSecsSinceEpoch() requires Qt 4.7
+  QDateTime modified = fileInfo.lastModified();
+  state.Modified = static_cast<qint64>(modified.toTime_t()) * 1000 + modified.time().msec();
+#ifndef Q_OS_WIN
+  // inode numbers are not meaningful on Windows
+  struct stat buffer;
+  if (stat(QFile::encodeName(fileInfo.absoluteFilePath()).constData(), &buffer) == 0)
+    {
+    state.Inode = static_cast<qint64>(buffer.st_ino);
+    // QFileInfo only has a one second resolution on Unix
+# ifdef Q_OS_MAC
+    state.Modified = static_cast<qint64>(buffer.st_mtimespec.tv_sec) * 1000
+      + buffer.st_mtimespec.tv_nsec / 1000000;
+# else
+    state.Modified = static_cast<qint64>(buffer.st_mtim.tv_sec) * 1000
+      + buffer.st_mtim.tv_nsec / 1000000;
+# endif
+    }
+#endif
+  return state;
+}
+
+//------------------------------------------------------------------------------
+// Message of the error of the last failed system call
+QString lastSystemError()
+{
+#ifdef Q_OS_WIN
+  // MoveFileW() and CreateHardLinkW() don't set errno
+  DWORD error = GetLastError();
+  LPWSTR message = 0;
+  FormatMessageW(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM |
+                 FORMAT_MESSAGE_IGNORE_INSERTS, NULL, error, 0,
+                 reinterpret_cast<LPWSTR>(&message), 0, NULL);
+  QString text = message ?
+    QString::fromWCharArray(message).trimmed() : QString::number(error);
+  LocalFree(message);
+  return text;
+#else
+  return QString::fromLocal8Bit(strerror(errno));
+#endif
+}
+}
+
 //------------------------------------------------------------------------------
 class ctkDICOMDatabasePrivate
 {
@@ -83,6 +177,35 @@ public:
   // filePath has to be set if this is an import of an actual file
   void insert ( const ctkDICOMDataset& ctkDataset, const QString& filePath, bool storeFile = true, bool generateThumbnail = true);
 
+  ///
+  /// \brief returns a query prepared with @param sql. During a batch insert
+  /// the statement is prepared only once and reused until the batch ends.
+  QSharedPointer<QSqlQuery> preparedQuery(const QString& sql);
+
+  ///
+  /// \brief stores @param sourceFilePath as @param storedFilePath according
+  /// to StoragePolicy, falling back on a copy if needed.
+  /// \return true on success, @param usedPolicy is set to the policy used
+  bool storeFile(const QString& sourceFilePath, const QString& storedFilePath,
+                 ctkDICOMDatabase::StoragePolicy& usedPolicy);
+  bool hardLinkFile(const QString& sourceFilePath, const QString& storedFilePath);
+  bool reflinkFile(const QString& sourceFilePath, const QString& storedFilePath);
+
+  ///
+  /// \brief commits the pending batch transaction and opens a new one
+  /// \return false if the inserts of the transaction were rolled back
+  bool commitBatch();
+  ///
+  /// \brief commits the current transaction, retrying while another
+  /// connection holds a lock. The transaction is rolled back if it can't
+  /// be committed, LastError is set and BatchFailed is raised.
+  bool commitTransaction();
+  void setBusyTimeout(int timeout);
+  void clearBatchCache();
+  ///
+  /// \brief forgets the last inserted patient, study and series, e.g. when
+  /// their rows are removed or rolled back
+  void clearInsertCache();
 
   /// Name of the database file (i.e. for SQLITE the sqlite file)
   QString      DatabaseFileName;
@@ -91,6 +214,7 @@ public:
   QMap<QString, QString> LoadedHeader;
 
   ctkDICOMAbstractThumbnailGenerator* thumbnailGenerator;
+  ctkDICOMDatabase::StoragePolicy StoragePolicy;
   
   /// these are for optimizing the import of image sequences
   /// since most information are identical for all slices
@@ -100,6 +224,19 @@ public:
   QString lastStudyInstanceUID;
   QString lastSeriesInstanceUID;
   int lastPatientUID;
+
+  /// batch insert state, see ctkDICOMDatabase::beginBatchInsert()
+  int  BatchInsertLevel;
+  int  BatchCommitInterval;
+  int  BatchPendingInserts;
+  bool BatchDatabaseChanged;
+  /// a commit of the batch failed, see endBatchInsert()
+  bool BatchFailed;
+  QHash<QString, QSharedPointer<QSqlQuery> > BatchQueries;
+  /// "PatientID\\PatientsName" -> Patients.UID
+  QHash<QString, int> BatchPatientUIDs;
+  QSet<QString> BatchStudyInstanceUIDs;
+  QSet<QString> BatchSeriesInstanceUIDs;
 };
 
 //------------------------------------------------------------------------------
@@ -109,7 +246,13 @@ public:
 ctkDICOMDatabasePrivate::ctkDICOMDatabasePrivate(ctkDICOMDatabase& o): q_ptr(&o)
 {
     this->thumbnailGenerator = NULL;
+    this->StoragePolicy = ctkDICOMDatabase::CopyFiles;
     this->lastPatientUID = -1;
+    this->BatchInsertLevel = 0;
+    this->BatchCommitInterval = 500;
+    this->BatchPendingInserts = 0;
+    this->BatchDatabaseChanged = false;
+    this->BatchFailed = false;
 }
 
 //------------------------------------------------------------------------------
@@ -171,6 +314,212 @@ bool ctkDICOMDatabasePrivate::loggedExec(QSqlQuery& query, const QString& queryS
   return (success);
 }
 
+//------------------------------------------------------------------------------
+QSharedPointer<QSqlQuery> ctkDICOMDatabasePrivate::preparedQuery(const QString& sql)
+{
+  QSharedPointer<QSqlQuery> query;
+  if (this->BatchInsertLevel > 0)
+    {
+    query = this->BatchQueries.value(sql);
+    if (query)
+      {
+      query->finish();
+      return query;
+      }
+    }
+  query = QSharedPointer<QSqlQuery>(new QSqlQuery(this->Database));
+  if (!query->prepare(sql))
+    {
+    logger.error("SQL failed to prepare: " + sql + " Error: " + query->lastError().text());
+    }
+  if (this->BatchInsertLevel > 0)
+    {
+    this->BatchQueries.insert(sql, query);
+    }
+  return query;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabasePrivate::hardLinkFile(const QString& sourceFilePath, const QString& storedFilePath)
+{
+#ifdef Q_OS_WIN
+  return CreateHardLinkW(reinterpret_cast<const wchar_t*>(QDir::toNativeSeparators(storedFilePath).utf16()),
+                         reinterpret_cast<const wchar_t*>(QDir::toNativeSeparators(sourceFilePath).utf16()),
+                         NULL) != 0;
+#else
+  return link(QFile::encodeName(sourceFilePath).constData(),
+              QFile::encodeName(storedFilePath).constData()) == 0;
+#endif
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabasePrivate::reflinkFile(const QString& sourceFilePath, const QString& storedFilePath)
+{
+#if defined(Q_OS_LINUX) && defined(FICLONE)
+  int source = open(QFile::encodeName(sourceFilePath).constData(), O_RDONLY);
+  if (source < 0)
+    {
+    return false;
+    }
+  int stored = open(QFile::encodeName(storedFilePath).constData(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+  if (stored < 0)
+    {
+    close(source);
+    return false;
+    }
+  bool success = ioctl(stored, FICLONE, source) == 0;
+  int error = errno;
+  close(stored);
+  close(source);
+  if (!success)
+    {
+    // EXDEV, EOPNOTSUPP...: leave no empty file behind
+    QFile::remove(storedFilePath);
+    // reported by storeFile()
+    errno = error;
+    }
+  return success;
+#else
+  Q_UNUSED(sourceFilePath);
+  Q_UNUSED(storedFilePath);
+  return false;
+#endif
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabasePrivate::storeFile(const QString& sourceFilePath, const QString& storedFilePath,
+                                        ctkDICOMDatabase::StoragePolicy& usedPolicy)
+{
+  usedPolicy = this->StoragePolicy;
+  switch (this->StoragePolicy)
+    {
+    case ctkDICOMDatabase::HardLinkFiles:
+      if (this->hardLinkFile(sourceFilePath, storedFilePath))
+        {
+        return true;
+        }
+      break;
+    case ctkDICOMDatabase::ReflinkFiles:
+      if (this->reflinkFile(sourceFilePath, storedFilePath))
+        {
+        return true;
+        }
+      break;
+    case ctkDICOMDatabase::MoveFiles:
+#ifdef Q_OS_WIN
+      if (MoveFileW(reinterpret_cast<const wchar_t*>(QDir::toNativeSeparators(sourceFilePath).utf16()),
+                    reinterpret_cast<const wchar_t*>(QDir::toNativeSeparators(storedFilePath).utf16())))
+#else
+      // unlike QFile::rename(), rename() doesn't copy across file systems,
+      // the fallback is reported
+      if (::rename(QFile::encodeName(sourceFilePath).constData(),
+                   QFile::encodeName(storedFilePath).constData()) == 0)
+#endif
+        {
+        return true;
+        }
+      break;
+    case ctkDICOMDatabase::CopyFiles:
+    default:
+      break;
+    }
+  if (usedPolicy != ctkDICOMDatabase::CopyFiles)
+    {
+    logger.debug(QString("Storage policy %1 failed for %2 (%3), copying the file")
+                 .arg(usedPolicy).arg(sourceFilePath).arg(lastSystemError()));
+    }
+  usedPolicy = ctkDICOMDatabase::CopyFiles;
+  if (!QFile::copy(sourceFilePath, storedFilePath))
+    {
+    return false;
+    }
+  if (this->StoragePolicy == ctkDICOMDatabase::MoveFiles)
+    {
+    QFile::remove(sourceFilePath);
+    }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabasePrivate::commitBatch()
+{
+  // the cached statements must be reset before the transaction can be
+  // committed, otherwise SQLite reports the database as busy
+  foreach (QSharedPointer<QSqlQuery> query, this->BatchQueries)
+    {
+    query->finish();
+    }
+  bool success = this->commitTransaction();
+  this->BatchPendingInserts = 0;
+  if (!this->Database.transaction())
+    {
+    logger.error("Failed to start batch insert transaction: " + this->Database.lastError().text());
+    }
+  return success;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabasePrivate::commitTransaction()
+{
+  // A COMMIT that fails with SQLITE_BUSY, after the busy timeout, leaves
+  // the transaction open and can be retried. SQLite sleeps with increasing
+  // delays while waiting, a longer timeout backs off the retries.
+  const int attempts = 3;
+  for (int attempt = 1; attempt <= attempts; ++attempt)
+    {
+    if (this->Database.commit())
+      {
+      this->setBusyTimeout(BusyTimeout);
+      return true;
+      }
+    logger.warn(QString("Failed to commit batch insert (attempt %1/%2): %3")
+                .arg(attempt).arg(attempts).arg(this->Database.lastError().text()));
+    this->setBusyTimeout(BusyTimeout << attempt);
+    }
+  this->setBusyTimeout(BusyTimeout);
+  this->LastError = "Failed to commit batch insert: " + this->Database.lastError().text();
+  logger.error(this->LastError);
+  this->Database.rollback();
+  // the cached rows no longer exist
+  this->BatchPatientUIDs.clear();
+  this->BatchStudyInstanceUIDs.clear();
+  this->BatchSeriesInstanceUIDs.clear();
+  this->clearInsertCache();
+  this->BatchFailed = true;
+  return false;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabasePrivate::setBusyTimeout(int timeout)
+{
+  QSqlQuery busyTimeout(this->Database);
+  if (!busyTimeout.exec(QString("PRAGMA busy_timeout = %1").arg(timeout)))
+    {
+    logger.warn("Failed to set the busy timeout: " + busyTimeout.lastError().text());
+    }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabasePrivate::clearBatchCache()
+{
+  this->BatchQueries.clear();
+  this->BatchPatientUIDs.clear();
+  this->BatchStudyInstanceUIDs.clear();
+  this->BatchSeriesInstanceUIDs.clear();
+  this->BatchPendingInserts = 0;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabasePrivate::clearInsertCache()
+{
+  this->lastPatientID = "";
+  this->lastPatientsName = "";
+  this->lastPatientsBirthDate = "";
+  this->lastPatientUID = -1;
+  this->lastStudyInstanceUID = "";
+  this->lastSeriesInstanceUID = "";
+}
+
 //------------------------------------------------------------------------------
 void ctkDICOMDatabase::openDatabase(const QString databaseFile, const QString& connectionName )
 {
@@ -178,11 +527,22 @@ void ctkDICOMDatabase::openDatabase(const QString databaseFile, const QString& c
   d->DatabaseFileName = databaseFile;
   d->Database = QSqlDatabase::addDatabase("QSQLITE", connectionName);
   d->Database.setDatabaseName(databaseFile);
+  d->Database.setConnectOptions(QString("QSQLITE_BUSY_TIMEOUT=%1").arg(BusyTimeout));
   if ( ! (d->Database.open()) )
     {
     d->LastError = d->Database.lastError().text();
     return;
     }
+  if (!isInMemory())
+    {
+    // Readers don't block the writer, e.g. the indexer thread of
+    // ctkDICOMRetrieve, and a writer only blocks the other writers.
+    QSqlQuery journalMode(d->Database);
+    if (!journalMode.exec("PRAGMA journal_mode=WAL"))
+      {
+      logger.warn("Failed to enable write-ahead logging: " + journalMode.lastError().text());
+      }
+    }
   if ( d->Database.tables().empty() )
     {
     if (!initializeDatabase())
@@ -191,9 +551,34 @@ void ctkDICOMDatabase::openDatabase(const QString databaseFile, const QString& c
       return;
       }
     }
+  else
+    {
+    int version = this->schemaVersionLoaded();
+    if ( version < ctkDICOMDatabase::schemaVersion() )
+      {
+      if (!this->upgradeSchema())
+        {
+        d->LastError = QString("Unable to upgrade DICOM database schema!");
+        return;
+        }
+      }
+    else if ( version > ctkDICOMDatabase::schemaVersion() )
+      {
+      // Opened as is: what the newer version added is not maintained
+      logger.warn(QString("Database schema version %1 of %2 is newer than the supported "
+                          "version %3, some information may not be updated")
+                  .arg(version).arg(databaseFile).arg(ctkDICOMDatabase::schemaVersion()));
+      }
+    }
   if (!isInMemory())
     {
     QFileSystemWatcher* watcher = new QFileSystemWatcher(QStringList(databaseFile),this);
+    // in WAL mode, the changes are written into the database file only at
+    // checkpoints
+    if (QFile::exists(databaseFile + "-wal"))
+      {
+      watcher->addPath(databaseFile + "-wal");
+      }
     connect(watcher, SIGNAL(fileChanged(QString)),this, SIGNAL (databaseChanged()) );
     }
 }
@@ -267,6 +652,20 @@ ctkDICOMAbstractThumbnailGenerator* ctkDICOMDatabase::thumbnailGenerator(){
     return d->thumbnailGenerator;
 }
 
+//------------------------------------------------------------------------------
+void ctkDICOMDatabase::setStoragePolicy(StoragePolicy policy)
+{
+  Q_D(ctkDICOMDatabase);
+  d->StoragePolicy = policy;
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMDatabase::StoragePolicy ctkDICOMDatabase::storagePolicy()const
+{
+  Q_D(const ctkDICOMDatabase);
+  return d->StoragePolicy;
+}
+
 //------------------------------------------------------------------------------
 bool ctkDICOMDatabasePrivate::executeScript(const QString script) {
   QFile scriptFile(script);
@@ -310,10 +709,67 @@ bool ctkDICOMDatabase::initializeDatabase(const char* sqlFileName)
   return d->executeScript(sqlFileName);
 }
 
+//------------------------------------------------------------------------------
+int ctkDICOMDatabase::schemaVersion()
+{
+  return DICOMDatabaseSchemaVersion;
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMDatabase::schemaVersionLoaded()
+{
+  Q_D(ctkDICOMDatabase);
+  if (!d->Database.tables().contains("SchemaInfo"))
+    {
+    return 0;
+    }
+  QSqlQuery query(d->Database);
+  if (!d->loggedExec(query, "SELECT Version FROM SchemaInfo") || !query.next())
+    {
+    return 0;
+    }
+  return query.value(0).toInt();
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabase::upgradeSchema()
+{
+  Q_D(ctkDICOMDatabase);
+  int version = this->schemaVersionLoaded();
+  if (version > ctkDICOMDatabase::schemaVersion())
+    {
+    logger.error(QString("Database schema version %1 is newer than the supported version %2")
+                 .arg(version).arg(ctkDICOMDatabase::schemaVersion()));
+    return false;
+    }
+  if (version == ctkDICOMDatabase::schemaVersion())
+    {
+    return true;
+    }
+  d->Database.transaction();
+  for (++version; version <= ctkDICOMDatabase::schemaVersion(); ++version)
+    {
+    logger.info(QString("Upgrading database schema to version %1").arg(version));
+    if (!d->executeScript(QString(":/dicom/dicom-schema-upgrade-%1.sql").arg(version)))
+      {
+      logger.error(QString("Failed to upgrade database schema to version %1").arg(version));
+      d->Database.rollback();
+      return false;
+      }
+    }
+  return d->Database.commit();
+}
+
 //------------------------------------------------------------------------------
 void ctkDICOMDatabase::closeDatabase()
 {
   Q_D(ctkDICOMDatabase);
+  if (d->BatchInsertLevel > 0)
+    {
+    logger.warn("Closing the database during a batch insert, committing pending inserts");
+    d->BatchInsertLevel = 1;
+    this->endBatchInsert();
+    }
   d->Database.close();
 }
 
@@ -417,7 +873,9 @@ void ctkDICOMDatabase::loadFileHeader (QString fileName)
   Q_D(ctkDICOMDatabase);
   d->LoadedHeader.clear();
   DcmFileFormat fileFormat;
-  OFCondition status = fileFormat.loadFile(fileName.toLatin1().data());
+  // large values (e.g. pixel data) are not loaded and printed "(not loaded)"
+  OFCondition status = fileFormat.loadFile(fileName.toLatin1().data(),
+    EXS_Unknown, EGL_noChange, HeaderMaxValueLength);
   if (status.good())
     {
     DcmDataset *dataset = fileFormat.getDataset();
@@ -497,7 +955,7 @@ void ctkDICOMDatabase::insert ( const QString& filePath, bool storeFile, bool ge
   DcmFileFormat fileformat;
   ctkDICOMDataset ctkDataset;
 
-  ctkDataset.InitializeFromFile(filePath);
+  ctkDataset.InitializeFromFileHeader(filePath);
   if ( ctkDataset.IsInitialized() )
   {
     d->insert( ctkDataset, filePath, storeFile, generateThumbnail );
@@ -505,9 +963,90 @@ void ctkDICOMDatabase::insert ( const QString& filePath, bool storeFile, bool ge
   else
   {
     logger.warn(QString("Could not read DICOM file:") + filePath);
+    if (!storeFile)
+    {
+      this->rejectFile(filePath);
+    }
   }
 }
 
+//------------------------------------------------------------------------------
+void ctkDICOMDatabase::insert ( const QString& filePath, const ctkDICOMDataset& ctkDataset, bool storeFile, bool generateThumbnail)
+{
+  Q_D(ctkDICOMDatabase);
+  d->insert( ctkDataset, filePath, storeFile, generateThumbnail );
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabase::insert ( const QStringList& filePaths, bool storeFile, bool generateThumbnail)
+{
+  this->beginBatchInsert();
+  foreach (const QString& filePath, filePaths)
+    {
+    this->insert(filePath, storeFile, generateThumbnail);
+    }
+  this->endBatchInsert();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabase::beginBatchInsert(int commitInterval)
+{
+  Q_D(ctkDICOMDatabase);
+  if (d->BatchInsertLevel++ > 0)
+    {
+    return;
+    }
+  d->BatchCommitInterval = qMax(1, commitInterval);
+  d->BatchDatabaseChanged = false;
+  d->BatchFailed = false;
+  d->clearBatchCache();
+  if (!d->Database.transaction())
+    {
+    logger.error("Failed to start batch insert transaction: " + d->Database.lastError().text());
+    }
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabase::endBatchInsert()
+{
+  Q_D(ctkDICOMDatabase);
+  if (d->BatchInsertLevel == 0)
+    {
+    logger.warn("endBatchInsert() called without matching beginBatchInsert()");
+    return false;
+    }
+  if (--d->BatchInsertLevel > 0)
+    {
+    return !d->BatchFailed;
+    }
+  foreach (QSharedPointer<QSqlQuery> query, d->BatchQueries)
+    {
+    query->finish();
+    }
+  d->commitTransaction();
+  d->clearBatchCache();
+  if (d->BatchDatabaseChanged)
+    {
+    d->BatchDatabaseChanged = false;
+    emit databaseChanged();
+    }
+  return !d->BatchFailed;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabase::clearInsertCache()
+{
+  Q_D(ctkDICOMDatabase);
+  d->clearInsertCache();
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabase::isBatchInsert() const
+{
+  Q_D(const ctkDICOMDatabase);
+  return d->BatchInsertLevel > 0;
+}
+
 //------------------------------------------------------------------------------
 void ctkDICOMDatabasePrivate::insert( const ctkDICOMDataset& ctkDataset, const QString& filePath, bool storeFile, bool generateThumbnail)
 {
@@ -521,23 +1060,26 @@ void ctkDICOMDatabasePrivate::insert( const ctkDICOMDataset& ctkDataset, const Q
 
   QString sopInstanceUID ( ctkDataset.GetElementAsString(DCM_SOPInstanceUID) );
 
-  QSqlQuery fileExists ( Database );
-  fileExists.prepare("SELECT InsertTimestamp,Filename FROM Images WHERE SOPInstanceUID == :sopInstanceUID");
-  fileExists.bindValue(":sopInstanceUID",sopInstanceUID);
-  bool success = fileExists.exec();
+  QSharedPointer<QSqlQuery> fileExists = this->preparedQuery(
+    "SELECT InsertTimestamp,Filename FROM Images WHERE SOPInstanceUID == :sopInstanceUID");
+  fileExists->bindValue(":sopInstanceUID",sopInstanceUID);
+  bool success = fileExists->exec();
   if (!success)
   {
-    logger.error("SQLITE ERROR: " + fileExists.lastError().driverText());
+    logger.error("SQLITE ERROR: " + fileExists->lastError().driverText());
     return;
   }
-  qDebug() << "filename is: " << fileExists.value(1).toString();
-  qDebug() << "modified date is: " << QFileInfo(fileExists.value(1).toString()).lastModified();
-  qDebug() << "db mod date is: " << QDateTime::fromString(fileExists.value(0).toString(),Qt::ISODate);
-  if ( fileExists.next() && QFileInfo(fileExists.value(1).toString()).lastModified() < QDateTime::fromString(fileExists.value(0).toString(),Qt::ISODate) )
+  if ( fileExists->next() && QFileInfo(fileExists->value(1).toString()).lastModified() < QDateTime::fromString(fileExists->value(0).toString(),Qt::ISODate) )
   {
-    logger.debug ( "File " + fileExists.value(1).toString() + " already added" );
+    logger.debug ( "File " + fileExists->value(1).toString() + " already added" );
+    if ( !storeFile && !filePath.isEmpty() && filePath != fileExists->value(1).toString() )
+    {
+      // another file of the same image
+      q->rejectFile(filePath);
+    }
     return;
   }
+  fileExists->finish();
 
   //If the following fields can not be evaluated, cancel evaluation of the DICOM file
   QString patientsName(ctkDataset.GetElementAsString(DCM_PatientName) );
@@ -552,6 +1094,10 @@ void ctkDICOMDatabasePrivate::insert( const ctkDICOMDataset& ctkDataset, const Q
   if ( patientsName.isEmpty() || studyInstanceUID.isEmpty() || patientID.isEmpty() )
   {
     logger.error("Dataset is missing necessary information!");
+    if ( !storeFile && !filePath.isEmpty() )
+    {
+      q->rejectFile(filePath);
+    }
     return;
   } 
 
@@ -657,15 +1203,31 @@ void ctkDICOMDatabasePrivate::insert( const ctkDICOMDataset& ctkDataset, const Q
       else
       {
         // we're inserting an existing file
-
-        QFile currentFile( filePath );
-        currentFile.copy(filename);
-        logger.debug( "Copy file from: " + filePath );
-        logger.debug( "Copy file to  : " + filename );
+        if ( QFile::exists(filename) )
+        {
+          logger.debug( "File already stored: " + filename );
+        }
+        else
+        {
+          if ( this->StoragePolicy == ctkDICOMDatabase::MoveFiles )
+          {
+            // the values not read yet could no longer be loaded from the
+            // source file, the pixel data is read from the stored file
+            ctkDataset.LoadValuesIntoMemory();
+          }
+          ctkDICOMDatabase::StoragePolicy usedPolicy;
+          if ( !this->storeFile(filePath, filename, usedPolicy) )
+          {
+            logger.error ( "Error storing file " + filePath + " to " + filename );
+            return;
+          }
+          logger.debug( "Stored file from: " + filePath );
+          logger.debug( "Stored file to  : " + filename );
+          emit q->fileStored(filePath, filename, usedPolicy);
+        }
       }
     }
 
-  QSqlQuery checkPatientExistsQuery(Database);
   //The dbPatientID  is a unique number within the database, 
   //generated by the sqlite autoincrement
   //The patientID  is the (non-unique) DICOM patient id
@@ -682,53 +1244,91 @@ void ctkDICOMDatabasePrivate::insert( const ctkDICOMDataset& ctkDataset, const Q
       // Ok, something is different from last insert, let's insert him if he's not
       // already in the db.
       //
-
-      // Check if patient is already present in the db
-      // TODO: maybe add birthdate check for extra safety
-      checkPatientExistsQuery.prepare ( "SELECT * FROM Patients WHERE PatientID = ? AND PatientsName = ?" );
-      checkPatientExistsQuery.bindValue ( 0, patientID );
-      checkPatientExistsQuery.bindValue ( 1, patientsName );
-      loggedExec(checkPatientExistsQuery);
-
-      if (checkPatientExistsQuery.next())
-      {
-        // we found him
-        dbPatientID = checkPatientExistsQuery.value(checkPatientExistsQuery.record().indexOf("UID")).toInt();
-      }
+      QString batchPatientKey = patientID + "\\" + patientsName;
+      if ( BatchInsertLevel > 0 && BatchPatientUIDs.contains(batchPatientKey) )
+        {
+        // already looked up or inserted during this batch
+        dbPatientID = BatchPatientUIDs.value(batchPatientKey);
+        }
       else
         {
-        // Insert it
-        QSqlQuery insertPatientStatement ( Database );
-        insertPatientStatement.prepare ( "INSERT INTO Patients ('UID', 'PatientsName', 'PatientID', 'PatientsBirthDate', 'PatientsBirthTime', 'PatientsSex', 'PatientsAge', 'PatientsComments' ) values ( NULL, ?, ?, ?, ?, ?, ?, ? )" );
-        insertPatientStatement.bindValue ( 0, patientsName );
-        insertPatientStatement.bindValue ( 1, patientID );
-        insertPatientStatement.bindValue ( 2, QDate::fromString ( patientsBirthDate, "yyyyMMdd" ) );
-        insertPatientStatement.bindValue ( 3, patientsBirthTime );
-        insertPatientStatement.bindValue ( 4, patientsSex );
-        // TODO: shift patient's age to study, 
-        // since this is not a patient level attribute in images
-        // insertPatientStatement.bindValue ( 5, patientsAge );
-        insertPatientStatement.bindValue ( 6, patientComments );
-        loggedExec(insertPatientStatement);
-        dbPatientID = insertPatientStatement.lastInsertId().toInt();
-        logger.debug ( "New patient inserted: " + QString().setNum ( dbPatientID ) );
+        // Check if patient is already present in the db
+        // TODO: maybe add birthdate check for extra safety
+        QSharedPointer<QSqlQuery> checkPatientExistsQuery = this->preparedQuery(
+          "SELECT UID FROM Patients WHERE PatientID = ? AND PatientsName = ?" );
+        checkPatientExistsQuery->bindValue ( 0, patientID );
+        checkPatientExistsQuery->bindValue ( 1, patientsName );
+        loggedExec(*checkPatientExistsQuery);
+
+        if (checkPatientExistsQuery->next())
+          {
+          // we found him
+          dbPatientID = checkPatientExistsQuery->value(0).toInt();
+          checkPatientExistsQuery->finish();
+          }
+        else
+          {
+          // Insert it
+          QSharedPointer<QSqlQuery> insertPatientStatement = this->preparedQuery(
+            "INSERT INTO Patients ('UID', 'PatientsName', 'PatientID', 'PatientsBirthDate', 'PatientsBirthTime', 'PatientsSex', 'PatientsAge', 'PatientsComments' ) values ( NULL, ?, ?, ?, ?, ?, ?, ? )" );
+          insertPatientStatement->bindValue ( 0, patientsName );
+          insertPatientStatement->bindValue ( 1, patientID );
+          insertPatientStatement->bindValue ( 2, QDate::fromString ( patientsBirthDate, "yyyyMMdd" ) );
+          insertPatientStatement->bindValue ( 3, patientsBirthTime );
+          insertPatientStatement->bindValue ( 4, patientsSex );
+          // TODO: shift patient's age to study, 
+          // since this is not a patient level attribute in images
+          // insertPatientStatement->bindValue ( 5, patientsAge );
+          insertPatientStatement->bindValue ( 5, QVariant() );
+          insertPatientStatement->bindValue ( 6, patientComments );
+          if ( loggedExec(*insertPatientStatement) )
+            {
+            dbPatientID = insertPatientStatement->lastInsertId().toInt();
+            logger.debug ( "New patient inserted: " + QString().setNum ( dbPatientID ) );
+            }
+          }
+        // a patient that could not be inserted is tried again with the
+        // next file
+        if ( BatchInsertLevel > 0 && dbPatientID != -1 )
+          {
+          BatchPatientUIDs.insert(batchPatientKey, dbPatientID);
+          }
         }
       /// keep this for the next image
-      lastPatientUID = dbPatientID;
-      lastPatientID = patientID;
-      lastPatientsBirthDate = patientsBirthDate;
-      lastPatientsName = patientsName;
+      if ( dbPatientID != -1 )
+        {
+        lastPatientUID = dbPatientID;
+        lastPatientID = patientID;
+        lastPatientsBirthDate = patientsBirthDate;
+        lastPatientsName = patientsName;
+        }
+      }
+    else
+      {
+      dbPatientID = lastPatientUID;
       }
 
     // Patient is in now. Let's continue with the study
 
-    if ( studyInstanceUID != "" /*&& lastStudyInstanceUID != studyInstanceUID */)
+    if ( studyInstanceUID != "" )
     {
-      QSqlQuery checkStudyExistsQuery (Database);
-      checkStudyExistsQuery.prepare ( "SELECT * FROM Studies WHERE StudyInstanceUID = ?" );
-      checkStudyExistsQuery.bindValue ( 0, studyInstanceUID );
-      checkStudyExistsQuery.exec();
-      if(checkStudyExistsQuery.next())
+      // the studies found or inserted in the current batch are not looked
+      // up again, but each file may still add study information
+      bool studyExists = BatchStudyInstanceUIDs.contains(studyInstanceUID);
+      if (!studyExists)
+      {
+        QSharedPointer<QSqlQuery> checkStudyExistsQuery = this->preparedQuery(
+          "SELECT StudyInstanceUID FROM Studies WHERE StudyInstanceUID = ?" );
+        checkStudyExistsQuery->bindValue ( 0, studyInstanceUID );
+        checkStudyExistsQuery->exec();
+        studyExists = checkStudyExistsQuery->next();
+        checkStudyExistsQuery->finish();
+        if ( studyExists && BatchInsertLevel > 0 )
+        {
+          BatchStudyInstanceUIDs.insert(studyInstanceUID);
+        }
+      }
+      if(studyExists)
       {
         if (!studyDescription.isEmpty()          
           || !institutionName.isEmpty()
@@ -739,26 +1339,25 @@ void ctkDICOMDatabasePrivate::insert( const ctkDICOMDataset& ctkDataset, const Q
         {
           // the study has been already added
           // there maybe additional study information
-          QSqlQuery updateStudyStatement ( Database );
-          updateStudyStatement.prepare(
+          QSharedPointer<QSqlQuery> updateStudyStatement = this->preparedQuery(
             "UPDATE Studies SET StudyID=?, StudyDate=?, StudyTime=?, AccessionNumber=?, \
             ModalitiesInStudy=?, InstitutionName=?, ReferringPhysician=?, PerformingPhysiciansName=?, \
             StudyDescription=? \
             WHERE StudyInstanceUID=?" );
           int ind=0;
-          updateStudyStatement.bindValue ( ind++, studyID );
-          updateStudyStatement.bindValue ( ind++, QDate::fromString ( studyDate, "yyyyMMdd" ) );
-          updateStudyStatement.bindValue ( ind++, studyTime );
-          updateStudyStatement.bindValue ( ind++, accessionNumber );
-          updateStudyStatement.bindValue ( ind++, modalitiesInStudy );
-          updateStudyStatement.bindValue ( ind++, institutionName );
-          updateStudyStatement.bindValue ( ind++, referringPhysician );
-          updateStudyStatement.bindValue ( ind++, performingPhysiciansName );
-          updateStudyStatement.bindValue ( ind++, studyDescription );
-          updateStudyStatement.bindValue ( ind++, studyInstanceUID );
-          if ( !updateStudyStatement.exec() )
+          updateStudyStatement->bindValue ( ind++, studyID );
+          updateStudyStatement->bindValue ( ind++, QDate::fromString ( studyDate, "yyyyMMdd" ) );
+          updateStudyStatement->bindValue ( ind++, studyTime );
+          updateStudyStatement->bindValue ( ind++, accessionNumber );
+          updateStudyStatement->bindValue ( ind++, modalitiesInStudy );
+          updateStudyStatement->bindValue ( ind++, institutionName );
+          updateStudyStatement->bindValue ( ind++, referringPhysician );
+          updateStudyStatement->bindValue ( ind++, performingPhysiciansName );
+          updateStudyStatement->bindValue ( ind++, studyDescription );
+          updateStudyStatement->bindValue ( ind++, studyInstanceUID );
+          if ( !updateStudyStatement->exec() )
           {
-            logger.error ( "Error executing statament: " + updateStudyStatement.lastQuery() + " Error: " + updateStudyStatement.lastError().text() );
+            logger.error ( "Error executing statament: " + updateStudyStatement->lastQuery() + " Error: " + updateStudyStatement->lastError().text() );
           }
           else
           {
@@ -768,92 +1367,113 @@ void ctkDICOMDatabasePrivate::insert( const ctkDICOMDataset& ctkDataset, const Q
       }
       else
       {
-        QSqlQuery insertStudyStatement ( Database );
-        insertStudyStatement.prepare ( "INSERT INTO Studies ( 'StudyInstanceUID', 'PatientsUID', 'StudyID', 'StudyDate', 'StudyTime', 'AccessionNumber', 'ModalitiesInStudy', 'InstitutionName', 'ReferringPhysician', 'PerformingPhysiciansName', 'StudyDescription' ) VALUES ( ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ? )" );
-        insertStudyStatement.bindValue ( 0, studyInstanceUID );
-        insertStudyStatement.bindValue ( 1, dbPatientID );
-        insertStudyStatement.bindValue ( 2, studyID );
-        insertStudyStatement.bindValue ( 3, QDate::fromString ( studyDate, "yyyyMMdd" ) );
-        insertStudyStatement.bindValue ( 4, studyTime );
-        insertStudyStatement.bindValue ( 5, accessionNumber );
-        insertStudyStatement.bindValue ( 6, modalitiesInStudy );
-        insertStudyStatement.bindValue ( 7, institutionName );
-        insertStudyStatement.bindValue ( 8, referringPhysician );
-        insertStudyStatement.bindValue ( 9, performingPhysiciansName );
-        insertStudyStatement.bindValue ( 10, studyDescription );
-        if ( !insertStudyStatement.exec() )
+        QSharedPointer<QSqlQuery> insertStudyStatement = this->preparedQuery(
+          "INSERT INTO Studies ( 'StudyInstanceUID', 'PatientsUID', 'StudyID', 'StudyDate', 'StudyTime', 'AccessionNumber', 'ModalitiesInStudy', 'InstitutionName', 'ReferringPhysician', 'PerformingPhysiciansName', 'StudyDescription' ) VALUES ( ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ? )" );
+        insertStudyStatement->bindValue ( 0, studyInstanceUID );
+        insertStudyStatement->bindValue ( 1, dbPatientID );
+        insertStudyStatement->bindValue ( 2, studyID );
+        insertStudyStatement->bindValue ( 3, QDate::fromString ( studyDate, "yyyyMMdd" ) );
+        insertStudyStatement->bindValue ( 4, studyTime );
+        insertStudyStatement->bindValue ( 5, accessionNumber );
+        insertStudyStatement->bindValue ( 6, modalitiesInStudy );
+        insertStudyStatement->bindValue ( 7, institutionName );
+        insertStudyStatement->bindValue ( 8, referringPhysician );
+        insertStudyStatement->bindValue ( 9, performingPhysiciansName );
+        insertStudyStatement->bindValue ( 10, studyDescription );
+        if ( !insertStudyStatement->exec() )
         {
-          logger.error ( "Error executing statament: " + insertStudyStatement.lastQuery() + " Error: " + insertStudyStatement.lastError().text() );
+          logger.error ( "Error executing statament: " + insertStudyStatement->lastQuery() + " Error: " + insertStudyStatement->lastError().text() );
         }
         else
         {
           lastStudyInstanceUID = studyInstanceUID;
+          if ( BatchInsertLevel > 0 )
+          {
+            BatchStudyInstanceUIDs.insert(studyInstanceUID);
+          }
         }
 
       }
     }
 
-    if ( seriesInstanceUID != "" && seriesInstanceUID != lastSeriesInstanceUID )
+    if ( seriesInstanceUID != "" && seriesInstanceUID != lastSeriesInstanceUID
+         && !BatchSeriesInstanceUIDs.contains(seriesInstanceUID) )
     {
-      QSqlQuery checkSeriesExistsQuery (Database);
-      checkSeriesExistsQuery.prepare ( "SELECT * FROM Series WHERE SeriesInstanceUID = ?" );
-      checkSeriesExistsQuery.bindValue ( 0, seriesInstanceUID );
-      logger.warn ( "Statement: " + checkSeriesExistsQuery.lastQuery() );
-      loggedExec(checkSeriesExistsQuery);
+      QSharedPointer<QSqlQuery> checkSeriesExistsQuery = this->preparedQuery(
+        "SELECT SeriesInstanceUID FROM Series WHERE SeriesInstanceUID = ?" );
+      checkSeriesExistsQuery->bindValue ( 0, seriesInstanceUID );
+      loggedExec(*checkSeriesExistsQuery);
       if (seriesDate.isEmpty())
       {
         QString contentDate(ctkDataset.GetElementAsString(DCM_ContentDate) );
         seriesDate=contentDate;
       }
-      if(!checkSeriesExistsQuery.next())
+      if(!checkSeriesExistsQuery->next())
       {
-        QSqlQuery insertSeriesStatement ( Database );
-        insertSeriesStatement.prepare ( "INSERT INTO Series ( 'SeriesInstanceUID', 'StudyInstanceUID', 'SeriesNumber', 'SeriesDate', 'SeriesTime', 'SeriesDescription', 'BodyPartExamined', 'FrameOfReferenceUID', 'AcquisitionNumber', 'ContrastAgent', 'ScanningSequence', 'EchoNumber', 'TemporalPosition' ) VALUES ( ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ? )" );
-        insertSeriesStatement.bindValue ( 0, seriesInstanceUID );
-        insertSeriesStatement.bindValue ( 1, studyInstanceUID );
-        insertSeriesStatement.bindValue ( 2, static_cast<int>(seriesNumber) );
-        insertSeriesStatement.bindValue ( 3, QDate::fromString ( seriesDate, "yyyyMMdd" ));
-        insertSeriesStatement.bindValue ( 4, seriesTime );
-        insertSeriesStatement.bindValue ( 5, seriesDescription );
-        insertSeriesStatement.bindValue ( 6, bodyPartExamined );
-        insertSeriesStatement.bindValue ( 7, frameOfReferenceUID );
-        insertSeriesStatement.bindValue ( 8, static_cast<int>(acquisitionNumber) );
-        insertSeriesStatement.bindValue ( 9, contrastAgent );
-        insertSeriesStatement.bindValue ( 10, scanningSequence );
-        insertSeriesStatement.bindValue ( 11, static_cast<int>(echoNumber) );
-        insertSeriesStatement.bindValue ( 12, static_cast<int>(temporalPosition) );
-        if ( !insertSeriesStatement.exec() )
+        QSharedPointer<QSqlQuery> insertSeriesStatement = this->preparedQuery(
+          "INSERT INTO Series ( 'SeriesInstanceUID', 'StudyInstanceUID', 'SeriesNumber', 'SeriesDate', 'SeriesTime', 'SeriesDescription', 'BodyPartExamined', 'FrameOfReferenceUID', 'AcquisitionNumber', 'ContrastAgent', 'ScanningSequence', 'EchoNumber', 'TemporalPosition' ) VALUES ( ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ? )" );
+        insertSeriesStatement->bindValue ( 0, seriesInstanceUID );
+        insertSeriesStatement->bindValue ( 1, studyInstanceUID );
+        insertSeriesStatement->bindValue ( 2, static_cast<int>(seriesNumber) );
+        insertSeriesStatement->bindValue ( 3, QDate::fromString ( seriesDate, "yyyyMMdd" ));
+        insertSeriesStatement->bindValue ( 4, seriesTime );
+        insertSeriesStatement->bindValue ( 5, seriesDescription );
+        insertSeriesStatement->bindValue ( 6, bodyPartExamined );
+        insertSeriesStatement->bindValue ( 7, frameOfReferenceUID );
+        insertSeriesStatement->bindValue ( 8, static_cast<int>(acquisitionNumber) );
+        insertSeriesStatement->bindValue ( 9, contrastAgent );
+        insertSeriesStatement->bindValue ( 10, scanningSequence );
+        insertSeriesStatement->bindValue ( 11, static_cast<int>(echoNumber) );
+        insertSeriesStatement->bindValue ( 12, static_cast<int>(temporalPosition) );
+        if ( !insertSeriesStatement->exec() )
         {
           logger.error ( "Error executing statament: " 
-            + insertSeriesStatement.lastQuery() 
-            + " Error: " + insertSeriesStatement.lastError().text() );
+            + insertSeriesStatement->lastQuery() 
+            + " Error: " + insertSeriesStatement->lastError().text() );
           lastSeriesInstanceUID = "";
         }
         else
         {
           lastSeriesInstanceUID = seriesInstanceUID;
+          if ( BatchInsertLevel > 0 )
+          {
+            BatchSeriesInstanceUIDs.insert(seriesInstanceUID);
+          }
         }
 
       }
+      else
+      {
+        checkSeriesExistsQuery->finish();
+        if ( BatchInsertLevel > 0 )
+        {
+          BatchSeriesInstanceUIDs.insert(seriesInstanceUID);
+        }
+      }
     }
     // TODO: what to do with imported files
     //
    if ( !filename.isEmpty() && !seriesInstanceUID.isEmpty() )
    {
-     QSqlQuery checkImageExistsQuery (Database);
-     checkImageExistsQuery.prepare ( "SELECT * FROM Images WHERE Filename = ?" );
-     checkImageExistsQuery.bindValue ( 0, filename );
-     checkImageExistsQuery.exec();
-     if(!checkImageExistsQuery.next())
+     QSharedPointer<QSqlQuery> checkImageExistsQuery = this->preparedQuery(
+       "SELECT SOPInstanceUID FROM Images WHERE Filename = ?" );
+     checkImageExistsQuery->bindValue ( 0, filename );
+     checkImageExistsQuery->exec();
+     if(!checkImageExistsQuery->next())
       {
-        QSqlQuery insertImageStatement ( Database );
-        insertImageStatement.prepare ( "INSERT INTO Images ( 'SOPInstanceUID', 'Filename', 'SeriesInstanceUID', 'InsertTimestamp' ) VALUES ( ?, ?, ?, ? )" );
-        insertImageStatement.bindValue ( 0, sopInstanceUID );
-        insertImageStatement.bindValue ( 1, filename );
-        insertImageStatement.bindValue ( 2, seriesInstanceUID );
-        insertImageStatement.bindValue ( 3, QDateTime::currentDateTime() );
-        insertImageStatement.exec();
+        ctkDICOMFileState state = fileState(QFileInfo(filename));
+        QSharedPointer<QSqlQuery> insertImageStatement = this->preparedQuery(
+          "INSERT INTO Images ( 'SOPInstanceUID', 'Filename', 'SeriesInstanceUID', 'InsertTimestamp', 'FileSize', 'FileModified', 'FileInode' ) VALUES ( ?, ?, ?, ?, ?, ?, ? )" );
+        insertImageStatement->bindValue ( 0, sopInstanceUID );
+        insertImageStatement->bindValue ( 1, filename );
+        insertImageStatement->bindValue ( 2, seriesInstanceUID );
+        insertImageStatement->bindValue ( 3, QDateTime::currentDateTime() );
+        insertImageStatement->bindValue ( 4, state.Size );
+        insertImageStatement->bindValue ( 5, state.Modified );
+        insertImageStatement->bindValue ( 6, state.Inode );
+        insertImageStatement->exec();
       }
+     checkImageExistsQuery->finish();
     }
 
     if( generateThumbnail && thumbnailGenerator && !seriesInstanceUID.isEmpty() )
@@ -873,7 +1493,18 @@ void ctkDICOMDatabasePrivate::insert( const ctkDICOMDataset& ctkDataset, const Q
         }
       }
 
-    if (q->isInMemory())
+    if ( BatchInsertLevel > 0 )
+      {
+      if (q->isInMemory())
+        {
+        BatchDatabaseChanged = true;
+        }
+      if ( ++BatchPendingInserts >= BatchCommitInterval )
+        {
+        this->commitBatch();
+        }
+      }
+    else if (q->isInMemory())
       {
       emit q->databaseChanged();
       }
@@ -900,6 +1531,197 @@ bool ctkDICOMDatabase::fileExistsAndUpToDate(const QString& filePath)
   return result; 
 }
 
+//------------------------------------------------------------------------------
+void ctkDICOMDatabase::compareFiles(const QString& directory,
+                                    QStringList& newFiles,
+                                    QStringList& modifiedFiles,
+                                    QStringList& removedFiles)
+{
+  Q_D(ctkDICOMDatabase);
+  QString directoryPath = QDir(directory).absolutePath();
+  if (!directoryPath.endsWith('/'))
+    {
+    directoryPath += '/';
+    }
+
+  // Files on disk
+  QHash<QString, QFileInfo> fileSystemFiles;
+  QDirIterator it(QDir(directory).absolutePath(), QDir::Files, QDirIterator::Subdirectories);
+  while (it.hasNext())
+    {
+    it.next();
+    fileSystemFiles.insert(it.filePath(), it.fileInfo());
+    }
+
+  // Files in the database. All the paths below the directory sort between
+  // "<directory>/" and "<directory>0" ('0' follows '/'), this range query
+  // uses the Filename index.
+  QSqlQuery databaseFiles(d->Database);
+  databaseFiles.prepare("SELECT Filename, FileSize, FileModified, FileInode, InsertTimestamp "
+                        "FROM Images WHERE Filename >= ? AND Filename < ?");
+  databaseFiles.bindValue(0, directoryPath);
+  databaseFiles.bindValue(1, directoryPath.left(directoryPath.size() - 1) + '0');
+  d->loggedExec(databaseFiles);
+
+  QSharedPointer<QSqlQuery> updateState = d->preparedQuery(
+    "UPDATE Images SET FileSize = ?, FileModified = ?, FileInode = ? WHERE Filename = ?");
+  QSet<QString> databaseFileNames;
+  while (databaseFiles.next())
+    {
+    QString fileName = databaseFiles.value(0).toString();
+    databaseFileNames.insert(fileName);
+    QHash<QString, QFileInfo>::const_iterator fileIt = fileSystemFiles.find(fileName);
+    if (fileIt == fileSystemFiles.end())
+      {
+      removedFiles << fileName;
+      continue;
+      }
+    ctkDICOMFileState state = fileState(fileIt.value());
+    if (databaseFiles.value(1).isNull())
+      {
+      // Inserted before the file states were recorded: fall back on the
+      // insert time and record the state for the next comparison.
+      if (fileIt.value().lastModified() <
+          QDateTime::fromString(databaseFiles.value(4).toString(), Qt::ISODate))
+        {
+        updateState->bindValue(0, state.Size);
+        updateState->bindValue(1, state.Modified);
+        updateState->bindValue(2, state.Inode);
+        updateState->bindValue(3, fileName);
+        d->loggedExec(*updateState);
+        }
+      else
+        {
+        modifiedFiles << fileName;
+        }
+      continue;
+      }
+    ctkDICOMFileState databaseState;
+    databaseState.Size = databaseFiles.value(1).toLongLong();
+    databaseState.Modified = databaseFiles.value(2).toLongLong();
+    databaseState.Inode = databaseFiles.value(3).toLongLong();
+    if (!(databaseState == state))
+      {
+      modifiedFiles << fileName;
+      }
+    }
+
+  // Files that could not be inserted are not parsed again while they are
+  // unchanged. The others are forgotten: they are reported as new, and
+  // rejected again if they still can't be inserted.
+  QSqlQuery rejectedFiles(d->Database);
+  rejectedFiles.prepare("SELECT Filename, FileSize, FileModified, FileInode "
+                        "FROM RejectedFiles WHERE Filename >= ? AND Filename < ?");
+  rejectedFiles.bindValue(0, directoryPath);
+  rejectedFiles.bindValue(1, directoryPath.left(directoryPath.size() - 1) + '0');
+  d->loggedExec(rejectedFiles);
+  QStringList forgottenFiles;
+  while (rejectedFiles.next())
+    {
+    QString fileName = rejectedFiles.value(0).toString();
+    QHash<QString, QFileInfo>::const_iterator fileIt = fileSystemFiles.find(fileName);
+    ctkDICOMFileState rejectedState;
+    rejectedState.Size = rejectedFiles.value(1).toLongLong();
+    rejectedState.Modified = rejectedFiles.value(2).toLongLong();
+    rejectedState.Inode = rejectedFiles.value(3).toLongLong();
+    if (fileIt != fileSystemFiles.end() && !databaseFileNames.contains(fileName) &&
+        rejectedState == fileState(fileIt.value()))
+      {
+      databaseFileNames.insert(fileName);
+      }
+    else
+      {
+      forgottenFiles << fileName;
+      }
+    }
+  rejectedFiles.finish();
+  QSharedPointer<QSqlQuery> forgetFile = d->preparedQuery(
+    "DELETE FROM RejectedFiles WHERE Filename = ?");
+  foreach(const QString& fileName, forgottenFiles)
+    {
+    forgetFile->bindValue(0, fileName);
+    d->loggedExec(*forgetFile);
+    }
+
+  foreach(const QString& fileName, fileSystemFiles.keys())
+    {
+    if (!databaseFileNames.contains(fileName))
+      {
+      newFiles << fileName;
+      }
+    }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabase::rejectFile(const QString& filePath)
+{
+  Q_D(ctkDICOMDatabase);
+  ctkDICOMFileState state = fileState(QFileInfo(filePath));
+  QSharedPointer<QSqlQuery> insertRejectedFile = d->preparedQuery(
+    "INSERT OR REPLACE INTO RejectedFiles ( 'Filename', 'FileSize', 'FileModified', 'FileInode' ) VALUES ( ?, ?, ?, ? )");
+  insertRejectedFile->bindValue(0, filePath);
+  insertRejectedFile->bindValue(1, state.Size);
+  insertRejectedFile->bindValue(2, state.Modified);
+  insertRejectedFile->bindValue(3, state.Inode);
+  d->loggedExec(*insertRejectedFile);
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabase::removeFileEntries(const QStringList& filePaths)
+{
+  Q_D(ctkDICOMDatabase);
+  if (filePaths.isEmpty())
+    {
+    return true;
+    }
+  bool result = true;
+  QSharedPointer<QSqlQuery> selectImage = d->preparedQuery(
+    "SELECT SOPInstanceUID FROM Images WHERE Filename = ?");
+  QSharedPointer<QSqlQuery> removeImage = d->preparedQuery(
+    "DELETE FROM Images WHERE Filename = ?");
+  QStringList removedUIDs;
+  foreach(const QString& filePath, filePaths)
+    {
+    selectImage->bindValue(0, filePath);
+    QString sopInstanceUID;
+    if (d->loggedExec(*selectImage) && selectImage->next())
+      {
+      sopInstanceUID = selectImage->value(0).toString();
+      }
+    selectImage->finish();
+    removeImage->bindValue(0, filePath);
+    if (!d->loggedExec(*removeImage))
+      {
+      result = false;
+      }
+    else if (!sopInstanceUID.isEmpty())
+      {
+      removedUIDs << sopInstanceUID;
+      }
+    }
+  this->cleanup();
+  if (!removedUIDs.isEmpty())
+    {
+    emit imagesRemoved(removedUIDs);
+    }
+  return result;
+}
+
+//------------------------------------------------------------------------------
+QStringList ctkDICOMDatabase::indexedDirectories()
+{
+  return this->runQuery("SELECT Dirname FROM Directories");
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabase::addIndexedDirectory(const QString& directory)
+{
+  Q_D(ctkDICOMDatabase);
+  QSqlQuery query(d->Database);
+  query.prepare("INSERT OR IGNORE INTO Directories ( 'Dirname' ) VALUES ( ? )");
+  query.bindValue(0, QDir(directory).absolutePath());
+  d->loggedExec(query);
+}
 
 bool ctkDICOMDatabase::isOpen() const
 {
@@ -929,6 +1751,7 @@ bool ctkDICOMDatabase::removeSeries(const QString& seriesInstanceUID)
   }
 
   QList< QPair<QString,QString> > removeList;
+  QStringList removedUIDs;
   while ( fileExists.next() )
   {
     QString dbFilePath = fileExists.value(fileExists.record().indexOf("Filename")).toString();
@@ -936,6 +1759,7 @@ bool ctkDICOMDatabase::removeSeries(const QString& seriesInstanceUID)
     QString studyInstanceUID = fileExists.value(fileExists.record().indexOf("StudyInstanceUID")).toString();
     QString internalFilePath = studyInstanceUID + "/" + seriesInstanceUID + "/" + sopInstanceUID;
     removeList << qMakePair(dbFilePath,internalFilePath);
+    removedUIDs << sopInstanceUID;
   }
 
   QSqlQuery fileRemove ( d->Database );
@@ -947,6 +1771,7 @@ bool ctkDICOMDatabase::removeSeries(const QString& seriesInstanceUID)
   {
     logger.error("SQLITE ERROR: could not remove seriesInstanceUID " + seriesInstanceUID);
     logger.error("SQLITE ERROR: " + fileRemove.lastError().driverText());
+    removedUIDs.clear();
   }
   
   QPair<QString,QString> fileToRemove;
@@ -984,7 +1809,10 @@ bool ctkDICOMDatabase::removeSeries(const QString& seriesInstanceUID)
 
   this->cleanup();
 
-  d->lastSeriesInstanceUID = "";
+  if (!removedUIDs.isEmpty())
+  {
+    emit imagesRemoved(removedUIDs);
+  }
 
   return true;
 }
@@ -992,6 +1820,12 @@ bool ctkDICOMDatabase::removeSeries(const QString& seriesInstanceUID)
 bool ctkDICOMDatabase::cleanup()
 {
   Q_D(ctkDICOMDatabase);
+  // the batch lookups and the last inserted patient, study and series may
+  // refer to rows removed below
+  d->clearInsertCache();
+  d->BatchPatientUIDs.clear();
+  d->BatchStudyInstanceUIDs.clear();
+  d->BatchSeriesInstanceUIDs.clear();
   QSqlQuery seriesCleanup ( d->Database );
   seriesCleanup.exec("DELETE FROM Series WHERE ( SELECT COUNT(*) FROM Images WHERE Images.SeriesInstanceUID = Series.SeriesInstanceUID ) = 0;");
   seriesCleanup.exec("DELETE FROM Studies WHERE ( SELECT COUNT(*) FROM Series WHERE Series.StudyInstanceUID = Studies.StudyInstanceUID ) = 0;");
@@ -1021,7 +1855,7 @@ bool ctkDICOMDatabase::removeStudy(const QString& studyInstanceUID)
       result = false;
     }
   }
-  d->lastStudyInstanceUID = "";
+  d->clearInsertCache();
   return result;
 }
 
@@ -1047,10 +1881,7 @@ bool ctkDICOMDatabase::removePatient(const QString& patientID)
       result = false;
     }
   }
-  d->lastPatientID = "";
-  d->lastPatientsName = "";
-  d->lastPatientsBirthDate = "";
-  d->lastPatientUID = -1;
+  d->clearInsertCache();
   return result;
 }
 
@@ -48,6 +48,8 @@ class ctkDICOMAbstractThumbnailGenerator;
 /// a file for each object. The corresponding UIDs are used as filenames.
 /// Thumbnais for each image can be created; if so, they are stored in a directory
 /// parallel to "dicom" directory called "thumbs".
+/// Creating them while inserting is slow, ctkDICOMThumbnailService generates
+/// them on demand instead.
 class CTK_DICOM_CORE_EXPORT ctkDICOMDatabase : public QObject
 {
 
@@ -55,8 +57,31 @@ class CTK_DICOM_CORE_EXPORT ctkDICOMDatabase : public QObject
   Q_PROPERTY(bool isOpen READ isOpen)
   Q_PROPERTY(QString lastError READ lastError)
   Q_PROPERTY(QString databaseFilename READ databaseFilename)
+  Q_PROPERTY(StoragePolicy storagePolicy READ storagePolicy WRITE setStoragePolicy)
+  Q_ENUMS(StoragePolicy)
 
 public:
+  /// How files inserted with storeFile are stored into the database
+  /// directory:
+  /// - CopyFiles: the file is copied (default)
+  /// - HardLinkFiles: a hard link to the file is created, no data is copied
+  /// - ReflinkFiles: the file is cloned with FICLONE (Linux, e.g. Btrfs, XFS);
+  ///   blocks are shared until one of the files is modified
+  /// - MoveFiles: the file is moved into the database directory
+  /// Hard links, reflinks and renames only work within a file system, the
+  /// file is copied otherwise (and removed for MoveFiles).
+  /// Before a move, the values of a dataset read with
+  /// ctkDICOMDataset::InitializeFromFileHeader() are loaded, but for the
+  /// pixel data which must then be read from the stored file.
+  /// \sa fileStored()
+  enum StoragePolicy
+  {
+    CopyFiles,
+    HardLinkFiles,
+    ReflinkFiles,
+    MoveFiles
+  };
+
   explicit ctkDICOMDatabase(QObject *parent = 0);
   explicit ctkDICOMDatabase(QString databaseFile);
   virtual ~ctkDICOMDatabase();
@@ -90,10 +115,18 @@ public:
   /// get thumbnail genrator object
   ctkDICOMAbstractThumbnailGenerator* thumbnailGenerator();
 
+  ///
+  /// Set how inserted files are stored into the database directory.
+  /// CopyFiles by default.
+  void setStoragePolicy(StoragePolicy policy);
+  StoragePolicy storagePolicy()const;
+
   ///
   /// open the SQLite database in @param databaseFile . If the file does not
   /// exist, a new database is created and initialized with the
-  /// default schema
+  /// default schema. Database files are opened in write-ahead logging
+  /// mode: other connections, e.g. of other threads, can read while
+  /// this one writes.
   ///
   /// @param databaseFile The file to store the SQLITE database should be
   ///        stored to. If specified with ":memory:", the database is not
@@ -110,6 +143,24 @@ public:
   /// delete all data and reinitialize the database.
   Q_INVOKABLE bool initializeDatabase(const char* schemaFile = ":/dicom/dicom-schema.sql");
 
+  ///
+  /// \brief Version of the database schema this class works with.
+  /// New databases are created with this version, older ones are upgraded
+  /// when opened.
+  static int schemaVersion();
+  ///
+  /// \brief Version of the schema of the opened database, 0 if the database
+  /// predates schema versioning.
+  Q_INVOKABLE int schemaVersionLoaded();
+  ///
+  /// \brief Upgrade the schema of the opened database to schemaVersion()
+  /// without losing its content. Each step from version N-1 to N is read
+  /// from the resource ":/dicom/dicom-schema-upgrade-N.sql" and the whole
+  /// upgrade runs in a single transaction.
+  /// Called by openDatabase() when needed.
+  /// \return true if the database is up-to-date
+  Q_INVOKABLE bool upgradeSchema();
+
   ///
   /// \brief database accessors
   Q_INVOKABLE QStringList patients ();
@@ -143,10 +194,68 @@ public:
   void insert( const ctkDICOMDataset& ctkDataset, bool storeFile, bool generateThumbnail);
   void insert ( DcmDataset *dataset, bool storeFile = true, bool generateThumbnail = true);
   Q_INVOKABLE void insert ( const QString& filePath, bool storeFile = true, bool generateThumbnail = true, bool createHierarchy = true, const QString& destinationDirectoryName = QString() );
-  
+
+  /// Insert a dataset that has already been read from @param filePath, e.g.
+  /// by a worker thread of ctkDICOMIndexer. Unlike insert(filePath), the
+  /// file is not checked with fileExistsAndUpToDate().
+  void insert ( const QString& filePath, const ctkDICOMDataset& ctkDataset, bool storeFile = true, bool generateThumbnail = true );
+
+  /// Insert a list of files within a single batch.
+  /// \sa beginBatchInsert(), endBatchInsert()
+  void insert ( const QStringList& filePaths, bool storeFile = true, bool generateThumbnail = true );
+
+  /// Start a batch of inserts. Until endBatchInsert() is called, inserts are
+  /// grouped into one transaction per @param commitInterval files, the
+  /// prepared SQL statements are reused and patients, studies and series
+  /// that were already inserted in the batch are not looked up again.
+  /// Calls can be nested, only the outermost pair opens and commits the batch.
+  Q_INVOKABLE void beginBatchInsert(int commitInterval = 500);
+  /// Commit the pending inserts and end the batch started with
+  /// beginBatchInsert().
+  /// Returns false if a transaction of the batch could not be committed,
+  /// e.g. because another connection kept the database locked: its inserts
+  /// were rolled back and lastError() describes the failure. Nested calls
+  /// return false once a transaction of the batch failed.
+  Q_INVOKABLE bool endBatchInsert();
+  /// Returns true if a batch insert is in progress.
+  bool isBatchInsert() const;
+  /// Forget the patient, study and series of the last insert, e.g. once
+  /// another connection changed the database file.
+  void clearInsertCache();
+
   /// Check if file is already in database and up-to-date
   bool fileExistsAndUpToDate(const QString& filePath);
 
+  /// Compare the files below @param directory with the images of the
+  /// database in a single pass. The size, modification time and inode of
+  /// each file recorded at insert time are compared with the file system.
+  /// Files that could not be inserted, see rejectFile(), are reported as
+  /// new only once they changed.
+  /// @param newFiles files on disk that are not in the database
+  /// @param modifiedFiles files that changed since they were inserted
+  /// @param removedFiles files of the database that no longer exist
+  void compareFiles(const QString& directory,
+                    QStringList& newFiles,
+                    QStringList& modifiedFiles,
+                    QStringList& removedFiles);
+
+  /// Record @param filePath as a file that can't be inserted, e.g. not
+  /// DICOM or another file of an image of the database, so that
+  /// compareFiles() doesn't report it as new while it is unchanged. insert()
+  /// records only the files indexed in place, i.e. without storeFile, as
+  /// the others are not compared.
+  void rejectFile(const QString& filePath);
+
+  /// Remove the images stored in @param filePaths from the database, as
+  /// well as the series, studies and patients left empty. The files
+  /// themselves are not deleted.
+  Q_INVOKABLE bool removeFileEntries(const QStringList& filePaths);
+
+  /// Directories indexed into the database, see addIndexedDirectory()
+  Q_INVOKABLE QStringList indexedDirectories();
+  /// Record @param directory in the Directories table
+  Q_INVOKABLE void addIndexedDirectory(const QString& directory);
+
   /// remove the series from the database, including images and
   /// thumbnails  
   Q_INVOKABLE bool removeSeries(const QString& seriesInstanceUID);
@@ -156,6 +265,17 @@ public:
 
 Q_SIGNALS:
   void databaseChanged();
+  /// Emitted for each file stored into the database directory, with the
+  /// policy that was actually used: it differs from storagePolicy() when
+  /// falling back on a copy. For MoveFiles, the source file is removed
+  /// after the copy.
+  void fileStored(const QString& sourceFilePath, const QString& storedFilePath,
+                  ctkDICOMDatabase::StoragePolicy usedPolicy);
+  /// Emitted once the images of @a sopInstanceUIDs are removed by
+  /// removeFileEntries() or removeSeries(), e.g. to drop what is cached
+  /// about them. A file modified on disk is removed before it is inserted
+  /// again by ctkDICOMIndexer::refreshDatabase().
+  void imagesRemoved(const QStringList& sopInstanceUIDs);
 
 protected:
   QScopedPointer<ctkDICOMDatabasePrivate> d_ptr;
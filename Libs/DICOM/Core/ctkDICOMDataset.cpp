@@ -128,6 +128,29 @@ void ctkDICOMDataset::InitializeFromFile(const QString& filename,
   InitializeFromDataset(dataset, true);
 }
 
+void ctkDICOMDataset::InitializeFromFileHeader(const QString& filename,
+                                               const Uint32 maxValueLength)
+{
+  this->InitializeFromFile(filename, EXS_Unknown, EGL_noChange, maxValueLength);
+}
+
+void ctkDICOMDataset::LoadValuesIntoMemory(bool includePixelData) const
+{
+  EnsureDcmDataSetIsInitialized();
+  DcmStack stack;
+  while (GetDcmDataset().nextObject(stack, OFTrue).good())
+  {
+    DcmObject* object = stack.top();
+    if (!object->isLeaf() ||
+        (!includePixelData && object->getTag() == DCM_PixelData))
+    {
+      continue;
+    }
+    // no-op for the values already in memory
+    static_cast<DcmElement*>(object)->loadAllDataIntoMemory();
+  }
+}
+
 void ctkDICOMDataset::Serialize()
 {
   Q_D(ctkDICOMDataset);
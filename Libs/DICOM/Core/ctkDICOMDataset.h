@@ -89,6 +89,28 @@ public:
                     const Uint32 maxReadLength = DCM_MaxReadLength,
                     const E_FileReadMode readMode = ERM_autoDetect);
 
+    ///
+    /// \brief Initialize from the header of a file.
+    ///
+    /// Values longer than \a maxValueLength bytes, in particular the pixel
+    /// data, are not read into memory: DCMTK keeps a reference to the file
+    /// and loads them only if they are accessed. Peak memory and read time
+    /// then no longer depend on the size of the pixel data, which matters
+    /// for multi-frame objects. To be preferred to InitializeFromFile() when
+    /// only header attributes are needed, e.g. when indexing.
+    ///
+    void InitializeFromFileHeader(const QString& filename,
+                    const Uint32 maxValueLength = 256);
+
+    ///
+    /// \brief Load the values left in the file by InitializeFromFileHeader().
+    ///
+    /// DCMTK reopens the file by its name to load them, so they must be
+    /// loaded before the file is moved or removed. The pixel data is loaded
+    /// only if \a includePixelData is true.
+    ///
+    void LoadValuesIntoMemory(bool includePixelData = false) const;
+
 
 
     /// \brief Save dataset to file
@@ -32,10 +32,14 @@
 #include <QDebug>
 #include <QPixmap>
 
+// STD includes
+#include <limits>
+
 
 // ctkDICOM includes
 #include "ctkLogger.h"
 #include "ctkDICOMIndexer.h"
+#include "ctkDICOMIndexer_p.h"
 
 // DCMTK includes
 #include <dcmtk/dcmdata/dcfilefo.h>
@@ -61,11 +65,126 @@ public:
   ctkDICOMIndexerPrivate();
   ~ctkDICOMIndexerPrivate();
 
+  /// Index the files, with addFilesInParallel() if NumberOfThreads > 1
+  void addFiles(ctkDICOMIndexer& indexer,
+                ctkDICOMDatabase& database,
+                const QStringList& files,
+                const QString& destinationDirectoryName);
+
+  /// Index the files using NumberOfThreads worker threads to read the
+  /// headers while the calling thread writes them into the database.
+  void addFilesInParallel(ctkDICOMIndexer& indexer,
+                          ctkDICOMDatabase& database,
+                          const QStringList& files,
+                          bool storeFile);
+
   ctkDICOMAbstractThumbnailGenerator* thumbnailGenerator;
   bool                    Canceled;
-
+  int                     NumberOfThreads;
+  int                     QueueSize;
+  int                     CommitInterval;
 };
 
+//------------------------------------------------------------------------------
+// ctkDICOMIndexerQueue methods
+
+//------------------------------------------------------------------------------
+ctkDICOMIndexerQueue::ctkDICOMIndexerQueue(int capacity, int producers)
+{
+  this->Capacity = qMax(1, capacity);
+  this->Producers = producers;
+  this->Canceled = false;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMIndexerQueue::put(const ctkDICOMIndexerParsedFile& file)
+{
+  QMutexLocker lock(&this->Mutex);
+  while (this->Files.size() >= this->Capacity && !this->Canceled)
+    {
+    this->NotFull.wait(&this->Mutex);
+    }
+  if (this->Canceled)
+    {
+    return false;
+    }
+  this->Files.enqueue(file);
+  this->NotEmpty.wakeOne();
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMIndexerQueue::take(ctkDICOMIndexerParsedFile& file)
+{
+  QMutexLocker lock(&this->Mutex);
+  while (this->Files.isEmpty() && this->Producers > 0 && !this->Canceled)
+    {
+    this->NotEmpty.wait(&this->Mutex);
+    }
+  if (this->Canceled || this->Files.isEmpty())
+    {
+    return false;
+    }
+  file = this->Files.dequeue();
+  this->NotFull.wakeOne();
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMIndexerQueue::producerFinished()
+{
+  QMutexLocker lock(&this->Mutex);
+  --this->Producers;
+  this->NotEmpty.wakeAll();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMIndexerQueue::cancel()
+{
+  QMutexLocker lock(&this->Mutex);
+  this->Canceled = true;
+  this->Files.clear();
+  this->NotEmpty.wakeAll();
+  this->NotFull.wakeAll();
+}
+
+//------------------------------------------------------------------------------
+// ctkDICOMIndexerWorker methods
+
+//------------------------------------------------------------------------------
+ctkDICOMIndexerWorker::ctkDICOMIndexerWorker(const QStringList& files,
+                                             QAtomicInt& nextFile,
+                                             ctkDICOMIndexerQueue& queue)
+  : Files(files)
+  , NextFile(nextFile)
+  , Queue(queue)
+{
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMIndexerWorker::run()
+{
+  for (int index = this->NextFile.fetchAndAddOrdered(1);
+       index < this->Files.size();
+       index = this->NextFile.fetchAndAddOrdered(1))
+    {
+    ctkDICOMIndexerParsedFile parsedFile;
+    parsedFile.FilePath = this->Files.at(index);
+    QSharedPointer<ctkDICOMDataset> dataset(new ctkDICOMDataset);
+    dataset->InitializeFromFileHeader(parsedFile.FilePath);
+    if (dataset->IsInitialized())
+      {
+      parsedFile.Dataset = dataset;
+      }
+    // the file is queued even if it can't be read, to report progress
+    if (!this->Queue.put(parsedFile))
+      {
+      break;
+      }
+    }
+  this->Queue.producerFinished();
+}
+
 //------------------------------------------------------------------------------
 // ctkDICOMIndexerPrivate methods
 
@@ -73,6 +192,9 @@ public:
 ctkDICOMIndexerPrivate::ctkDICOMIndexerPrivate()
 {
   this->Canceled = false;
+  this->NumberOfThreads = 1;
+  this->QueueSize = 256;
+  this->CommitInterval = 500;
 }
 
 //------------------------------------------------------------------------------
@@ -81,6 +203,127 @@ ctkDICOMIndexerPrivate::~ctkDICOMIndexerPrivate()
 }
 
 //------------------------------------------------------------------------------
+void ctkDICOMIndexerPrivate::addFiles(ctkDICOMIndexer& indexer,
+                                      ctkDICOMDatabase& database,
+                                      const QStringList& files,
+                                      const QString& destinationDirectoryName)
+{
+  this->Canceled = false;
+  if (this->NumberOfThreads > 1)
+    {
+    this->addFilesInParallel(indexer, database, files,
+                             !destinationDirectoryName.isEmpty());
+    return;
+    }
+
+  /* iterate over all input filenames */
+  int totalNumberOfFiles = files.size();
+  int fileNumber = 0;
+  int currentProgress = -1;
+  database.beginBatchInsert(this->CommitInterval);
+  foreach(const QString& filePath, files)
+    {
+    if (this->Canceled)
+      {
+      break;
+      }
+    emit indexer.indexingFileNumber(++fileNumber);
+    int newProgress = ( fileNumber * 100 ) / totalNumberOfFiles;
+    if (newProgress != currentProgress)
+      {
+      currentProgress = newProgress;
+      emit indexer.progress( currentProgress );
+      }
+    indexer.addFile(database, filePath, destinationDirectoryName);
+    }
+  if (!database.endBatchInsert())
+    {
+    logger.error("Files not indexed: " + database.lastError());
+    }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMIndexerPrivate::addFilesInParallel(ctkDICOMIndexer& indexer,
+                                                ctkDICOMDatabase& database,
+                                                const QStringList& files,
+                                                bool storeFile)
+{
+  int totalNumberOfFiles = files.size();
+  int fileNumber = 0;
+  int currentProgress = -1;
+
+  // The database connection can only be used by this thread: the files
+  // already indexed are skipped here before starting the workers.
+  QStringList filesToParse;
+  foreach(const QString& filePath, files)
+    {
+    if (database.fileExistsAndUpToDate(filePath))
+      {
+      ++fileNumber;
+      }
+    else
+      {
+      filesToParse << filePath;
+      }
+    }
+  if (fileNumber > 0)
+    {
+    emit indexer.indexingFileNumber(fileNumber);
+    currentProgress = ( fileNumber * 100 ) / totalNumberOfFiles;
+    emit indexer.progress(currentProgress);
+    }
+
+  int numberOfWorkers = qBound(1, this->NumberOfThreads, qMax(1, filesToParse.size()));
+  QAtomicInt nextFile(0);
+  ctkDICOMIndexerQueue queue(this->QueueSize, numberOfWorkers);
+  QList<ctkDICOMIndexerWorker*> workers;
+  for (int i = 0; i < numberOfWorkers; ++i)
+    {
+    workers << new ctkDICOMIndexerWorker(filesToParse, nextFile, queue);
+    workers.last()->start();
+    }
+
+  database.beginBatchInsert(this->CommitInterval);
+  ctkDICOMIndexerParsedFile parsedFile;
+  while (queue.take(parsedFile))
+    {
+    if (this->Canceled)
+      {
+      queue.cancel();
+      break;
+      }
+    emit indexer.indexingFileNumber(++fileNumber);
+    int newProgress = ( fileNumber * 100 ) / totalNumberOfFiles;
+    if (newProgress != currentProgress)
+      {
+      currentProgress = newProgress;
+      emit indexer.progress( currentProgress );
+      }
+    emit indexer.indexingFilePath(parsedFile.FilePath);
+    if (parsedFile.Dataset)
+      {
+      database.insert(parsedFile.FilePath, *parsedFile.Dataset, storeFile, true);
+      }
+    else
+      {
+      logger.warn(QString("Could not read DICOM file:") + parsedFile.FilePath);
+      if (!storeFile)
+        {
+        database.rejectFile(parsedFile.FilePath);
+        }
+      }
+    }
+  if (!database.endBatchInsert())
+    {
+    logger.error("Files not indexed: " + database.lastError());
+    }
+
+  foreach(ctkDICOMIndexerWorker* worker, workers)
+    {
+    worker->wait();
+    delete worker;
+    }
+}
 
 //------------------------------------------------------------------------------
 // ctkDICOMIndexer methods
@@ -118,91 +361,101 @@ void ctkDICOMIndexer::addDirectory(ctkDICOMDatabase& ctkDICOMDatabase,
 {
   Q_D(ctkDICOMIndexer);
 
-  const std::string src_directory(directoryName.toStdString());
+  // absolute paths are needed to later compare the database with the
+  // file system, see refreshDatabase()
+  const std::string src_directory(directoryName.isEmpty() ?
+    std::string() : QDir(directoryName).absolutePath().toStdString());
 
   OFList<OFString> originalDcmtkFileNames;
-  OFList<OFString> dcmtkFileNames;
   OFStandard::searchDirectoryRecursively( QDir::toNativeSeparators(src_directory.c_str()).toAscii().data(), originalDcmtkFileNames, "", "");
 
-  int totalNumberOfFiles = originalDcmtkFileNames.size();
-
   // hack to reverse list of filenames (not neccessary when image loading works correctly)
+  QStringList files;
   for ( OFListIterator(OFString) iter = originalDcmtkFileNames.begin(); iter != originalDcmtkFileNames.end(); ++iter )
   {
-    dcmtkFileNames.push_front( *iter );
+    files.push_front( QString((*iter).c_str()) );
   }
 
-  OFListIterator(OFString) iter = dcmtkFileNames.begin();
+  if (files.isEmpty()) return;
+
+  // refreshDatabase() compares the indexed directories with the file names
+  // of the database: copied files are below the database directory.
+  if (!destinationDirectoryName.isEmpty() && !ctkDICOMDatabase.isInMemory())
+    {
+    ctkDICOMDatabase.addIndexedDirectory(ctkDICOMDatabase.databaseDirectory() + "/dicom");
+    }
+  else
+    {
+    ctkDICOMDatabase.addIndexedDirectory(directoryName);
+    }
 
-  OFListIterator(OFString) last = dcmtkFileNames.end();
+  emit foundFilesToIndex(files.size());
 
-  if(iter == last) return;
+  d->addFiles(*this, ctkDICOMDatabase, files, destinationDirectoryName);
+}
 
-  emit foundFilesToIndex(totalNumberOfFiles);
+//------------------------------------------------------------------------------
+void ctkDICOMIndexer::setNumberOfThreads(int numberOfThreads)
+{
+  Q_D(ctkDICOMIndexer);
+  d->NumberOfThreads = qMax(1, numberOfThreads);
+}
 
-  /* iterate over all input filenames */
-  int fileNumber = 0;
-  int currentProgress = -1;
-  d->Canceled = false;
-  while (iter != last)
-  {
-    if (d->Canceled)
-      {
-      break;
-      }
-    emit indexingFileNumber(++fileNumber);
-    int newProgress = ( fileNumber * 100 ) / totalNumberOfFiles;
-    if (newProgress != currentProgress)
-    {
-      currentProgress = newProgress;
-      emit progress( currentProgress );
-    }
-    QString filePath((*iter).c_str());
-    this->addFile(ctkDICOMDatabase, filePath, destinationDirectoryName);
-    ++iter;
-  }
+//------------------------------------------------------------------------------
+int ctkDICOMIndexer::numberOfThreads()const
+{
+  Q_D(const ctkDICOMIndexer);
+  return d->NumberOfThreads;
 }
 
 //------------------------------------------------------------------------------
 void ctkDICOMIndexer::refreshDatabase(ctkDICOMDatabase& dicomDatabase, const QString& directoryName)
 {
-  Q_UNUSED(dicomDatabase);
-  Q_UNUSED(directoryName);
-  /*
-   * Probably this should go to the database class as well
-   * Or we have to extend the interface to make possible what we do here
-   * without using SQL directly
-   
-
-  /// get all filenames from the database
-  QSqlQuery allFilesQuery(dicomDatabase.database());
-  QStringList databaseFileNames;
-  QStringList filesToRemove;
-  this->loggedExec(allFilesQuery, "SELECT Filename from Images;");
-
-  while (allFilesQuery.next())
-    {
-    QString fileName = allFilesQuery.value(0).toString();
-    databaseFileNames.append(fileName);
-    if (! QFile::exists(fileName) )
-      {
-      filesToRemove.append(fileName);
-      }
+  Q_D(ctkDICOMIndexer);
+
+  QStringList directories;
+  if (directoryName.isEmpty())
+    {
+    directories = dicomDatabase.indexedDirectories();
     }
+  else
+    {
+    directories << directoryName;
+    }
+  if (directories.isEmpty())
+    {
+    return;
+    }
+
+  // The whole refresh runs in a single transaction: the batch started here
+  // encloses the one started by addFiles().
+  dicomDatabase.beginBatchInsert(std::numeric_limits<int>::max());
 
-  QSet<QString> filesytemFiles;
-  QDirIterator dirIt(directoryName);
-  while (dirIt.hasNext())
+  QStringList newFiles;
+  QStringList modifiedFiles;
+  QStringList removedFiles;
+  foreach(const QString& directory, directories)
     {
-    filesytemFiles.insert(dirIt.next());
+    dicomDatabase.compareFiles(directory, newFiles, modifiedFiles, removedFiles);
     }
-  
-  // TODO: it looks like this function was never finished...
-  // 
-  // I guess the next step is to remove all filesToRemove from the database
-  // and also to add filesystemFiles into the database tables
-  */ 
-  }
+  logger.debug(QString("Refresh: %1 new, %2 modified and %3 removed files")
+               .arg(newFiles.count()).arg(modifiedFiles.count()).arg(removedFiles.count()));
+
+  // modified files are removed then parsed again
+  dicomDatabase.removeFileEntries(removedFiles + modifiedFiles);
+
+  QStringList filesToIndex = newFiles + modifiedFiles;
+  if (!filesToIndex.isEmpty())
+    {
+    emit foundFilesToIndex(filesToIndex.count());
+    d->addFiles(*this, dicomDatabase, filesToIndex, QString());
+    }
+
+  if (!dicomDatabase.endBatchInsert())
+    {
+    logger.error("Database not refreshed: " + dicomDatabase.lastError());
+    }
+}
 
 //----------------------------------------------------------------------------
 void ctkDICOMIndexer::cancel()
@@ -61,8 +61,32 @@ public:
   Q_INVOKABLE void addFile(ctkDICOMDatabase& database, const QString& filePath,
                     const QString& destinationDirectoryName = "");
 
+  ///
+  /// \brief Update the database with the changes made on disk since the
+  /// files of \a directoryName were indexed.
+  ///
+  /// The file system is compared in one pass with the size, modification time
+  /// and inode recorded for each file at insert time: only new or modified
+  /// files are parsed, images of removed files are removed from the
+  /// database. The update is done in a single transaction.
+  /// If \a directoryName is empty, all the directories indexed with
+  /// addDirectory() are refreshed. Files copied into the database are
+  /// indexed in its "dicom" directory, not in the directory they came from.
+  ///
   Q_INVOKABLE void refreshDatabase(ctkDICOMDatabase& database, const QString& directoryName);
 
+  ///
+  /// \brief Number of threads reading the DICOM files in addDirectory().
+  ///
+  /// With more than one thread, the file headers are read by a pool of
+  /// worker threads while the calling thread inserts them into the
+  /// database, in batches. 1 by default: the files are read and inserted
+  /// by the calling thread. QThread::idealThreadCount() is a good value
+  /// for large directories.
+  ///
+  void setNumberOfThreads(int numberOfThreads);
+  int numberOfThreads()const;
+
 Q_SIGNALS:
   void foundFilesToIndex(int);
   void indexingFileNumber(int);
@@ -0,0 +1,95 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+#ifndef __ctkDICOMIndexer_p_h
+#define __ctkDICOMIndexer_p_h
+
+// Qt includes
+#include <QAtomicInt>
+#include <QMutex>
+#include <QQueue>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QThread>
+#include <QWaitCondition>
+
+// ctkDICOM includes
+#include "ctkDICOMDataset.h"
+
+//------------------------------------------------------------------------------
+/// \ingroup DICOM_Core
+/// A file parsed by a ctkDICOMIndexerWorker. Dataset is null if the file
+/// could not be read.
+struct ctkDICOMIndexerParsedFile
+{
+  QString FilePath;
+  QSharedPointer<ctkDICOMDataset> Dataset;
+};
+
+//------------------------------------------------------------------------------
+/// \ingroup DICOM_Core
+/// Bounded queue between the worker threads parsing the files and the
+/// thread writing them into the database. put() blocks while the queue is
+/// full so that the workers can't get too far ahead of the database.
+class ctkDICOMIndexerQueue
+{
+public:
+  ctkDICOMIndexerQueue(int capacity, int producers);
+
+  /// Blocks while the queue is full. Returns false if the queue is canceled.
+  bool put(const ctkDICOMIndexerParsedFile& file);
+  /// Blocks while the queue is empty. Returns false if the queue is canceled
+  /// or if it is empty and all the producers are finished.
+  bool take(ctkDICOMIndexerParsedFile& file);
+
+  /// To be called by each producer when it is done.
+  void producerFinished();
+  /// Wake up all the waiting threads, put() and take() return false.
+  void cancel();
+
+private:
+  QMutex Mutex;
+  QWaitCondition NotEmpty;
+  QWaitCondition NotFull;
+  QQueue<ctkDICOMIndexerParsedFile> Files;
+  int  Capacity;
+  int  Producers;
+  bool Canceled;
+};
+
+//------------------------------------------------------------------------------
+/// \ingroup DICOM_Core
+/// Worker thread reading the header of the files. The workers share the
+/// list of files and pick the next unparsed one until the list is exhausted.
+class ctkDICOMIndexerWorker : public QThread
+{
+public:
+  ctkDICOMIndexerWorker(const QStringList& files, QAtomicInt& nextFile,
+                        ctkDICOMIndexerQueue& queue);
+
+protected:
+  virtual void run();
+
+  const QStringList&    Files;
+  QAtomicInt&           NextFile;
+  ctkDICOMIndexerQueue& Queue;
+};
+
+#endif
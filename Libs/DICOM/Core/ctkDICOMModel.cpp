@@ -34,6 +34,8 @@
 #include "ctkLogger.h"
 
 static ctkLogger logger ( "org.commontk.dicom.DICOMModel" );
+// Maximum number of prepared queries kept per level
+static const int MaxFreeQueries = 256;
 struct Node;
 
 Q_DECLARE_METATYPE(Qt::CheckState);
@@ -61,7 +63,27 @@ public:
   QVariant value(Node* parentValue, int row, int field)const;
   QVariant value(const QModelIndex& indexValue, int row, int field)const;
   QString  generateQuery(const QString& fields, const QString& table, const QString& conditions = QString())const;
+  /// Generate the SQL of each level from the search parameters and the sort.
+  /// The search values are bound to the queries, only the levels whose SQL
+  /// changed lose their cached prepared queries.
+  void generateQueries();
+  /// Append to @a conditions the search of @a value anywhere in @a column,
+  /// ignoring the case of ASCII characters as LIKE does.
+  void addSearchCondition(QString& conditions, QMap<QString, QVariant>& bindings,
+                          const QString& column, const QString& value)const;
+  /// Execute the query listing the children of the node
   void updateQueries(Node* node)const;
+  QSqlQuery childrenQuery(Node* node)const;
+  /// Execute the queries of @a node and its children with the current sort
+  /// into @a queries, and find the new row of each existing node into
+  /// @a rows. Returns false if a node is not found anymore.
+  bool sortQueries(Node* node, QHash<Node*, QSqlQuery>& queries,
+                   QHash<Node*, int>& rows)const;
+  /// Move the queries of @a node and its children into the cache of
+  /// prepared queries.
+  void releaseQueries(Node* node)const;
+  void clearQueries();
+  void setRootNode(Node* node);
 
   Node*        RootNode;
   QSqlDatabase DataBase;
@@ -69,6 +91,14 @@ public:
   QString      Sort;
   QMap<QString, QVariant> SearchParameters;
 
+  /// SQL and bound search values of the query listing the children of a
+  /// node, indexed by the node type
+  QString                 LevelQueries[ctkDICOMModel::ImageType];
+  QMap<QString, QVariant> LevelBindings[ctkDICOMModel::ImageType];
+  /// Prepared queries released by deleted nodes, ready to be executed again
+  /// for new nodes of the same type without being compiled by SQLite.
+  mutable QList<QSqlQuery> FreeQueries[ctkDICOMModel::ImageType];
+
   ctkDICOMModel::IndexType StartLevel;
   ctkDICOMModel::IndexType EndLevel;
 };
@@ -109,8 +139,8 @@ ctkDICOMModelPrivate::ctkDICOMModelPrivate(ctkDICOMModel& o):q_ptr(&o)
 //------------------------------------------------------------------------------
 ctkDICOMModelPrivate::~ctkDICOMModelPrivate()
 {
-  delete this->RootNode;
-  this->RootNode = 0;
+  this->setRootNode(0);
+  this->clearQueries();
 }
 
 //------------------------------------------------------------------------------
@@ -301,69 +331,209 @@ QString ctkDICOMModelPrivate::generateQuery(const QString& fields, const QString
 }
 
 //------------------------------------------------------------------------------
-void ctkDICOMModelPrivate::updateQueries(Node* node)const
+void ctkDICOMModelPrivate::addSearchCondition(QString& conditions, QMap<QString, QVariant>& bindings,
+                                              const QString& column, const QString& value)const
 {
-  // are you kidding me, it should be virtualized here :-)
-  QString query;
+  if (value.isEmpty())
+    {
+    return;
+    }
+  QString placeholder = ":" + column;
+  conditions.append(column + " LIKE " + placeholder + " AND ");
+  bindings[placeholder] = "%" + value + "%";
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMModelPrivate::generateQueries()
+{
+  QString queries[ctkDICOMModel::ImageType];
+  for (int type = ctkDICOMModel::RootType; type < ctkDICOMModel::ImageType; ++type)
+    {
+    this->LevelBindings[type].clear();
+    }
   QString condition;
-  switch(node->Type)
+
+  // Root: patients
+  this->addSearchCondition(condition, this->LevelBindings[ctkDICOMModel::RootType],
+                           "PatientsName", this->SearchParameters["Name"].toString());
+  condition.chop(QString(" AND ").size());
+  queries[ctkDICOMModel::RootType] = this->generateQuery("UID as UID, PatientsName as Name, PatientsAge as Age, PatientsBirthDate as Date, PatientID as \"Subject ID\"","Patients", condition);
+
+  // Patient: studies
+  condition.clear();
+  QMap<QString, QVariant>& studyBindings = this->LevelBindings[ctkDICOMModel::PatientType];
+  this->addSearchCondition(condition, studyBindings,
+                           "StudyDescription", this->SearchParameters["Study"].toString());
+  QStringList modalities = this->SearchParameters["Modalities"].value<QStringList>();
+  if (modalities.count() > 0)
     {
-    default:
-      Q_ASSERT(node->Type == ctkDICOMModel::RootType);
-      break;
-    case ctkDICOMModel::RootType:
-      //query = QString("SELECT  FROM ");
-      if(this->SearchParameters["Name"].toString() != ""){
-        condition.append("PatientsName LIKE \"%" + this->SearchParameters["Name"].toString() + "%\"");
+    QStringList placeholders;
+    for (int i = 0; i < modalities.count(); ++i)
+      {
+      placeholders << QString(":modality%1").arg(i);
+      studyBindings[placeholders.last()] = modalities[i];
+      }
+    condition.append("ModalitiesInStudy IN (" + placeholders.join(", ") + ") AND ");
+    }
+  if(this->SearchParameters["StartDate"].toString() != "" &&
+     this->SearchParameters["EndDate"].toString() != "")
+    {
+    condition.append("( StudyDate BETWEEN :startDate AND :endDate ) AND ");
+    studyBindings[":startDate"] = QDate::fromString(this->SearchParameters["StartDate"].toString(), "yyyyMMdd").toString("yyyy-MM-dd");
+    studyBindings[":endDate"] = QDate::fromString(this->SearchParameters["EndDate"].toString(), "yyyyMMdd").toString("yyyy-MM-dd");
+    }
+  queries[ctkDICOMModel::PatientType] = this->generateQuery("StudyInstanceUID as UID, StudyDescription as Name, ModalitiesInStudy as Scan, StudyDate as Date, AccessionNumber as Number, InstitutionName as Institution, ReferringPhysician as Referrer, PerformingPhysiciansName as Performer", "Studies", condition + "PatientsUID = :uid");
+
+  // Study: series
+  condition.clear();
+  this->addSearchCondition(condition, this->LevelBindings[ctkDICOMModel::StudyType],
+                           "SeriesDescription", this->SearchParameters["Series"].toString());
+  queries[ctkDICOMModel::StudyType] = this->generateQuery("SeriesInstanceUID as UID, SeriesDescription as Name, BodyPartExamined as Scan, SeriesDate as Date, AcquisitionNumber as Number","Series",condition + "StudyInstanceUID = :uid");
+
+  // Series: images
+  condition.clear();
+  this->addSearchCondition(condition, this->LevelBindings[ctkDICOMModel::SeriesType],
+                           "SOPInstanceUID", this->SearchParameters["ID"].toString());
+  queries[ctkDICOMModel::SeriesType] = this->generateQuery("SOPInstanceUID as UID, Filename as Name, SeriesInstanceUID as Date", "Images", condition + "SeriesInstanceUID = :uid");
+
+  for (int type = ctkDICOMModel::RootType; type < ctkDICOMModel::ImageType; ++type)
+    {
+    if (queries[type] != this->LevelQueries[type])
+      {
+      this->LevelQueries[type] = queries[type];
+      this->FreeQueries[type].clear();
+      }
+    }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMModelPrivate::updateQueries(Node* node)const
+{
+  if (node->Type == ctkDICOMModel::ImageType)
+    {
+    return;
+    }
+  node->Query = this->childrenQuery(node);
+}
+
+//------------------------------------------------------------------------------
+QSqlQuery ctkDICOMModelPrivate::childrenQuery(Node* node)const
+{
+  Q_ASSERT(node->Type >= ctkDICOMModel::RootType && node->Type < ctkDICOMModel::ImageType);
+  QSqlQuery query;
+  QList<QSqlQuery>& freeQueries = this->FreeQueries[node->Type];
+  if (!freeQueries.isEmpty())
+    {
+    query = freeQueries.takeLast();
+    }
+  else
+    {
+    query = QSqlQuery(this->DataBase);
+    if (!query.prepare(this->LevelQueries[node->Type]))
+      {
+      logger.error("ctkDICOMModelPrivate::childrenQuery: " + query.lastError().text());
+      }
+    }
+  const QMap<QString, QVariant>& bindings = this->LevelBindings[node->Type];
+  for (QMap<QString, QVariant>::const_iterator it = bindings.constBegin();
+       it != bindings.constEnd(); ++it)
+    {
+    query.bindValue(it.key(), it.value());
+    }
+  if (node->Type != ctkDICOMModel::RootType)
+    {
+    query.bindValue(":uid", node->UID);
+    }
+  if (!query.exec())
+    {
+    logger.error("ctkDICOMModelPrivate::childrenQuery: " + query.lastError().text());
+    }
+  return query;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMModelPrivate::sortQueries(Node* node, QHash<Node*, QSqlQuery>& queries,
+                                       QHash<Node*, int>& rows)const
+{
+  if (node->Type == ctkDICOMModel::ImageType)
+    {
+    return true;
+    }
+  QSqlQuery query = this->childrenQuery(node);
+  queries[node] = query;
+
+  // Only read the rows up to the last existing child, the other rows are
+  // fetched on demand as usual.
+  QHash<QString, Node*> children;
+  foreach(Node* child, node->Children)
+    {
+    children[child->UID] = child;
+    }
+  int row = 0;
+  while (!children.isEmpty() && query.seek(row))
+    {
+    Node* child = children.take(query.value(0).toString());
+    if (child)
+      {
+      rows[child] = row;
+      }
+    ++row;
+    }
+  if (!children.isEmpty())
+    {
+    // the database changed
+    return false;
+    }
+  foreach(Node* child, node->Children)
+    {
+    if (!this->sortQueries(child, queries, rows))
+      {
+      return false;
       }
-      query = this->generateQuery("UID as UID, PatientsName as Name, PatientsAge as Age, PatientsBirthDate as Date, PatientID as \"Subject ID\"","Patients", condition);
-      logger.debug ( "ctkDICOMModelPrivate::updateQueries for Root: query is: " + query );
-      break;
-    case ctkDICOMModel::PatientType:
-      //query = QString("SELECT  FROM Studies WHERE PatientsUID='%1'").arg(node->UID);
-      if(this->SearchParameters["Study"].toString() != "")
-        {
-        condition.append("StudyDescription LIKE \"%" + this->SearchParameters["Study"].toString() + "%\"" + " AND ");
-        }
-      if(this->SearchParameters["Modalities"].value<QStringList>().count() > 0)
-        {
-        condition.append("ModalitiesInStudy IN (\"" + this->SearchParameters["Modalities"].value<QStringList>().join("\",\"") + "\") AND ");
-        }
-      if(this->SearchParameters["StartDate"].toString() != "" &&
-         this->SearchParameters["EndDate"].toString() != "")
-        {
-          condition.append(" ( StudyDate BETWEEN \'" + QDate::fromString(this->SearchParameters["StartDate"].toString(), "yyyyMMdd").toString("yyyy-MM-dd")
-                           + "\' AND \'" + QDate::fromString(this->SearchParameters["EndDate"].toString(), "yyyyMMdd").toString("yyyy-MM-dd") + "\' ) AND ");
-        }
-      query = this->generateQuery("StudyInstanceUID as UID, StudyDescription as Name, ModalitiesInStudy as Scan, StudyDate as Date, AccessionNumber as Number, InstitutionName as Institution, ReferringPhysician as Referrer, PerformingPhysiciansName as Performer", "Studies", condition + QString("PatientsUID='%1'").arg(node->UID));
-      logger.debug ( "ctkDICOMModelPrivate::updateQueries for Patient: query is: " + query );
-      break;
-    case ctkDICOMModel::StudyType:
-      //query = QString("SELECT SeriesInstanceUID as UID, SeriesDescription as Name, BodyPartExamined as Scan, SeriesDate as Date, AcquisitionNumber as Number FROM Series WHERE StudyInstanceUID='%1'").arg(node->UID);
-      if(this->SearchParameters["Series"].toString() != "")
-        {
-        condition.append("SeriesDescription LIKE \"%" + this->SearchParameters["Series"].toString() + "%\"" + " AND ");
-        }
-      query = this->generateQuery("SeriesInstanceUID as UID, SeriesDescription as Name, BodyPartExamined as Scan, SeriesDate as Date, AcquisitionNumber as Number","Series",condition + QString("StudyInstanceUID='%1'").arg(node->UID));
-      logger.debug ( "ctkDICOMModelPrivate::updateQueries for Study: query is: " + query );
-      break;
-    case ctkDICOMModel::SeriesType:
-      if(this->SearchParameters["ID"].toString() != "")
-        {
-        condition.append("SOPInstanceUID LIKE \"%" + this->SearchParameters["ID"].toString() + "%\"" + " AND ");
-        }
-      //query = QString("SELECT Filename as UID, Filename as Name, SeriesInstanceUID as Date FROM Images WHERE SeriesInstanceUID='%1'").arg(node->UID);
-      query = this->generateQuery("SOPInstanceUID as UID, Filename as Name, SeriesInstanceUID as Date", "Images", condition + QString("SeriesInstanceUID='%1'").arg(node->UID));
-      logger.debug ( "ctkDICOMModelPrivate::updateQueries for Series: query is: " + query );
-      break;
-    case ctkDICOMModel::ImageType:
-      break;
     }
-  node->Query = QSqlQuery(query, this->DataBase);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMModelPrivate::releaseQueries(Node* node)const
+{
   foreach(Node* child, node->Children)
     {
-    this->updateQueries(child);
+    this->releaseQueries(child);
+    }
+  if (node->Type == ctkDICOMModel::ImageType || !node->Query.isActive())
+    {
+    return;
+    }
+  // Release the SQLite read lock and the fetched rows, keep the statement.
+  node->Query.finish();
+  // queries generated before a search or sort change are dropped
+  if (node->Query.lastQuery() == this->LevelQueries[node->Type] &&
+      this->FreeQueries[node->Type].size() < MaxFreeQueries)
+    {
+    this->FreeQueries[node->Type] << node->Query;
+    }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMModelPrivate::clearQueries()
+{
+  for (int type = ctkDICOMModel::RootType; type < ctkDICOMModel::ImageType; ++type)
+    {
+    this->LevelQueries[type].clear();
+    this->FreeQueries[type].clear();
+    }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMModelPrivate::setRootNode(Node* node)
+{
+  if (this->RootNode)
+    {
+    this->releaseQueries(this->RootNode);
     }
+  delete this->RootNode;
+  this->RootNode = node;
 }
 
 //------------------------------------------------------------------------------
@@ -796,10 +966,14 @@ void ctkDICOMModel::setDatabase(const QSqlDatabase &db)
   Q_D(ctkDICOMModel);
 
   this->beginResetModel();
+  d->setRootNode(0);
+  if (d->DataBase.connectionName() != db.connectionName() ||
+      d->DataBase.driver() != db.driver())
+    {
+    // the cached queries can't be executed on another connection
+    d->clearQueries();
+    }
   d->DataBase = db;
-  
-  delete d->RootNode;
-  d->RootNode = 0;
 
   if (d->DataBase.tables().empty())
     {
@@ -807,8 +981,9 @@ void ctkDICOMModel::setDatabase(const QSqlDatabase &db)
     this->endResetModel();
     return;
     }
-    
-  d->RootNode = d->createNode(-1, QModelIndex());
+
+  d->generateQueries();
+  d->setRootNode(d->createNode(-1, QModelIndex()));
   
   this->endResetModel();
 
@@ -829,36 +1004,8 @@ void ctkDICOMModel::setDatabase(const QSqlDatabase &db)
 void ctkDICOMModel::setDatabase(const QSqlDatabase &db,const QMap<QString, QVariant>& parameters)
 {
   Q_D(ctkDICOMModel);
-
-  this->beginResetModel();
-  d->DataBase = db;
   d->SearchParameters = parameters;
-
-  delete d->RootNode;
-  d->RootNode = 0;
-
-  if (d->DataBase.tables().empty())
-    {
-    //Q_ASSERT(d->DataBase.isOpen());
-    this->endResetModel();
-    return;
-    }
-
-  d->RootNode = d->createNode(-1, QModelIndex());
-
-  this->endResetModel();
-
-  // TODO, use hasQuerySize everywhere, not only in setDataBase()
-  bool hasQuerySize = d->RootNode->Query.driver()->hasFeature(QSqlDriver::QuerySize);
-  if (hasQuerySize && d->RootNode->Query.size() > 0)
-    {
-    int newRowCount= d->RootNode->Query.size();
-    beginInsertRows(QModelIndex(), 0, qMax(0, newRowCount - 1));
-    d->RootNode->RowCount = newRowCount;
-    d->RootNode->AtEnd = true;
-    endInsertRows();
-    }
-  d->fetch(QModelIndex(), 256);
+  this->setDatabase(db);
 }
 
 //------------------------------------------------------------------------------
@@ -887,30 +1034,65 @@ void ctkDICOMModel::reset()
 void ctkDICOMModel::sort(int column, Qt::SortOrder order)
 {
   Q_D(ctkDICOMModel);
-  /* The following would work if there is no fetch involved.
-     ORDER BY doesn't just apply on the fetched item. By sorting
-     new items can show up in the model, and we need to be more
-     careful
-  emit layoutAboutToBeChanged();
-  QModelIndexList oldIndexList = d->modelIndexList();
   d->Sort = QString("\"%1\" %2")
-    .arg(d->Headers[column])
+    .arg(d->Headers[column][Qt::DisplayRole].toString())
     .arg(order == Qt::AscendingOrder ? "ASC" : "DESC");
-  d->updateQueries(d->RootNode);
-  QModelIndexList newIndexList = d->modelIndexList();
-  Q_ASSERT(oldIndexList.count() == newIndexList.count());
+  d->generateQueries();
+
+  QHash<Node*, QSqlQuery> sortedQueries;
+  QHash<Node*, int> sortedRows;
+  if (d->RootNode == 0 ||
+      !d->sortQueries(d->RootNode, sortedQueries, sortedRows))
+    {
+    this->beginResetModel();
+    d->setRootNode(0);
+    d->setRootNode(d->createNode(-1, QModelIndex()));
+    this->endResetModel();
+    return;
+    }
+
+  // ORDER BY doesn't just apply on the fetched rows: an existing node can
+  // be sorted after the fetched rows. Fetch the missing rows first, in the
+  // current order, so that sorting is a permutation of the rows.
+  QHash<Node*, int> rowCounts;
+  for (QHash<Node*, int>::const_iterator it = sortedRows.constBegin();
+       it != sortedRows.constEnd(); ++it)
+    {
+    Node* parentNode = it.key()->Parent;
+    rowCounts[parentNode] = qMax(rowCounts.value(parentNode, 0), it.value() + 1);
+    }
+  for (QHash<Node*, int>::const_iterator it = rowCounts.constBegin();
+       it != rowCounts.constEnd(); ++it)
+    {
+    Node* parentNode = it.key();
+    if (it.value() > parentNode->RowCount)
+      {
+      QModelIndex parentIndex = parentNode == d->RootNode ?
+        QModelIndex() : this->createIndex(parentNode->Row, 0, parentNode);
+      d->fetch(parentIndex, it.value());
+      }
+    }
+
+  emit layoutAboutToBeChanged();
+  for (QHash<Node*, QSqlQuery>::const_iterator it = sortedQueries.constBegin();
+       it != sortedQueries.constEnd(); ++it)
+    {
+    it.key()->Query = it.value();
+    }
+  for (QHash<Node*, int>::const_iterator it = sortedRows.constBegin();
+       it != sortedRows.constEnd(); ++it)
+    {
+    it.key()->Row = it.value();
+    }
+  QModelIndexList oldIndexList = this->persistentIndexList();
+  QModelIndexList newIndexList;
+  foreach(const QModelIndex& oldIndex, oldIndexList)
+    {
+    Node* node = d->nodeFromIndex(oldIndex);
+    newIndexList << this->createIndex(node->Row, oldIndex.column(), node);
+    }
   this->changePersistentIndexList(oldIndexList, newIndexList);
   emit layoutChanged();
-  */
-  this->beginResetModel();
-  delete d->RootNode;
-  d->RootNode = 0;
-  d->Sort = QString("\"%1\" %2")
-    .arg(d->Headers[column][Qt::DisplayRole].toString())
-    .arg(order == Qt::AscendingOrder ? "ASC" : "DESC");
-  d->RootNode = d->createNode(-1, QModelIndex());
-  
-  this->endResetModel();
 }
 
 //------------------------------------------------------------------------------
@@ -60,6 +60,10 @@ public:
   virtual ~ctkDICOMModel();
 
   void setDatabase(const QSqlDatabase& dataBase);
+  /// Set the database and the search parameters, e.g. from
+  /// ctkDICOMQueryWidget::parameters(). "Name", "Study", "Series" and "ID"
+  /// are searched anywhere in the patient name, study description, series
+  /// description and SOP instance UID, ignoring the case.
   void setDatabase(const QSqlDatabase& dataBase, const QMap<QString,QVariant>& parameters);
 
   /// Set it before populating the model
@@ -80,7 +84,9 @@ public:
   virtual int rowCount ( const QModelIndex & parent = QModelIndex() ) const;
   virtual bool setData(const QModelIndex &index, const QVariant &value, int role);
   virtual bool setHeaderData ( int section, Qt::Orientation orientation, const QVariant & value, int role = Qt::EditRole );
-  // Sorting resets the model because fetched/unfetched items could disappear/appear respectively.
+  // Sorting keeps the existing items and the persistent indexes. Rows that
+  // are not fetched yet but precede an existing item are fetched first.
+  // The model is reset only if an existing item is not found anymore.
   virtual void sort(int column, Qt::SortOrder order = Qt::AscendingOrder);
 public Q_SLOTS:
   virtual void reset();
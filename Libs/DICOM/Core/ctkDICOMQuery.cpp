@@ -28,10 +28,13 @@
 #include <QFile>
 #include <QDirIterator>
 #include <QFileInfo>
+#include <QHash>
 #include <QDebug>
 
 // ctkDICOMCore includes
+#include "ctkDICOMDataset.h"
 #include "ctkDICOMQuery.h"
+#include "ctkDICOMQuery_p.h"
 #include "ctkLogger.h"
 
 // DCMTK includes
@@ -48,9 +51,164 @@
 #include <dcmtk/ofstd/ofstd.h>        /* for class OFStandard */
 #include <dcmtk/dcmdata/dcddirif.h>   /* for class DicomDirInterface */
 
+// STD includes
+#include <climits>
+
 
 static ctkLogger logger ( "org.commontk.dicom.DICOMQuery" );
 
+//------------------------------------------------------------------------------
+// Copy of the attributes of a response, decoded with its character set
+static ctkDICOMQueryMatch queryMatch(DcmDataset* dataset)
+{
+  ctkDICOMDataset response;
+  response.InitializeFromDataset(dataset);
+  ctkDICOMQueryMatch match;
+  match.PatientID = response.GetElementAsString(DCM_PatientID);
+  match.PatientsName = response.GetElementAsString(DCM_PatientName);
+  match.StudyInstanceUID = response.GetElementAsString(DCM_StudyInstanceUID);
+  match.SeriesInstanceUID = response.GetElementAsString(DCM_SeriesInstanceUID);
+  for (unsigned long i = 0; i < dataset->card(); ++i)
+    {
+    DcmElement* element = dataset->getElement(i);
+    // sequences are not returned by the queries
+    if (element && element->isLeaf())
+      {
+      DcmTag tag = element->getTag();
+      match.Attributes.insert(tag.getTagName(), response.GetAllElementValuesAsString(tag));
+      }
+    }
+  return match;
+}
+
+//------------------------------------------------------------------------------
+// ctkDICOMQuerySeriesQueue methods
+
+//------------------------------------------------------------------------------
+ctkDICOMQuerySeriesQueue::ctkDICOMQuerySeriesQueue(const QStringList& studyInstanceUIDs,
+                                                   int producers)
+  : StudyInstanceUIDs(studyInstanceUIDs)
+  , NextStudy(0)
+  , Producers(producers)
+  , Canceled(false)
+{
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMQuerySeriesQueue::nextStudy(QString& studyInstanceUID)
+{
+  QMutexLocker locker(&this->Mutex);
+  if (this->Canceled || this->NextStudy >= this->StudyInstanceUIDs.count())
+    {
+    return false;
+    }
+  studyInstanceUID = this->StudyInstanceUIDs.at(this->NextStudy++);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMQuerySeriesQueue::put(const ctkDICOMQuerySeriesResult& result)
+{
+  QMutexLocker locker(&this->Mutex);
+  this->Results.append(result);
+  this->NotEmpty.wakeAll();
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMQuerySeriesQueue::take(QList<ctkDICOMQuerySeriesResult>& results,
+                                    unsigned long timeout)
+{
+  QMutexLocker locker(&this->Mutex);
+  if (this->Results.isEmpty() && this->Producers > 0)
+    {
+    this->NotEmpty.wait(&this->Mutex, timeout);
+    }
+  results += this->Results;
+  this->Results.clear();
+  return this->Producers > 0 || !results.isEmpty();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMQuerySeriesQueue::producerFinished()
+{
+  QMutexLocker locker(&this->Mutex);
+  --this->Producers;
+  this->NotEmpty.wakeAll();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMQuerySeriesQueue::cancel()
+{
+  QMutexLocker locker(&this->Mutex);
+  this->Canceled = true;
+}
+
+//------------------------------------------------------------------------------
+// ctkDICOMQuerySeriesWorker methods
+
+//------------------------------------------------------------------------------
+ctkDICOMQuerySeriesWorker::ctkDICOMQuerySeriesWorker(ctkDICOMQuerySeriesQueue& queue,
+                                                     const QString& callingAETitle,
+                                                     const QString& calledAETitle,
+                                                     const QString& host, int port,
+                                                     const DcmDataset& query)
+  : Queue(queue)
+  , Query(query)
+{
+  this->SCU.setAETitle ( OFString(callingAETitle.toStdString().c_str()) );
+  this->SCU.setPeerAETitle ( OFString(calledAETitle.toStdString().c_str()) );
+  this->SCU.setPeerHostName ( OFString(host.toStdString().c_str()) );
+  this->SCU.setPeerPort ( port );
+
+  OFList<OFString> transferSyntaxes;
+  transferSyntaxes.push_back ( UID_LittleEndianExplicitTransferSyntax );
+  transferSyntaxes.push_back ( UID_BigEndianExplicitTransferSyntax );
+  transferSyntaxes.push_back ( UID_LittleEndianImplicitTransferSyntax );
+  this->SCU.addPresentationContext ( UID_FINDStudyRootQueryRetrieveInformationModel, transferSyntaxes );
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMQuerySeriesWorker::run()
+{
+  OFCondition status = this->SCU.initNetwork();
+  if (status.good())
+    {
+    status = this->SCU.negotiateAssociation();
+    }
+  if (status.bad())
+    {
+    logger.error( "Error negotiating a series level association: " + QString(status.text()) );
+    this->Queue.producerFinished();
+    return;
+    }
+  T_ASC_PresentationContextID presentationContext =
+    this->SCU.findPresentationContextID ( UID_FINDStudyRootQueryRetrieveInformationModel, "" );
+
+  QString studyInstanceUID;
+  while (this->Queue.nextStudy(studyInstanceUID))
+    {
+    ctkDICOMQuerySeriesResult result;
+    result.StudyInstanceUID = studyInstanceUID;
+    this->Query.putAndInsertString ( DCM_StudyInstanceUID, studyInstanceUID.toStdString().c_str() );
+    OFList<QRResponse *> responses;
+    result.Success = this->SCU.sendFINDRequest (
+      presentationContext, &this->Query, &responses ).good();
+    for ( OFIterator<QRResponse*> it = responses.begin(); it != responses.end(); it++ )
+      {
+      // the last response is always empty
+      if ( (*it)->m_dataset != NULL )
+        {
+        result.Datasets << (*it)->m_dataset;
+        (*it)->m_dataset = NULL;
+        }
+      delete *it;
+      }
+    this->Queue.put(result);
+    }
+  this->SCU.closeAssociation ( DCMSCU_RELEASE_ASSOCIATION );
+  this->Queue.producerFinished();
+}
+
 //------------------------------------------------------------------------------
 // A customized implemenation so that Qt signals can be emitted
 // when query results are obtained
@@ -58,23 +216,20 @@ class ctkDICOMQuerySCUPrivate : public DcmSCU
 {
 public:
   ctkDICOMQuery *query;
+  /// Database the study level matches are inserted into as they arrive
+  ctkDICOMDatabase *database;
+  /// True once a C-CANCEL is sent for the current C-FIND
+  bool cancelSent;
   ctkDICOMQuerySCUPrivate()
     {
     this->query = 0;
+    this->database = 0;
+    this->cancelSent = false;
     };
   ~ctkDICOMQuerySCUPrivate() {};
   virtual OFCondition handleFINDResponse(const T_ASC_PresentationContextID  presID,
                                          QRResponse *response,
-                                         OFBool &waitForNextResponse)
-    {
-      if (this->query)
-        {
-        logger.debug ( "FIND RESPONSE" );
-        emit this->query->debug("Got a find response!");
-        return this->DcmSCU::handleFINDResponse(presID, response, waitForNextResponse);
-        }
-      return DIMSE_NULLKEY;
-    };
+                                         OFBool &waitForNextResponse);
 };
 
 //------------------------------------------------------------------------------
@@ -84,7 +239,8 @@ public:
   ctkDICOMQueryPrivate();
   ~ctkDICOMQueryPrivate();
 
-  /// Add a StudyInstanceUID to be queried
+  /// Add a StudyInstanceUID to be queried, the patient of the study is
+  /// read from @a dataset
   void addStudyInstanceUIDAndDataset(const QString& StudyInstanceUID, DcmDataset* dataset );
 
   QString                 CallingAETitle;
@@ -92,11 +248,14 @@ public:
   QString                 Host;
   int                     Port;
   bool                    PreferCGET;
+  int                     NumberOfAssociations;
   QMap<QString,QVariant>  Filters;
   ctkDICOMQuerySCUPrivate SCU;
   DcmDataset*             Query;
   QStringList             StudyInstanceUIDList;
-  QList<DcmDataset*>      StudyDatasetList;
+  /// Patient attributes of the studies, added to their series
+  QHash<QString, ctkDICOMQueryStudyPatient> StudyPatients;
+  int                     MaximumNumberOfResults;
   bool                    Canceled;
 };
 
@@ -110,6 +269,8 @@ ctkDICOMQueryPrivate::ctkDICOMQueryPrivate()
   this->Port = 0;
   this->Canceled = false;
   this->PreferCGET = true;
+  this->NumberOfAssociations = 1;
+  this->MaximumNumberOfResults = 0;
 }
 
 //------------------------------------------------------------------------------
@@ -122,7 +283,51 @@ ctkDICOMQueryPrivate::~ctkDICOMQueryPrivate()
 void ctkDICOMQueryPrivate::addStudyInstanceUIDAndDataset( const QString& s, DcmDataset* dataset )
 {
   this->StudyInstanceUIDList.append ( s );
-  this->StudyDatasetList.append ( dataset );
+  ctkDICOMQueryStudyPatient& patient = this->StudyPatients[s];
+  dataset->findAndGetOFStringArray ( DCM_PatientName, patient.PatientName );
+  dataset->findAndGetOFStringArray ( DCM_PatientID, patient.PatientID );
+}
+
+//------------------------------------------------------------------------------
+// ctkDICOMQuerySCUPrivate methods
+
+//------------------------------------------------------------------------------
+OFCondition ctkDICOMQuerySCUPrivate::handleFINDResponse(const T_ASC_PresentationContextID  presID,
+                                                        QRResponse *response,
+                                                        OFBool &waitForNextResponse)
+{
+  if (!this->query)
+    {
+    return DIMSE_NULLKEY;
+    }
+  logger.debug ( "FIND RESPONSE" );
+  emit this->query->debug("Got a find response!");
+  OFCondition result = this->DcmSCU::handleFINDResponse(presID, response, waitForNextResponse);
+  ctkDICOMQueryPrivate* d = this->query->d_func();
+  DcmDataset *dataset = response->m_dataset;
+  // Matches still pending after a C-CANCEL are dropped
+  if ( result.bad() || dataset == NULL || this->database == NULL ||
+       !DICOM_PENDING_STATUS(response->m_status) || this->cancelSent )
+    {
+    return result;
+    }
+  this->database->insert ( dataset, false /* do not store to disk*/, false /* no thumbnail*/);
+  OFString StudyInstanceUID;
+  dataset->findAndGetOFString ( DCM_StudyInstanceUID, StudyInstanceUID );
+  d->addStudyInstanceUIDAndDataset ( StudyInstanceUID.c_str(), dataset );
+
+  emit this->query->studyMatched(queryMatch(dataset));
+  emit this->query->progress(QString("Processing: ") + QString(StudyInstanceUID.c_str()));
+  emit this->query->progress(50);
+
+  if ( d->Canceled ||
+       ( d->MaximumNumberOfResults > 0 &&
+         d->StudyInstanceUIDList.count() >= d->MaximumNumberOfResults ) )
+    {
+    logger.debug ( "Sending C-CANCEL" );
+    this->cancelSent = this->sendCANCELRequest(presID).good();
+    }
+  return result;
 }
 
 //------------------------------------------------------------------------------
@@ -135,6 +340,7 @@ ctkDICOMQuery::ctkDICOMQuery(QObject* parentObject)
 {
   Q_D(ctkDICOMQuery);
   d->SCU.query = this; // give the dcmtk level access to this for emitting signals
+  qRegisterMetaType<ctkDICOMQueryMatch>("ctkDICOMQueryMatch");
 }
 
 //------------------------------------------------------------------------------
@@ -213,6 +419,34 @@ bool ctkDICOMQuery::preferCGET()const
   return d->PreferCGET;
 }
 
+//------------------------------------------------------------------------------
+void ctkDICOMQuery::setNumberOfAssociations ( int associations )
+{
+  Q_D(ctkDICOMQuery);
+  d->NumberOfAssociations = qMax(1, associations);
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMQuery::numberOfAssociations()const
+{
+  Q_D(const ctkDICOMQuery);
+  return d->NumberOfAssociations;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMQuery::setMaximumNumberOfResults ( int maximum )
+{
+  Q_D(ctkDICOMQuery);
+  d->MaximumNumberOfResults = qMax(0, maximum);
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMQuery::maximumNumberOfResults()const
+{
+  Q_D(const ctkDICOMQuery);
+  return d->MaximumNumberOfResults;
+}
+
 //------------------------------------------------------------------------------
 void ctkDICOMQuery::setFilters( const QMap<QString,QVariant>& filters )
 {
@@ -260,6 +494,7 @@ bool ctkDICOMQuery::query(ctkDICOMDatabase& database )
   if (d->Canceled) {return false;}
 
   d->StudyInstanceUIDList.clear();
+  d->StudyPatients.clear();
   d->SCU.setAETitle ( OFString(this->callingAETitle().toStdString().c_str()) );
   d->SCU.setPeerAETitle ( OFString(this->calledAETitle().toStdString().c_str()) );
   d->SCU.setPeerHostName ( OFString(this->host().toStdString().c_str()) );
@@ -380,8 +615,6 @@ bool ctkDICOMQuery::query(ctkDICOMDatabase& database )
   emit progress(30);
   if (d->Canceled) {return false;}
 
-  OFList<QRResponse *> responses;
-
   Uint16 presentationContext = 0;
   // Check for any accepted presentation context for FIND in study root (dont care about transfer syntax)
   presentationContext = d->SCU.findPresentationContextID ( UID_FINDStudyRootQueryRetrieveInformationModel, "");
@@ -398,7 +631,13 @@ bool ctkDICOMQuery::query(ctkDICOMDatabase& database )
   emit progress(40);
   if (d->Canceled) {return false;}
 
-  OFCondition status = d->SCU.sendFINDRequest ( presentationContext, d->Query, &responses );
+  // The matches are handled by the SCU as they arrive, no response is kept
+  d->SCU.database = &database;
+  d->SCU.cancelSent = false;
+  database.beginBatchInsert(100);
+  OFCondition status = d->SCU.sendFINDRequest ( presentationContext, d->Query, NULL );
+  database.endBatchInsert();
+  d->SCU.database = 0;
   if ( !status.good() )
     {
     logger.error ( "Find failed" );
@@ -410,21 +649,10 @@ bool ctkDICOMQuery::query(ctkDICOMDatabase& database )
   logger.debug ( "Find succeded");
   emit progress("Find succeded");
   emit progress(50);
-  if (d->Canceled) {return false;}
-
-  for ( OFIterator<QRResponse*> it = responses.begin(); it != responses.end(); it++ )
+  if (d->Canceled)
     {
-    DcmDataset *dataset = (*it)->m_dataset;
-    if ( dataset != NULL ) // the last response is always empty
-      {
-      database.insert ( dataset, false /* do not store to disk*/, false /* no thumbnail*/);
-      OFString StudyInstanceUID;
-      dataset->findAndGetOFString ( DCM_StudyInstanceUID, StudyInstanceUID );
-      d->addStudyInstanceUIDAndDataset ( StudyInstanceUID.c_str(), dataset );
-      emit progress(QString("Processing: ") + QString(StudyInstanceUID.c_str()));
-      emit progress(50);
-      if (d->Canceled) {return false;}
-      }
+    d->SCU.closeAssociation ( DCMSCU_RELEASE_ASSOCIATION );
+    return false;
     }
 
   /* Only ask for series attributes now. This requires kicking out the rest of former query. */
@@ -442,53 +670,73 @@ bool ctkDICOMQuery::query(ctkDICOMDatabase& database )
 
   // Now search each within each Study that was identified
   d->Query->putAndInsertString ( DCM_QueryRetrieveLevel, "SERIES" );
-  float progressRatio = 25. / d->StudyInstanceUIDList.count();
-  int i = 0; 
 
-  QListIterator<DcmDataset*> datasetIterator(d->StudyDatasetList);
-  foreach ( QString StudyInstanceUID, d->StudyInstanceUIDList )
-    {
-    DcmDataset *studyDataset = datasetIterator.next();
-    DcmElement *patientName, *patientID;
-    studyDataset->findAndGetElement(DCM_PatientName, patientName);
-    studyDataset->findAndGetElement(DCM_PatientID, patientID);
+  // The series level queries are sent on their own associations
+  d->SCU.closeAssociation ( DCMSCU_RELEASE_ASSOCIATION );
 
-    logger.debug ( "Starting Series C-FIND for Study: " + StudyInstanceUID );
-    emit progress(QString("Starting Series C-FIND for Study: ") + StudyInstanceUID);
-    emit progress(50 + (progressRatio * i++));
-    if (d->Canceled) {return false;}
+  int numberOfWorkers = qMin(d->NumberOfAssociations, d->StudyInstanceUIDList.count());
+  ctkDICOMQuerySeriesQueue queue(d->StudyInstanceUIDList, numberOfWorkers);
+  QList<ctkDICOMQuerySeriesWorker*> workers;
+  for (int i = 0; i < numberOfWorkers; ++i)
+    {
+    workers << new ctkDICOMQuerySeriesWorker(
+      queue, this->callingAETitle(), this->calledAETitle(),
+      this->host(), this->port(), *d->Query);
+    workers.last()->start();
+    }
 
-    d->Query->putAndInsertString ( DCM_StudyInstanceUID, StudyInstanceUID.toStdString().c_str() );
-    OFList<QRResponse *> responses;
-    status = d->SCU.sendFINDRequest ( presentationContext, d->Query, &responses );
-    if ( status.good() )
+  // All the responses are inserted within a single transaction
+  database.beginBatchInsert(INT_MAX);
+  float progressRatio = 50. / qMax(1, d->StudyInstanceUIDList.count());
+  int studiesDone = 0;
+  QList<ctkDICOMQuerySeriesResult> results;
+  while (queue.take(results, 100))
+    {
+    foreach (const ctkDICOMQuerySeriesResult& result, results)
       {
-      for ( OFIterator<QRResponse*> it = responses.begin(); it != responses.end(); it++ )
+      if (result.Success && !d->Canceled)
         {
-        DcmDataset *dataset = (*it)->m_dataset;
-        if ( dataset != NULL )
+        // add the patient elements not provided for the series level query
+        const ctkDICOMQueryStudyPatient& patient =
+          d->StudyPatients[result.StudyInstanceUID];
+        foreach (DcmDataset* dataset, result.Datasets)
           {
-          // add the patient elements not provided for the series level query
-          dataset->insert( patientName, true );
-          dataset->insert( patientID, true );
-          // insert series dataset 
+          dataset->putAndInsertOFStringArray( DCM_PatientName, patient.PatientName );
+          dataset->putAndInsertOFStringArray( DCM_PatientID, patient.PatientID );
+          // insert series dataset
           database.insert ( dataset, false /* do not store */, false /* no thumbnail */ );
+          emit seriesMatched(queryMatch(dataset));
           }
+        logger.debug ( "Find succeded on Series level for Study: " + result.StudyInstanceUID );
+        emit progress(QString("Find succeded on Series level for Study: ") + result.StudyInstanceUID);
+        }
+      else if (!result.Success)
+        {
+        logger.error ( "Find on Series level failed for Study: " + result.StudyInstanceUID );
+        emit progress(QString("Find on Series level failed for Study: ") + result.StudyInstanceUID);
         }
-      logger.debug ( "Find succeded on Series level for Study: " + StudyInstanceUID );
-      emit progress(QString("Find succeded on Series level for Study: ") + StudyInstanceUID);
-      emit progress(50 + (progressRatio * i++));
-      if (d->Canceled) {return false;}
+      qDeleteAll(result.Datasets);
+      emit progress(50 + (progressRatio * ++studiesDone));
       }
-    else
+    results.clear();
+    if (d->Canceled)
       {
-      logger.error ( "Find on Series level failed for Study: " + StudyInstanceUID );
-      emit progress(QString("Find on Series level failed for Study: ") + StudyInstanceUID);
+      queue.cancel();
       }
-    emit progress(50 + (progressRatio * i++));
-    if (d->Canceled) {return false;}
     }
-  d->SCU.closeAssociation ( DCMSCU_RELEASE_ASSOCIATION );
+  foreach (ctkDICOMQuerySeriesWorker* worker, workers)
+    {
+    worker->wait();
+    }
+  qDeleteAll(workers);
+  database.endBatchInsert();
+
+  if (d->Canceled) {return false;}
+  if (studiesDone < d->StudyInstanceUIDList.count())
+    {
+    logger.error ( "Find on Series level failed for " +
+                   QString::number(d->StudyInstanceUIDList.count() - studiesDone) + " studies" );
+    }
   emit progress(100);
   return true;
 }
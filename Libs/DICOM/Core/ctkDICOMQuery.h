@@ -24,6 +24,7 @@
 // Qt includes 
 #include <QObject>
 #include <QMap>
+#include <QMetaType>
 #include <QString>
 #include <QSqlDatabase>
 
@@ -35,6 +36,21 @@
 
 class ctkDICOMQueryPrivate;
 
+/// \ingroup DICOM_Core
+/// Study or series matched by ctkDICOMQuery, copied from the response so
+/// that it can be kept or queued to another thread.
+struct ctkDICOMQueryMatch
+{
+  QString PatientID;
+  QString PatientsName;
+  QString StudyInstanceUID;
+  /// Empty for a study
+  QString SeriesInstanceUID;
+  /// All the attributes of the response by DICOM keyword,
+  /// e.g. "StudyDescription", multiple values are separated by '|'.
+  QMap<QString, QString> Attributes;
+};
+
 /// \ingroup DICOM_Core
 class CTK_DICOM_CORE_EXPORT ctkDICOMQuery : public QObject
 {
@@ -44,6 +60,8 @@ class CTK_DICOM_CORE_EXPORT ctkDICOMQuery : public QObject
   Q_PROPERTY(QString host READ host WRITE setHost);
   Q_PROPERTY(int port READ port WRITE setPort);
   Q_PROPERTY(bool preferCGET READ preferCGET WRITE setPreferCGET);
+  Q_PROPERTY(int numberOfAssociations READ numberOfAssociations WRITE setNumberOfAssociations);
+  Q_PROPERTY(int maximumNumberOfResults READ maximumNumberOfResults WRITE setMaximumNumberOfResults);
 
 public:
   explicit ctkDICOMQuery(QObject* parent = 0);
@@ -68,9 +86,25 @@ public:
   /// false by default
   void setPreferCGET ( bool preferCGET );
   bool preferCGET()const;
+  /// Number of associations sending the series level C-FINDs in
+  /// parallel once the studies are found, each study is queried on one of
+  /// them. The responses are inserted into the database within a single
+  /// transaction.
+  /// 1 by default.
+  void setNumberOfAssociations ( int associations );
+  int numberOfAssociations()const;
+  /// Maximum number of studies to find. Once reached, the study level
+  /// C-FIND is canceled (C-CANCEL) and only the series of the studies
+  /// found so far are queried.
+  /// 0 (no limit) by default.
+  void setMaximumNumberOfResults ( int maximum );
+  int maximumNumberOfResults()const;
 
   /// Query a remote DICOM Image Store SCP
   /// You must at least set the host and port before calling query()
+  /// The matches are inserted into the database and studyMatched() and
+  /// seriesMatched() are emitted as they arrive, the responses are not
+  /// kept in memory.
   bool query(ctkDICOMDatabase& database);
 
   /// Access the list of study instance UIDs from the last query
@@ -111,6 +145,12 @@ Q_SIGNALS:
   /// Signal is emitted inside the query() function when finished with value 
   /// true for success or false for error
   void done(const bool& error);
+  /// Emitted inside the query() function for each study matching the
+  /// filters, once it is inserted into the database.
+  void studyMatched(const ctkDICOMQueryMatch& match);
+  /// Emitted inside the query() function for each series of the studies
+  /// found, once it is inserted into the database.
+  void seriesMatched(const ctkDICOMQueryMatch& match);
 
 public Q_SLOTS:
   void cancel();
@@ -125,4 +165,6 @@ private:
   friend class ctkDICOMQuerySCUPrivate;  // for access to queryResponseHandled
 };
 
+Q_DECLARE_METATYPE(ctkDICOMQueryMatch)
+
 #endif
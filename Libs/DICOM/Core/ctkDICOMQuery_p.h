@@ -0,0 +1,109 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+
+#ifndef __ctkDICOMQuery_p_h
+#define __ctkDICOMQuery_p_h
+
+// Qt includes
+#include <QMutex>
+#include <QStringList>
+#include <QThread>
+#include <QWaitCondition>
+
+// DCMTK includes
+#include <dcmtk/dcmnet/scu.h>
+
+//------------------------------------------------------------------------------
+/// \ingroup DICOM_Core
+/// Patient of a study found by the study level C-FIND, not returned by the
+/// series level C-FIND.
+struct ctkDICOMQueryStudyPatient
+{
+  OFString PatientName;
+  OFString PatientID;
+};
+
+//------------------------------------------------------------------------------
+/// \ingroup DICOM_Core
+/// Series level C-FIND response of a study. The datasets are owned by the
+/// receiver of the result.
+struct ctkDICOMQuerySeriesResult
+{
+  QString            StudyInstanceUID;
+  bool               Success;
+  QList<DcmDataset*> Datasets;
+};
+
+//------------------------------------------------------------------------------
+/// \ingroup DICOM_Core
+/// Studies to query at the series level and responses of the
+/// ctkDICOMQuerySeriesWorker threads, each of them querying on its own
+/// association.
+class ctkDICOMQuerySeriesQueue
+{
+public:
+  ctkDICOMQuerySeriesQueue(const QStringList& studyInstanceUIDs, int producers);
+
+  /// Returns false once all the studies are taken or the queue is canceled.
+  bool nextStudy(QString& studyInstanceUID);
+  void put(const ctkDICOMQuerySeriesResult& result);
+  /// Wait at most @a timeout ms for results and move them all into
+  /// @a results. Returns false once all the producers are finished and
+  /// all the results are taken.
+  bool take(QList<ctkDICOMQuerySeriesResult>& results, unsigned long timeout);
+
+  /// To be called by each producer when it is done.
+  void producerFinished();
+  /// The producers stop after their current C-FIND.
+  void cancel();
+
+private:
+  QMutex Mutex;
+  QWaitCondition NotEmpty;
+  QStringList StudyInstanceUIDs;
+  int NextStudy;
+  QList<ctkDICOMQuerySeriesResult> Results;
+  int  Producers;
+  bool Canceled;
+};
+
+//------------------------------------------------------------------------------
+/// \ingroup DICOM_Core
+/// Worker thread negotiating its own association and sending the series
+/// level C-FIND of the studies taken from the queue.
+class ctkDICOMQuerySeriesWorker : public QThread
+{
+public:
+  ctkDICOMQuerySeriesWorker(ctkDICOMQuerySeriesQueue& queue,
+                            const QString& callingAETitle,
+                            const QString& calledAETitle,
+                            const QString& host, int port,
+                            const DcmDataset& query);
+
+protected:
+  virtual void run();
+
+  ctkDICOMQuerySeriesQueue& Queue;
+  DcmSCU     SCU;
+  DcmDataset Query;
+};
+
+#endif
@@ -21,9 +21,13 @@
 #include <stdexcept>
 
 // Qt includes
+#include <QDir>
+#include <QFile>
+#include <QSqlDatabase>
 
 // ctkDICOMCore includes
 #include "ctkDICOMRetrieve.h"
+#include "ctkDICOMRetrieve_p.h"
 #include "ctkLogger.h"
 
 // DCMTK includes
@@ -49,6 +53,172 @@
 
 static ctkLogger logger("org.commontk.dicom.DICOMRetrieve");
 
+//------------------------------------------------------------------------------
+// ctkDICOMRetrieveIndexer methods
+
+//------------------------------------------------------------------------------
+ctkDICOMRetrieveIndexer::ctkDICOMRetrieveIndexer(const QString& databaseFileName,
+                                                 int commitInterval)
+  : DatabaseFileName(databaseFileName)
+  , CommitInterval(commitInterval)
+  , IndexedFiles(0)
+  , FailedFiles(0)
+  , Finished(false)
+{
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMRetrieveIndexer::put(const QString& filePath)
+{
+  QMutexLocker locker(&this->Mutex);
+  this->Files.enqueue(filePath);
+  this->NotEmpty.wakeOne();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMRetrieveIndexer::finish()
+{
+  QMutexLocker locker(&this->Mutex);
+  this->Finished = true;
+  this->NotEmpty.wakeAll();
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMRetrieveIndexer::indexedFiles()
+{
+  QMutexLocker locker(&this->Mutex);
+  return this->IndexedFiles;
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMRetrieveIndexer::failedFiles()
+{
+  QMutexLocker locker(&this->Mutex);
+  return this->FailedFiles;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMRetrieveIndexer::take(QString& filePath)
+{
+  QMutexLocker locker(&this->Mutex);
+  while (this->Files.isEmpty() && !this->Finished)
+    {
+    this->NotEmpty.wait(&this->Mutex);
+    }
+  if (this->Files.isEmpty())
+    {
+    return false;
+    }
+  filePath = this->Files.dequeue();
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMRetrieveIndexer::commit(ctkDICOMDatabase& database, QStringList& uncommittedFiles)
+{
+  if (database.endBatchInsert())
+    {
+    uncommittedFiles.clear();
+    return true;
+    }
+  // The inserts were rolled back but the files were already moved
+  logger.warn(QString("Inserting again %1 received files: %2")
+              .arg(uncommittedFiles.count()).arg(database.lastError()));
+  database.beginBatchInsert(uncommittedFiles.count() + 1);
+  foreach(const QString& storedFilePath, uncommittedFiles)
+    {
+    database.insert(storedFilePath, false, false);
+    }
+  bool success = database.endBatchInsert();
+  if (!success)
+    {
+    logger.error(QString("Failed to index %1 received files stored in %2: %3")
+                 .arg(uncommittedFiles.count())
+                 .arg(database.databaseDirectory() + "/dicom")
+                 .arg(database.lastError()));
+    QMutexLocker locker(&this->Mutex);
+    this->FailedFiles += uncommittedFiles.count();
+    }
+  uncommittedFiles.clear();
+  return success;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMRetrieveIndexer::run()
+{
+  QString connectionName =
+    QString("ctkDICOMRetrieveIndexer-%1").arg(reinterpret_cast<quintptr>(this));
+  {
+  ctkDICOMDatabase database;
+  database.openDatabase(this->DatabaseFileName, connectionName);
+  if (!database.isOpen())
+    {
+    logger.error("Can't open " + this->DatabaseFileName + " to index the "
+                 "received files: " + database.lastError());
+    }
+  else
+    {
+    // The staged files are ours, no need to copy them
+    database.setStoragePolicy(ctkDICOMDatabase::MoveFiles);
+    database.beginBatchInsert(this->CommitInterval);
+    }
+  QStringList uncommittedFiles;
+  QString filePath;
+  while (this->take(filePath))
+    {
+    if (database.isOpen())
+      {
+      ctkDICOMDataset dataset;
+      dataset.InitializeFromFileHeader(filePath);
+      if (dataset.IsInitialized())
+        {
+        database.insert(filePath, dataset, true, false);
+        // The file is left in the staging directory if the image was
+        // already in the database
+        QString storedFilePath = database.databaseDirectory() + "/dicom/" +
+          dataset.GetElementAsString(DCM_StudyInstanceUID) + "/" +
+          dataset.GetElementAsString(DCM_SeriesInstanceUID) + "/" +
+          dataset.GetElementAsString(DCM_SOPInstanceUID);
+        if (QFile::exists(storedFilePath))
+          {
+          uncommittedFiles << storedFilePath;
+          if (QFile::exists(filePath))
+            {
+            QFile::remove(filePath);
+            }
+          }
+        }
+      else
+        {
+        logger.warn("Could not read received DICOM file: " + filePath);
+        QFile::remove(filePath);
+        QMutexLocker locker(&this->Mutex);
+        ++this->FailedFiles;
+        }
+      // commit ourselves to know which files a failed commit drops
+      if (uncommittedFiles.count() >= this->CommitInterval)
+        {
+        this->commit(database, uncommittedFiles);
+        database.beginBatchInsert(this->CommitInterval);
+        }
+      }
+    else
+      {
+      QMutexLocker locker(&this->Mutex);
+      ++this->FailedFiles;
+      }
+    QMutexLocker locker(&this->Mutex);
+    ++this->IndexedFiles;
+    }
+  if (database.isOpen())
+    {
+    this->commit(database, uncommittedFiles);
+    database.closeDatabase();
+    }
+  }
+  QSqlDatabase::removeDatabase(connectionName);
+}
+
 //------------------------------------------------------------------------------
 // A customized local implemenation of the DcmSCU so that Qt signals can be emitted
 // when retrieve results are obtained
@@ -56,9 +226,12 @@ class ctkDICOMRetrieveSCUPrivate : public DcmSCU
 {
 public:
   ctkDICOMRetrieve *retrieve;
+  /// Indexes the files stored by a C-GET in bit preserving mode
+  ctkDICOMRetrieveIndexer *indexer;
   ctkDICOMRetrieveSCUPrivate()
     {
     this->retrieve = 0;
+    this->indexer = 0;
     };
   ~ctkDICOMRetrieveSCUPrivate() {};
 
@@ -109,6 +282,25 @@ public:
       return EC_IllegalCall;
     };
 
+  // called when a data set coming in from a server in response to a CGET
+  // has been written as is into the storage directory
+  // (DCMSCU_STORAGE_BIT_PRESERVING mode)
+  virtual void notifyInstanceStored(const OFString& filename,
+                                    const OFString& sopClassUID,
+                                    const OFString& sopInstanceUID) const
+    {
+      Q_UNUSED(sopClassUID);
+      if (this->retrieve)
+        {
+        emit this->retrieve->progress("Stored " + QString(sopInstanceUID.c_str()));
+        emit this->retrieve->progress(0);
+        }
+      if (this->indexer)
+        {
+        this->indexer->put(QString::fromLocal8Bit(filename.c_str()));
+        }
+    };
+
   // called when status information from remote server
   // comes in from CGET
   virtual OFCondition handleCGETResponse(const T_ASC_PresentationContextID presID,
@@ -145,6 +337,7 @@ public:
   bool          KeepAssociationOpen;
   bool          ConnectionParamsChanged;
   bool          LastRetrieveType;
+  int           IndexingCommitInterval;
   QSharedPointer<ctkDICOMDatabase> Database;
   ctkDICOMRetrieveSCUPrivate        SCU;
   QString MoveDestinationAETitle;
@@ -174,6 +367,7 @@ ctkDICOMRetrievePrivate::ctkDICOMRetrievePrivate(ctkDICOMRetrieve& obj)
   this->KeepAssociationOpen = true;
   this->ConnectionParamsChanged = false;
   this->LastRetrieveType = RetrieveNone;
+  this->IndexingCommitInterval = 500;
 
   // Register the JPEG libraries in case we need them
   // (registration only happens once, so it's okay to call repeatedly)
@@ -413,10 +607,59 @@ bool ctkDICOMRetrievePrivate::get ( const QString& studyInstanceUID,
   emit q->progress("Found Presentation Context");
   emit q->progress(1);
 
+  // Unless the database is in memory, the received objects are written as is
+  // into a staging directory and indexed by another thread while the
+  // next ones are received
+  QScopedPointer<ctkDICOMRetrieveIndexer> indexer;
+  if (!this->Database->isInMemory())
+    {
+    QString stagingDirectory = this->Database->databaseDirectory() + "/incoming";
+    if (QDir().mkpath(stagingDirectory))
+      {
+      this->SCU.setStorageDir(QDir::toNativeSeparators(stagingDirectory).toLocal8Bit().constData());
+      this->SCU.setStorageMode(DCMSCU_STORAGE_BIT_PRESERVING);
+      indexer.reset(new ctkDICOMRetrieveIndexer(
+        this->Database->databaseFilename(), this->IndexingCommitInterval));
+      indexer->start();
+      this->SCU.indexer = indexer.data();
+      }
+    else
+      {
+      logger.warn("Can't create " + stagingDirectory + ", the received objects are inserted one by one");
+      }
+    }
+  if (!indexer)
+    {
+    this->SCU.setStorageMode(DCMSCU_STORAGE_DISK);
+    }
+
   // do the actual move request
   OFCondition status = this->SCU.sendCGETRequest ( 
                           presID, retrieveParameters, &responses );
 
+  if (indexer)
+    {
+    this->SCU.indexer = 0;
+    emit q->progress("Indexing Received Objects");
+    indexer->finish();
+    indexer->wait();
+    logger.debug(QString::number(indexer->indexedFiles()) + " received objects indexed");
+    // the patients, studies and series looked up by the previous inserts
+    // of this connection may have changed
+    this->Database->clearInsertCache();
+    if (indexer->failedFiles() > 0)
+      {
+      logger.error(QString("%1 received objects could not be indexed")
+                   .arg(indexer->failedFiles()));
+      if (!this->KeepAssociationOpen)
+        {
+        this->SCU.closeAssociation(DCMSCU_RELEASE_ASSOCIATION);
+        }
+      delete retrieveParameters;
+      return false;
+      }
+    }
+
   emit q->progress("Sent Get Request");
   emit q->progress(2);
 
@@ -607,6 +850,20 @@ QString ctkDICOMRetrieve::moveDestinationAETitle()const
   return d->MoveDestinationAETitle;
 }
 
+//------------------------------------------------------------------------------
+void ctkDICOMRetrieve::setIndexingCommitInterval(int commitInterval)
+{
+  Q_D(ctkDICOMRetrieve);
+  d->IndexingCommitInterval = qMax(1, commitInterval);
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMRetrieve::indexingCommitInterval()const
+{
+  Q_D(const ctkDICOMRetrieve);
+  return d->IndexingCommitInterval;
+}
+
 //------------------------------------------------------------------------------
 void ctkDICOMRetrieve::setDatabase(QSharedPointer<ctkDICOMDatabase> dicomDatabase)
 {
@@ -45,6 +45,7 @@ class CTK_DICOM_CORE_EXPORT ctkDICOMRetrieve : public QObject
   Q_PROPERTY(QString moveDestinationAETitle READ moveDestinationAETitle WRITE setMoveDestinationAETitle)
   Q_PROPERTY(bool keepAssociationOpen READ keepAssociationOpen WRITE setKeepAssociationOpen)
   Q_PROPERTY(bool wasCanceled READ wasCanceled WRITE setWasCanceled)
+  Q_PROPERTY(int indexingCommitInterval READ indexingCommitInterval WRITE setIndexingCommitInterval)
 
 public:
   explicit ctkDICOMRetrieve();
@@ -78,6 +79,14 @@ public:
   /// (default false)
   void setWasCanceled(const bool wasCanceled);
   bool wasCanceled();
+  /// Number of objects received by get that are inserted into the
+  /// database per transaction (default 500). Unless the database is in
+  /// memory, the objects are written as is into the "incoming" directory of
+  /// the database while they are received, and another thread moves them
+  /// into the database directory and inserts them. get returns once all
+  /// the received objects are inserted.
+  void setIndexingCommitInterval(int commitInterval);
+  int indexingCommitInterval()const;
   /// where to insert new data sets obtained via get (must be set for
   /// get to succeed
   Q_INVOKABLE void setDatabase(QSharedPointer<ctkDICOMDatabase> dicomDatabase);
@@ -0,0 +1,80 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+
+#ifndef __ctkDICOMRetrieve_p_h
+#define __ctkDICOMRetrieve_p_h
+
+// Qt includes
+#include <QMutex>
+#include <QQueue>
+#include <QStringList>
+#include <QThread>
+#include <QWaitCondition>
+
+class ctkDICOMDatabase;
+
+//------------------------------------------------------------------------------
+/// \ingroup DICOM_Core
+/// Thread indexing the files received by ctkDICOMRetrieve while the
+/// retrieve goes on. The files are moved from the staging directory into
+/// the database directory and inserted in batches of CommitInterval files.
+/// QSqlDatabase connections can't be shared between threads: the thread
+/// opens its own connection to the database file, in WAL mode so that it
+/// doesn't block the readers of the other connections. A batch that can't
+/// be committed is inserted again from the database directory, files that
+/// can't be read are removed from the staging directory.
+class ctkDICOMRetrieveIndexer : public QThread
+{
+public:
+  ctkDICOMRetrieveIndexer(const QString& databaseFileName, int commitInterval);
+
+  /// Queue a received file. Never blocks, the receiving thread must not
+  /// wait for the database.
+  void put(const QString& filePath);
+  /// No more files are received, run() returns once the queued files are
+  /// indexed.
+  void finish();
+  /// Number of files indexed so far
+  int indexedFiles();
+  /// Number of received files that couldn't be inserted into the database
+  int failedFiles();
+
+protected:
+  virtual void run();
+  /// Blocks while the queue is empty. Returns false once finished and empty.
+  bool take(QString& filePath);
+  /// End the batch of @a uncommittedFiles, the files stored into the
+  /// database directory since the last commit. If the commit fails, they
+  /// are inserted again in a new batch once.
+  bool commit(ctkDICOMDatabase& database, QStringList& uncommittedFiles);
+
+  QString DatabaseFileName;
+  int     CommitInterval;
+
+  QMutex         Mutex;
+  QWaitCondition NotEmpty;
+  QQueue<QString> Files;
+  int  IndexedFiles;
+  int  FailedFiles;
+  bool Finished;
+};
+
+#endif
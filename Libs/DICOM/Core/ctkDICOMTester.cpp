@@ -24,11 +24,17 @@
 #include <QFileInfo>
 #include <QProcess>
 #include <QTextStream>
+#include <QVector>
 
 // ctkDICOM includes
 #include "ctkDICOMTester.h"
 #include "ctkLogger.h"
 
+// DCMTK includes
+#include <dcmtk/dcmdata/dcfilefo.h>
+#include <dcmtk/dcmdata/dcdeftag.h>
+#include <dcmtk/dcmdata/dcuid.h>
+
 //------------------------------------------------------------------------------
 static ctkLogger logger("org.commontk.dicom.DICOMTester" );
 //------------------------------------------------------------------------------
@@ -297,3 +303,72 @@ bool ctkDICOMTester::storeData(const QStringList& data)
   d->printProcessOutputs("StoreSCU", &storeSCU);
   return res;
 }
+
+//------------------------------------------------------------------------------
+QStringList ctkDICOMTester::createSyntheticData(const QString& directory,
+                                                int studies,
+                                                int seriesPerStudy,
+                                                int imagesPerSeries,
+                                                int pixelDataSize)
+{
+  QStringList files;
+  QDir dir(directory);
+  if (!dir.exists() && !dir.mkpath("."))
+    {
+    logger.error("Can't create directory " + directory);
+    return files;
+    }
+  // 8 bit monochrome frame, at most 1024 columns wide
+  const int columns = qBound(1, pixelDataSize, 1024);
+  const int rows = (pixelDataSize + columns - 1) / columns;
+  QVector<Uint8> pixelData(rows * columns, 0);
+  char uid[100];
+  for (int study = 0; study < studies; ++study)
+    {
+    QString studyInstanceUID(dcmGenerateUniqueIdentifier(uid, SITE_STUDY_UID_ROOT));
+    QString patientID = QString("CTK%1").arg(study, 6, 10, QLatin1Char('0'));
+    for (int series = 0; series < seriesPerStudy; ++series)
+      {
+      QString seriesInstanceUID(dcmGenerateUniqueIdentifier(uid, SITE_SERIES_UID_ROOT));
+      for (int image = 0; image < imagesPerSeries; ++image)
+        {
+        QString sopInstanceUID(dcmGenerateUniqueIdentifier(uid, SITE_INSTANCE_UID_ROOT));
+        DcmFileFormat fileFormat;
+        DcmDataset* dataset = fileFormat.getDataset();
+        dataset->putAndInsertString(DCM_SOPClassUID, UID_SecondaryCaptureImageStorage);
+        dataset->putAndInsertString(DCM_SOPInstanceUID, sopInstanceUID.toAscii().data());
+        dataset->putAndInsertString(DCM_PatientName, QString("Synthetic^%1").arg(patientID).toAscii().data());
+        dataset->putAndInsertString(DCM_PatientID, patientID.toAscii().data());
+        dataset->putAndInsertString(DCM_PatientBirthDate, "19700101");
+        dataset->putAndInsertString(DCM_StudyInstanceUID, studyInstanceUID.toAscii().data());
+        dataset->putAndInsertString(DCM_StudyDate, "20120101");
+        dataset->putAndInsertString(DCM_StudyDescription, "CTK synthetic study");
+        dataset->putAndInsertString(DCM_SeriesInstanceUID, seriesInstanceUID.toAscii().data());
+        dataset->putAndInsertString(DCM_SeriesNumber, QString::number(series + 1).toAscii().data());
+        dataset->putAndInsertString(DCM_Modality, "OT");
+        dataset->putAndInsertString(DCM_InstanceNumber, QString::number(image + 1).toAscii().data());
+        if (pixelDataSize > 0)
+          {
+          dataset->putAndInsertUint16(DCM_Rows, rows);
+          dataset->putAndInsertUint16(DCM_Columns, columns);
+          dataset->putAndInsertUint16(DCM_SamplesPerPixel, 1);
+          dataset->putAndInsertString(DCM_PhotometricInterpretation, "MONOCHROME2");
+          dataset->putAndInsertUint16(DCM_BitsAllocated, 8);
+          dataset->putAndInsertUint16(DCM_BitsStored, 8);
+          dataset->putAndInsertUint16(DCM_HighBit, 7);
+          dataset->putAndInsertUint16(DCM_PixelRepresentation, 0);
+          dataset->putAndInsertUint8Array(DCM_PixelData, pixelData.data(), pixelData.size());
+          }
+        QString fileName = dir.absoluteFilePath(sopInstanceUID + ".dcm");
+        OFCondition status = fileFormat.saveFile(fileName.toAscii().data(), EXS_LittleEndianExplicit);
+        if (status.bad())
+          {
+          logger.error("Can't write " + fileName + ": " + status.text());
+          continue;
+          }
+        files << fileName;
+        }
+      }
+    }
+  return files;
+}
@@ -85,6 +85,17 @@ public:
   ///
   Q_INVOKABLE bool storeData(const QStringList& data);
 
+  ///  Writes synthetic DICOM files into \a directory: one patient per study,
+  /// \a seriesPerStudy series per study and \a imagesPerSeries images per
+  /// series. Each image has \a pixelDataSize bytes of (zero) pixel data.
+  /// Useful to generate large data sets for benchmarks.
+  /// Returns the list of files written.
+  Q_INVOKABLE QStringList createSyntheticData(const QString& directory,
+                                              int studies,
+                                              int seriesPerStudy,
+                                              int imagesPerSeries,
+                                              int pixelDataSize = 0);
+
 protected:
   QScopedPointer<ctkDICOMTesterPrivate> d_ptr;
 
@@ -0,0 +1,695 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QBuffer>
+#include <QCache>
+#include <QDir>
+#include <QSet>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+
+// ctkDICOM includes
+#include "ctkLogger.h"
+#include "ctkDICOMAbstractThumbnailGenerator.h"
+#include "ctkDICOMDatabase.h"
+#include "ctkDICOMThumbnailService.h"
+#include "ctkDICOMThumbnailService_p.h"
+
+// DCMTK includes
+#include <dcmtk/dcmimgle/dcmimage.h>  /* for class DicomImage */
+#include <dcmtk/dcmimage/diregist.h>  /* include support for color images */
+
+//------------------------------------------------------------------------------
+static ctkLogger logger("org.commontk.dicom.DICOMThumbnailService" );
+//------------------------------------------------------------------------------
+
+// Size of the thumbnails kept in memory, in KB
+static const int MemoryCacheSize = 16 * 1024;
+
+//------------------------------------------------------------------------------
+// ctkDICOMThumbnailQueue methods
+
+//------------------------------------------------------------------------------
+ctkDICOMThumbnailQueue::ctkDICOMThumbnailQueue()
+{
+  this->Counter = 0;
+  this->Stopped = false;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailQueue::put(const ctkDICOMThumbnailRequest& request)
+{
+  QMutexLocker lock(&this->Mutex);
+  QHash<QString, QStringList>::iterator inProgress =
+    this->InProgress.find(request.SOPInstanceUID);
+  // a discarded render can't serve the request, it is rendered again
+  if (inProgress != this->InProgress.end() &&
+      !this->Discarded.contains(request.SOPInstanceUID))
+    {
+    foreach(const QString& uid, request.UIDs)
+      {
+      if (!inProgress->contains(uid))
+        {
+        inProgress->append(uid);
+        }
+      }
+    return;
+    }
+  QHash<QString, ctkDICOMThumbnailRequest>::iterator pending =
+    this->Requests.find(request.SOPInstanceUID);
+  if (pending == this->Requests.end())
+    {
+    pending = this->Requests.insert(request.SOPInstanceUID, request);
+    }
+  else
+    {
+    foreach(const QString& uid, request.UIDs)
+      {
+      if (!pending->UIDs.contains(uid))
+        {
+        pending->UIDs.append(uid);
+        }
+      }
+    pending->Priority = request.Priority;
+    }
+  pending->Order = this->Counter++;
+  this->NotEmpty.wakeOne();
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailQueue::take(ctkDICOMThumbnailRequest& request)
+{
+  QMutexLocker lock(&this->Mutex);
+  QHash<QString, ctkDICOMThumbnailRequest>::iterator next;
+  while (!this->Stopped)
+    {
+    next = this->Requests.end();
+    for (QHash<QString, ctkDICOMThumbnailRequest>::iterator it = this->Requests.begin();
+         it != this->Requests.end(); ++it)
+      {
+      // wait for the discarded render of the image to finish
+      if (this->InProgress.contains(it.key()))
+        {
+        continue;
+        }
+      if (next == this->Requests.end() || it->Priority > next->Priority ||
+          (it->Priority == next->Priority && it->Order > next->Order))
+        {
+        next = it;
+        }
+      }
+    if (next != this->Requests.end())
+      {
+      break;
+      }
+    this->NotEmpty.wait(&this->Mutex);
+    }
+  if (this->Stopped)
+    {
+    return false;
+    }
+  request = next.value();
+  this->Requests.erase(next);
+  this->InProgress[request.SOPInstanceUID] = request.UIDs;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailQueue::setPriority(const QString& sopInstanceUID, int priority)
+{
+  QMutexLocker lock(&this->Mutex);
+  if (this->InProgress.contains(sopInstanceUID))
+    {
+    return true;
+    }
+  QHash<QString, ctkDICOMThumbnailRequest>::iterator pending =
+    this->Requests.find(sopInstanceUID);
+  if (pending == this->Requests.end())
+    {
+    return false;
+    }
+  pending->Priority = priority;
+  pending->Order = this->Counter++;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailQueue::remove(const QStringList& sopInstanceUIDs)
+{
+  QMutexLocker lock(&this->Mutex);
+  QSet<QString> removedUIDs = sopInstanceUIDs.toSet();
+  foreach(const QString& sopInstanceUID, sopInstanceUIDs)
+    {
+    this->Requests.remove(sopInstanceUID);
+    if (this->InProgress.contains(sopInstanceUID))
+      {
+      this->Discarded.insert(sopInstanceUID);
+      }
+    }
+  QList<ctkDICOMThumbnailResult>::iterator it = this->Results.begin();
+  while (it != this->Results.end())
+    {
+    if (removedUIDs.contains(it->SOPInstanceUID))
+      {
+      it = this->Results.erase(it);
+      }
+    else
+      {
+      ++it;
+      }
+    }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailQueue::discard()
+{
+  QMutexLocker lock(&this->Mutex);
+  this->Requests.clear();
+  this->Results.clear();
+  foreach(const QString& sopInstanceUID, this->InProgress.keys())
+    {
+    this->Discarded.insert(sopInstanceUID);
+    }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailQueue::clear()
+{
+  QMutexLocker lock(&this->Mutex);
+  this->Requests.clear();
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMThumbnailQueue::count()
+{
+  QMutexLocker lock(&this->Mutex);
+  return this->Requests.count();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailQueue::stop()
+{
+  QMutexLocker lock(&this->Mutex);
+  this->Stopped = true;
+  this->Requests.clear();
+  this->NotEmpty.wakeAll();
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailQueue::putResult(ctkDICOMThumbnailResult& result)
+{
+  QMutexLocker lock(&this->Mutex);
+  // UIDs requested while the image was rendered
+  result.UIDs = this->InProgress.take(result.SOPInstanceUID);
+  if (this->Discarded.remove(result.SOPInstanceUID))
+    {
+    // the image was requested again meanwhile
+    if (this->Requests.contains(result.SOPInstanceUID))
+      {
+      this->NotEmpty.wakeOne();
+      }
+    return false;
+    }
+  this->Results.append(result);
+  return this->Results.size() == 1;
+}
+
+//------------------------------------------------------------------------------
+QList<ctkDICOMThumbnailResult> ctkDICOMThumbnailQueue::takeResults()
+{
+  QMutexLocker lock(&this->Mutex);
+  QList<ctkDICOMThumbnailResult> results = this->Results;
+  this->Results.clear();
+  return results;
+}
+
+//------------------------------------------------------------------------------
+// ctkDICOMThumbnailWorker methods
+
+//------------------------------------------------------------------------------
+ctkDICOMThumbnailWorker::ctkDICOMThumbnailWorker(ctkDICOMThumbnailQueue& queue,
+                                                 QObject* service)
+  : Queue(queue)
+  , Service(service)
+{
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailWorker::run()
+{
+  ctkDICOMThumbnailRequest request;
+  while (this->Queue.take(request))
+    {
+    ctkDICOMThumbnailResult result;
+    result.SOPInstanceUID = request.SOPInstanceUID;
+    DicomImage dcmImage(QDir::toNativeSeparators(request.FilePath).toAscii());
+    if (request.Generator &&
+        request.Generator->generateThumbnail(&dcmImage, result.Thumbnail) &&
+        !result.Thumbnail.isNull())
+      {
+      QBuffer buffer(&result.PNG);
+      buffer.open(QIODevice::WriteOnly);
+      result.Thumbnail.save(&buffer, "PNG");
+      }
+    else
+      {
+      logger.warn("Failed to generate the thumbnail of " + request.FilePath);
+      result.Thumbnail = QImage();
+      }
+    if (this->Queue.putResult(result))
+      {
+      QMetaObject::invokeMethod(this->Service, "storeThumbnails", Qt::QueuedConnection);
+      }
+    }
+}
+
+//------------------------------------------------------------------------------
+class ctkDICOMThumbnailServicePrivate
+{
+  Q_DECLARE_PUBLIC(ctkDICOMThumbnailService);
+protected:
+  ctkDICOMThumbnailService* const q_ptr;
+
+public:
+  ctkDICOMThumbnailServicePrivate(ctkDICOMThumbnailService&);
+  ~ctkDICOMThumbnailServicePrivate();
+
+  void openCache();
+  void closeCache();
+  void startWorkers();
+  void stopWorkers();
+
+  /// Look up the thumbnail in memory then in the cache file
+  QImage cachedThumbnail(const QString& sopInstanceUID);
+  void request(const QString& sopInstanceUID, const QString& filePath,
+               const QString& uid, int priority);
+
+  QSharedPointer<ctkDICOMDatabase>    Database;
+  ctkDICOMAbstractThumbnailGenerator* Generator;
+  int                                 NumberOfThreads;
+
+  ctkDICOMThumbnailQueue              Queue;
+  QList<ctkDICOMThumbnailWorker*>     Workers;
+
+  QString                             CacheConnectionName;
+  QSqlDatabase                        Cache;
+  QCache<QString, QImage>             Thumbnails;
+  /// SOPInstanceUID of the representative image of each series
+  QHash<QString, QString>             SeriesRepresentatives;
+};
+
+//------------------------------------------------------------------------------
+// ctkDICOMThumbnailServicePrivate methods
+
+//------------------------------------------------------------------------------
+ctkDICOMThumbnailServicePrivate::ctkDICOMThumbnailServicePrivate(ctkDICOMThumbnailService& o)
+  : q_ptr(&o)
+{
+  this->Generator = 0;
+  this->NumberOfThreads = QThread::idealThreadCount();
+  this->CacheConnectionName = QString("ctkDICOMThumbnailService-%1").arg(reinterpret_cast<quintptr>(&o));
+  this->Thumbnails.setMaxCost(MemoryCacheSize);
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMThumbnailServicePrivate::~ctkDICOMThumbnailServicePrivate()
+{
+  this->stopWorkers();
+  this->closeCache();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailServicePrivate::openCache()
+{
+  if (!this->Database || !this->Database->isOpen())
+    {
+    return;
+    }
+  QString cacheFile = this->Database->isInMemory() ?
+    QString(":memory:") : this->Database->databaseDirectory() + "/thumbs.db";
+  this->Cache = QSqlDatabase::addDatabase("QSQLITE", this->CacheConnectionName);
+  this->Cache.setDatabaseName(cacheFile);
+  if (!this->Cache.open())
+    {
+    logger.error("Can't open the thumbnail cache " + cacheFile + ": " +
+                 this->Cache.lastError().text());
+    return;
+    }
+  QSqlQuery createTable(this->Cache);
+  if (!createTable.exec("CREATE TABLE IF NOT EXISTS 'Thumbnails' ( "
+                        "'SOPInstanceUID' VARCHAR(64) NOT NULL, "
+                        "'Thumbnail' BLOB NOT NULL, "
+                        "PRIMARY KEY ('SOPInstanceUID') )"))
+    {
+    logger.error("Can't create the thumbnail cache: " + createTable.lastError().text());
+    }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailServicePrivate::closeCache()
+{
+  if (!this->Cache.isValid())
+    {
+    return;
+    }
+  this->Cache.close();
+  this->Cache = QSqlDatabase();
+  QSqlDatabase::removeDatabase(this->CacheConnectionName);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailServicePrivate::startWorkers()
+{
+  Q_Q(ctkDICOMThumbnailService);
+  if (!this->Workers.isEmpty())
+    {
+    return;
+    }
+  for (int i = 0; i < qMax(1, this->NumberOfThreads); ++i)
+    {
+    ctkDICOMThumbnailWorker* worker = new ctkDICOMThumbnailWorker(this->Queue, q);
+    worker->start(QThread::LowPriority);
+    this->Workers << worker;
+    }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailServicePrivate::stopWorkers()
+{
+  this->Queue.stop();
+  foreach(ctkDICOMThumbnailWorker* worker, this->Workers)
+    {
+    worker->wait();
+    delete worker;
+    }
+  this->Workers.clear();
+}
+
+//------------------------------------------------------------------------------
+QImage ctkDICOMThumbnailServicePrivate::cachedThumbnail(const QString& sopInstanceUID)
+{
+  QImage* thumbnail = this->Thumbnails.object(sopInstanceUID);
+  if (thumbnail)
+    {
+    return *thumbnail;
+    }
+  if (!this->Cache.isOpen())
+    {
+    return QImage();
+    }
+  QSqlQuery query(this->Cache);
+  query.prepare("SELECT Thumbnail FROM Thumbnails WHERE SOPInstanceUID = ?");
+  query.bindValue(0, sopInstanceUID);
+  QImage image;
+  if (query.exec() && query.next())
+    {
+    image.loadFromData(query.value(0).toByteArray(), "PNG");
+    if (!image.isNull())
+      {
+      this->Thumbnails.insert(sopInstanceUID, new QImage(image), qMax(1, image.byteCount() / 1024));
+      }
+    }
+  return image;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailServicePrivate::request(const QString& sopInstanceUID, const QString& filePath,
+                                              const QString& uid, int priority)
+{
+  ctkDICOMThumbnailRequest request;
+  request.SOPInstanceUID = sopInstanceUID;
+  request.FilePath = filePath;
+  request.UIDs << uid;
+  request.Priority = priority;
+  request.Order = 0;
+  request.Generator = this->Generator;
+  this->startWorkers();
+  this->Queue.put(request);
+}
+
+//------------------------------------------------------------------------------
+// ctkDICOMThumbnailService methods
+
+//------------------------------------------------------------------------------
+ctkDICOMThumbnailService::ctkDICOMThumbnailService(QObject* parentValue)
+  : QObject(parentValue)
+  , d_ptr(new ctkDICOMThumbnailServicePrivate(*this))
+{
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMThumbnailService::~ctkDICOMThumbnailService()
+{
+  Q_D(ctkDICOMThumbnailService);
+  // no queued call must reach a partially destroyed service
+  d->stopWorkers();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailService::setDatabase(QSharedPointer<ctkDICOMDatabase> database)
+{
+  Q_D(ctkDICOMThumbnailService);
+  // the renders in progress must not be stored into the cache of the new
+  // database
+  d->Queue.discard();
+  d->closeCache();
+  d->Thumbnails.clear();
+  d->SeriesRepresentatives.clear();
+  if (d->Database)
+    {
+    QObject::disconnect(d->Database.data(), SIGNAL(imagesRemoved(QStringList)),
+                        this, SLOT(removeThumbnails(QStringList)));
+    }
+  d->Database = database;
+  if (d->Database)
+    {
+    QObject::connect(d->Database.data(), SIGNAL(imagesRemoved(QStringList)),
+                     this, SLOT(removeThumbnails(QStringList)));
+    }
+  d->openCache();
+}
+
+//------------------------------------------------------------------------------
+QSharedPointer<ctkDICOMDatabase> ctkDICOMThumbnailService::database()const
+{
+  Q_D(const ctkDICOMThumbnailService);
+  return d->Database;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailService::setThumbnailGenerator(ctkDICOMAbstractThumbnailGenerator* generator)
+{
+  Q_D(ctkDICOMThumbnailService);
+  d->Generator = generator;
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMAbstractThumbnailGenerator* ctkDICOMThumbnailService::thumbnailGenerator()const
+{
+  Q_D(const ctkDICOMThumbnailService);
+  return d->Generator;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailService::setNumberOfThreads(int threads)
+{
+  Q_D(ctkDICOMThumbnailService);
+  d->NumberOfThreads = qMax(1, threads);
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMThumbnailService::numberOfThreads()const
+{
+  Q_D(const ctkDICOMThumbnailService);
+  return d->NumberOfThreads;
+}
+
+//------------------------------------------------------------------------------
+QImage ctkDICOMThumbnailService::thumbnail(const QString& sopInstanceUID, int priority)
+{
+  Q_D(ctkDICOMThumbnailService);
+  QImage image = d->cachedThumbnail(sopInstanceUID);
+  if (!image.isNull() || !d->Database || !d->Database->isOpen())
+    {
+    return image;
+    }
+  QSqlQuery query(d->Database->database());
+  query.prepare("SELECT Filename FROM Images WHERE SOPInstanceUID = ?");
+  query.bindValue(0, sopInstanceUID);
+  if (!query.exec() || !query.next())
+    {
+    logger.warn("No image " + sopInstanceUID + " in the database");
+    return image;
+    }
+  d->request(sopInstanceUID, query.value(0).toString(), sopInstanceUID, priority);
+  return image;
+}
+
+//------------------------------------------------------------------------------
+QImage ctkDICOMThumbnailService::seriesThumbnail(const QString& seriesInstanceUID, int priority)
+{
+  Q_D(ctkDICOMThumbnailService);
+  QString sopInstanceUID = d->SeriesRepresentatives.value(seriesInstanceUID);
+  if (!sopInstanceUID.isEmpty())
+    {
+    QImage image = d->cachedThumbnail(sopInstanceUID);
+    if (!image.isNull())
+      {
+      return image;
+      }
+    }
+  if (!d->Database || !d->Database->isOpen())
+    {
+    return QImage();
+    }
+  QSqlQuery query(d->Database->database());
+  query.prepare("SELECT SOPInstanceUID, Filename FROM Images WHERE SeriesInstanceUID = ? ORDER BY Filename");
+  query.bindValue(0, seriesInstanceUID);
+  QStringList sopInstanceUIDs;
+  QStringList files;
+  if (query.exec())
+    {
+    while (query.next())
+      {
+      sopInstanceUIDs << query.value(0).toString();
+      files << query.value(1).toString();
+      }
+    }
+  if (sopInstanceUIDs.isEmpty())
+    {
+    logger.warn("No image in series " + seriesInstanceUID);
+    return QImage();
+    }
+  int representative = sopInstanceUIDs.count() / 2;
+  sopInstanceUID = sopInstanceUIDs[representative];
+  d->SeriesRepresentatives[seriesInstanceUID] = sopInstanceUID;
+  QImage image = d->cachedThumbnail(sopInstanceUID);
+  if (image.isNull())
+    {
+    d->request(sopInstanceUID, files[representative], seriesInstanceUID, priority);
+    }
+  return image;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailService::setRequestPriority(const QString& uid, int priority)
+{
+  Q_D(ctkDICOMThumbnailService);
+  // uid is either a SOPInstanceUID or a SeriesInstanceUID
+  QString sopInstanceUID = d->SeriesRepresentatives.value(uid, uid);
+  return d->Queue.setPriority(sopInstanceUID, priority);
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMThumbnailService::pendingRequests()const
+{
+  Q_D(const ctkDICOMThumbnailService);
+  return const_cast<ctkDICOMThumbnailQueue&>(d->Queue).count();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailService::cancelRequests()
+{
+  Q_D(ctkDICOMThumbnailService);
+  d->Queue.clear();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailService::removeThumbnails(const QStringList& sopInstanceUIDs)
+{
+  Q_D(ctkDICOMThumbnailService);
+  d->Queue.remove(sopInstanceUIDs);
+  foreach(const QString& sopInstanceUID, sopInstanceUIDs)
+    {
+    d->Thumbnails.remove(sopInstanceUID);
+    }
+  // the representative of the series is chosen again on the next request
+  QSet<QString> removedUIDs = sopInstanceUIDs.toSet();
+  QHash<QString, QString>::iterator it = d->SeriesRepresentatives.begin();
+  while (it != d->SeriesRepresentatives.end())
+    {
+    if (removedUIDs.contains(it.value()))
+      {
+      it = d->SeriesRepresentatives.erase(it);
+      }
+    else
+      {
+      ++it;
+      }
+    }
+  if (!d->Cache.isOpen())
+    {
+    return;
+    }
+  d->Cache.transaction();
+  QSqlQuery removeThumbnail(d->Cache);
+  removeThumbnail.prepare("DELETE FROM Thumbnails WHERE SOPInstanceUID = ?");
+  foreach(const QString& sopInstanceUID, sopInstanceUIDs)
+    {
+    removeThumbnail.bindValue(0, sopInstanceUID);
+    if (!removeThumbnail.exec())
+      {
+      logger.error("Can't remove thumbnail: " + removeThumbnail.lastError().text());
+      }
+    }
+  d->Cache.commit();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailService::storeThumbnails()
+{
+  Q_D(ctkDICOMThumbnailService);
+  QList<ctkDICOMThumbnailResult> results = d->Queue.takeResults();
+  if (d->Cache.isOpen())
+    {
+    // one transaction for all the thumbnails rendered meanwhile
+    d->Cache.transaction();
+    QSqlQuery insertThumbnail(d->Cache);
+    insertThumbnail.prepare("INSERT OR REPLACE INTO Thumbnails ('SOPInstanceUID', 'Thumbnail') VALUES (?, ?)");
+    foreach(const ctkDICOMThumbnailResult& result, results)
+      {
+      if (result.PNG.isEmpty())
+        {
+        continue;
+        }
+      insertThumbnail.bindValue(0, result.SOPInstanceUID);
+      insertThumbnail.bindValue(1, result.PNG);
+      if (!insertThumbnail.exec())
+        {
+        logger.error("Can't store thumbnail: " + insertThumbnail.lastError().text());
+        }
+      }
+    d->Cache.commit();
+    }
+  foreach(const ctkDICOMThumbnailResult& result, results)
+    {
+    if (!result.Thumbnail.isNull())
+      {
+      d->Thumbnails.insert(result.SOPInstanceUID, new QImage(result.Thumbnail),
+                           qMax(1, result.Thumbnail.byteCount() / 1024));
+      }
+    foreach(const QString& uid, result.UIDs)
+      {
+      emit this->thumbnailReady(uid, result.Thumbnail);
+      }
+    }
+}
@@ -0,0 +1,117 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+#ifndef __ctkDICOMThumbnailService_h
+#define __ctkDICOMThumbnailService_h
+
+// Qt includes
+#include <QImage>
+#include <QObject>
+#include <QSharedPointer>
+#include <QStringList>
+
+#include "ctkDICOMCoreExport.h"
+
+class ctkDICOMAbstractThumbnailGenerator;
+class ctkDICOMDatabase;
+class ctkDICOMThumbnailServicePrivate;
+
+/// \ingroup DICOM_Core
+///
+/// Generate the thumbnails of the images of a database on demand, in
+/// worker threads, and cache them.
+/// thumbnail() and seriesThumbnail() return the cached thumbnail right away
+/// or queue its generation and return a null image; thumbnailReady() is
+/// emitted once the thumbnail is generated. Pending requests with the
+/// highest priority are rendered first, e.g. the visible items of a list.
+/// The thumbnails are stored as PNG in a single SQLite file
+/// "thumbs.db" in the database directory, keyed by SOPInstanceUID, and
+/// dropped when their image is removed from the database.
+class CTK_DICOM_CORE_EXPORT ctkDICOMThumbnailService : public QObject
+{
+  Q_OBJECT
+  Q_PROPERTY(int numberOfThreads READ numberOfThreads WRITE setNumberOfThreads)
+
+public:
+  explicit ctkDICOMThumbnailService(QObject* parent = 0);
+  virtual ~ctkDICOMThumbnailService();
+
+  /// Database of the images. Pending requests are canceled and the
+  /// thumbnails being rendered are discarded.
+  void setDatabase(QSharedPointer<ctkDICOMDatabase> database);
+  QSharedPointer<ctkDICOMDatabase> database()const;
+
+  /// Generator used by the worker threads, it must be reentrant.
+  void setThumbnailGenerator(ctkDICOMAbstractThumbnailGenerator* generator);
+  ctkDICOMAbstractThumbnailGenerator* thumbnailGenerator()const;
+
+  /// Number of worker threads, QThread::idealThreadCount() by default.
+  /// Only taken into account before the first request.
+  void setNumberOfThreads(int threads);
+  int numberOfThreads()const;
+
+  /// Returns the thumbnail of the image if it is cached, otherwise queues
+  /// its generation with @a priority and returns a null image. Requesting
+  /// a pending thumbnail again updates its priority.
+  Q_INVOKABLE QImage thumbnail(const QString& sopInstanceUID, int priority = 0);
+  /// Same as thumbnail() for the representative image of the series (the
+  /// image in the middle of the series). thumbnailReady() is emitted with
+  /// @a seriesInstanceUID.
+  Q_INVOKABLE QImage seriesThumbnail(const QString& seriesInstanceUID, int priority = 0);
+
+  /// Update the priority of the pending request of @a uid, a
+  /// SOPInstanceUID or SeriesInstanceUID given to thumbnail() or
+  /// seriesThumbnail(), without querying the database. Returns false if
+  /// there is no such request, e.g. it was canceled or is done.
+  bool setRequestPriority(const QString& uid, int priority);
+
+  /// Number of requests waiting for a worker thread
+  int pendingRequests()const;
+
+public Q_SLOTS:
+  /// Drop the requests that are not being rendered yet, e.g. when the
+  /// displayed items change.
+  void cancelRequests();
+
+  /// Drop the cached thumbnails of these images, in memory and in
+  /// "thumbs.db". Called when images are removed from the database. The
+  /// thumbnails of these images being rendered are discarded.
+  void removeThumbnails(const QStringList& sopInstanceUIDs);
+
+Q_SIGNALS:
+  /// Emitted when the thumbnail of a request is generated. @a uid is the
+  /// SOPInstanceUID or SeriesInstanceUID given to thumbnail() or
+  /// seriesThumbnail(). @a thumbnail is null if it can't be generated.
+  void thumbnailReady(const QString& uid, const QImage& thumbnail);
+
+protected Q_SLOTS:
+  /// Store the thumbnails rendered by the worker threads into the cache
+  /// and emit thumbnailReady()
+  void storeThumbnails();
+
+protected:
+  QScopedPointer<ctkDICOMThumbnailServicePrivate> d_ptr;
+
+private:
+  Q_DECLARE_PRIVATE(ctkDICOMThumbnailService);
+  Q_DISABLE_COPY(ctkDICOMThumbnailService);
+};
+
+#endif
@@ -0,0 +1,127 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+#ifndef __ctkDICOMThumbnailService_p_h
+#define __ctkDICOMThumbnailService_p_h
+
+// Qt includes
+#include <QByteArray>
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QSet>
+#include <QStringList>
+#include <QThread>
+#include <QWaitCondition>
+
+class ctkDICOMAbstractThumbnailGenerator;
+
+//------------------------------------------------------------------------------
+/// \ingroup DICOM_Core
+/// Thumbnail of an image to render. UIDs are the SOPInstanceUIDs and
+/// SeriesInstanceUIDs the thumbnail was requested for.
+struct ctkDICOMThumbnailRequest
+{
+  QString     SOPInstanceUID;
+  QString     FilePath;
+  QStringList UIDs;
+  int         Priority;
+  qint64      Order;
+  ctkDICOMAbstractThumbnailGenerator* Generator;
+};
+
+//------------------------------------------------------------------------------
+/// \ingroup DICOM_Core
+/// Thumbnail rendered by a worker, PNG is the encoded Thumbnail. Both are
+/// empty if the image can't be rendered.
+struct ctkDICOMThumbnailResult
+{
+  QString     SOPInstanceUID;
+  QStringList UIDs;
+  QImage      Thumbnail;
+  QByteArray  PNG;
+};
+
+//------------------------------------------------------------------------------
+/// \ingroup DICOM_Core
+/// Requests waiting for a worker and results waiting to be stored.
+/// Requests are taken by decreasing priority, the most recent first for
+/// equal priorities. An image is rendered only once even if it is
+/// requested again while it is being rendered. The renders running when
+/// their image is removed are discarded when they finish.
+class ctkDICOMThumbnailQueue
+{
+public:
+  ctkDICOMThumbnailQueue();
+
+  /// Add a request or update the priority of the pending one
+  void put(const ctkDICOMThumbnailRequest& request);
+  /// Blocks while there is no request. Returns false once stopped.
+  bool take(ctkDICOMThumbnailRequest& request);
+  /// Update the priority of the pending request of the image. Returns
+  /// false if it is not pending.
+  bool setPriority(const QString& sopInstanceUID, int priority);
+  /// Drop the pending requests and the results of these images, the
+  /// renders in progress are discarded.
+  void remove(const QStringList& sopInstanceUIDs);
+  /// Drop all the requests and results, the renders in progress are
+  /// discarded. Called when the database changes.
+  void discard();
+  /// Drop the pending requests
+  void clear();
+  int count();
+  /// Wake up the workers, take() returns false.
+  void stop();
+
+  /// Returns true if there was no result waiting to be stored, i.e. if the
+  /// service has to be notified. Discarded results are dropped.
+  bool putResult(ctkDICOMThumbnailResult& result);
+  QList<ctkDICOMThumbnailResult> takeResults();
+
+private:
+  QMutex Mutex;
+  QWaitCondition NotEmpty;
+  QHash<QString, ctkDICOMThumbnailRequest> Requests;
+  /// UIDs of the images being rendered
+  QHash<QString, QStringList> InProgress;
+  /// Images whose render in progress is stale
+  QSet<QString> Discarded;
+  QList<ctkDICOMThumbnailResult> Results;
+  qint64 Counter;
+  bool   Stopped;
+};
+
+//------------------------------------------------------------------------------
+/// \ingroup DICOM_Core
+/// Worker thread rendering the requests of the queue. The service is
+/// notified with a queued call to its storeThumbnails() slot.
+class ctkDICOMThumbnailWorker : public QThread
+{
+public:
+  ctkDICOMThumbnailWorker(ctkDICOMThumbnailQueue& queue, QObject* service);
+
+protected:
+  virtual void run();
+
+  ctkDICOMThumbnailQueue& Queue;
+  QObject*                Service;
+};
+
+#endif
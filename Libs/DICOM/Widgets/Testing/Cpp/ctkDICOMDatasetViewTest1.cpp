@@ -51,6 +51,17 @@ int ctkDICOMDatasetViewTest1( int argc, char * argv [] )
   QImage image2(200, 200, QImage::Format_RGB32);
   
   ctkDICOMDatasetView datasetView;
+
+  datasetView.setSliceCacheSize(64);
+  datasetView.setPrefetchCount(4);
+  if (datasetView.sliceCacheSize() != 64 ||
+      datasetView.prefetchCount() != 4)
+    {
+    std::cerr << "Line " << __LINE__ << " - Failed to set slice cache properties"
+              << std::endl;
+    return EXIT_FAILURE;
+    }
+
   datasetView.addImage(img);
   datasetView.addImage(image);
   datasetView.addImage(image2);
@@ -0,0 +1,247 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QDir>
+#include <QThread>
+#include <QTime>
+
+// ctkDICOMWidgets includes
+#include "ctkDICOMSliceCache_p.h"
+
+// DCMTK includes
+#include <dcmimage.h>
+
+// STD includes
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+//------------------------------------------------------------------------------
+// Gives access to the slices of the cache
+class ctkDICOMSliceCacheTester : public ctkDICOMSliceCache
+{
+public:
+  bool isCached(const QString& filePath)const
+  {
+    return this->Slices.contains(filePath);
+  }
+  int totalCost()const
+  {
+    return this->Slices.totalCost();
+  }
+  int maxCost()const
+  {
+    return this->Slices.maxCost();
+  }
+  ctkDICOMSliceQueue& queue()
+  {
+    return this->Queue;
+  }
+};
+
+//------------------------------------------------------------------------------
+// Decodes a slice taken from the queue after a delay, like a slow decoder
+class DelayedDecoder : public QThread
+{
+public:
+  DelayedDecoder(ctkDICOMSliceQueue& queue, const QString& filePath)
+    : Queue(queue), FilePath(filePath) {}
+
+  virtual void run()
+  {
+    this->msleep(200);
+    this->Image = QSharedPointer<DicomImage>(
+      new DicomImage(QDir::toNativeSeparators(this->FilePath).toStdString().c_str()));
+    this->Queue.putResult(this->FilePath, this->Image);
+  }
+
+  ctkDICOMSliceQueue& Queue;
+  QString FilePath;
+  QSharedPointer<DicomImage> Image;
+};
+
+//------------------------------------------------------------------------------
+// Display the slices in order, as fast as possible, and return the number of
+// slices displayed per second. With prefetch, the next prefetchCount slices
+// are requested after each slice, like ctkDICOMDatasetView does.
+double scrollRate(const QStringList& filePaths, int prefetchCount)
+{
+  ctkDICOMSliceCache cache;
+  QTime time;
+  time.start();
+  for (int i = 0; i < filePaths.count(); ++i)
+    {
+    QSharedPointer<DicomImage> image = cache.slice(filePaths[i]);
+    if (image)
+      {
+      // Render it as the view does
+      image->getOutputData(8);
+      }
+    if (prefetchCount > 0)
+      {
+      cache.prefetch(filePaths.mid(i + 1, prefetchCount));
+      }
+    QCoreApplication::processEvents();
+    }
+  return filePaths.count() * 1000. / qMax(1, time.elapsed());
+}
+
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMSliceCacheTest1(int argc, char * argv [])
+{
+  QCoreApplication app(argc, argv);
+  if (argc < 2)
+    {
+    std::cerr << "Usage: ctkDICOMSliceCacheTest1 dicomDirectory" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  QDir directory(argv[1]);
+  QStringList filePaths;
+  foreach(const QString& fileName, directory.entryList(QDir::Files, QDir::Name))
+    {
+    filePaths << directory.filePath(fileName);
+    }
+  if (filePaths.count() < 8)
+    {
+    std::cerr << "Line " << __LINE__ << " - Expected at least 8 slices in "
+              << argv[1] << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //------Test LRU eviction-----------------------------------------------------
+  {
+  ctkDICOMSliceCacheTester cache;
+  cache.setMaximumSize(1);
+  QSharedPointer<DicomImage> first = cache.slice(filePaths[0]);
+  if (first.isNull() || first->getStatus() != EIS_Normal ||
+      cache.slice(filePaths[0]) != first)
+    {
+    std::cerr << "Line " << __LINE__ << " - Failed to cache " << qPrintable(filePaths[0])
+              << std::endl;
+    return EXIT_FAILURE;
+    }
+  cache.slice(filePaths[1]);
+  // filePaths[1] is now the least recently used slice
+  cache.slice(filePaths[0]);
+  int next = 2;
+  while (cache.isCached(filePaths[1]) && next < filePaths.count())
+    {
+    cache.slice(filePaths[next++]);
+    if (cache.totalCost() > cache.maxCost())
+      {
+      std::cerr << "Line " << __LINE__ << " - Cache over budget: " << cache.totalCost()
+                << " KB instead of " << cache.maxCost() << " KB" << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+  if (cache.isCached(filePaths[1]) || !cache.isCached(filePaths[0]))
+    {
+    std::cerr << "Line " << __LINE__ << " - Failed to evict the least recently used slice"
+              << std::endl;
+    return EXIT_FAILURE;
+    }
+  }
+
+  //------Test replacing the prefetch requests-----------------------------------
+  {
+  ctkDICOMSliceQueue queue;
+  queue.setRequests(QStringList() << "a" << "b" << "c");
+  queue.setRequests(QStringList() << "d" << "e");
+  QString filePath;
+  if (!queue.take(filePath) || filePath != "d")
+    {
+    std::cerr << "Line " << __LINE__ << " - Stale request taken: "
+              << qPrintable(filePath) << std::endl;
+    return EXIT_FAILURE;
+    }
+  // "d" is being decoded, it is not requested again
+  queue.setRequests(QStringList() << "d" << "f" << "g");
+  queue.cancel("f");
+  if (!queue.take(filePath) || filePath != "g")
+    {
+    std::cerr << "Line " << __LINE__ << " - Wrong request taken: "
+              << qPrintable(filePath) << std::endl;
+    return EXIT_FAILURE;
+    }
+  queue.stop();
+  if (queue.take(filePath))
+    {
+    std::cerr << "Line " << __LINE__ << " - Request taken once stopped" << std::endl;
+    return EXIT_FAILURE;
+    }
+  }
+
+  //------Test waiting for a decoder---------------------------------------------
+  {
+  ctkDICOMSliceCacheTester cache;
+  QString filePath;
+  cache.queue().setRequests(QStringList() << filePaths[0]);
+  cache.queue().take(filePath);
+  DelayedDecoder decoder(cache.queue(), filePath);
+  decoder.start();
+  // The slice is not decoded again but taken from the decoder
+  QSharedPointer<DicomImage> image = cache.slice(filePath);
+  decoder.wait();
+  if (image.isNull() || image != decoder.Image || !cache.isCached(filePath))
+    {
+    std::cerr << "Line " << __LINE__ << " - Failed to wait for the decoder" << std::endl;
+    return EXIT_FAILURE;
+    }
+  }
+
+  //------Test prefetch----------------------------------------------------------
+  {
+  ctkDICOMSliceCacheTester cache;
+  QStringList prefetched = filePaths.mid(0, 4);
+  cache.prefetch(prefetched);
+  // The decoders notify the cache with a queued call to storeSlices()
+  QTime time;
+  time.start();
+  bool stored = false;
+  while (!stored && time.elapsed() < 30000)
+    {
+    QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+    stored = true;
+    foreach(const QString& filePath, prefetched)
+      {
+      stored = stored && cache.isCached(filePath);
+      }
+    }
+  if (!stored)
+    {
+    std::cerr << "Line " << __LINE__ << " - Failed to store the prefetched slices"
+              << std::endl;
+    return EXIT_FAILURE;
+    }
+  }
+
+  //------Scroll rate------------------------------------------------------------
+  std::cout << "Scrolling through " << filePaths.count() << " slices: "
+            << scrollRate(filePaths, 0) << " slices/s without prefetch, "
+            << scrollRate(filePaths, 8) << " slices/s with prefetch" << std::endl;
+
+  return EXIT_SUCCESS;
+}
@@ -46,6 +46,7 @@
 #include "ctkDICOMFilterProxyModel.h"
 #include "ctkDICOMIndexer.h"
 #include "ctkDICOMModel.h"
+#include "ctkDICOMThumbnailService.h"
 
 // ctkDICOMWidgets includes
 #include "ctkDICOMAppWidget.h"
@@ -77,6 +78,7 @@ public:
 
   QSharedPointer<ctkDICOMDatabase> DICOMDatabase;
   QSharedPointer<ctkDICOMThumbnailGenerator> ThumbnailGenerator;
+  ctkDICOMThumbnailService ThumbnailService;
   ctkDICOMModel DICOMModel;
   ctkDICOMFilterProxyModel DICOMProxyModel;
   QSharedPointer<ctkDICOMIndexer> DICOMIndexer;
@@ -95,7 +97,8 @@ public:
 ctkDICOMAppWidgetPrivate::ctkDICOMAppWidgetPrivate(ctkDICOMAppWidget* parent): q_ptr(parent){
   DICOMDatabase = QSharedPointer<ctkDICOMDatabase> (new ctkDICOMDatabase);
   ThumbnailGenerator = QSharedPointer <ctkDICOMThumbnailGenerator> (new ctkDICOMThumbnailGenerator);
-  DICOMDatabase->setThumbnailGenerator(ThumbnailGenerator.data());
+  // Thumbnails are generated on demand by the service, not when inserting
+  ThumbnailService.setThumbnailGenerator(ThumbnailGenerator.data());
   DICOMIndexer = QSharedPointer<ctkDICOMIndexer> (new ctkDICOMIndexer);
 }
 
@@ -128,6 +131,7 @@ ctkDICOMAppWidget::ctkDICOMAppWidget(QWidget* _parent):Superclass(_parent),
 
   d->ThumbnailsWidget->setThumbnailSize(
     QSize(d->ThumbnailWidthSlider->value(), d->ThumbnailWidthSlider->value()));
+  d->ThumbnailsWidget->setThumbnailService(&d->ThumbnailService);
 
   connect(d->TreeView, SIGNAL(collapsed(QModelIndex)), this, SLOT(onTreeCollapsed(QModelIndex)));
   connect(d->TreeView, SIGNAL(expanded(QModelIndex)), this, SLOT(onTreeExpanded(QModelIndex)));
@@ -202,6 +206,7 @@ void ctkDICOMAppWidget::setDatabaseDirectory(const QString& directory)
   settings.sync();
 
   //close the active DICOM database
+  d->ThumbnailService.setDatabase(QSharedPointer<ctkDICOMDatabase>());
   d->DICOMDatabase->closeDatabase();
   
   //open DICOM database on the directory
@@ -219,6 +224,7 @@ void ctkDICOMAppWidget::setDatabaseDirectory(const QString& directory)
   
   d->DICOMModel.setDatabase(d->DICOMDatabase->database());
   d->DICOMModel.setEndLevel(ctkDICOMModel::SeriesType);
+  d->ThumbnailService.setDatabase(d->DICOMDatabase);
   d->TreeView->resizeColumnToContents(0);
 
   //pass DICOM database instance to Import widget
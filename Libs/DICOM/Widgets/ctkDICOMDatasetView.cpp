@@ -34,6 +34,7 @@
 
 // ctkDICOMWidgets includex
 #include "ctkDICOMDatasetView.h"
+#include "ctkDICOMSliceCache_p.h"
 
 // Qt includes
 #include <QDebug>
@@ -64,10 +65,17 @@ public:
   double DicomIntensityLevel;
   double DicomIntensityWindow;
   bool AutoWindowLevel;
+  ctkDICOMSliceCache SliceCache;
+  QSharedPointer<DicomImage> CurrentImage;
+  int PrefetchCount;
 
   void init();
 
+  QString filePath(const QModelIndex& imageIndex)const;
   void setImage(const QModelIndex& imageIndex, bool defaultIntensity = true);
+  /// Decode in the background the next slices in the scroll direction and
+  /// a few slices behind.
+  void prefetch(const QModelIndex& imageIndex, int direction);
 
   void onPatientModelSelected(const QModelIndex& index);
   void onStudyModelSelected(const QModelIndex& index);
@@ -101,6 +109,8 @@ void ctkDICOMDatasetViewPrivate::init()
 
   this->AutoWindowLevel = true;
 
+  this->PrefetchCount = 8;
+
   /*
   this->Window->setParent(q);
   QHBoxLayout* layout = new QHBoxLayout(q);
@@ -110,6 +120,19 @@ void ctkDICOMDatasetViewPrivate::init()
   */
 }
 
+// -------------------------------------------------------------------------
+QString ctkDICOMDatasetViewPrivate::filePath(const QModelIndex &imageIndex)const{
+    const QAbstractItemModel* model = imageIndex.model();
+    QModelIndex seriesIndex = imageIndex.parent();
+    QModelIndex studyIndex = seriesIndex.parent();
+
+    QString dicomPath = this->DatabaseDirectory;
+    dicomPath.append("/dicom/").append(model->data(studyIndex ,ctkDICOMModel::UIDRole).toString());
+    dicomPath.append("/").append(model->data(seriesIndex ,ctkDICOMModel::UIDRole).toString());
+    dicomPath.append("/").append(model->data(imageIndex ,ctkDICOMModel::UIDRole).toString());
+    return dicomPath;
+}
+
 // -------------------------------------------------------------------------
 void ctkDICOMDatasetViewPrivate::setImage(const QModelIndex &imageIndex, bool defaultIntensity){
     Q_Q(ctkDICOMDatasetView);
@@ -118,27 +141,67 @@ void ctkDICOMDatasetViewPrivate::setImage(const QModelIndex &imageIndex, bool de
 
     if(model){
         QModelIndex seriesIndex = imageIndex.parent();
-        QModelIndex studyIndex = seriesIndex.parent();
 
-        QString dicomPath = this->DatabaseDirectory;
-        dicomPath.append("/dicom/").append(model->data(studyIndex ,ctkDICOMModel::UIDRole).toString());
-        dicomPath.append("/").append(model->data(seriesIndex ,ctkDICOMModel::UIDRole).toString());
-        dicomPath.append("/").append(model->data(imageIndex ,ctkDICOMModel::UIDRole).toString());
+        // Scroll direction, forward when a series is selected
+        int direction = 1;
+        if(seriesIndex == this->CurrentImageIndex.parent() &&
+           imageIndex.row() < this->CurrentImageIndex.row()){
+            direction = -1;
+        }
 
-        if (QFile(dicomPath).exists()){
-          DicomImage dcmImage(  QDir::toNativeSeparators(dicomPath).toStdString().c_str() );
+        QSharedPointer<DicomImage> dcmImage;
+        if(imageIndex == this->CurrentImageIndex && this->CurrentImage){
+            // New window/level, the pixel data is already decoded
+            dcmImage = this->CurrentImage;
+        }else{
+            QString dicomPath = this->filePath(imageIndex);
+            if (QFile(dicomPath).exists()){
+                dcmImage = this->SliceCache.slice(dicomPath);
+            }
+        }
 
+        if (dcmImage){
             q->clearImages();
-            q->addImage(dcmImage, defaultIntensity);
+            q->addImage(*dcmImage, defaultIntensity);
+            bool sliceChanged = (imageIndex != this->CurrentImageIndex);
             this->CurrentImageIndex = imageIndex;
+            this->CurrentImage = dcmImage;
 
             q->emitImageDisplayedSignal(imageIndex.row(), model->rowCount(seriesIndex));
+
+            if (sliceChanged){
+                this->prefetch(imageIndex, direction);
+            }
         }else{
             q->clearImages();
         }
     }
 }
 
+// -------------------------------------------------------------------------
+void ctkDICOMDatasetViewPrivate::prefetch(const QModelIndex &imageIndex, int direction){
+    const QAbstractItemModel* model = imageIndex.model();
+    QModelIndex seriesIndex = imageIndex.parent();
+    const int imageCount = model->rowCount(seriesIndex);
+    const int behindCount = qMax(1, this->PrefetchCount / 4);
+
+    // Requests are served in order: ahead first, nearest first
+    QStringList filePaths;
+    for (int i = 1; i <= this->PrefetchCount; ++i){
+        int row = imageIndex.row() + direction * i;
+        if (row >= 0 && row < imageCount){
+            filePaths << this->filePath(model->index(row, 0, seriesIndex));
+        }
+    }
+    for (int i = 1; i <= behindCount && this->PrefetchCount > 0; ++i){
+        int row = imageIndex.row() - direction * i;
+        if (row >= 0 && row < imageCount){
+            filePaths << this->filePath(model->index(row, 0, seriesIndex));
+        }
+    }
+    this->SliceCache.prefetch(filePaths);
+}
+
 // -------------------------------------------------------------------------
 void ctkDICOMDatasetViewPrivate::onPatientModelSelected(const QModelIndex &index){
     Q_Q(ctkDICOMDatasetView);
@@ -247,6 +310,35 @@ void ctkDICOMDatasetView::setDatabaseDirectory(const QString &directory){
     Q_D(ctkDICOMDatasetView);
 
     d->DatabaseDirectory = directory;
+    d->SliceCache.clear();
+}
+
+// -------------------------------------------------------------------------
+void ctkDICOMDatasetView::setSliceCacheSize(int sizeInMB){
+    Q_D(ctkDICOMDatasetView);
+
+    d->SliceCache.setMaximumSize(sizeInMB);
+}
+
+// -------------------------------------------------------------------------
+int ctkDICOMDatasetView::sliceCacheSize()const{
+    Q_D(const ctkDICOMDatasetView);
+
+    return d->SliceCache.maximumSize();
+}
+
+// -------------------------------------------------------------------------
+void ctkDICOMDatasetView::setPrefetchCount(int count){
+    Q_D(ctkDICOMDatasetView);
+
+    d->PrefetchCount = qMax(0, count);
+}
+
+// -------------------------------------------------------------------------
+int ctkDICOMDatasetView::prefetchCount()const{
+    Q_D(const ctkDICOMDatasetView);
+
+    return d->PrefetchCount;
 }
 
 // -------------------------------------------------------------------------
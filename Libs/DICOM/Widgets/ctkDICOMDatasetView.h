@@ -58,6 +58,16 @@ public:
 
   QModelIndex currentImageIndex();
 
+  /// Memory budget in MB of the decoded slices, 256 by default. The least
+  /// recently displayed slices are discarded first.
+  void setSliceCacheSize(int sizeInMB);
+  int sliceCacheSize()const;
+
+  /// Number of slices decoded in the background ahead of the scroll
+  /// direction, 8 by default. A quarter as many are decoded behind.
+  void setPrefetchCount(int count);
+  int prefetchCount()const;
+
 Q_SIGNALS:
 
   void requestNextImage();
@@ -0,0 +1,278 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QDir>
+
+// ctkDICOMWidgets includes
+#include "ctkDICOMSliceCache_p.h"
+
+// DCMTK includes
+#include <dcmtk/dcmimgle/dcmimage.h>  /* for class DicomImage */
+#include <dcmtk/dcmimage/diregist.h>  /* include support for color images */
+
+//------------------------------------------------------------------------------
+namespace
+{
+QSharedPointer<DicomImage> decodeSlice(const QString& filePath)
+{
+  return QSharedPointer<DicomImage>(
+    new DicomImage(QDir::toNativeSeparators(filePath).toStdString().c_str()));
+}
+}
+
+//------------------------------------------------------------------------------
+// ctkDICOMSliceQueue methods
+
+//------------------------------------------------------------------------------
+ctkDICOMSliceQueue::ctkDICOMSliceQueue()
+{
+  this->Stopped = false;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMSliceQueue::setRequests(const QStringList& filePaths)
+{
+  QMutexLocker lock(&this->Mutex);
+  this->Requests.clear();
+  foreach(const QString& filePath, filePaths)
+    {
+    if (!this->InProgress.contains(filePath) && !this->Results.contains(filePath))
+      {
+      this->Requests << filePath;
+      }
+    }
+  this->NotEmpty.wakeAll();
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMSliceQueue::take(QString& filePath)
+{
+  QMutexLocker lock(&this->Mutex);
+  while (this->Requests.isEmpty() && !this->Stopped)
+    {
+    this->NotEmpty.wait(&this->Mutex);
+    }
+  if (this->Stopped)
+    {
+    return false;
+    }
+  filePath = this->Requests.takeFirst();
+  this->InProgress.insert(filePath);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMSliceQueue::cancel(const QString& filePath)
+{
+  QMutexLocker lock(&this->Mutex);
+  this->Requests.removeAll(filePath);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMSliceQueue::waitForDecoder(const QString& filePath)
+{
+  QMutexLocker lock(&this->Mutex);
+  while (this->InProgress.contains(filePath))
+    {
+    this->Decoded.wait(&this->Mutex);
+    }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMSliceQueue::stop()
+{
+  QMutexLocker lock(&this->Mutex);
+  this->Stopped = true;
+  this->Requests.clear();
+  this->NotEmpty.wakeAll();
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMSliceQueue::putResult(const QString& filePath,
+                                   const QSharedPointer<DicomImage>& image)
+{
+  QMutexLocker lock(&this->Mutex);
+  this->InProgress.remove(filePath);
+  this->Results.insert(filePath, image);
+  this->Decoded.wakeAll();
+  return this->Results.size() == 1;
+}
+
+//------------------------------------------------------------------------------
+QHash<QString, QSharedPointer<DicomImage> > ctkDICOMSliceQueue::takeResults()
+{
+  QMutexLocker lock(&this->Mutex);
+  QHash<QString, QSharedPointer<DicomImage> > results = this->Results;
+  this->Results.clear();
+  return results;
+}
+
+//------------------------------------------------------------------------------
+// ctkDICOMSliceDecoder methods
+
+//------------------------------------------------------------------------------
+ctkDICOMSliceDecoder::ctkDICOMSliceDecoder(ctkDICOMSliceQueue& queue, QObject* cache)
+  : Queue(queue)
+  , Cache(cache)
+{
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMSliceDecoder::run()
+{
+  QString filePath;
+  while (this->Queue.take(filePath))
+    {
+    if (this->Queue.putResult(filePath, decodeSlice(filePath)))
+      {
+      QMetaObject::invokeMethod(this->Cache, "storeSlices", Qt::QueuedConnection);
+      }
+    }
+}
+
+//------------------------------------------------------------------------------
+// ctkDICOMSliceCache methods
+
+//------------------------------------------------------------------------------
+ctkDICOMSliceCache::ctkDICOMSliceCache(QObject* parentObject)
+  : QObject(parentObject)
+{
+  // Costs are in KB
+  this->Slices.setMaxCost(256 * 1024);
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMSliceCache::~ctkDICOMSliceCache()
+{
+  this->stopDecoders();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMSliceCache::setMaximumSize(int sizeInMB)
+{
+  this->Slices.setMaxCost(qMax(1, sizeInMB) * 1024);
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMSliceCache::maximumSize()const
+{
+  return this->Slices.maxCost() / 1024;
+}
+
+//------------------------------------------------------------------------------
+QSharedPointer<DicomImage> ctkDICOMSliceCache::slice(const QString& filePath)
+{
+  QSharedPointer<DicomImage>* cachedSlice = this->Slices.object(filePath);
+  if (cachedSlice)
+    {
+    return *cachedSlice;
+    }
+
+  // Don't decode twice the slice a decoder is working on
+  this->Queue.cancel(filePath);
+  this->Queue.waitForDecoder(filePath);
+  this->storeSlices();
+  cachedSlice = this->Slices.object(filePath);
+  if (cachedSlice)
+    {
+    return *cachedSlice;
+    }
+
+  QSharedPointer<DicomImage> image = decodeSlice(filePath);
+  this->insert(filePath, image);
+  return image;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMSliceCache::prefetch(const QStringList& filePaths)
+{
+  QStringList missingSlices;
+  foreach(const QString& filePath, filePaths)
+    {
+    if (!this->Slices.contains(filePath))
+      {
+      missingSlices << filePath;
+      }
+    }
+  this->startDecoders();
+  this->Queue.setRequests(missingSlices);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMSliceCache::clear()
+{
+  this->Queue.setRequests(QStringList());
+  this->Slices.clear();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMSliceCache::storeSlices()
+{
+  QHash<QString, QSharedPointer<DicomImage> > results = this->Queue.takeResults();
+  for (QHash<QString, QSharedPointer<DicomImage> >::const_iterator it = results.constBegin();
+       it != results.constEnd(); ++it)
+    {
+    this->insert(it.key(), it.value());
+    }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMSliceCache::startDecoders()
+{
+  if (!this->Decoders.isEmpty())
+    {
+    return;
+    }
+  // Decoding is mostly bound by the disk
+  int decoderCount = qBound(1, QThread::idealThreadCount() / 2, 4);
+  for (int i = 0; i < decoderCount; ++i)
+    {
+    ctkDICOMSliceDecoder* decoder = new ctkDICOMSliceDecoder(this->Queue, this);
+    decoder->start(QThread::LowPriority);
+    this->Decoders << decoder;
+    }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMSliceCache::stopDecoders()
+{
+  this->Queue.stop();
+  foreach(ctkDICOMSliceDecoder* decoder, this->Decoders)
+    {
+    decoder->wait();
+    delete decoder;
+    }
+  this->Decoders.clear();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMSliceCache::insert(const QString& filePath,
+                               const QSharedPointer<DicomImage>& image)
+{
+  // DCMTK keeps the pixel data of the file and its modality transformed
+  // copy, each about the size of a 16-bit rendering.
+  int cost = 1;
+  if (image && image->getStatus() == EIS_Normal)
+    {
+    cost = qMax(1, static_cast<int>(2 * image->getOutputDataSize(16) / 1024));
+    }
+  this->Slices.insert(filePath, new QSharedPointer<DicomImage>(image), cost);
+}
@@ -0,0 +1,132 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+#ifndef __ctkDICOMSliceCache_p_h
+#define __ctkDICOMSliceCache_p_h
+
+// Qt includes
+#include <QCache>
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QThread>
+#include <QWaitCondition>
+
+// ctkDICOMWidgets includes
+#include "ctkDICOMWidgetsExport.h"
+
+class DicomImage;
+
+//------------------------------------------------------------------------------
+/// \ingroup DICOM_Widgets
+/// Slices waiting for a decoder and decoded slices waiting to be stored
+/// into the cache. Slices are taken in the order they were requested.
+class CTK_DICOM_WIDGETS_EXPORT ctkDICOMSliceQueue
+{
+public:
+  ctkDICOMSliceQueue();
+
+  /// Replace the pending requests
+  void setRequests(const QStringList& filePaths);
+  /// Blocks while there is no request. Returns false once stopped.
+  bool take(QString& filePath);
+  /// Drop the pending request of \a filePath, if any
+  void cancel(const QString& filePath);
+  /// Blocks while \a filePath is being decoded
+  void waitForDecoder(const QString& filePath);
+  /// Wake up the decoders, take() returns false.
+  void stop();
+
+  /// Returns true if there was no slice waiting to be stored, i.e. if the
+  /// cache has to be notified.
+  bool putResult(const QString& filePath, const QSharedPointer<DicomImage>& image);
+  QHash<QString, QSharedPointer<DicomImage> > takeResults();
+
+private:
+  QMutex Mutex;
+  QWaitCondition NotEmpty;
+  QWaitCondition Decoded;
+  QStringList Requests;
+  QSet<QString> InProgress;
+  QHash<QString, QSharedPointer<DicomImage> > Results;
+  bool Stopped;
+};
+
+//------------------------------------------------------------------------------
+/// \ingroup DICOM_Widgets
+/// Decoder thread of the requests of the queue. The cache is notified with
+/// a queued call to its storeSlices() slot.
+class ctkDICOMSliceDecoder : public QThread
+{
+public:
+  ctkDICOMSliceDecoder(ctkDICOMSliceQueue& queue, QObject* cache);
+
+protected:
+  virtual void run();
+
+  ctkDICOMSliceQueue& Queue;
+  QObject*            Cache;
+};
+
+//------------------------------------------------------------------------------
+/// \ingroup DICOM_Widgets
+/// Decoded slices of ctkDICOMDatasetView, by file path. A DicomImage keeps
+/// the pixel data at full depth: a new window/level is rendered from it
+/// without reading the file again. The least recently used slices are
+/// dropped once the size of the cache exceeds its memory budget.
+class CTK_DICOM_WIDGETS_EXPORT ctkDICOMSliceCache : public QObject
+{
+  Q_OBJECT
+public:
+  ctkDICOMSliceCache(QObject* parent = 0);
+  virtual ~ctkDICOMSliceCache();
+
+  /// Memory budget in MB, 256 by default. The size of a slice is estimated
+  /// from its dimensions.
+  void setMaximumSize(int sizeInMB);
+  int maximumSize()const;
+
+  /// Decoded slice of \a filePath, decoded by the calling thread if it is
+  /// neither in the cache nor being decoded.
+  QSharedPointer<DicomImage> slice(const QString& filePath);
+
+  /// Decode these slices in the background, in order, instead of the
+  /// slices requested before. Slices already in the cache are skipped.
+  void prefetch(const QStringList& filePaths);
+
+  void clear();
+
+protected Q_SLOTS:
+  void storeSlices();
+
+protected:
+  void startDecoders();
+  void stopDecoders();
+  void insert(const QString& filePath, const QSharedPointer<DicomImage>& image);
+
+  QCache<QString, QSharedPointer<DicomImage> > Slices;
+  ctkDICOMSliceQueue                            Queue;
+  QList<ctkDICOMSliceDecoder*>                  Decoders;
+};
+
+#endif
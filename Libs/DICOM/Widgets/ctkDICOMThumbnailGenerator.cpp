@@ -75,6 +75,16 @@ ctkDICOMThumbnailGenerator::~ctkDICOMThumbnailGenerator()
 
 //------------------------------------------------------------------------------
 bool ctkDICOMThumbnailGenerator::generateThumbnail(DicomImage *dcmImage, const QString &path){
+    QImage thumbnail;
+    if (!this->generateThumbnail(dcmImage, thumbnail))
+    {
+      return false;
+    }
+    return thumbnail.save(path,"PNG");
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailGenerator::generateThumbnail(DicomImage *dcmImage, QImage& thumbnail){
     QImage image;
     // Check whether we have a valid image
     EI_Status result = dcmImage->getStatus();
@@ -132,6 +142,6 @@ bool ctkDICOMThumbnailGenerator::generateThumbnail(DicomImage *dcmImage, const Q
             return false;
         }
     }
-    image.scaled(128,128,Qt::KeepAspectRatio).save(path,"PNG");
+    thumbnail = image.scaled(128,128,Qt::KeepAspectRatio);
     return true;
 }
@@ -43,6 +43,7 @@ public:
   virtual ~ctkDICOMThumbnailGenerator();
 
   virtual bool generateThumbnail(DicomImage* dcmImage, const QString& path );
+  virtual bool generateThumbnail(DicomImage* dcmImage, QImage& thumbnail );
 
 protected:
   QScopedPointer<ctkDICOMThumbnailGeneratorPrivate> d_ptr;
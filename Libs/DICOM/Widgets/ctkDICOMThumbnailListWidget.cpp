@@ -27,8 +27,11 @@
 #include <QMetaType>
 #include <QPersistentModelIndex>
 #include <QPixmap>
+#include <QPointer>
 #include <QPushButton>
 #include <QResizeEvent>
+#include <QScrollBar>
+#include <QTimer>
 
 // ctk includes
 #include "ctkLogger.h"
@@ -42,6 +45,7 @@
 #include "ctkDICOMDatabase.h"
 #include "ctkDICOMFilterProxyModel.h"
 #include "ctkDICOMModel.h"
+#include "ctkDICOMThumbnailService.h"
 
 // ctkDICOMWidgets includes
 #include "ctkDICOMThumbnailListWidget.h"
@@ -68,8 +72,16 @@ public:
 
   QString DatabaseDirectory;
   QModelIndex CurrentSelectedModel;
+  QPointer<ctkDICOMThumbnailService> ThumbnailService;
+  /// Thumbnails requested to ThumbnailService, by SOPInstanceUID or
+  /// SeriesInstanceUID
+  QHash<QString, QPointer<ctkThumbnailLabel> > PendingThumbnails;
+  /// Compress the scroll bar changes into one updateThumbnailPriorities()
+  QTimer* PriorityTimer;
 
-  void addThumbnailWidget(const QModelIndex &imageIndex, const QModelIndex& sourceIndex, const QString& text);
+  /// @a thumbnailIndex is the index of the image, or of the series when
+  /// using ThumbnailService
+  void addThumbnailWidget(const QModelIndex &thumbnailIndex, const QModelIndex& sourceIndex, const QString& text);
 
   void onPatientModelSelected(const QModelIndex &index);
   void onStudyModelSelected(const QModelIndex &index);
@@ -86,7 +98,7 @@ private:
 ctkDICOMThumbnailListWidgetPrivate::ctkDICOMThumbnailListWidgetPrivate(ctkDICOMThumbnailListWidget* parent):
   Superclass(parent)
 {
-
+  this->PriorityTimer = 0;
 }
 
 //----------------------------------------------------------------------------
@@ -104,6 +116,12 @@ void ctkDICOMThumbnailListWidgetPrivate::onPatientModelSelected(const QModelInde
         {
             QModelIndex studyIndex = patientIndex.child(i, 0);
             QModelIndex seriesIndex = studyIndex.child(0, 0);
+            if (this->ThumbnailService)
+            {
+                // the service picks the image of the series itself
+                this->addThumbnailWidget(seriesIndex, studyIndex, model->data(studyIndex, Qt::DisplayRole).toString());
+                continue;
+            }
             model->fetchMore(seriesIndex);
             int imageCount = model->rowCount(seriesIndex);
             QModelIndex imageIndex = seriesIndex.child(imageCount/2, 0);
@@ -134,6 +152,11 @@ void ctkDICOMThumbnailListWidgetPrivate::onStudyModelSelected(const QModelIndex
         for(int i=0; i<seriesCount; i++)
         {
             QModelIndex seriesIndex = studyIndex.child(i, 0);
+            if (this->ThumbnailService)
+            {
+                this->addThumbnailWidget(seriesIndex, seriesIndex, model->data(seriesIndex, Qt::DisplayRole).toString());
+                continue;
+            }
             model->fetchMore(seriesIndex);
             int imageCount = model->rowCount(seriesIndex);
             QModelIndex imageIndex = seriesIndex.child(imageCount/2, 0);
@@ -172,7 +195,7 @@ void ctkDICOMThumbnailListWidgetPrivate::onSeriesModelSelected(const QModelIndex
                                     model->data(seriesIndex ,ctkDICOMModel::UIDRole).toString() + "/" +
                                     model->data(imageIndex, ctkDICOMModel::UIDRole).toString() + ".png";
 
-            if(QFile(thumbnailPath).exists())
+            if(this->ThumbnailService || QFile(thumbnailPath).exists())
             {
                 this->addThumbnailWidget(imageIndex, imageIndex, QString("Image %1").arg(i));
             }
@@ -180,31 +203,49 @@ void ctkDICOMThumbnailListWidgetPrivate::onSeriesModelSelected(const QModelIndex
     }
 }
 
-void ctkDICOMThumbnailListWidgetPrivate::addThumbnailWidget(const QModelIndex& imageIndex, const QModelIndex& sourceIndex, const QString &text){
+void ctkDICOMThumbnailListWidgetPrivate::addThumbnailWidget(const QModelIndex& thumbnailIndex, const QModelIndex& sourceIndex, const QString &text){
     Q_Q(ctkDICOMThumbnailListWidget);
 
-    ctkDICOMModel* model = const_cast<ctkDICOMModel*>(qobject_cast<const ctkDICOMModel*>(imageIndex.model()));
+    ctkDICOMModel* model = const_cast<ctkDICOMModel*>(qobject_cast<const ctkDICOMModel*>(thumbnailIndex.model()));
 
     if(model)
     {
-        QModelIndex seriesIndex = imageIndex.parent();
-        QModelIndex studyIndex = seriesIndex.parent();
-
-        QString thumbnailPath = this->DatabaseDirectory +
-                                "/thumbs/" + model->data(studyIndex ,ctkDICOMModel::UIDRole).toString() + "/" +
-                                model->data(seriesIndex ,ctkDICOMModel::UIDRole).toString() + "/" +
-                                model->data(imageIndex, ctkDICOMModel::UIDRole).toString() + ".png";
-
         ctkThumbnailLabel* widget = new ctkThumbnailLabel(this->ScrollAreaContentWidget);
 
         QString widgetLabel = text;
         widget->setText( widgetLabel );
-        QPixmap pix(thumbnailPath);
-        logger.debug("Setting pixmap to " + thumbnailPath);
         if(this->ThumbnailSize.isValid()){
           widget->setFixedSize(this->ThumbnailSize);
         }
-        widget->setPixmap(pix);
+
+        if (this->ThumbnailService)
+        {
+            QString uid = model->data(thumbnailIndex, ctkDICOMModel::UIDRole).toString();
+            QImage thumbnail =
+              model->data(thumbnailIndex, ctkDICOMModel::TypeRole) == static_cast<int>(ctkDICOMModel::SeriesType) ?
+              this->ThumbnailService->seriesThumbnail(uid) : this->ThumbnailService->thumbnail(uid);
+            if (thumbnail.isNull())
+            {
+                this->PendingThumbnails[uid] = widget;
+            }
+            else
+            {
+                widget->setPixmap(QPixmap::fromImage(thumbnail));
+            }
+        }
+        else
+        {
+            QModelIndex seriesIndex = thumbnailIndex.parent();
+            QModelIndex studyIndex = seriesIndex.parent();
+
+            QString thumbnailPath = this->DatabaseDirectory +
+                                    "/thumbs/" + model->data(studyIndex ,ctkDICOMModel::UIDRole).toString() + "/" +
+                                    model->data(seriesIndex ,ctkDICOMModel::UIDRole).toString() + "/" +
+                                    model->data(thumbnailIndex, ctkDICOMModel::UIDRole).toString() + ".png";
+            QPixmap pix(thumbnailPath);
+            logger.debug("Setting pixmap to " + thumbnailPath);
+            widget->setPixmap(pix);
+        }
 
         QVariant var;
         var.setValue(QPersistentModelIndex(sourceIndex));
@@ -225,7 +266,16 @@ void ctkDICOMThumbnailListWidgetPrivate::addThumbnailWidget(const QModelIndex& i
 ctkDICOMThumbnailListWidget::ctkDICOMThumbnailListWidget(QWidget* _parent):
   Superclass(new ctkDICOMThumbnailListWidgetPrivate(this), _parent)
 {
-
+  Q_D(ctkDICOMThumbnailListWidget);
+  d->PriorityTimer = new QTimer(this);
+  d->PriorityTimer->setSingleShot(true);
+  d->PriorityTimer->setInterval(50);
+  connect(d->PriorityTimer, SIGNAL(timeout()),
+          this, SLOT(updateThumbnailPriorities()));
+  connect(d->ScrollArea->verticalScrollBar(), SIGNAL(valueChanged(int)),
+          d->PriorityTimer, SLOT(start()));
+  connect(d->ScrollArea->horizontalScrollBar(), SIGNAL(valueChanged(int)),
+          d->PriorityTimer, SLOT(start()));
 }
 
 //----------------------------------------------------------------------------
@@ -241,6 +291,71 @@ void ctkDICOMThumbnailListWidget::setDatabaseDirectory(const QString &directory)
     d->DatabaseDirectory = directory;
 }
 
+//----------------------------------------------------------------------------
+void ctkDICOMThumbnailListWidget::setThumbnailService(ctkDICOMThumbnailService* service){
+    Q_D(ctkDICOMThumbnailListWidget);
+
+    if (d->ThumbnailService)
+    {
+        disconnect(d->ThumbnailService, SIGNAL(thumbnailReady(QString,QImage)),
+                   this, SLOT(onThumbnailReady(QString,QImage)));
+    }
+    d->ThumbnailService = service;
+    d->PendingThumbnails.clear();
+    if (d->ThumbnailService)
+    {
+        connect(d->ThumbnailService, SIGNAL(thumbnailReady(QString,QImage)),
+                this, SLOT(onThumbnailReady(QString,QImage)));
+    }
+}
+
+//----------------------------------------------------------------------------
+void ctkDICOMThumbnailListWidget::onThumbnailReady(const QString& uid, const QImage& thumbnail){
+    Q_D(ctkDICOMThumbnailListWidget);
+
+    QPointer<ctkThumbnailLabel> widget = d->PendingThumbnails.take(uid);
+    if (widget && !thumbnail.isNull())
+    {
+        widget->setPixmap(QPixmap::fromImage(thumbnail));
+    }
+}
+
+//----------------------------------------------------------------------------
+void ctkDICOMThumbnailListWidget::updateThumbnailPriorities(){
+    Q_D(ctkDICOMThumbnailListWidget);
+
+    if (!d->ThumbnailService)
+    {
+        return;
+    }
+    QHash<QString, QPointer<ctkThumbnailLabel> >::iterator it = d->PendingThumbnails.begin();
+    while (it != d->PendingThumbnails.end())
+    {
+        if (it.value().isNull())
+        {
+            it = d->PendingThumbnails.erase(it);
+            continue;
+        }
+        const int visiblePriority = 1;
+        // the file of a pending request is already resolved, only the
+        // requests that were canceled are looked up in the database again
+        if (!it.value()->visibleRegion().isEmpty() &&
+            !d->ThumbnailService->setRequestPriority(it.key(), visiblePriority))
+        {
+            if (it.value()->property("sourceIndex").value<QPersistentModelIndex>().data(ctkDICOMModel::TypeRole) ==
+                static_cast<int>(ctkDICOMModel::ImageType))
+            {
+                d->ThumbnailService->thumbnail(it.key(), visiblePriority);
+            }
+            else
+            {
+                d->ThumbnailService->seriesThumbnail(it.key(), visiblePriority);
+            }
+        }
+        ++it;
+    }
+}
+
 //----------------------------------------------------------------------------
 void ctkDICOMThumbnailListWidget::selectThumbnailFromIndex(const QModelIndex &index){
     Q_D(ctkDICOMThumbnailListWidget);
@@ -280,6 +395,11 @@ void ctkDICOMThumbnailListWidget::onModelSelected(const QModelIndex &index){
     Q_D(ctkDICOMThumbnailListWidget);
 
     this->clearThumbnails();
+    d->PendingThumbnails.clear();
+    if (d->ThumbnailService)
+    {
+        d->ThumbnailService->cancelRequests();
+    }
 
     ctkDICOMModel* model = const_cast<ctkDICOMModel*>(qobject_cast<const ctkDICOMModel*>(index.model()));
 
@@ -304,4 +424,7 @@ void ctkDICOMThumbnailListWidget::onModelSelected(const QModelIndex &index){
     }
 
     this->setCurrentThumbnail(0);
+
+    // once the thumbnails are laid out
+    QTimer::singleShot(0, this, SLOT(updateThumbnailPriorities()));
 }
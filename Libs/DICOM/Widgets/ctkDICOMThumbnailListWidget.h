@@ -24,8 +24,10 @@
 #include "ctkDICOMWidgetsExport.h"
 #include "ctkThumbnailListWidget.h"
 
+class QImage;
 class QModelIndex;
 class ctkDICOMThumbnailListWidgetPrivate;
+class ctkDICOMThumbnailService;
 class ctkThumbnailWidget;
 
 /// \ingroup DICOM_Widgets
@@ -39,6 +41,11 @@ public:
 
   void setDatabaseDirectory(const QString& directory);
 
+  /// Get the thumbnails from @a service, asynchronously, instead of loading
+  /// the PNG files of the "thumbs" directory of the database. The visible
+  /// thumbnails are generated first.
+  void setThumbnailService(ctkDICOMThumbnailService* service);
+
   void selectThumbnailFromIndex(const QModelIndex& index);
 
 private:
@@ -47,6 +54,12 @@ private:
 
 public Q_SLOTS:
   void onModelSelected(const QModelIndex& index);
+
+protected Q_SLOTS:
+  void onThumbnailReady(const QString& uid, const QImage& thumbnail);
+  /// Raise the priority of the visible thumbnails not generated yet.
+  /// Called 50ms after the last scroll bar change.
+  void updateThumbnailPriorities();
 };
 
 #endif
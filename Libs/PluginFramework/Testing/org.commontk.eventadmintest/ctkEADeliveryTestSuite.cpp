@@ -0,0 +1,301 @@
+/*=============================================================================
+
+  Library: CTK
+
+  Copyright (c) German Cancer Research Center,
+    Division of Medical and Biological Informatics
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+
+
+
+#include "ctkEADeliveryTestSuite_p.h"
+
+#include <ctkPluginContext.h>
+#include <ctkServiceRegistration.h>
+
+#include <service/event/ctkEventAdmin.h>
+#include <service/event/ctkEventConstants.h>
+
+#include <QTest>
+#include <QTime>
+
+namespace {
+
+const int NumberOfHandlers = 20;
+const int NumberOfTopics = 5;
+const int NumberOfPostHandlers = 3;
+const int NumberOfPostedEvents = 1000;
+const int DeliveryTimeout = 30000; // ms
+
+}
+
+//----------------------------------------------------------------------------
+ctkEADeliveryTestHandler::ctkEADeliveryTestHandler()
+  : last(-1), ordered(true)
+{
+
+}
+
+//----------------------------------------------------------------------------
+void ctkEADeliveryTestHandler::handleEvent(const ctkEvent& event)
+{
+  received.ref();
+  QMutexLocker l(&mutex);
+  const int value = event.getProperty("delivery.value").toInt();
+  ordered = ordered && value > last;
+  last = value;
+}
+
+//----------------------------------------------------------------------------
+int ctkEADeliveryTestHandler::lastValue() const
+{
+  QMutexLocker l(&mutex);
+  return last;
+}
+
+//----------------------------------------------------------------------------
+bool ctkEADeliveryTestHandler::receivedInOrder() const
+{
+  QMutexLocker l(&mutex);
+  return ordered;
+}
+
+//----------------------------------------------------------------------------
+ctkEADeliveryTestSuite::ctkEADeliveryTestSuite(
+  ctkPluginContext* pc, long eventPluginId)
+  : context(pc), eventPluginId(eventPluginId), eventAdmin(0)
+{
+
+}
+
+//----------------------------------------------------------------------------
+void ctkEADeliveryTestSuite::init()
+{
+  context->getPlugin(eventPluginId)->start();
+  reference = context->getServiceReference<ctkEventAdmin>();
+  eventAdmin = context->getService<ctkEventAdmin>(reference);
+}
+
+//----------------------------------------------------------------------------
+void ctkEADeliveryTestSuite::cleanup()
+{
+  context->ungetService(reference);
+  context->getPlugin(eventPluginId)->stop();
+}
+
+//----------------------------------------------------------------------------
+void ctkEADeliveryTestSuite::testSendEvent_data()
+{
+  QTest::addColumn<bool>("useFilter");
+  QTest::addColumn<bool>("useWildcard");
+
+  QTest::newRow("topics") << false << false;
+  QTest::newRow("topics and wildcards") << false << true;
+  QTest::newRow("topics and filters") << true << false;
+}
+
+//----------------------------------------------------------------------------
+void ctkEADeliveryTestSuite::testSendEvent()
+{
+  QFETCH(bool, useFilter);
+  QFETCH(bool, useWildcard);
+
+  // Handler i listens to topic i % NumberOfTopics. With wildcards, every
+  // tenth handler listens to all the topics instead. With filters, every
+  // other handler only accepts the events of the even rounds.
+  QList<ctkEADeliveryTestHandler*> handlers;
+  QList<ctkServiceRegistration> registrations;
+  for (int i = 0; i < NumberOfHandlers; ++i)
+  {
+    ctkDictionary properties;
+    if (useWildcard && i % 10 == 0)
+    {
+      properties.insert(ctkEventConstants::EVENT_TOPIC, "org/commontk/delivery/*");
+    }
+    else
+    {
+      properties.insert(ctkEventConstants::EVENT_TOPIC,
+                        QString("org/commontk/delivery/topic%1").arg(i % NumberOfTopics));
+    }
+    if (useFilter && i % 2 == 0)
+    {
+      properties.insert(ctkEventConstants::EVENT_FILTER, "(delivery.even=true)");
+    }
+
+    ctkEADeliveryTestHandler* handler = new ctkEADeliveryTestHandler();
+    handlers.push_back(handler);
+    registrations.push_back(context->registerService<ctkEventHandler>(handler, properties));
+  }
+
+  for (int round = 0; round < 2; ++round)
+  {
+    for (int topic = 0; topic < NumberOfTopics; ++topic)
+    {
+      ctkDictionary properties;
+      properties.insert("delivery.even", round == 0);
+      eventAdmin->sendEvent(ctkEvent(QString("org/commontk/delivery/topic%1").arg(topic), properties));
+    }
+  }
+
+  // Each handler gets one event per round, except the filtered ones which
+  // only get the even round events.
+  QList<int> received;
+  foreach (ctkEADeliveryTestHandler* handler, handlers)
+  {
+    received.push_back(handler->received);
+  }
+  foreach (ctkServiceRegistration registration, registrations)
+  {
+    registration.unregister();
+  }
+  qDeleteAll(handlers);
+
+  for (int i = 0; i < NumberOfHandlers; ++i)
+  {
+    int expected = 2;
+    if (i % 10 == 0 && useWildcard)
+    {
+      expected = 2 * NumberOfTopics;
+    }
+    if (useFilter && i % 2 == 0)
+    {
+      expected /= 2;
+    }
+    QCOMPARE(received.at(i), expected);
+  }
+}
+
+//----------------------------------------------------------------------------
+void ctkEADeliveryTestSuite::testPostEvent_data()
+{
+  QTest::addColumn<bool>("coalesce");
+
+  QTest::newRow("ordered") << false;
+  QTest::newRow("latest value wins") << true;
+}
+
+//----------------------------------------------------------------------------
+void ctkEADeliveryTestSuite::testPostEvent()
+{
+  QFETCH(bool, coalesce);
+
+  QList<ctkEADeliveryTestHandler*> handlers;
+  QList<ctkServiceRegistration> registrations;
+  for (int i = 0; i < NumberOfPostHandlers; ++i)
+  {
+    ctkDictionary properties;
+    properties.insert(ctkEventConstants::EVENT_TOPIC, "org/commontk/delivery/post");
+    ctkEADeliveryTestHandler* handler = new ctkEADeliveryTestHandler();
+    handlers.push_back(handler);
+    registrations.push_back(context->registerService<ctkEventHandler>(handler, properties));
+  }
+
+  for (int i = 0; i < NumberOfPostedEvents; ++i)
+  {
+    ctkDictionary properties;
+    properties.insert("delivery.value", i);
+    if (coalesce)
+    {
+      properties.insert(ctkEventConstants::EVENT_COALESCE, true);
+    }
+    eventAdmin->postEvent(ctkEvent("org/commontk/delivery/post", properties));
+  }
+
+  // Whether coalesced or not, the last event is delivered to all handlers
+  QTime time;
+  time.start();
+  bool delivered = false;
+  while (!delivered && time.elapsed() < DeliveryTimeout)
+  {
+    delivered = true;
+    foreach (ctkEADeliveryTestHandler* handler, handlers)
+    {
+      delivered = delivered && handler->lastValue() == NumberOfPostedEvents - 1;
+    }
+    if (!delivered)
+    {
+      QTest::qWait(10);
+    }
+  }
+
+  bool ordered = true;
+  int received = 0;
+  foreach (ctkEADeliveryTestHandler* handler, handlers)
+  {
+    ordered = ordered && handler->receivedInOrder();
+    received += handler->received;
+  }
+  foreach (ctkServiceRegistration registration, registrations)
+  {
+    registration.unregister();
+  }
+  qDeleteAll(handlers);
+
+  QVERIFY2(delivered, "The last posted event was not delivered to all handlers");
+  QVERIFY2(ordered, "Events were not delivered in the order they were posted");
+  if (!coalesce)
+  {
+    QCOMPARE(received, NumberOfPostHandlers * NumberOfPostedEvents);
+  }
+}
+
+//----------------------------------------------------------------------------
+void ctkEADeliveryTestSuite::testCoalesceWithFilters()
+{
+  // Both handlers get the odd events, only the first one the even ones
+  ctkEADeliveryTestHandler evenHandler;
+  ctkEADeliveryTestHandler oddHandler;
+
+  ctkDictionary evenProperties;
+  evenProperties.insert(ctkEventConstants::EVENT_TOPIC, "org/commontk/delivery/filter");
+  evenProperties.insert(ctkEventConstants::EVENT_FILTER, "(delivery.even=true)");
+  ctkServiceRegistration evenRegistration =
+      context->registerService<ctkEventHandler>(&evenHandler, evenProperties);
+
+  ctkDictionary oddProperties;
+  oddProperties.insert(ctkEventConstants::EVENT_TOPIC, "org/commontk/delivery/filter");
+  oddProperties.insert(ctkEventConstants::EVENT_FILTER, "(delivery.even=false)");
+  ctkServiceRegistration oddRegistration =
+      context->registerService<ctkEventHandler>(&oddHandler, oddProperties);
+
+  // The last event is odd: the last even one must not be coalesced with it
+  for (int i = 0; i < NumberOfPostedEvents; ++i)
+  {
+    ctkDictionary properties;
+    properties.insert("delivery.value", i);
+    properties.insert("delivery.even", i % 2 == 0);
+    properties.insert(ctkEventConstants::EVENT_COALESCE, true);
+    eventAdmin->postEvent(ctkEvent("org/commontk/delivery/filter", properties));
+  }
+
+  QTime time;
+  time.start();
+  while ((evenHandler.lastValue() != NumberOfPostedEvents - 2 ||
+          oddHandler.lastValue() != NumberOfPostedEvents - 1) &&
+         time.elapsed() < DeliveryTimeout)
+  {
+    QTest::qWait(10);
+  }
+
+  evenRegistration.unregister();
+  oddRegistration.unregister();
+
+  QCOMPARE(evenHandler.lastValue(), NumberOfPostedEvents - 2);
+  QCOMPARE(oddHandler.lastValue(), NumberOfPostedEvents - 1);
+  QVERIFY(evenHandler.receivedInOrder());
+  QVERIFY(oddHandler.receivedInOrder());
+}
@@ -0,0 +1,107 @@
+/*=============================================================================
+
+  Library: CTK
+
+  Copyright (c) German Cancer Research Center,
+    Division of Medical and Biological Informatics
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+
+
+#ifndef CTKEADELIVERYTESTSUITE_P_H
+#define CTKEADELIVERYTESTSUITE_P_H
+
+#include <QObject>
+#include <QAtomicInt>
+#include <QMutex>
+
+#include <service/event/ctkEventHandler.h>
+#include <ctkServiceReference.h>
+#include <ctkTestSuiteInterface.h>
+
+class ctkPluginContext;
+struct ctkEventAdmin;
+
+class ctkEADeliveryTestHandler : public QObject, public ctkEventHandler
+{
+  Q_OBJECT
+  Q_INTERFACES(ctkEventHandler)
+
+private:
+
+  mutable QMutex mutex;
+  int last;
+  bool ordered;
+
+public:
+
+  QAtomicInt received;
+
+  ctkEADeliveryTestHandler();
+
+  void handleEvent(const ctkEvent& event);
+
+  // The value of the last event received, -1 if none
+  int lastValue() const;
+
+  // Whether the events were received in the order they were posted
+  bool receivedInOrder() const;
+};
+
+/**
+ * Checks which handlers get the sent and posted events, including the
+ * posted events marked with ctkEventConstants::EVENT_COALESCE. The timings
+ * are measured by ctkEAPerformanceTestSuite.
+ */
+class ctkEADeliveryTestSuite : public QObject,
+    public ctkTestSuiteInterface
+{
+  Q_OBJECT
+  Q_INTERFACES(ctkTestSuiteInterface)
+
+public:
+
+  ctkEADeliveryTestSuite(ctkPluginContext* pc, long eventPluginId);
+
+private Q_SLOTS:
+
+  void init();
+  void cleanup();
+
+  // Handlers subscribed to several topics, with or without wildcards and
+  // event filters, get exactly the events they subscribed to.
+  void testSendEvent_data();
+  void testSendEvent();
+
+  // All the posted events are delivered in order, or at least the last one
+  // if they are marked with EVENT_COALESCE.
+  void testPostEvent_data();
+  void testPostEvent();
+
+  // Two handlers of the same topic with different filters: each one gets
+  // the last marked event its filter matches, even if a newer marked event
+  // of the topic only matches the filter of the other handler.
+  void testCoalesceWithFilters();
+
+private:
+
+  ctkPluginContext* context;
+  long eventPluginId;
+  ctkEventAdmin* eventAdmin;
+  ctkServiceReference reference;
+};
+
+#endif // CTKEADELIVERYTESTSUITE_P_H
@@ -0,0 +1,370 @@
+/*=============================================================================
+
+  Library: CTK
+
+  Copyright (c) German Cancer Research Center,
+    Division of Medical and Biological Informatics
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+
+
+#include "ctkEAPerformanceTestSuite_p.h"
+
+#include <ctkPluginContext.h>
+
+#include <service/event/ctkEventAdmin.h>
+#include <service/event/ctkEventConstants.h>
+
+#include <QTest>
+#include <QTime>
+#include <QDebug>
+
+#include <algorithm>
+
+namespace {
+
+const int NumberOfHandlers = 1000;
+const int NumberOfTopics = 100;
+const int MinimumDuration = 1000; // ms
+
+const int NumberOfPostHandlers = 10;
+const int NumberOfPostedEvents = 20000;
+const int DeliveryTimeout = 30000; // ms
+
+// The clock of the latency measurements
+QTime postClock;
+
+int percentile(const QVector<int>& sorted, int p)
+{
+  return sorted.isEmpty() ? 0 : sorted.at((sorted.size() - 1) * p / 100);
+}
+
+}
+
+//----------------------------------------------------------------------------
+void ctkEAPerformanceTestHandler::handleEvent(const ctkEvent& /*event*/)
+{
+  received.ref();
+}
+
+//----------------------------------------------------------------------------
+ctkEAPerformanceTestLatencyHandler::ctkEAPerformanceTestLatencyHandler()
+  : last(-1), ordered(true)
+{
+  latencies.reserve(NumberOfPostedEvents);
+}
+
+//----------------------------------------------------------------------------
+void ctkEAPerformanceTestLatencyHandler::handleEvent(const ctkEvent& event)
+{
+  const int latency = postClock.elapsed() - event.getProperty("perf.sent").toInt();
+  QMutexLocker l(&mutex);
+  latencies.push_back(latency);
+  const int value = event.getProperty("perf.value").toInt();
+  ordered = ordered && value > last;
+  last = value;
+}
+
+//----------------------------------------------------------------------------
+int ctkEAPerformanceTestLatencyHandler::lastValue() const
+{
+  QMutexLocker l(&mutex);
+  return last;
+}
+
+//----------------------------------------------------------------------------
+bool ctkEAPerformanceTestLatencyHandler::receivedInOrder() const
+{
+  QMutexLocker l(&mutex);
+  return ordered;
+}
+
+//----------------------------------------------------------------------------
+QVector<int> ctkEAPerformanceTestLatencyHandler::takeLatencies()
+{
+  QMutexLocker l(&mutex);
+  QVector<int> result = latencies;
+  latencies.clear();
+  return result;
+}
+
+//----------------------------------------------------------------------------
+ctkEAPerformanceTestSuite::ctkEAPerformanceTestSuite(
+  ctkPluginContext* pc, long eventPluginId)
+  : context(pc), eventPluginId(eventPluginId), eventAdmin(0)
+{
+
+}
+
+//----------------------------------------------------------------------------
+void ctkEAPerformanceTestSuite::init()
+{
+  context->getPlugin(eventPluginId)->start();
+  reference = context->getServiceReference<ctkEventAdmin>();
+  eventAdmin = context->getService<ctkEventAdmin>(reference);
+}
+
+//----------------------------------------------------------------------------
+void ctkEAPerformanceTestSuite::cleanup()
+{
+  foreach (ctkServiceRegistration registration, registrations)
+  {
+    registration.unregister();
+  }
+  registrations.clear();
+  qDeleteAll(handlers);
+  handlers.clear();
+
+  context->ungetService(reference);
+  context->getPlugin(eventPluginId)->stop();
+}
+
+//----------------------------------------------------------------------------
+void ctkEAPerformanceTestSuite::testSendEvent_data()
+{
+  QTest::addColumn<bool>("useFilter");
+  QTest::addColumn<bool>("useWildcard");
+
+  QTest::newRow("topics") << false << false;
+  QTest::newRow("topics and wildcards") << false << true;
+  QTest::newRow("topics and filters") << true << false;
+}
+
+//----------------------------------------------------------------------------
+void ctkEAPerformanceTestSuite::testSendEvent()
+{
+  QFETCH(bool, useFilter);
+  QFETCH(bool, useWildcard);
+
+  // Handler i listens to topic i % NumberOfTopics. With wildcards, every
+  // tenth handler listens to all the topics instead. With filters, every
+  // other handler only accepts the events of the even rounds.
+  QTime time;
+  time.start();
+  for (int i = 0; i < NumberOfHandlers; ++i)
+  {
+    ctkDictionary properties;
+    if (useWildcard && i % 10 == 0)
+    {
+      properties.insert(ctkEventConstants::EVENT_TOPIC, "org/commontk/perf/*");
+    }
+    else
+    {
+      properties.insert(ctkEventConstants::EVENT_TOPIC,
+                        QString("org/commontk/perf/topic%1").arg(i % NumberOfTopics));
+    }
+    if (useFilter && i % 2 == 0)
+    {
+      properties.insert(ctkEventConstants::EVENT_FILTER, "(perf.even=true)");
+    }
+
+    ctkEAPerformanceTestHandler* handler = new ctkEAPerformanceTestHandler();
+    handlers.push_back(handler);
+    registrations.push_back(context->registerService<ctkEventHandler>(handler, properties));
+  }
+  qDebug() << "registered" << NumberOfHandlers << "handlers in" << time.elapsed() << "ms";
+
+  QList<ctkEvent> events;
+  for (int round = 0; round < 2; ++round)
+  {
+    for (int topic = 0; topic < NumberOfTopics; ++topic)
+    {
+      ctkDictionary properties;
+      properties.insert("perf.even", round == 0);
+      events.push_back(ctkEvent(QString("org/commontk/perf/topic%1").arg(topic), properties));
+    }
+  }
+
+  // Each handler gets one event per round, except the filtered ones which
+  // only get the even round events.
+  foreach (const ctkEvent& event, events)
+  {
+    eventAdmin->sendEvent(event);
+  }
+  const int wildcardHandlers = useWildcard ? NumberOfHandlers / 10 : 0;
+  for (int i = 0; i < NumberOfHandlers; ++i)
+  {
+    int expected = 2;
+    if (i % 10 == 0 && useWildcard)
+    {
+      expected = 2 * NumberOfTopics;
+    }
+    if (useFilter && i % 2 == 0)
+    {
+      expected /= 2;
+    }
+    QCOMPARE(int(handlers.at(i)->received), expected);
+  }
+
+  int sent = 0;
+  time.start();
+  int elapsed = 0;
+  do
+  {
+    eventAdmin->sendEvent(events.at(sent % events.size()));
+    ++sent;
+    elapsed = time.elapsed();
+  } while (elapsed < MinimumDuration);
+
+  qDebug() << QTest::currentDataTag() << ":" << sent * 1000.0 / elapsed << "events/sec with"
+           << NumberOfHandlers << "handlers," << NumberOfTopics << "topics and"
+           << wildcardHandlers << "wildcard handlers";
+}
+
+//----------------------------------------------------------------------------
+void ctkEAPerformanceTestSuite::testSendEventLatency_data()
+{
+  QTest::addColumn<int>("numberOfHandlers");
+
+  QTest::newRow("1 handler") << 1;
+  QTest::newRow("10 handlers") << 10;
+}
+
+//----------------------------------------------------------------------------
+void ctkEAPerformanceTestSuite::testSendEventLatency()
+{
+  QFETCH(int, numberOfHandlers);
+
+  for (int i = 0; i < numberOfHandlers; ++i)
+  {
+    ctkDictionary properties;
+    properties.insert(ctkEventConstants::EVENT_TOPIC, "org/commontk/perf/send");
+    ctkEAPerformanceTestHandler* handler = new ctkEAPerformanceTestHandler();
+    handlers.push_back(handler);
+    registrations.push_back(context->registerService<ctkEventHandler>(handler, properties));
+  }
+
+  const ctkEvent event("org/commontk/perf/send");
+  int sent = 0;
+  QTime time;
+  time.start();
+  int elapsed = 0;
+  do
+  {
+    eventAdmin->sendEvent(event);
+    ++sent;
+    elapsed = time.elapsed();
+  } while (elapsed < MinimumDuration);
+
+  // sendEvent returns once all the handlers were called
+  foreach (ctkEAPerformanceTestHandler* handler, handlers)
+  {
+    QCOMPARE(int(handler->received), sent);
+  }
+
+  qDebug() << QTest::currentDataTag() << ":" << elapsed * 1000.0 / sent
+           << "us per sendEvent," << sent * 1000.0 / elapsed << "events/sec";
+}
+
+//----------------------------------------------------------------------------
+void ctkEAPerformanceTestSuite::testPostEvent_data()
+{
+  QTest::addColumn<bool>("post");
+  QTest::addColumn<bool>("coalesce");
+
+  // The baseline delivers the same events with sendEvent() from the posting
+  // thread: the throughput of the handlers themselves, without queueing.
+  QTest::newRow("sendEvent baseline") << false << false;
+  QTest::newRow("ordered") << true << false;
+  QTest::newRow("latest value wins") << true << true;
+}
+
+//----------------------------------------------------------------------------
+void ctkEAPerformanceTestSuite::testPostEvent()
+{
+  QFETCH(bool, post);
+  QFETCH(bool, coalesce);
+
+  QList<ctkEAPerformanceTestLatencyHandler*> latencyHandlers;
+  QList<ctkServiceRegistration> latencyRegistrations;
+  for (int i = 0; i < NumberOfPostHandlers; ++i)
+  {
+    ctkDictionary properties;
+    properties.insert(ctkEventConstants::EVENT_TOPIC, "org/commontk/perf/post");
+    ctkEAPerformanceTestLatencyHandler* handler = new ctkEAPerformanceTestLatencyHandler();
+    latencyHandlers.push_back(handler);
+    latencyRegistrations.push_back(context->registerService<ctkEventHandler>(handler, properties));
+  }
+
+  postClock.start();
+  for (int i = 0; i < NumberOfPostedEvents; ++i)
+  {
+    ctkDictionary properties;
+    properties.insert("perf.value", i);
+    properties.insert("perf.sent", postClock.elapsed());
+    if (coalesce)
+    {
+      properties.insert(ctkEventConstants::EVENT_COALESCE, true);
+    }
+    if (post)
+    {
+      eventAdmin->postEvent(ctkEvent("org/commontk/perf/post", properties));
+    }
+    else
+    {
+      eventAdmin->sendEvent(ctkEvent("org/commontk/perf/post", properties));
+    }
+  }
+  const int postDuration = qMax(1, postClock.elapsed());
+
+  // Whether coalesced or not, the last event is delivered to all handlers
+  bool delivered = false;
+  while (!delivered && postClock.elapsed() < DeliveryTimeout)
+  {
+    delivered = true;
+    foreach (ctkEAPerformanceTestLatencyHandler* handler, latencyHandlers)
+    {
+      delivered = delivered && handler->lastValue() == NumberOfPostedEvents - 1;
+    }
+    if (!delivered)
+    {
+      QTest::qWait(10);
+    }
+  }
+  const int deliveryDuration = qMax(1, postClock.elapsed());
+
+  QVector<int> latencies;
+  bool ordered = true;
+  foreach (ctkEAPerformanceTestLatencyHandler* handler, latencyHandlers)
+  {
+    latencies += handler->takeLatencies();
+    ordered = ordered && handler->receivedInOrder();
+  }
+
+  foreach (ctkServiceRegistration registration, latencyRegistrations)
+  {
+    registration.unregister();
+  }
+  qDeleteAll(latencyHandlers);
+
+  QVERIFY2(delivered, "The last posted event was not delivered to all handlers");
+  QVERIFY2(ordered, "Events were not delivered in the order they were posted");
+  if (!coalesce)
+  {
+    QCOMPARE(latencies.size(), NumberOfPostHandlers * NumberOfPostedEvents);
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+  qDebug() << QTest::currentDataTag() << ":"
+           << NumberOfPostedEvents * 1000.0 / postDuration << (post ? "posts/sec," : "sends/sec,")
+           << latencies.size() * 1000.0 / deliveryDuration << "deliveries/sec,"
+           << latencies.size() << "of" << NumberOfPostHandlers * NumberOfPostedEvents
+           << "events delivered";
+  qDebug() << "latency (ms): p50" << percentile(latencies, 50)
+           << "p90" << percentile(latencies, 90)
+           << "p99" << percentile(latencies, 99)
+           << "max" << percentile(latencies, 100);
+}
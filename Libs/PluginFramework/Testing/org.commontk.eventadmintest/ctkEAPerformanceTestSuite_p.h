@@ -0,0 +1,127 @@
+/*=============================================================================
+
+  Library: CTK
+
+  Copyright (c) German Cancer Research Center,
+    Division of Medical and Biological Informatics
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+
+
+#ifndef CTKEAPERFORMANCETESTSUITE_P_H
+#define CTKEAPERFORMANCETESTSUITE_P_H
+
+#include <QObject>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QVector>
+
+#include <service/event/ctkEventHandler.h>
+#include <ctkServiceReference.h>
+#include <ctkServiceRegistration.h>
+#include <ctkTestSuiteInterface.h>
+
+class ctkPluginContext;
+struct ctkEventAdmin;
+
+class ctkEAPerformanceTestHandler : public QObject, public ctkEventHandler
+{
+  Q_OBJECT
+  Q_INTERFACES(ctkEventHandler)
+
+public:
+
+  QAtomicInt received;
+
+  void handleEvent(const ctkEvent& event);
+};
+
+class ctkEAPerformanceTestLatencyHandler : public QObject, public ctkEventHandler
+{
+  Q_OBJECT
+  Q_INTERFACES(ctkEventHandler)
+
+private:
+
+  mutable QMutex mutex;
+  QVector<int> latencies;
+  int last;
+  bool ordered;
+
+public:
+
+  ctkEAPerformanceTestLatencyHandler();
+
+  void handleEvent(const ctkEvent& event);
+
+  // The value of the last event received, -1 if none
+  int lastValue() const;
+
+  // Whether the events were received in the order they were posted
+  bool receivedInOrder() const;
+
+  // The delivery latencies in ms
+  QVector<int> takeLatencies();
+};
+
+/**
+ * Benchmarks of the event delivery, only registered if the environment
+ * variable CTK_PERFORMANCE_TESTS is set. The delivery itself is checked by
+ * ctkEADeliveryTestSuite.
+ */
+class ctkEAPerformanceTestSuite : public QObject,
+    public ctkTestSuiteInterface
+{
+  Q_OBJECT
+  Q_INTERFACES(ctkTestSuiteInterface)
+
+public:
+
+  ctkEAPerformanceTestSuite(ctkPluginContext* pc, long eventPluginId);
+
+private Q_SLOTS:
+
+  void init();
+  void cleanup();
+
+  // Measures the number of events per second sent to 1000 handlers
+  // subscribed to 100 topics, with or without event filters.
+  void testSendEvent_data();
+  void testSendEvent();
+
+  // Measures the time a sendEvent call takes with 1 or 10 handlers doing
+  // nothing, i.e. the overhead of the synchronous delivery.
+  void testSendEventLatency_data();
+  void testSendEventLatency();
+
+  // Measures the number of events per second posted to 10 handlers and
+  // the delivery latency percentiles, with or without coalescing, compared
+  // with sending the same events synchronously.
+  void testPostEvent_data();
+  void testPostEvent();
+
+private:
+
+  ctkPluginContext* context;
+  long eventPluginId;
+  ctkEventAdmin* eventAdmin;
+  ctkServiceReference reference;
+
+  QList<ctkEAPerformanceTestHandler*> handlers;
+  QList<ctkServiceRegistration> registrations;
+};
+
+#endif // CTKEAPERFORMANCETESTSUITE_P_H
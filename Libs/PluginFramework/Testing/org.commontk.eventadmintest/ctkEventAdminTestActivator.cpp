@@ -32,11 +32,15 @@
 #include "ctkEAScenario2TestSuite_p.h"
 #include "ctkEAScenario3TestSuite_p.h"
 #include "ctkEAScenario4TestSuite_p.h"
+#include "ctkEADeliveryTestSuite_p.h"
+#include "ctkEAPerformanceTestSuite_p.h"
 
 //----------------------------------------------------------------------------
 ctkEventAdminTestActivator::ctkEventAdminTestActivator()
   : topicWildcardTestSuite(0), topicWildcardTestSuiteSS(0),
-    scenario1TestSuite(0), scenario1TestSuiteSS(0), scenario2TestSuite(0)
+    scenario1TestSuite(0), scenario1TestSuiteSS(0), scenario2TestSuite(0),
+    scenario3TestSuite(0), scenario4TestSuite(0), deliveryTestSuite(0),
+    performanceTestSuite(0)
 {
 
 }
@@ -49,6 +53,10 @@ ctkEventAdminTestActivator::~ctkEventAdminTestActivator()
   delete scenario1TestSuite;
   delete scenario1TestSuiteSS;
   delete scenario2TestSuite;
+  delete scenario3TestSuite;
+  delete scenario4TestSuite;
+  delete deliveryTestSuite;
+  delete performanceTestSuite;
 }
 
 //----------------------------------------------------------------------------
@@ -98,6 +106,16 @@ void ctkEventAdminTestActivator::start(ctkPluginContext* context)
 
   scenario4TestSuite = new ctkEAScenario4TestSuite(context, eventPluginId);
   context->registerService<ctkTestSuiteInterface>(scenario4TestSuite);
+
+  deliveryTestSuite = new ctkEADeliveryTestSuite(context, eventPluginId);
+  context->registerService<ctkTestSuiteInterface>(deliveryTestSuite);
+
+  // The benchmarks take a while, they only run if CTK_PERFORMANCE_TESTS is set
+  if (!qgetenv("CTK_PERFORMANCE_TESTS").isEmpty())
+  {
+    performanceTestSuite = new ctkEAPerformanceTestSuite(context, eventPluginId);
+    context->registerService<ctkTestSuiteInterface>(performanceTestSuite);
+  }
 }
 
 //----------------------------------------------------------------------------
@@ -112,6 +130,8 @@ void ctkEventAdminTestActivator::stop(ctkPluginContext* context)
   delete scenario2TestSuite;
   delete scenario3TestSuite;
   delete scenario4TestSuite;
+  delete deliveryTestSuite;
+  delete performanceTestSuite;
 
   topicWildcardTestSuite = 0;
   topicWildcardTestSuiteSS = 0;
@@ -120,6 +140,8 @@ void ctkEventAdminTestActivator::stop(ctkPluginContext* context)
   scenario2TestSuite = 0;
   scenario3TestSuite = 0;
   scenario4TestSuite = 0;
+  deliveryTestSuite = 0;
+  performanceTestSuite = 0;
 }
 
 Q_EXPORT_PLUGIN2(org_commontk_eventadmintest, ctkEventAdminTestActivator)
@@ -49,6 +49,8 @@ private:
   QObject* scenario2TestSuite;
   QObject* scenario3TestSuite;
   QObject* scenario4TestSuite;
+  QObject* deliveryTestSuite;
+  QObject* performanceTestSuite;
 };
 
 #endif // CTKEVENTADMINTESTACTIVATOR_H
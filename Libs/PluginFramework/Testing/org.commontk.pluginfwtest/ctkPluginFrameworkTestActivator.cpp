@@ -23,6 +23,7 @@
 
 #include "ctkPluginFrameworkTestSuite_p.h"
 #include "ctkServiceListenerTestSuite_p.h"
+#include "ctkServiceRegistryPerfTestSuite_p.h"
 #include "ctkServiceTrackerTestSuite_p.h"
 
 #include <ctkPluginContext.h>
@@ -50,6 +51,16 @@ void ctkPluginFrameworkTestActivator::start(ctkPluginContext* context)
   props.clear();
   props.insert(ctkPluginConstants::SERVICE_PID, serviceTrackerTestSuite->metaObject()->className());
   context->registerService<ctkTestSuiteInterface>(serviceTrackerTestSuite, props);
+
+  // The benchmarks take a while, they only run if CTK_PERFORMANCE_TESTS is set
+  serviceRegistryPerfTestSuite = 0;
+  if (!qgetenv("CTK_PERFORMANCE_TESTS").isEmpty())
+  {
+    serviceRegistryPerfTestSuite = new ctkServiceRegistryPerfTestSuite(context);
+    props.clear();
+    props.insert(ctkPluginConstants::SERVICE_PID, serviceRegistryPerfTestSuite->metaObject()->className());
+    context->registerService<ctkTestSuiteInterface>(serviceRegistryPerfTestSuite, props);
+  }
 }
 
 //----------------------------------------------------------------------------
@@ -60,6 +71,7 @@ void ctkPluginFrameworkTestActivator::stop(ctkPluginContext* context)
   delete frameworkTestSuite;
   delete serviceListenerTestSuite;
   delete serviceTrackerTestSuite;
+  delete serviceRegistryPerfTestSuite;
 }
 
 Q_EXPORT_PLUGIN2(org_commontk_pluginfwtest, ctkPluginFrameworkTestActivator)
@@ -42,6 +42,7 @@ private:
   QObject* frameworkTestSuite;
   QObject* serviceListenerTestSuite;
   QObject* serviceTrackerTestSuite;
+  QObject* serviceRegistryPerfTestSuite;
 };
 
 #endif // CTKPLUGINFRAMEWORKTESTACTIVATOR_H
@@ -316,6 +316,71 @@ void ctkServiceListenerTestSuite::frameSL25a()
   }
 }
 
+//----------------------------------------------------------------------------
+void ctkServiceListenerTestSuite::testServiceEventBatch()
+{
+  ctkServiceListener sListen(pc, false);
+  pc->connectServiceListener(&sListen, "serviceChanged", "(sltest.batch=*)");
+
+  QObject service;
+  QList<ctkServiceRegistration> srs;
+  pc->beginServiceEventBatch();
+  for (int i = 0; i < 10; ++i)
+  {
+    ctkDictionary props;
+    props.insert("sltest.batch", i);
+    ctkServiceRegistration sr = pc->registerService("QObject", &service, props);
+    props.insert("sltest.modified", true);
+    sr.setProperties(props);
+    sr.setProperties(props);
+    srs.push_back(sr);
+  }
+  srs.takeFirst().unregister();
+  srs.takeFirst().unregister();
+
+  // Only the UNREGISTERING events are delivered during the batch
+  QList<ctkServiceEvent::Type> expectedServiceEventTypes;
+  expectedServiceEventTypes << ctkServiceEvent::UNREGISTERING;
+  expectedServiceEventTypes << ctkServiceEvent::UNREGISTERING;
+  QVERIFY(sListen.checkEvents(expectedServiceEventTypes));
+  pc->endServiceEventBatch();
+
+  // The registrations and modifications of each service
+  // are coalesced into one REGISTERED event
+  for (int i = 0; i < srs.size(); ++i)
+  {
+    expectedServiceEventTypes << ctkServiceEvent::REGISTERED;
+  }
+  QVERIFY(sListen.checkEvents(expectedServiceEventTypes));
+
+  // Modifications of already registered services
+  sListen.clearEvents();
+  pc->beginServiceEventBatch();
+  foreach (ctkServiceRegistration sr, srs)
+  {
+    ctkDictionary props;
+    props.insert("sltest.batch", -1);
+    sr.setProperties(props);
+    sr.setProperties(ctkDictionary());
+  }
+  QVERIFY(sListen.events.isEmpty());
+  pc->endServiceEventBatch();
+
+  expectedServiceEventTypes.clear();
+  for (int i = 0; i < srs.size(); ++i)
+  {
+    expectedServiceEventTypes << ctkServiceEvent::MODIFIED_ENDMATCH;
+  }
+  QVERIFY(sListen.checkEvents(expectedServiceEventTypes));
+
+  foreach (ctkServiceRegistration sr, srs)
+  {
+    sr.unregister();
+  }
+  pc->disconnectServiceListener(&sListen, "serviceChanged");
+  QVERIFY(sListen.teststatus);
+}
+
 //----------------------------------------------------------------------------
 bool ctkServiceListenerTestSuite::runStartStopTest(
   const QString& tcName, int cnt, QSharedPointer<ctkPlugin> targetPlugin,
@@ -63,6 +63,10 @@ private Q_SLOTS:
 //    void frameSL20a();
     void frameSL25a();
 
+    // Checks that the service events of a batch are
+    // coalesced and delivered when the batch ends.
+    void testServiceEventBatch();
+
 private:
 
     ctkPluginContext* pc;
@@ -0,0 +1,255 @@
+/*=============================================================================
+
+  Library: CTK
+
+  Copyright (c) German Cancer Research Center,
+    Division of Medical and Biological Informatics
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+
+#include "ctkServiceRegistryPerfTestSuite_p.h"
+
+#include <ctkPluginContext.h>
+#include <ctkVersion.h>
+
+#include <QTest>
+#include <QTime>
+
+namespace {
+
+const int NumberOfServices = 10000;
+const int MinimumDuration = 1000; // ms
+
+}
+
+//----------------------------------------------------------------------------
+ctkServiceRegistryPerfTestSuite::ctkServiceRegistryPerfTestSuite(ctkPluginContext* pc)
+  : pc(pc)
+{
+}
+
+//----------------------------------------------------------------------------
+void ctkServiceRegistryPerfTestSuite::initTestCase()
+{
+  QTime time;
+  time.start();
+  for (int i = 0; i < NumberOfServices; ++i)
+  {
+    ctkDictionary props;
+    props.insert("perftest.index", i);
+    props.insert("perftest.group", QString("group%1").arg(i % 100));
+    props.insert("perftest.enabled", i % 2 == 0);
+    props.insert("perftest.version", QVariant::fromValue(ctkVersion(1, i % 10, 0)));
+
+    QObject* service = new QObject();
+    serviceObjects.push_back(service);
+    registrations.push_back(pc->registerService("QObject", service, props));
+  }
+  qDebug() << "registered" << NumberOfServices << "services in" << time.elapsed() << "ms";
+}
+
+//----------------------------------------------------------------------------
+void ctkServiceRegistryPerfTestSuite::cleanupTestCase()
+{
+  foreach (ctkServiceRegistration sr, registrations)
+  {
+    sr.unregister();
+  }
+  registrations.clear();
+  qDeleteAll(serviceObjects);
+  serviceObjects.clear();
+}
+
+//----------------------------------------------------------------------------
+void ctkServiceRegistryPerfTestSuite::testLookups_data()
+{
+  QTest::addColumn<QString>("clazz");
+  QTest::addColumn<QString>("filter");
+  QTest::addColumn<int>("expectedCount");
+
+  QTest::newRow("class only") << "QObject" << QString() << NumberOfServices;
+  QTest::newRow("string") << "QObject" << "(perftest.group=group42)" << 100;
+  QTest::newRow("substring") << "QObject"
+    << "(&(perftest.group=group*)(!(perftest.index<=9989)))" << 10;
+  // integers are compared as integers, not as strings
+  QTest::newRow("integer") << "QObject" << "(perftest.index>=9900)" << 100;
+  QTest::newRow("boolean") << "QObject"
+    << "(&(perftest.enabled=true)(perftest.index<=99))" << 50;
+  QTest::newRow("version") << "QObject" << "(perftest.version>=1.9.0)" << 1000;
+  QTest::newRow("objectclass") << QString()
+    << "(&(objectclass=QObject)(perftest.index=5))" << 1;
+  QTest::newRow("no match") << "QObject" << "(perftest.group=none)" << 0;
+}
+
+//----------------------------------------------------------------------------
+void ctkServiceRegistryPerfTestSuite::testLookups()
+{
+  QFETCH(QString, clazz);
+  QFETCH(QString, filter);
+  QFETCH(int, expectedCount);
+
+  QCOMPARE(pc->getServiceReferences(clazz, filter).size(), expectedCount);
+
+  int lookups = 0;
+  QTime time;
+  time.start();
+  int elapsed = 0;
+  do
+  {
+    pc->getServiceReferences(clazz, filter);
+    ++lookups;
+    elapsed = time.elapsed();
+  } while (elapsed < MinimumDuration);
+
+  qDebug() << filter << ":" << lookups * 1000.0 / elapsed << "lookups/sec with"
+           << NumberOfServices << "services";
+}
+
+//----------------------------------------------------------------------------
+void ctkServiceRegistryPerfTestSuite::testConcurrentLookups_data()
+{
+  QTest::addColumn<int>("threads");
+
+  QTest::newRow("1 thread") << 1;
+  QTest::newRow("2 threads") << 2;
+  QTest::newRow("4 threads") << 4;
+  QTest::newRow("8 threads") << 8;
+}
+
+//----------------------------------------------------------------------------
+void ctkServiceRegistryPerfTestSuite::testConcurrentLookups()
+{
+  QFETCH(int, threads);
+
+  QList<ctkServiceRegistryPerfTestWorker*> workers;
+  for (int i = 0; i < threads; ++i)
+  {
+    workers.push_back(new ctkServiceRegistryPerfTestWorker(
+                        pc, "(perftest.group=group42)", 100, MinimumDuration));
+  }
+
+  QTime time;
+  time.start();
+  foreach (ctkServiceRegistryPerfTestWorker* worker, workers)
+  {
+    worker->start();
+  }
+
+  // Lookups must not be blocked by modifications of the registry
+  int modifications = 0;
+  QObject service;
+  while (time.elapsed() < MinimumDuration)
+  {
+    ctkDictionary props;
+    props.insert("perftest.group", "modified");
+    ctkServiceRegistration sr = pc->registerService("QObject", &service, props);
+    props.insert("perftest.index", -1);
+    sr.setProperties(props);
+    sr.unregister();
+    ++modifications;
+  }
+
+  int lookups = 0;
+  bool success = true;
+  foreach (ctkServiceRegistryPerfTestWorker* worker, workers)
+  {
+    worker->wait();
+    lookups += worker->lookups;
+    success = success && worker->success;
+  }
+  const int elapsed = time.elapsed();
+  qDeleteAll(workers);
+
+  QVERIFY2(success, "Lookups returned a wrong number of services");
+  qDebug() << threads << "threads:" << lookups * 1000.0 / elapsed << "lookups/sec,"
+           << modifications * 1000.0 / elapsed << "modifications/sec";
+}
+
+//----------------------------------------------------------------------------
+void ctkServiceRegistryPerfTestSuite::testServiceListenerDispatch()
+{
+  const int numberOfListeners = 300;
+  const int servicesPerListener = 10;
+
+  QList<ctkServiceRegistryPerfTestListener*> listeners;
+  for (int i = 0; i < numberOfListeners; ++i)
+  {
+    ctkServiceRegistryPerfTestListener* listener = new ctkServiceRegistryPerfTestListener();
+    listeners.push_back(listener);
+    pc->connectServiceListener(listener, "serviceChanged",
+      QString("(&(objectclass=QObject)(perftest.listener=%1)(perftest.enabled=true))").arg(i));
+  }
+
+  QObject service;
+  QList<ctkServiceRegistration> srs;
+  QTime time;
+  time.start();
+  for (int i = 0; i < numberOfListeners * servicesPerListener; ++i)
+  {
+    ctkDictionary props;
+    props.insert("perftest.listener", i % numberOfListeners);
+    props.insert("perftest.enabled", true);
+    srs.push_back(pc->registerService("QObject", &service, props));
+  }
+  const int registerElapsed = time.elapsed();
+  time.restart();
+  foreach (ctkServiceRegistration sr, srs)
+  {
+    sr.unregister();
+  }
+  const int unregisterElapsed = time.elapsed();
+
+  foreach (ctkServiceRegistryPerfTestListener* listener, listeners)
+  {
+    QCOMPARE(listener->events.count(ctkServiceEvent::REGISTERED), servicesPerListener);
+    QCOMPARE(listener->events.count(ctkServiceEvent::UNREGISTERING), servicesPerListener);
+    pc->disconnectServiceListener(listener, "serviceChanged");
+  }
+  qDeleteAll(listeners);
+
+  qDebug() << srs.size() << "services registered in" << registerElapsed
+           << "ms and unregistered in" << unregisterElapsed << "ms with"
+           << numberOfListeners << "service listeners";
+}
+
+//----------------------------------------------------------------------------
+void ctkServiceRegistryPerfTestListener::serviceChanged(const ctkServiceEvent& event)
+{
+  events.push_back(event.getType());
+}
+
+//----------------------------------------------------------------------------
+ctkServiceRegistryPerfTestWorker::ctkServiceRegistryPerfTestWorker(
+  ctkPluginContext* pc, const QString& filter, int expectedCount, int duration)
+  : lookups(0), success(true), pc(pc), filter(filter),
+    expectedCount(expectedCount), duration(duration)
+{
+}
+
+//----------------------------------------------------------------------------
+void ctkServiceRegistryPerfTestWorker::run()
+{
+  QTime time;
+  time.start();
+  while (time.elapsed() < duration)
+  {
+    if (pc->getServiceReferences("QObject", filter).size() != expectedCount)
+    {
+      success = false;
+    }
+    ++lookups;
+  }
+}
@@ -0,0 +1,120 @@
+/*=============================================================================
+
+  Library: CTK
+
+  Copyright (c) German Cancer Research Center,
+    Division of Medical and Biological Informatics
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+
+#ifndef CTKSERVICEREGISTRYPERFTESTSUITE_P_H
+#define CTKSERVICEREGISTRYPERFTESTSUITE_P_H
+
+#include <QObject>
+#include <QList>
+#include <QThread>
+
+#include <ctkTestSuiteInterface.h>
+#include <ctkServiceEvent.h>
+#include <ctkServiceRegistration.h>
+
+class ctkPluginContext;
+
+/**
+ * Benchmarks of the service registry, only registered if the environment
+ * variable CTK_PERFORMANCE_TESTS is set. The event batches are checked by
+ * ctkServiceListenerTestSuite.
+ */
+class ctkServiceRegistryPerfTestSuite : public QObject,
+    public ctkTestSuiteInterface
+{
+  Q_OBJECT
+  Q_INTERFACES(ctkTestSuiteInterface)
+
+public:
+    ctkServiceRegistryPerfTestSuite(ctkPluginContext* pc);
+
+private Q_SLOTS:
+
+    // Registers the services looked up by the test functions
+    void initTestCase();
+    void cleanupTestCase();
+
+    // test functions
+
+    // Measures the number of filtered service lookups per second
+    // in a registry holding many services.
+    void testLookups_data();
+    void testLookups();
+
+    // Measures the lookup throughput of several threads doing lookups
+    // concurrently, while another thread modifies the registry.
+    void testConcurrentLookups_data();
+    void testConcurrentLookups();
+
+    // Measures the dispatching of service events to many service
+    // listeners with compound filters.
+    void testServiceListenerDispatch();
+
+private:
+
+    ctkPluginContext* pc;
+
+    QList<QObject*> serviceObjects;
+    QList<ctkServiceRegistration> registrations;
+
+};
+
+class ctkServiceRegistryPerfTestListener : public QObject
+{
+  Q_OBJECT
+
+public:
+
+  QList<ctkServiceEvent::Type> events;
+
+public Q_SLOTS:
+
+  void serviceChanged(const ctkServiceEvent& event);
+
+};
+
+class ctkServiceRegistryPerfTestWorker : public QThread
+{
+  Q_OBJECT
+
+public:
+
+  ctkServiceRegistryPerfTestWorker(ctkPluginContext* pc, const QString& filter,
+                                   int expectedCount, int duration);
+
+  int lookups;
+  bool success;
+
+protected:
+
+  void run();
+
+private:
+
+  ctkPluginContext* pc;
+  QString filter;
+  int expectedCount;
+  int duration;
+
+};
+
+#endif // CTKSERVICEREGISTRYPERFTESTSUITE_P_H
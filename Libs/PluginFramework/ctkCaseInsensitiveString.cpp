@@ -57,7 +57,22 @@ ctkCaseInsensitiveString& ctkCaseInsensitiveString::operator=(const ctkCaseInsen
 //----------------------------------------------------------------------------
 bool ctkCaseInsensitiveString::operator==(const ctkCaseInsensitiveString& str) const
 {
-  return this->str.toLower() == str.str.toLower();
+  // Compare in place, this is called for each lookup in a ctkDictionary
+  const int size = this->str.size();
+  if (size != str.str.size())
+  {
+    return false;
+  }
+  const QChar* c1 = this->str.constData();
+  const QChar* c2 = str.str.constData();
+  for (int i = 0; i < size; ++i)
+  {
+    if (c1[i] != c2[i] && c1[i].toLower() != c2[i].toLower())
+    {
+      return false;
+    }
+  }
+  return true;
 }
 
 //----------------------------------------------------------------------------
@@ -75,7 +90,18 @@ ctkCaseInsensitiveString::operator QString() const
 //----------------------------------------------------------------------------
 uint qHash(const ctkCaseInsensitiveString& str)
 {
-  return qHash(QString(str).toLower());
+  // Same hash function as qHash(const QString&) on the lower case
+  // characters, without allocating a lower case copy
+  const QString s = str;
+  const QChar* c = s.constData();
+  uint h = 0;
+  for (int i = 0; i < s.size(); ++i)
+  {
+    h = (h << 4) + c[i].toLower().unicode();
+    h ^= (h & 0xf0000000) >> 23;
+    h &= 0x0fffffff;
+  }
+  return h;
 }
 
 //----------------------------------------------------------------------------
@@ -21,6 +21,8 @@ limitations under the License.
 
 #include "ctkLDAPExpr_p.h"
 
+#include "ctkVersion.h"
+
 #include <ctkException.h>
 
 #include <QSet>
@@ -106,13 +108,35 @@ public:
   ctkLDAPExprData( int op, QString attrName, QString attrValue )
     : m_operator(op), m_attrName(attrName), m_attrValue(attrValue)
   {
+    compile();
   }
 
-  ctkLDAPExprData( const ctkLDAPExprData& other )
-    : QSharedData(other), m_operator(other.m_operator),
-    m_args(other.m_args), m_attrName(other.m_attrName),
-    m_attrValue(other.m_attrValue)
+  //! Pre-compute what the evaluation of a simple expression needs
+  void compile()
   {
+    m_key = m_attrName.toLower();
+    m_wildcard = m_attrValue.indexOf(ctkLDAPExpr::WILDCARD) >= 0;
+    m_presence = m_operator == ctkLDAPExpr::EQ &&
+                 m_attrValue == ctkLDAPExpr::WILDCARD_QString;
+    if (m_operator == ctkLDAPExpr::APPROX)
+    {
+      m_approxValue = ctkLDAPExpr::fixupString(m_attrValue);
+    }
+
+    QString trimmed = m_attrValue.trimmed();
+    m_boolValid = !trimmed.compare("true", Qt::CaseInsensitive) ||
+                  !trimmed.compare("false", Qt::CaseInsensitive);
+    m_boolValue = !trimmed.compare("true", Qt::CaseInsensitive);
+    m_longValue = trimmed.toLongLong(&m_longValid);
+    m_doubleValue = trimmed.toDouble(&m_doubleValid);
+    try
+    {
+      m_versionValue = QVariant::fromValue(ctkVersion::parseVersion(trimmed));
+    }
+    catch (const ctkInvalidArgumentException&)
+    {
+      m_versionValue = QVariant();
+    }
   }
 
   //!
@@ -123,6 +147,25 @@ public:
   QString m_attrName;
   //!
   QString m_attrValue;
+
+  // Compiled simple expression, see compile()
+
+  //! Lower case attribute name
+  QString m_key;
+  //! The value contains wildcards
+  bool m_wildcard;
+  //! (name=*)
+  bool m_presence;
+  //! fixupString(m_attrValue) for APPROX
+  QString m_approxValue;
+  //! m_attrValue parsed for comparisons with properties of these types
+  bool m_boolValid;
+  bool m_boolValue;
+  bool m_longValid;
+  qlonglong m_longValue;
+  bool m_doubleValid;
+  double m_doubleValue;
+  QVariant m_versionValue;
 };
 
 //----------------------------------------------------------------------------
@@ -189,7 +232,7 @@ bool ctkLDAPExpr::getMatchedObjectClasses(QSet<QString>& objClasses) const
 {
   if (d->m_operator == EQ)
   {
-    if (d->m_attrName.compare(ctkPluginConstants::OBJECTCLASS, Qt::CaseInsensitive) &&
+    if (d->m_attrName.compare(ctkPluginConstants::OBJECTCLASS, Qt::CaseInsensitive) == 0 &&
       d->m_attrValue.indexOf(WILDCARD) < 0) 
     {
       objClasses.insert( d->m_attrValue );
@@ -268,6 +311,65 @@ bool ctkLDAPExpr::isSimple(
   return false;
 }
 
+//----------------------------------------------------------------------------
+bool ctkLDAPExpr::getIndexTerms(IndexTerms& terms) const
+{
+  if ((d->m_operator & SIMPLE) != 0)
+  {
+    if (d->m_operator == EQ && !d->m_wildcard)
+    {
+      terms.equalities.insert(d->m_key, d->m_attrValue);
+      // Booleans and integers are compared by value
+      if (d->m_boolValid)
+      {
+        terms.equalities.insert(d->m_key, d->m_boolValue ? "true" : "false");
+      }
+      if (d->m_longValid)
+      {
+        terms.equalities.insert(d->m_key, QString::number(d->m_longValue));
+      }
+    }
+    else
+    {
+      terms.presences.insert(d->m_key);
+    }
+    return true;
+  }
+  else if (d->m_operator == OR)
+  {
+    for (int i = 0; i < d->m_args.size(); i++)
+    {
+      if (!d->m_args[i].getIndexTerms(terms))
+        return false;
+    }
+    return true;
+  }
+  else if (d->m_operator == AND)
+  {
+    // Prefer equalities, as few as possible
+    IndexTerms best;
+    int bestScore = -1;
+    for (int i = 0; i < d->m_args.size(); i++)
+    {
+      IndexTerms argTerms;
+      if (!d->m_args[i].getIndexTerms(argTerms))
+        continue;
+      int score = argTerms.equalities.size() + 1000 * argTerms.presences.size();
+      if (bestScore < 0 || score < bestScore)
+      {
+        best = argTerms;
+        bestScore = score;
+      }
+    }
+    if (bestScore < 0)
+      return false;
+    terms.equalities += best.equalities;
+    terms.presences += best.presences;
+    return true;
+  }
+  return false;
+}
+
 //----------------------------------------------------------------------------
 bool ctkLDAPExpr::isNull() const
 {
@@ -283,9 +385,10 @@ bool ctkLDAPExpr::query( const QString &filter, const ctkDictionary &pd )
 //----------------------------------------------------------------------------
 bool ctkLDAPExpr::evaluate( const ctkDictionary &p, bool matchCase ) const
 {
+  Q_UNUSED(matchCase) // the keys of ctkDictionary are case insensitive
   if ((d->m_operator & SIMPLE) != 0) {
-    return compare(p[ matchCase ? d->m_attrName : d->m_attrName.toLower() ],
-      d->m_operator, d->m_attrValue);
+    ctkDictionary::const_iterator it = p.find(d->m_key);
+    return it != p.end() && compare(it.value());
   } else { // (d->m_operator & COMPLEX) != 0
     switch (d->m_operator) {
     case AND:
@@ -309,90 +412,116 @@ bool ctkLDAPExpr::evaluate( const ctkDictionary &p, bool matchCase ) const
 }
 
 //----------------------------------------------------------------------------
-bool ctkLDAPExpr::compare( const QVariant &obj, int op, const QString &s ) const
+bool ctkLDAPExpr::compare( const QVariant &obj ) const
 {
   if (obj.isNull())
     return false;
-  if (op == EQ && s == WILDCARD_QString )
+  if (d->m_presence)
     return true;
-  try {
-    if ( obj.canConvert<QString>( ) ) {
-      return compareString(obj.toString(), op, s);
-    } else if (obj.canConvert<char>( ) ) {
-      return compareString(obj.toString(), op, s);
-    } else if (obj.canConvert<bool>( ) ) {
-      if (op==LE || op==GE)
-        return false;
-      if ( obj.toBool() ) {
-        return s.compare("true", Qt::CaseInsensitive);
-      } else {
-        return s.compare("false", Qt::CaseInsensitive);
-      }
-    } 
-    else if ( obj.canConvert<Byte>( ) || obj.canConvert<int>( ) ) 
-    {
-      switch(op) {
-      case LE:
-        return obj.toInt() <= s.toInt();
-      case GE:
-        return obj.toInt() >= s.toInt();
-      default: /*APPROX and EQ*/
-        return s.toInt( ) == obj.toInt();
-      }
-    } else if ( obj.canConvert<float>( ) ) {
-      switch(op) {
-      case LE:
-        return obj.toFloat() <= s.toFloat();
-      case GE:
-        return obj.toFloat() >= s.toFloat();
-      default: /*APPROX and EQ*/
-        return s.toFloat() == obj.toFloat();
-      }
-    } else if (obj.canConvert<double>()) {
-      switch(op) {
-      case LE:
-        return obj.toDouble() <= s.toDouble();
-      case GE:
-        return obj.toDouble() >= s.toDouble();
-      default: /*APPROX and EQ*/
-        return s.toDouble( ) == obj.toDouble( );
-      }
-    } else if (obj.canConvert<qlonglong>( )) {
-      switch(op) {
-      case LE:
-        return obj.toLongLong() <= s.toLongLong( );
-      case GE:
-        return obj.toLongLong() >= s.toLongLong( );
-      default: /*APPROX and EQ*/
-        return obj.toLongLong() == s.toLongLong( );
-      }
-    } 
-    else if (obj.canConvert< QList<QVariant> >()) {
-      QList<QVariant> list = obj.toList();
-      QList<QVariant>::Iterator it;
-      for (it=list.begin(); it != list.end( ); it++)
-         if (compare(*it, op, s))
-           return true;
-    } 
-  } catch (...) {
-    // This might happen if a QString-to-datatype conversion fails
-    // Just consider it a false match and ignore the exception
+  const int op = d->m_operator;
+
+  switch (obj.type())
+  {
+  case QVariant::String:
+    return compareString(obj.toString());
+  case QVariant::StringList:
+  {
+    const QStringList list = obj.toStringList();
+    for (QStringList::const_iterator it = list.begin(); it != list.end(); ++it)
+      if (compareString(*it))
+        return true;
+    return false;
+  }
+  case QVariant::List:
+  {
+    const QList<QVariant> list = obj.toList();
+    for (QList<QVariant>::const_iterator it = list.begin(); it != list.end(); ++it)
+      if (compare(*it))
+        return true;
+    return false;
+  }
+  default:
+    break;
+  }
+
+  // Substring matching only makes sense on strings
+  if (d->m_wildcard)
+    return compareString(obj.toString());
+
+  switch (obj.userType())
+  {
+  case QVariant::Bool:
+    if (op == LE || op == GE)
+      return false;
+    return d->m_boolValid && obj.toBool() == d->m_boolValue;
+  case QVariant::Int:
+  case QVariant::UInt:
+  case QVariant::LongLong:
+  case QVariant::ULongLong:
+  {
+    if (!d->m_longValid)
+      return false;
+    const qlonglong value = obj.toLongLong();
+    switch(op) {
+    case LE:
+      return value <= d->m_longValue;
+    case GE:
+      return value >= d->m_longValue;
+    default: /*APPROX and EQ*/
+      return value == d->m_longValue;
+    }
+  }
+  case QVariant::Double:
+  case QMetaType::Float:
+  {
+    if (!d->m_doubleValid)
+      return false;
+    const double value = obj.toDouble();
+    switch(op) {
+    case LE:
+      return value <= d->m_doubleValue;
+    case GE:
+      return value >= d->m_doubleValue;
+    default: /*APPROX and EQ*/
+      return value == d->m_doubleValue;
+    }
   }
+  default:
+    break;
+  }
+
+  if (obj.userType() == qMetaTypeId<ctkVersion>())
+  {
+    if (!d->m_versionValue.isValid())
+      return false;
+    const int cmp = obj.value<ctkVersion>().compare(d->m_versionValue.value<ctkVersion>());
+    switch(op) {
+    case LE:
+      return cmp <= 0;
+    case GE:
+      return cmp >= 0;
+    default: /*APPROX and EQ*/
+      return cmp == 0;
+    }
+  }
+
+  if (obj.canConvert<QString>())
+    return compareString(obj.toString());
   return false;
 }
 
 //----------------------------------------------------------------------------
-bool ctkLDAPExpr::compareString( const QString &s1, int op, const QString &s2 )
+bool ctkLDAPExpr::compareString( const QString &s ) const
 {
-  switch(op) {
+  switch(d->m_operator) {
   case LE:
-    return s1.compare(s2) <= 0;
+    return s.compare(d->m_attrValue) <= 0;
   case GE:
-    return s1.compare(s2) >= 0;
+    return s.compare(d->m_attrValue) >= 0;
   case EQ:
-    return patSubstr(s1,s2);
+    return d->m_wildcard ? patSubstr(s, d->m_attrValue) : s == d->m_attrValue;
   case APPROX:
-    return fixupString(s2) == fixupString(s1);
+    return fixupString(s) == d->m_approxValue;
   default:
     return false;
   }
@@ -28,6 +28,8 @@ limitations under the License.
 #include <QString>
 #include <QHash>
 #include <QSharedDataPointer>
+#include <QMultiHash>
+#include <QSet>
 #include <QVector>
 #include <QStringList>
 
@@ -57,6 +59,17 @@ public:
   typedef char Byte;
   typedef QVector<QStringList> LocalCache;
 
+  /**
+   * Terms of a filter index, see getIndexTerms().
+   */
+  struct IndexTerms
+  {
+    //! (lower case key, value) pairs, values are compared as strings
+    QMultiHash<QString, QString> equalities;
+    //! lower case keys
+    QSet<QString> presences;
+  };
+
   /**
    * Creates an invalid ctkLDAPExpr object. Use with care.
    *
@@ -111,6 +124,21 @@ public:
     LocalCache& cache,
     bool matchCase) const;
 
+  /**
+   * Get terms that any dictionary matching this expression satisfies: it
+   * has one of the <code>equalities</code> values (or its canonical
+   * boolean or integer form) for the key, or one of the
+   * <code>presences</code> keys. Dictionaries satisfying a term still
+   * have to be evaluated.
+   * AND expressions use the terms of their most selective operand, OR
+   * expressions the terms of all their operands.
+   *
+   * @param terms The terms are added to <code>terms</code>.
+   * @return <code>false</code> if there are no such terms, e.g. for
+   *         NOT expressions.
+   */
+  bool getIndexTerms(IndexTerms& terms) const;
+
   /**
    * Returns <code>true</code> if this instance is invalid, i.e. it was
    * constructed using ctkLDAPExpr().
@@ -146,11 +174,12 @@ private:
   //!
   static ctkLDAPExpr parseSimple(ParseState &ps);
 
-  //!
-  bool compare(const QVariant &obj, int op, const QString &s) const;
+  //! Compare a property with the operand of this simple expression,
+  //! according to the type of the property.
+  bool compare(const QVariant &obj) const;
 
-  //! 
-  static bool compareString(const QString &s1, int op, const QString &s2);
+  //!
+  bool compareString(const QString &s) const;
 
   //! 
   static QString fixupString(const QString &s);
@@ -174,6 +203,8 @@ private:
   //! Shared pointer
   QSharedDataPointer<ctkLDAPExprData> d;
 
+  friend class ctkLDAPExprData;
+
 };
 
 
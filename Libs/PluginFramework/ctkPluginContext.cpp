@@ -221,3 +221,19 @@ void ctkPluginContext::disconnectServiceListener(QObject* receiver,
   d->isPluginContextValid();
   d->plugin->fwCtx->listeners.removeServiceSlot(getPlugin(), receiver, slot);
 }
+
+//----------------------------------------------------------------------------
+void ctkPluginContext::beginServiceEventBatch()
+{
+  Q_D(ctkPluginContext);
+  d->isPluginContextValid();
+  d->plugin->fwCtx->listeners.beginServiceEventBatch();
+}
+
+//----------------------------------------------------------------------------
+void ctkPluginContext::endServiceEventBatch()
+{
+  Q_D(ctkPluginContext);
+  d->isPluginContextValid();
+  d->plugin->fwCtx->listeners.endServiceEventBatch();
+}
@@ -694,6 +694,35 @@ public:
    */
   void disconnectServiceListener(QObject* receiver, const char* slot);
 
+  /**
+   * Delays the service events caused by the calling thread, e.g. while
+   * registering many services, until the matching call to
+   * endServiceEventBatch(). Calls can be nested.
+   *
+   * <p>
+   * When the outermost batch ends, the events of each service are
+   * coalesced: the service slots receive a single <code>REGISTERED</code>
+   * or <code>MODIFIED</code> event per service, matched against its
+   * current properties. <code>UNREGISTERING</code> events are delivered
+   * right away; a service registered and unregistered within the batch
+   * is only notified as <code>UNREGISTERING</code>.
+   *
+   * @throws ctkIllegalStateException If this ctkPluginContext is no
+   *         longer valid.
+   * @see endServiceEventBatch()
+   */
+  void beginServiceEventBatch();
+
+  /**
+   * Ends a batch started with beginServiceEventBatch() and delivers the
+   * delayed service events if it is the outermost one.
+   *
+   * @throws ctkIllegalStateException If this ctkPluginContext is no
+   *         longer valid.
+   * @see beginServiceEventBatch()
+   */
+  void endServiceEventBatch();
+
 protected:
 
   friend class ctkPluginFrameworkPrivate;
@@ -26,26 +26,15 @@
 #include "ctkPluginConstants.h"
 #include "ctkLDAPExpr_p.h"
 #include "ctkServiceReferencePrivate.h"
+#include "ctkServiceRegistrationPrivate.h"
 
 #include <QStringListIterator>
 #include <QDebug>
 
-const int ctkPluginFrameworkListeners::OBJECTCLASS_IX = 0;
-const int ctkPluginFrameworkListeners::SERVICE_ID_IX = 1;
-const int ctkPluginFrameworkListeners::SERVICE_PID_IX = 2;
-
 //----------------------------------------------------------------------------
 ctkPluginFrameworkListeners::ctkPluginFrameworkListeners(ctkPluginFrameworkContext* pluginFw)
   : pluginFw(pluginFw)
 {
-  hashedServiceKeys << ctkPluginConstants::OBJECTCLASS.toLower()
-      << ctkPluginConstants::SERVICE_ID.toLower()
-      << ctkPluginConstants::SERVICE_PID.toLower();
-
-  for (int i = 0; i < hashedServiceKeys.size(); ++i)
-  {
-    cache.push_back(QHash<QString, QList<ctkServiceSlotEntry> >());
-  }
 }
 
 //----------------------------------------------------------------------------
@@ -60,7 +49,7 @@ void ctkPluginFrameworkListeners::addServiceSlot(
     removeServiceSlot_unlocked(plugin, receiver, slot);
   }
   serviceSet.insert(sse);
-  checkSimple(sse);
+  addToIndex(sse);
 
   connect(receiver, SIGNAL(destroyed(QObject*)), this, SLOT(serviceListenerDestroyed(QObject*)), Qt::DirectConnection);
 }
@@ -88,7 +77,7 @@ void ctkPluginFrameworkListeners::removeServiceSlot_unlocked(QSharedPointer<ctkP
     {
       currentEntry.setRemoved(true);
       //listeners.framework.hooks.handleServiceListenerUnreg(sle);
-      removeFromCache(currentEntry);
+      removeFromIndex(currentEntry);
       it.remove();
       if (slot) break;
     }
@@ -110,6 +99,17 @@ void ctkPluginFrameworkListeners::serviceListenerDestroyed(QObject *listener)
 QSet<ctkServiceSlotEntry> ctkPluginFrameworkListeners::getMatchingServiceSlots(
     const ctkServiceReference& sr, bool lockProps)
 {
+  ctkDictionary props;
+  if (lockProps)
+  {
+    QMutexLocker propsLock(&sr.d_func()->registration->propsLock);
+    props = sr.d_func()->getProperties();
+  }
+  else
+  {
+    props = sr.d_func()->getProperties();
+  }
+
   QMutexLocker lock(&mutex); Q_UNUSED(lock);
 
   QSet<ctkServiceSlotEntry> set;
@@ -118,7 +118,7 @@ QSet<ctkServiceSlotEntry> ctkPluginFrameworkListeners::getMatchingServiceSlots(
   foreach (ctkServiceSlotEntry sse, complicatedListeners)
   {
     ++n;
-    if (sse.getLDAPExpr().isNull() || sse.getLDAPExpr().evaluate(sr.d_func()->getProperties(), false))
+    if (sse.getLDAPExpr().isNull() || sse.getLDAPExpr().evaluate(props, false))
     {
       set.insert(sse);
     }
@@ -130,24 +130,40 @@ QSet<ctkServiceSlotEntry> ctkPluginFrameworkListeners::getMatchingServiceSlots(
       << "listeners with complicated filters";
   }
 
-  // Check the cache
-  QStringList c = sr.d_func()->getProperty(ctkPluginConstants::OBJECTCLASS, lockProps).toStringList();
-  foreach (QString objClass, c)
+  // Check the index, only the candidates it returns are evaluated
+  QSet<ctkServiceSlotEntry> candidates;
+  for (ctkDictionary::const_iterator it = props.begin(); it != props.end(); ++it)
   {
-    addToSet(set, OBJECTCLASS_IX, objClass);
+    const QString key = QString(it.key()).toLower();
+    QHash<QString, QList<ctkServiceSlotEntry> >::const_iterator presence = presenceIndex.find(key);
+    if (presence != presenceIndex.end())
+    {
+      foreach (const ctkServiceSlotEntry& sse, presence.value())
+      {
+        candidates.insert(sse);
+      }
+    }
+    QHash<QString, QHash<QString, QList<ctkServiceSlotEntry> > >::const_iterator equality = equalityIndex.find(key);
+    if (equality != equalityIndex.end())
+    {
+      addEqualityCandidates(candidates, equality.value(), it.value());
+    }
   }
 
-  bool ok = false;
-  qlonglong service_id = sr.d_func()->getProperty(ctkPluginConstants::SERVICE_ID, lockProps).toLongLong(&ok);
-  if (ok)
+  n = 0;
+  foreach (const ctkServiceSlotEntry& sse, candidates)
   {
-    addToSet(set, SERVICE_ID_IX, QString::number(service_id));
+    if (sse.getLDAPExpr().evaluate(props, false))
+    {
+      set.insert(sse);
+      ++n;
+    }
   }
 
-  QStringList service_pids = sr.d_func()->getProperty(ctkPluginConstants::SERVICE_PID, lockProps).toStringList();
-  foreach (QString service_pid, service_pids)
+  if (pluginFw->debug.ldap)
   {
-    addToSet(set, SERVICE_PID_IX, service_pid);
+    qDebug() << "Added" << n << "out of" << candidates.size()
+      << "candidates of the listener index";
   }
 
   return set;
@@ -193,6 +209,13 @@ void ctkPluginFrameworkListeners::serviceChanged(
     const ctkServiceEvent& evt,
     QSet<ctkServiceSlotEntry>& matchBefore)
 {
+  if (serviceEventBatches.hasLocalData() &&
+      serviceEventBatches.localData()->depth > 0 &&
+      delayServiceEvent(serviceEventBatches.localData(), receivers, evt, matchBefore))
+  {
+    return;
+  }
+
   ctkServiceReference sr = evt.getServiceReference();
   //QStringList classes = sr.getProperty(ctkPluginConstants::OBJECTCLASS).toStringList();
   int n = 0;
@@ -236,89 +259,219 @@ void ctkPluginFrameworkListeners::serviceChanged(
 }
 
 //----------------------------------------------------------------------------
-void ctkPluginFrameworkListeners::removeFromCache(const ctkServiceSlotEntry& sse)
+void ctkPluginFrameworkListeners::beginServiceEventBatch()
+{
+  if (!serviceEventBatches.hasLocalData())
+  {
+    serviceEventBatches.setLocalData(new ctkServiceEventBatch());
+  }
+  ++serviceEventBatches.localData()->depth;
+}
+
+//----------------------------------------------------------------------------
+void ctkPluginFrameworkListeners::endServiceEventBatch()
 {
-  if (!sse.getLocalCache().isEmpty())
+  if (!serviceEventBatches.hasLocalData())
+  {
+    return;
+  }
+  ctkServiceEventBatch* batch = serviceEventBatches.localData();
+  if (batch->depth == 0 || --batch->depth > 0)
   {
-    for (int i = 0; i < hashedServiceKeys.size(); ++i)
+    return;
+  }
+
+  QList<ctkServiceReference> order = batch->order;
+  QHash<ctkServiceReference, ctkServiceEventBatch::Pending> pending = batch->pending;
+  batch->order.clear();
+  batch->pending.clear();
+
+  foreach (const ctkServiceReference& sr, order)
+  {
+    ctkServiceEventBatch::Pending& p = pending[sr];
+    if (p.type == ctkServiceEvent::REGISTERED)
     {
-      QHash<QString, QList<ctkServiceSlotEntry> >& keymap = cache[i];
-      QStringList& l = sse.getLocalCache()[i];
-      QStringListIterator it(l);
-      while (it.hasNext())
-      {
-        QString value = it.next();
-        QList<ctkServiceSlotEntry>& sses = keymap[value];
-        sses.removeAll(sse);
-        if (sses.isEmpty())
-        {
-          keymap.remove(value);
-        }
-      }
+      serviceChanged(getMatchingServiceSlots(sr),
+                     ctkServiceEvent(ctkServiceEvent::REGISTERED, sr));
+    }
+    else
+    {
+      serviceChanged(getMatchingServiceSlots(sr),
+                     ctkServiceEvent(ctkServiceEvent::MODIFIED, sr), p.matchBefore);
+      serviceChanged(p.matchBefore,
+                     ctkServiceEvent(ctkServiceEvent::MODIFIED_ENDMATCH, sr));
     }
   }
-  else
+}
+
+//----------------------------------------------------------------------------
+bool ctkPluginFrameworkListeners::delayServiceEvent(ctkServiceEventBatch* batch,
+                                                    const QSet<ctkServiceSlotEntry>& receivers,
+                                                    const ctkServiceEvent& evt,
+                                                    QSet<ctkServiceSlotEntry>& matchBefore)
+{
+  ctkServiceReference sr = evt.getServiceReference();
+  switch (evt.getType())
   {
-    complicatedListeners.removeAll(sse);
+  case ctkServiceEvent::REGISTERED:
+  {
+    ctkServiceEventBatch::Pending p;
+    p.type = ctkServiceEvent::REGISTERED;
+    batch->order.push_back(sr);
+    batch->pending.insert(sr, p);
+    return true;
+  }
+  case ctkServiceEvent::MODIFIED:
+  {
+    if (!batch->pending.contains(sr))
+    {
+      ctkServiceEventBatch::Pending p;
+      p.type = ctkServiceEvent::MODIFIED;
+      p.matchBefore = matchBefore;
+      batch->order.push_back(sr);
+      batch->pending.insert(sr, p);
+    }
+    // Like if the event was delivered, see the MODIFIED_ENDMATCH event
+    foreach (const ctkServiceSlotEntry& l, receivers)
+    {
+      matchBefore.remove(l);
+    }
+    return true;
+  }
+  case ctkServiceEvent::MODIFIED_ENDMATCH:
+    // Computed when the batch ends
+    return batch->pending.contains(sr);
+  default:
+    // UNREGISTERING, the service must not be used after the event
+    if (batch->pending.remove(sr) > 0)
+    {
+      batch->order.removeAll(sr);
+    }
+    return false;
   }
 }
 
 //----------------------------------------------------------------------------
-void ctkPluginFrameworkListeners::checkSimple(const ctkServiceSlotEntry& sse)
+void ctkPluginFrameworkListeners::removeFromIndex(const ctkServiceSlotEntry& sse)
 {
-  if (sse.getLDAPExpr().isNull()) // || listeners.nocacheldap) {
+  const ctkLDAPExpr::IndexTerms& terms = sse.getIndexTerms();
+  if (terms.equalities.isEmpty() && terms.presences.isEmpty())
   {
-    complicatedListeners.push_back(sse);
+    complicatedListeners.removeAll(sse);
+    return;
   }
-  else
+
+  for (QMultiHash<QString, QString>::const_iterator it = terms.equalities.begin();
+       it != terms.equalities.end(); ++it)
   {
-    ctkLDAPExpr::LocalCache local_cache;
-    if (sse.getLDAPExpr().isSimple(hashedServiceKeys, local_cache, false))
+    QHash<QString, QList<ctkServiceSlotEntry> >& values = equalityIndex[it.key()];
+    QList<ctkServiceSlotEntry>& sses = values[it.value()];
+    sses.removeAll(sse);
+    if (sses.isEmpty())
     {
-      sse.getLocalCache() = local_cache;
-      for (int i = 0; i < hashedServiceKeys.size(); ++i)
+      values.remove(it.value());
+      if (values.isEmpty())
       {
-        QStringListIterator it(local_cache[i]);
-        while (it.hasNext())
-        {
-          QString value = it.next();
-          QList<ctkServiceSlotEntry>& sses = cache[i][value];
-          sses.push_back(sse);
-        }
+        equalityIndex.remove(it.key());
       }
     }
-    else
+  }
+
+  foreach (const QString& key, terms.presences)
+  {
+    QList<ctkServiceSlotEntry>& sses = presenceIndex[key];
+    sses.removeAll(sse);
+    if (sses.isEmpty())
     {
-      if (pluginFw->debug.ldap)
-      {
-        qDebug() << "## DEBUG: Too complicated filter:" << sse.getFilter();
-      }
-      complicatedListeners.push_back(sse);
+      presenceIndex.remove(key);
     }
   }
 }
 
 //----------------------------------------------------------------------------
-void ctkPluginFrameworkListeners::addToSet(QSet<ctkServiceSlotEntry>& set,
-                                           int cache_ix, const QString& val)
+void ctkPluginFrameworkListeners::addToIndex(const ctkServiceSlotEntry& sse)
 {
-  QList<ctkServiceSlotEntry>& l = cache[cache_ix][val];
-  if (!l.isEmpty())
+  ctkLDAPExpr::IndexTerms terms;
+  if (sse.getLDAPExpr().isNull() || !sse.getLDAPExpr().getIndexTerms(terms))
   {
-    if (pluginFw->debug.ldap)
+    if (pluginFw->debug.ldap && !sse.getLDAPExpr().isNull())
     {
-      qDebug() << hashedServiceKeys[cache_ix] << "matches" << l.size();
+      qDebug() << "## DEBUG: Too complicated filter:" << sse.getFilter();
     }
-    foreach (ctkServiceSlotEntry entry, l)
+    complicatedListeners.push_back(sse);
+    return;
+  }
+
+  // A value may be listed several times, e.g. "true" as value and as boolean
+  QSet<QPair<QString, QString> > inserted;
+  for (QMultiHash<QString, QString>::const_iterator it = terms.equalities.begin();
+       it != terms.equalities.end(); ++it)
+  {
+    if (!inserted.contains(qMakePair(it.key(), it.value())))
     {
-      set.insert(entry);
+      inserted.insert(qMakePair(it.key(), it.value()));
+      equalityIndex[it.key()][it.value()].push_back(sse);
     }
   }
-  else
+  foreach (const QString& key, terms.presences)
+  {
+    presenceIndex[key].push_back(sse);
+  }
+  sse.getIndexTerms() = terms;
+}
+
+//----------------------------------------------------------------------------
+void ctkPluginFrameworkListeners::addEqualityCandidates(
+    QSet<ctkServiceSlotEntry>& set,
+    const QHash<QString, QList<ctkServiceSlotEntry> >& values,
+    const QVariant& val)
+{
+  QStringList keys;
+  switch (val.userType())
   {
-    if (pluginFw->debug.ldap)
+  case QVariant::String:
+    keys << val.toString();
+    break;
+  case QVariant::StringList:
+    keys = val.toStringList();
+    break;
+  case QVariant::List:
+    foreach (const QVariant& v, val.toList())
     {
-      qDebug() << hashedServiceKeys[cache_ix] << "matches none";
+      addEqualityCandidates(set, values, v);
+    }
+    return;
+  case QVariant::Bool:
+    keys << (val.toBool() ? "true" : "false");
+    break;
+  case QVariant::Int:
+  case QVariant::UInt:
+  case QVariant::LongLong:
+  case QVariant::ULongLong:
+    keys << QString::number(val.toLongLong());
+    break;
+  default:
+    // No canonical string form, e.g. doubles, all the values may match
+    for (QHash<QString, QList<ctkServiceSlotEntry> >::const_iterator it = values.begin();
+         it != values.end(); ++it)
+    {
+      foreach (const ctkServiceSlotEntry& sse, it.value())
+      {
+        set.insert(sse);
+      }
+    }
+    return;
+  }
+
+  foreach (const QString& key, keys)
+  {
+    QHash<QString, QList<ctkServiceSlotEntry> >::const_iterator it = values.find(key);
+    if (it != values.end())
+    {
+      foreach (const ctkServiceSlotEntry& sse, it.value())
+      {
+        set.insert(sse);
+      }
     }
   }
 }
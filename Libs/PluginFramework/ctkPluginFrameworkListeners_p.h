@@ -26,6 +26,7 @@
 #include <QHash>
 #include <QSet>
 #include <QMutex>
+#include <QThreadStorage>
 
 #include "ctkPluginEvent.h"
 #include "ctkPluginFrameworkEvent.h"
@@ -33,6 +34,30 @@
 #include "ctkServiceSlotEntry_p.h"
 #include "ctkServiceEvent.h"
 
+/**
+ * \ingroup PluginFramework
+ *
+ * Service events delayed by a thread between
+ * ctkPluginFrameworkListeners::beginServiceEventBatch() and
+ * ctkPluginFrameworkListeners::endServiceEventBatch().
+ */
+struct ctkServiceEventBatch
+{
+  struct Pending
+  {
+    //! REGISTERED or MODIFIED
+    ctkServiceEvent::Type type;
+    //! For MODIFIED, the slots matching before the first modification
+    QSet<ctkServiceSlotEntry> matchBefore;
+  };
+
+  ctkServiceEventBatch() : depth(0) {}
+
+  int depth;
+  QList<ctkServiceReference> order;
+  QHash<ctkServiceReference, Pending> pending;
+};
+
 /**
  * \ingroup PluginFramework
  */
@@ -94,6 +119,28 @@ public:
   void serviceChanged(const QSet<ctkServiceSlotEntry>& receivers,
                       const ctkServiceEvent& evt);
 
+  /**
+   * Delay the service events of the calling thread until the matching
+   * endServiceEventBatch(). Calls can be nested.
+   */
+  void beginServiceEventBatch();
+
+  /**
+   * Deliver the service events delayed since beginServiceEventBatch(),
+   * once the outermost batch ends. The events of a service are coalesced:
+   * <ul>
+   * <li>a service registered during the batch gets a single
+   *     <code>REGISTERED</code> event, with its current properties;</li>
+   * <li>a service modified during the batch gets a single
+   *     <code>MODIFIED</code> event, and a single
+   *     <code>MODIFIED_ENDMATCH</code> event for the slots that no longer
+   *     match;</li>
+   * <li><code>UNREGISTERING</code> events are never delayed, the
+   *     pending events of the service are dropped.</li>
+   * </ul>
+   */
+  void endServiceEventBatch();
+
   void emitPluginChanged(const ctkPluginEvent& event);
 
   void emitFrameworkEvent(const ctkPluginFrameworkEvent& event);
@@ -113,16 +160,18 @@ private:
 
   QMutex mutex;
 
-  QList<QString> hashedServiceKeys;
-  static const int OBJECTCLASS_IX; // = 0;
-  static const int SERVICE_ID_IX; // = 1;
-  static const int SERVICE_PID_IX; // = 2;
-
-  // Service listeners with complicated or empty filters
+  // Service listeners with empty filters or filters that can't be indexed
   QList<ctkServiceSlotEntry> complicatedListeners;
 
-  // Service listeners with "simple" filters are cached
-  QList<QHash<QString, QList<ctkServiceSlotEntry> > > cache;
+  // Service listeners indexed by the equality terms of their filter:
+  // lower case key -> value -> listeners
+  QHash<QString, QHash<QString, QList<ctkServiceSlotEntry> > > equalityIndex;
+
+  // Service listeners indexed by the presence terms of their filter:
+  // lower case key -> listeners
+  QHash<QString, QList<ctkServiceSlotEntry> > presenceIndex;
+
+  QThreadStorage<ctkServiceEventBatch*> serviceEventBatches;
 
   QSet<ctkServiceSlotEntry> serviceSet;
 
@@ -130,20 +179,32 @@ private:
 
   /**
    * Remove all references to a service slot from the service listener
-   * cache.
+   * index.
+   */
+  void removeFromIndex(const ctkServiceSlotEntry& sse);
+
+  /**
+   * Index the specified service slot by the terms of its filter, or add it
+   * to the complicated listeners.
    */
-  void removeFromCache(const ctkServiceSlotEntry& sse);
+  void addToIndex(const ctkServiceSlotEntry& sse);
 
   /**
-   * Checks if the specified service slot's filter is simple enough
-   * to cache.
+   * Add the listeners whose equality terms may match the property value
+   * <code>val</code> to <code>set</code>.
    */
-  void checkSimple(const ctkServiceSlotEntry& sse);
+  void addEqualityCandidates(QSet<ctkServiceSlotEntry>& set,
+                             const QHash<QString, QList<ctkServiceSlotEntry> >& values,
+                             const QVariant& val);
 
   /**
-   * Add all members of the specified list to the specified set.
+   * Record an event of a batch instead of delivering it.
+   * @return <code>false</code> if the event must be delivered.
    */
-  void addToSet(QSet<ctkServiceSlotEntry>& set, int cache_ix, const QString& val);
+  bool delayServiceEvent(ctkServiceEventBatch* batch,
+                         const QSet<ctkServiceSlotEntry>& receivers,
+                         const ctkServiceEvent& evt,
+                         QSet<ctkServiceSlotEntry>& matchBefore);
 
   /**
    * The unsynchronized version of removeServiceSlot().
@@ -61,6 +61,7 @@ QObject* ctkServiceReferencePrivate::getService(QSharedPointer<ctkPlugin> plugin
         QStringList classes =
             registration->properties.value(ctkPluginConstants::OBJECTCLASS).toStringList();
         registration->dependents[plugin] = 1;
+        plugin->d_func()->fwCtx->services->addUsage(plugin, ctkServiceRegistration(registration));
         if (ctkServiceFactory* serviceFactory = qobject_cast<ctkServiceFactory*>(registration->getService()))
         {
           try
@@ -163,6 +164,8 @@ bool ctkServiceReferencePrivate::ungetService(QSharedPointer<ctkPlugin> plugin,
       }
     }
     registration->dependents.remove(plugin);
+    plugin->d_func()->fwCtx->services->removeUsage(
+          QList<QSharedPointer<ctkPlugin> >() << plugin, ctkServiceRegistration(registration));
   }
 
   return hadReferences;
@@ -117,16 +117,11 @@ void ctkServiceRegistration::setProperties(const ctkDictionary& props)
     if (d->available)
     {
       // NYI! Optimize the MODIFIED_ENDMATCH code
-      int old_rank = d->properties.value(ctkPluginConstants::SERVICE_RANKING).toInt();
       before = d->plugin->fwCtx->listeners.getMatchingServiceSlots(d->reference, false);
       QStringList classes = d->properties.value(ctkPluginConstants::OBJECTCLASS).toStringList();
       qlonglong sid = d->properties.value(ctkPluginConstants::SERVICE_ID).toLongLong();
       d->properties = ctkServices::createServiceProperties(props, classes, sid);
-      int new_rank = d->properties.value(ctkPluginConstants::SERVICE_RANKING).toInt();
-      if (old_rank != new_rank)
-      {
-        d->plugin->fwCtx->services->updateServiceRegistrationOrder(*this, classes);
-      }
+      d->plugin->fwCtx->services->updateServiceRegistration(*this, classes);
     }
     else
     {
@@ -197,6 +192,7 @@ void ctkServiceRegistration::unregister()
             d->plugin->fwCtx->listeners.emitFrameworkEvent(pfwEvent);
           }
         }
+        d->plugin->fwCtx->services->removeUsage(d->dependents.keys(), *this);
       }
       d->plugin = 0;
       d->dependents.clear();
@@ -43,25 +43,12 @@ public:
   }
 
   /**
-   * The elements of "simple" filters are cached, for easy lookup.
-   *
-   * The grammar for simple filters is as follows:
-   *
-   * <pre>
-   * Simple = '(' attr '=' value ')'
-   *        | '(' '|' Simple+ ')'
-   * </pre>
-   * where <code>attr</code> is one of {@link Constants#OBJECTCLASS},
-   * {@link Constants#SERVICE_ID} or {@link Constants#SERVICE_PID}, and
-   * <code>value</code> must not contain a wildcard character.
-   * <p>
-   * The index of the vector determines which key the cache is for
-   * (see {@link ServiceListenerState#hashedKeys}). For each key, there is
-   * a vector pointing out the values which are accepted by this
-   * ServiceListenerEntry's filter. This cache is maintained to make
-   * it easy to remove this service listener.
+   * The terms under which this entry is indexed by
+   * ctkPluginFrameworkListeners, see ctkLDAPExpr::getIndexTerms().
+   * Empty if the entry has no filter or if the filter can't be indexed.
+   * They are kept to make it easy to remove this service listener.
    */
-  ctkLDAPExpr::LocalCache local_cache;
+  ctkLDAPExpr::IndexTerms index_terms;
 
   ctkLDAPExpr ldap;
   QSharedPointer<ctkPlugin> plugin;
@@ -163,9 +150,9 @@ QString ctkServiceSlotEntry::getFilter() const
 }
 
 //----------------------------------------------------------------------------
-ctkLDAPExpr::LocalCache& ctkServiceSlotEntry::getLocalCache() const
+ctkLDAPExpr::IndexTerms& ctkServiceSlotEntry::getIndexTerms() const
 {
-  return d->local_cache;
+  return d->index_terms;
 }
 
 //----------------------------------------------------------------------------
@@ -76,7 +76,7 @@ public:
 
   QString getFilter() const;
 
-  ctkLDAPExpr::LocalCache& getLocalCache() const;
+  ctkLDAPExpr::IndexTerms& getIndexTerms() const;
 
 private:
 
@@ -24,6 +24,7 @@
 #include <QStringListIterator>
 #include <QMutexLocker>
 #include <QBuffer>
+#include <QSet>
 
 #include <algorithm>
 
@@ -35,14 +36,47 @@
 #include "ctkLDAPExpr_p.h"
 
 //----------------------------------------------------------------------------
-struct ServiceRegistrationComparator
+// Same order as ctkServiceRegistration::operator<(), computed from the
+// properties of the entries instead of locking the registrations.
+struct ServiceEntryComparator
 {
-  bool operator()(const ctkServiceRegistration& a, const ctkServiceRegistration& b) const
+  bool operator()(const ctkServicesEntry& a, const ctkServicesEntry& b) const
   {
-    return a < b;
+    int r1 = a.properties.value(ctkPluginConstants::SERVICE_RANKING).toInt();
+    int r2 = b.properties.value(ctkPluginConstants::SERVICE_RANKING).toInt();
+    if (r1 != r2)
+    {
+      return r1 < r2;
+    }
+    qlonglong id1 = a.properties.value(ctkPluginConstants::SERVICE_ID).toLongLong();
+    qlonglong id2 = b.properties.value(ctkPluginConstants::SERVICE_ID).toLongLong();
+    return id2 < id1;
   }
 };
 
+//----------------------------------------------------------------------------
+static void insertEntry(QList<ctkServicesEntry>& entries, const ctkServicesEntry& entry)
+{
+  entries.insert(std::lower_bound(entries.begin(), entries.end(), entry,
+                                  ServiceEntryComparator()), entry);
+}
+
+//----------------------------------------------------------------------------
+static void removeEntry(QList<ctkServicesEntry>& entries, const ctkServiceRegistration& sr)
+{
+  for (int i = 0; i < entries.size(); ++i)
+  {
+    if (entries[i].registration == sr)
+    {
+      entries.removeAt(i);
+      return;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+typedef ctkAtomicSnapshot<ctkServicesSnapshot>::Reader ctkServicesReader;
+
 //----------------------------------------------------------------------------
 ctkDictionary ctkServices::createServiceProperties(const ctkDictionary& in,
                                                        const QStringList& classes,
@@ -63,7 +97,7 @@ ctkDictionary ctkServices::createServiceProperties(const ctkDictionary& in,
 
 //----------------------------------------------------------------------------
 ctkServices::ctkServices(ctkPluginFrameworkContext* fwCtx)
-  : mutex(), framework(fwCtx)
+  : mutex(), framework(fwCtx), snapshot(new ctkServicesSnapshot()), filterCache(256)
 {
 
 }
@@ -77,8 +111,14 @@ ctkServices::~ctkServices()
 //----------------------------------------------------------------------------
 void ctkServices::clear()
 {
-  services.clear();
-  classServices.clear();
+  {
+    QMutexLocker lock(&mutex);
+    snapshot.publish(new ctkServicesSnapshot());
+  }
+  {
+    QMutexLocker lock(&usageMutex);
+    usedServices.clear();
+  }
   framework = 0;
 }
 
@@ -117,15 +157,17 @@ ctkServiceRegistration ctkServices::registerService(ctkPluginPrivate* plugin,
                              createServiceProperties(properties, classes));
   {
     QMutexLocker lock(&mutex);
-    services.insert(res, classes);
+    ctkServicesEntry entry;
+    entry.registration = res;
+    entry.properties = res.d_func()->properties;
+
+    ctkServicesSnapshot* next = new ctkServicesSnapshot(*snapshot.current());
+    next->pluginServices[plugin].push_back(entry);
     for (QStringListIterator i(classes); i.hasNext(); )
     {
-      QString currClass = i.next();
-      QList<ctkServiceRegistration>& s = classServices[currClass];
-      QList<ctkServiceRegistration>::iterator ip =
-          std::lower_bound(s.begin(), s.end(), res, ServiceRegistrationComparator());
-      s.insert(ip, res);
+      insertEntry(next->classServices[i.next()], entry);
     }
+    snapshot.publish(next);
   }
 
   ctkServiceReference r = res.getReference();
@@ -136,16 +178,31 @@ ctkServiceRegistration ctkServices::registerService(ctkPluginPrivate* plugin,
 }
 
 //----------------------------------------------------------------------------
-void ctkServices::updateServiceRegistrationOrder(const ctkServiceRegistration& sr,
-                                              const QStringList& classes)
+void ctkServices::updateServiceRegistration(const ctkServiceRegistration& sr,
+                                            const QStringList& classes)
 {
   QMutexLocker lock(&mutex);
+  ctkServicesEntry entry;
+  entry.registration = sr;
+  entry.properties = sr.d_func()->properties;
+
+  ctkServicesSnapshot* next = new ctkServicesSnapshot(*snapshot.current());
   for (QStringListIterator i(classes); i.hasNext(); )
   {
-    QList<ctkServiceRegistration>& s = classServices[i.next()];
-    s.removeAll(sr);
-    s.insert(std::lower_bound(s.begin(), s.end(), sr, ServiceRegistrationComparator()), sr);
+    QList<ctkServicesEntry>& s = next->classServices[i.next()];
+    removeEntry(s, sr);
+    insertEntry(s, entry);
+  }
+  QList<ctkServicesEntry>& ps = next->pluginServices[sr.d_func()->plugin];
+  for (int i = 0; i < ps.size(); ++i)
+  {
+    if (ps[i].registration == sr)
+    {
+      ps[i] = entry;
+      break;
+    }
   }
+  snapshot.publish(next);
 }
 
 //----------------------------------------------------------------------------
@@ -157,16 +214,21 @@ bool ctkServices::checkServiceClass(QObject* service, const QString& cls) const
 //----------------------------------------------------------------------------
 QList<ctkServiceRegistration> ctkServices::get(const QString& clazz) const
 {
-  QMutexLocker lock(&mutex);
-  return classServices.value(clazz);
+  ctkServicesReader reader(snapshot);
+  QList<ctkServiceRegistration> res;
+  foreach (const ctkServicesEntry& entry, reader->classServices.value(clazz))
+  {
+    res.push_back(entry.registration);
+  }
+  return res;
 }
 
 //----------------------------------------------------------------------------
 ctkServiceReference ctkServices::get(ctkPluginPrivate* plugin, const QString& clazz) const
 {
-  QMutexLocker lock(&mutex);
+  ctkServicesReader reader(snapshot);
   try {
-    QList<ctkServiceReference> srs = get_unlocked(clazz, QString(), plugin);
+    QList<ctkServiceReference> srs = get_unlocked(reader.data(), clazz, QString(), plugin);
     if (framework->debug.service_reference)
     {
       qDebug() << "get service ref" << clazz << "for plugin"
@@ -186,83 +248,95 @@ ctkServiceReference ctkServices::get(ctkPluginPrivate* plugin, const QString& cl
 QList<ctkServiceReference> ctkServices::get(const QString& clazz, const QString& filter,
                                             ctkPluginPrivate* plugin) const
 {
-  QMutexLocker lock(&mutex);
-  return get_unlocked(clazz, filter, plugin);
+  ctkServicesReader reader(snapshot);
+  return get_unlocked(reader.data(), clazz, filter, plugin);
+}
+
+//----------------------------------------------------------------------------
+ctkLDAPExpr ctkServices::getFilter(const QString& filter) const
+{
+  QMutexLocker lock(&filterCacheMutex);
+  ctkLDAPExpr* ldap = filterCache.object(filter);
+  if (ldap == 0)
+  {
+    // Throws for invalid filters, they are not cached
+    ldap = new ctkLDAPExpr(filter);
+    filterCache.insert(filter, ldap);
+  }
+  return *ldap;
+}
+
+//----------------------------------------------------------------------------
+void ctkServices::addMatching(const ctkServicesEntry& entry, const ctkLDAPExpr* ldap,
+                              QList<ctkServiceReference>& res) const
+{
+  if (ldap == 0 || ldap->evaluate(entry.properties, false))
+  {
+    res.push_back(entry.registration.getReference());
+  }
 }
 
 //----------------------------------------------------------------------------
-QList<ctkServiceReference> ctkServices::get_unlocked(const QString& clazz, const QString& filter,
+QList<ctkServiceReference> ctkServices::get_unlocked(const ctkServicesSnapshot* snapshot,
+                                                     const QString& clazz, const QString& filter,
                                                      ctkPluginPrivate* plugin) const
 {
   Q_UNUSED(plugin)
 
-  QListIterator<ctkServiceRegistration>* s = 0;
-  QList<ctkServiceRegistration> v;
   ctkLDAPExpr ldap;
-  if (clazz.isEmpty())
+  if (!filter.isEmpty())
+  {
+    ldap = getFilter(filter);
+  }
+  const ctkLDAPExpr* ldapPtr = filter.isEmpty() ? 0 : &ldap;
+
+  QList<ctkServiceReference> res;
+  if (!clazz.isEmpty())
   {
-    if (!filter.isEmpty())
+    QHash<QString, QList<ctkServicesEntry> >::const_iterator cl = snapshot->classServices.find(clazz);
+    if (cl != snapshot->classServices.end())
     {
-      ldap = ctkLDAPExpr(filter);
-      QSet<QString> matched;
-      if (ldap.getMatchedObjectClasses(matched))
-      {
-        v.clear();
-        foreach (QString className, matched)
-        {
-          const QList<ctkServiceRegistration>& cl = classServices[className];
-          v += cl;
-        }
-        if (!v.isEmpty())
-        {
-          s = new QListIterator<ctkServiceRegistration>(v);
-        }
-        else
-        {
-          return QList<ctkServiceReference>();
-        }
-      }
-      else
+      foreach (const ctkServicesEntry& entry, cl.value())
       {
-        s = new QListIterator<ctkServiceRegistration>(services.keys());
+        addMatching(entry, ldapPtr, res);
       }
     }
-    else
-    {
-      s = new QListIterator<ctkServiceRegistration>(services.keys());
-    }
+    return res;
   }
-  else
+
+  QSet<QString> matched;
+  if (ldapPtr != 0 && ldap.getMatchedObjectClasses(matched))
   {
-    QList<ctkServiceRegistration> v = classServices.value(clazz);
-    if (!v.isEmpty())
-    {
-      s = new QListIterator<ctkServiceRegistration>(v);
-    }
-    else
-    {
-      return QList<ctkServiceReference>();
-    }
-    if (!filter.isEmpty())
+    // A service registered under several of the matched classes is only
+    // returned once
+    QSet<ctkServiceRegistration> visited;
+    foreach (const QString& className, matched)
     {
-      ldap = ctkLDAPExpr(filter);
+      QHash<QString, QList<ctkServicesEntry> >::const_iterator cl = snapshot->classServices.find(className);
+      if (cl == snapshot->classServices.end())
+      {
+        continue;
+      }
+      foreach (const ctkServicesEntry& entry, cl.value())
+      {
+        if (matched.size() == 1 || !visited.contains(entry.registration))
+        {
+          visited.insert(entry.registration);
+          addMatching(entry, ldapPtr, res);
+        }
+      }
     }
+    return res;
   }
 
-  QList<ctkServiceReference> res;
-  while (s->hasNext())
+  for (QHash<ctkPluginPrivate*, QList<ctkServicesEntry> >::const_iterator it = snapshot->pluginServices.begin();
+       it != snapshot->pluginServices.end(); ++it)
   {
-    ctkServiceRegistration sr = s->next();
-    ctkServiceReference sri = sr.getReference();
-
-    if (filter.isEmpty() || ldap.evaluate(sr.d_func()->properties, false))
+    foreach (const ctkServicesEntry& entry, it.value())
     {
-      res.push_back(sri);
+      addMatching(entry, ldapPtr, res);
     }
   }
-
-  delete s;
-
   return res;
 }
 
@@ -272,35 +346,40 @@ void ctkServices::removeServiceRegistration(const ctkServiceRegistration& sr)
   QMutexLocker lock(&mutex);
 
   QStringList classes = sr.d_func()->properties.value(ctkPluginConstants::OBJECTCLASS).toStringList();
-  services.remove(sr);
+  ctkServicesSnapshot* next = new ctkServicesSnapshot(*snapshot.current());
   for (QStringListIterator i(classes); i.hasNext(); )
   {
     QString currClass = i.next();
-    QList<ctkServiceRegistration>& s = classServices[currClass];
+    QList<ctkServicesEntry>& s = next->classServices[currClass];
     if (s.size() > 1)
     {
-      s.removeAll(sr);
+      removeEntry(s, sr);
     }
     else
     {
-      classServices.remove(currClass);
+      next->classServices.remove(currClass);
     }
   }
+
+  ctkPluginPrivate* plugin = sr.d_func()->plugin;
+  QList<ctkServicesEntry>& ps = next->pluginServices[plugin];
+  removeEntry(ps, sr);
+  if (ps.isEmpty())
+  {
+    next->pluginServices.remove(plugin);
+  }
+  snapshot.publish(next);
 }
 
 //----------------------------------------------------------------------------
 QList<ctkServiceRegistration> ctkServices::getRegisteredByPlugin(ctkPluginPrivate* p) const
 {
-  QMutexLocker lock(&mutex);
+  ctkServicesReader reader(snapshot);
 
   QList<ctkServiceRegistration> res;
-  for (QHashIterator<ctkServiceRegistration, QStringList> i(services); i.hasNext(); )
+  foreach (const ctkServicesEntry& entry, reader->pluginServices.value(p))
   {
-    ctkServiceRegistration sr = i.next().key();
-    if (sr.d_func()->plugin == p)
-    {
-      res.push_back(sr);
-    }
+    res.push_back(entry.registration);
   }
   return res;
 }
@@ -308,17 +387,33 @@ QList<ctkServiceRegistration> ctkServices::getRegisteredByPlugin(ctkPluginPrivat
 //----------------------------------------------------------------------------
 QList<ctkServiceRegistration> ctkServices::getUsedByPlugin(QSharedPointer<ctkPlugin> p) const
 {
-  QMutexLocker lock(&mutex);
+  QMutexLocker lock(&usageMutex);
+  return usedServices.value(p.data()).toList();
+}
 
-  QList<ctkServiceRegistration> res;
-  for (QHashIterator<ctkServiceRegistration, QStringList> i(services); i.hasNext(); )
+//----------------------------------------------------------------------------
+void ctkServices::addUsage(QSharedPointer<ctkPlugin> p, const ctkServiceRegistration& sr)
+{
+  QMutexLocker lock(&usageMutex);
+  usedServices[p.data()].insert(sr);
+}
+
+//----------------------------------------------------------------------------
+void ctkServices::removeUsage(const QList<QSharedPointer<ctkPlugin> >& plugins,
+                              const ctkServiceRegistration& sr)
+{
+  QMutexLocker lock(&usageMutex);
+  foreach (const QSharedPointer<ctkPlugin>& p, plugins)
   {
-    ctkServiceRegistration sr = i.next().key();
-    if (sr.d_func()->isUsedByPlugin(p))
+    QHash<ctkPlugin*, QSet<ctkServiceRegistration> >::iterator it = usedServices.find(p.data());
+    if (it == usedServices.end())
+    {
+      continue;
+    }
+    it.value().remove(sr);
+    if (it.value().isEmpty())
     {
-      res.push_back(sr);
+      usedServices.erase(it);
     }
   }
-  return res;
 }
-
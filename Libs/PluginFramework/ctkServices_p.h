@@ -23,24 +23,71 @@
 #ifndef CTKSERVICES_P_H
 #define CTKSERVICES_P_H
 
+#include <QCache>
 #include <QHash>
 #include <QObject>
 #include <QMutex>
+#include <QSet>
 #include <QStringList>
 
 #include "ctkServiceRegistration.h"
 #include "ctkPluginPrivate_p.h"
+#include "ctkLDAPExpr_p.h"
 
+#include <ctkAtomicSnapshot.h>
+
+
+/**
+ * \ingroup PluginFramework
+ *
+ * A registered service as seen by the lookups. The properties are copied
+ * so that lookups don't need the lock of the registration.
+ */
+struct ctkServicesEntry
+{
+  ctkServiceRegistration registration;
+  ctkDictionary properties;
+};
+
+/**
+ * \ingroup PluginFramework
+ *
+ * State of the service registry. A snapshot is never modified once it
+ * is published, see ctkServices.
+ */
+struct ctkServicesSnapshot
+{
+  /**
+   * Mapping of classname to registered service.
+   * The List of registered services are ordered with the highest
+   * ranked service first.
+   */
+  QHash<QString, QList<ctkServicesEntry> > classServices;
+
+  /**
+   * Mapping of plugin to the services it registered.
+   */
+  QHash<ctkPluginPrivate*, QList<ctkServicesEntry> > pluginServices;
+};
 
 /**
  * \ingroup PluginFramework
  *
  * Here we handle all the services that are registered in the framework.
+ *
+ * Lookups are far more frequent than registrations, they never lock:
+ * they read the current ctkServicesSnapshot while modifications, serialized
+ * by <code>mutex</code>, publish a modified copy of it (the containers are
+ * implicitly shared, only the modified lists are copied). The previous
+ * snapshot is deleted once the lookups that may still read it are done.
  */
 class ctkServices {
 
 public:
 
+  /**
+   * Serializes the modifications of the registry.
+   */
   mutable QMutex mutex;
 
   /**
@@ -56,21 +103,6 @@ public:
                                  const QStringList& classes = QStringList(),
                                  long sid = -1);
 
-  /**
-   * All registered services in the current framework.
-   * Mapping of registered service to class names under which
-   * the service is registerd.
-   */
-  QHash<ctkServiceRegistration, QStringList> services;
-
-  /**
-   * Mapping of classname to registered service.
-   * The List of registered services are ordered with the highest
-   * ranked service first.
-   */
-  QHash<QString, QList<ctkServiceRegistration> > classServices;
-
-
   ctkPluginFrameworkContext* framework;
 
   ctkServices(ctkPluginFrameworkContext* fwCtx);
@@ -101,14 +133,15 @@ public:
 
 
   /**
-   * Service ranking changed, reorder registered services
-   * according to ranking.
+   * Service properties changed, update the properties seen by the
+   * lookups and reorder registered services according to ranking.
+   * The caller holds the properties lock of the registration.
    *
    * @param serviceRegistration The ctkServiceRegistrationPrivate object.
-   * @param rank New rank of object.
+   * @param classes The class names of the service.
    */
-  void updateServiceRegistrationOrder(const ctkServiceRegistration& sr,
-                                      const QStringList& classes);
+  void updateServiceRegistration(const ctkServiceRegistration& sr,
+                                 const QStringList& classes);
 
 
   /**
@@ -179,9 +212,57 @@ public:
    */
   QList<ctkServiceRegistration> getUsedByPlugin(QSharedPointer<ctkPlugin> p) const;
 
+  /**
+   * Record that plugin <code>p</code> got the service of <code>sr</code>,
+   * called when <code>p</code> becomes a dependent of the service.
+   */
+  void addUsage(QSharedPointer<ctkPlugin> p, const ctkServiceRegistration& sr);
+
+  /**
+   * Record that <code>plugins</code> no longer use the service of
+   * <code>sr</code>.
+   */
+  void removeUsage(const QList<QSharedPointer<ctkPlugin> >& plugins,
+                   const ctkServiceRegistration& sr);
+
 private:
 
-  QList<ctkServiceReference> get_unlocked(const QString& clazz, const QString& filter,
+  /**
+   * The current state of the registry, replaced under <code>mutex</code>.
+   */
+  ctkAtomicSnapshot<ctkServicesSnapshot> snapshot;
+
+  /**
+   * Services used by each plugin, modified on each first get and last
+   * unget of a service, hence not part of the snapshots.
+   */
+  QHash<ctkPlugin*, QSet<ctkServiceRegistration> > usedServices;
+  mutable QMutex usageMutex;
+
+  /**
+   * Parsed filters, by filter string. Applications usually look up
+   * services with a handful of filters, parsing them again for each
+   * lookup is not needed.
+   */
+  mutable QCache<QString, ctkLDAPExpr> filterCache;
+  mutable QMutex filterCacheMutex;
+
+  /**
+   * Returns the parsed filter, from the cache if possible.
+   *
+   * @exception ctkInvalidArgumentException If the filter is invalid.
+   */
+  ctkLDAPExpr getFilter(const QString& filter) const;
+
+  /**
+   * Appends the reference of the service of <code>entry</code> to
+   * <code>res</code> if its properties match <code>ldap</code> (if not 0).
+   */
+  void addMatching(const ctkServicesEntry& entry, const ctkLDAPExpr* ldap,
+                   QList<ctkServiceReference>& res) const;
+
+  QList<ctkServiceReference> get_unlocked(const ctkServicesSnapshot* snapshot,
+                                          const QString& clazz, const QString& filter,
                                           ctkPluginPrivate* plugin) const;
 
 };
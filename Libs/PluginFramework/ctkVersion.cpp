@@ -55,6 +55,13 @@ ctkVersion& ctkVersion::operator=(const ctkVersion& v)
   return *this;
 }
 
+//----------------------------------------------------------------------------
+ctkVersion::ctkVersion()
+  : majorVersion(0), minorVersion(0), microVersion(0), qualifier(""), undefined(false)
+{
+
+}
+
 //----------------------------------------------------------------------------
 ctkVersion::ctkVersion(bool undefined)
   : majorVersion(0), minorVersion(0), microVersion(0), qualifier(""), undefined(undefined)
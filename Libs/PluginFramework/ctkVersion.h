@@ -24,6 +24,7 @@
 
 #include <QString>
 #include <QRegExp>
+#include <QMetaType>
 
 #include "ctkPluginFrameworkExport.h"
 
@@ -73,10 +74,15 @@ private:
 
   ctkVersion& operator=(const ctkVersion& v);
 
-  ctkVersion(bool undefined = false);
+  ctkVersion(bool undefined);
 
 public:
 
+  /**
+   * Creates the empty version "0.0.0", allows storing versions in a QVariant.
+   */
+  ctkVersion();
+
   /**
    * The empty version "0.0.0".
    */
@@ -263,4 +269,6 @@ public:
  */
 CTK_PLUGINFW_EXPORT QDebug operator<<(QDebug dbg, const ctkVersion& v);
 
+Q_DECLARE_METATYPE(ctkVersion)
+
 #endif // CTKVERSION_H
@@ -28,6 +28,7 @@ const QString ctkEventConstants::EVENT_FILTER = "event.filter";
 const QString ctkEventConstants::EVENT_DELIVERY = "event.delivery";
 const QString ctkEventConstants::DELIVERY_ASYNC_ORDERED = "async.ordered";
 const QString ctkEventConstants::DELIVERY_ASYNC_UNORDERED = "async.unordered";
+const QString ctkEventConstants::EVENT_COALESCE = "event.coalesce";
 
 const QString ctkEventConstants::PLUGIN_SYMBOLICNAME = "plugin.symbolicName";
 const QString ctkEventConstants::PLUGIN_ID = "plugin.id";
@@ -125,6 +125,21 @@ struct CTK_PLUGINFW_EXPORT ctkEventConstants {
    */
   static const QString DELIVERY_ASYNC_UNORDERED; // = "async.unordered"
 
+  /**
+   * Event property (named <code>event.coalesce</code>) marking an event
+   * whose value supersedes the values of the previous events of the same
+   * topic, e.g. a progress value ("latest value wins").
+   * <p>
+   * If the value of this property is <code>true</code>, the Event Admin
+   * implementation may skip a handler of a posted event when a newer event of
+   * the same topic, also marked with this property and posted by the same
+   * thread, is waiting for its asynchronous delivery to that handler as well.
+   * Events sent synchronously are always delivered.
+   * <p>
+   * This is an extension of the OSGi Event Admin specification.
+   */
+  static const QString EVENT_COALESCE; // = "event.coalesce"
+
   /**
    * The Plugin Symbolic Name of the plugin relevant to the event. The type of
    * the value for this event property is <code>QString</code>.
@@ -0,0 +1,192 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QThread>
+#include <QTime>
+
+// CTKVTK includes
+#include "ctkVTKHistogram.h"
+
+// VTK includes
+#include <vtkShortArray.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+//-----------------------------------------------------------------------------
+QList<qint64> bins(const ctkVTKHistogram& histogram)
+{
+  QList<qint64> values;
+  for (int i = 0; i < histogram.count(); ++i)
+    {
+    QSharedPointer<ctkControlPoint> point(histogram.controlPoint(i));
+    values << point->value().toLongLong();
+    }
+  return values;
+}
+
+//-----------------------------------------------------------------------------
+qint64 sum(const QList<qint64>& values)
+{
+  qint64 total = 0;
+  foreach(qint64 value, values)
+    {
+    total += value;
+    }
+  return total;
+}
+
+}
+
+//-----------------------------------------------------------------------------
+int ctkVTKHistogramTest5( int argc, char * argv [])
+{
+  QCoreApplication app(argc, argv);
+
+  // Size of the int16 volume in megabytes, run with 2048 for a 2 GB volume
+  int sizeInMBytes = 64;
+  if (app.arguments().count() > 1)
+    {
+    sizeInMBytes = app.arguments().at(1).toInt();
+    }
+  const vtkIdType voxelCount = static_cast<vtkIdType>(sizeInMBytes) * 1024 * 1024 / 2;
+
+  vtkSmartPointer<vtkShortArray> dataArray = vtkSmartPointer<vtkShortArray>::New();
+  dataArray->SetNumberOfTuples(voxelCount);
+  short* voxels = dataArray->GetPointer(0);
+  for (vtkIdType i = 0; i < voxelCount; ++i)
+    {
+    voxels[i] = static_cast<short>((i * 7919) % 4096 - 1024);
+    }
+
+  //------Test build with an increasing number of threads---------------------
+  QList<qint64> reference;
+  for (int threadCount = 1; threadCount <= qMax(1, QThread::idealThreadCount()); threadCount *= 2)
+    {
+    ctkVTKHistogram histogram(dataArray);
+    histogram.setNumberOfThreads(threadCount);
+
+    QTime time;
+    time.start();
+    histogram.build();
+    int elapsed = qMax(1, time.elapsed());
+
+    std::cout << threadCount << " thread(s): " << elapsed << " ms, "
+              << static_cast<double>(voxelCount) / elapsed / 1000. << " Mvoxels/s" << std::endl;
+
+    QList<qint64> values = bins(histogram);
+    if (reference.isEmpty())
+      {
+      reference = values;
+      }
+    if (histogram.count() != 4096 || sum(values) != voxelCount || values != reference)
+      {
+      std::cerr << "Line " << __LINE__ << " - Failed to build histogram with "
+                << threadCount << " thread(s)" << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  //------Test irregular bins---------------------------------------------------
+  ctkVTKHistogram irregularHistogram(dataArray);
+  irregularHistogram.setNumberOfBins(100);
+  irregularHistogram.build();
+  if (irregularHistogram.count() != 100 || sum(bins(irregularHistogram)) != voxelCount)
+    {
+    std::cerr << "Line " << __LINE__ << " - Failed to build histogram with irregular bins"
+              << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //------Test progressive build-------------------------------------------------
+  ctkVTKHistogram progressiveHistogram(dataArray);
+  progressiveHistogram.setProgressive(true);
+  QTime time;
+  time.start();
+  progressiveHistogram.build();
+  std::cout << "Coarse histogram: " << time.elapsed() << " ms" << std::endl;
+  progressiveHistogram.waitForBuild();
+  std::cout << "Exact histogram: " << time.elapsed() << " ms" << std::endl;
+  if (bins(progressiveHistogram) != reference)
+    {
+    std::cerr << "Line " << __LINE__ << " - Failed to build progressive histogram"
+              << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Modifying the array drops the count in progress
+  progressiveHistogram.build();
+  dataArray->Modified();
+  progressiveHistogram.waitForBuild();
+  progressiveHistogram.build();
+  progressiveHistogram.waitForBuild();
+  if (bins(progressiveHistogram) != reference)
+    {
+    std::cerr << "Line " << __LINE__ << " - Failed to build progressive histogram again"
+              << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //------Test partial update---------------------------------------------------
+  ctkVTKHistogram histogram(dataArray);
+  histogram.build();
+
+  const vtkIdType firstTuple = voxelCount / 3;
+  const vtkIdType lastTuple = firstTuple + 9999;
+  time.start();
+  histogram.beginPartialUpdate(firstTuple, lastTuple);
+  for (vtkIdType i = firstTuple; i <= lastTuple; ++i)
+    {
+    voxels[i] = 0;
+    }
+  histogram.endPartialUpdate();
+  std::cout << "Partial update: " << time.elapsed() << " ms" << std::endl;
+
+  ctkVTKHistogram updatedHistogram(dataArray);
+  updatedHistogram.build();
+  if (bins(histogram) != bins(updatedHistogram))
+    {
+    std::cerr << "Line " << __LINE__ << " - Failed to update histogram"
+              << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Values out of the range of the histogram
+  histogram.beginPartialUpdate(0, 0);
+  voxels[0] = 10000;
+  dataArray->Modified();
+  histogram.endPartialUpdate();
+  if (histogram.count() != 10000 + 1024 + 1 || sum(bins(histogram)) != voxelCount)
+    {
+    std::cerr << "Line " << __LINE__ << " - Failed to update histogram out of range "
+              << histogram.count() << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
@@ -19,8 +19,13 @@
 =========================================================================*/
 
 /// Qt includes
+#include <QAtomicInt>
 #include <QColor>
 #include <QDebug>
+#include <QFutureWatcher>
+#include <QThread>
+#include <QVector>
+#include <QtConcurrentRun>
 
 /// CTK includes
 #include "ctkVTKHistogram.h"
@@ -28,8 +33,6 @@
 
 /// VTK includes
 #include <vtkDataArray.h>
-#include <vtkIntArray.h>
-#include <vtkMath.h>
 #include <vtkSmartPointer.h>
 
 /// STL include
@@ -39,31 +42,223 @@
 static ctkLogger logger("org.commontk.libs.visualization.core.ctkVTKHistogram");
 //--------------------------------------------------------------------------
 
+//-----------------------------------------------------------------------------
+/// What the threads counting the bins need to know, copied so that the
+/// exact histogram can be counted in the background.
+struct ctkVTKHistogramParameters
+{
+  ctkVTKHistogramParameters();
+
+  /// Index of the bin of \a value, NumberOfBins if it is out of Range and
+  /// NumberOfBins + 1 if it is NaN.
+  int binIndex(double value)const;
+
+  const void* Data;
+  int         DataType;
+  int         NumberOfComponents;
+  int         Component;
+  double      Range[2];
+  int         NumberOfBins;
+  /// Number of bins per unit of value
+  double      BinWidth;
+  /// If true, there is one bin per integer value
+  bool        Regular;
+
+  /// Bin of each value of 8 and 16-bit integer arrays, indexed by the value
+  /// minus ValueToBinOffset. Empty for other types.
+  QVector<int> ValueToBin;
+  int          ValueToBinOffset;
+
+  /// Set by the GUI thread to stop a background count early
+  const QAtomicInt* Canceled;
+};
+
+//-----------------------------------------------------------------------------
+ctkVTKHistogramParameters::ctkVTKHistogramParameters()
+{
+  this->Data = 0;
+  this->DataType = VTK_VOID;
+  this->NumberOfComponents = 1;
+  this->Component = 0;
+  this->Range[0] = this->Range[1] = 0.;
+  this->NumberOfBins = 0;
+  this->BinWidth = 1.;
+  this->Regular = true;
+  this->ValueToBinOffset = 0;
+  this->Canceled = 0;
+}
+
+//-----------------------------------------------------------------------------
+int ctkVTKHistogramParameters::binIndex(double value)const
+{
+  if (value != value)
+    {
+    return this->NumberOfBins + 1;
+    }
+  if (value < this->Range[0] || value > this->Range[1])
+    {
+    return this->NumberOfBins;
+    }
+  return qMin(static_cast<int>((value - this->Range[0]) * this->BinWidth),
+              this->NumberOfBins - 1);
+}
+
+//-----------------------------------------------------------------------------
+/// Count tupleCount tuples, every tupleStride tuples from firstTuple. bins
+/// has two more bins, for the values out of range and for NaN.
+template <class T>
+void ctkVTKHistogramCountTuples(const ctkVTKHistogramParameters& params,
+                                vtkIdType firstTuple, vtkIdType tupleCount,
+                                vtkIdType tupleStride, qint64* bins)
+{
+  const T* ptr = static_cast<const T*>(params.Data)
+    + firstTuple * params.NumberOfComponents + params.Component;
+  const vtkIdType step = tupleStride * params.NumberOfComponents;
+
+  if (!params.ValueToBin.isEmpty())
+    {
+    // 8 and 16-bit integers: no conversion to double
+    const int* valueToBin = params.ValueToBin.constData();
+    const int offset = params.ValueToBinOffset;
+    for (vtkIdType i = 0; i < tupleCount; ++i, ptr += step)
+      {
+      ++bins[valueToBin[static_cast<int>(*ptr) - offset]];
+      }
+    return;
+    }
+
+  if (std::numeric_limits<T>::is_integer && params.Regular)
+    {
+    const qint64 offset = static_cast<qint64>(params.Range[0]);
+    const qint64 binCount = params.NumberOfBins;
+    for (vtkIdType i = 0; i < tupleCount; ++i, ptr += step)
+      {
+      qint64 index = static_cast<qint64>(*ptr) - offset;
+      ++bins[(index >= 0 && index < binCount) ? index : binCount];
+      }
+    return;
+    }
+
+  for (vtkIdType i = 0; i < tupleCount; ++i, ptr += step)
+    {
+    ++bins[params.binIndex(static_cast<double>(*ptr))];
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Count a chunk of tuples in its own bins
+QVector<qint64> ctkVTKHistogramCountChunk(const ctkVTKHistogramParameters& params,
+                                          vtkIdType firstTuple, vtkIdType tupleCount,
+                                          vtkIdType tupleStride)
+{
+  QVector<qint64> bins(params.NumberOfBins + 2, 0);
+  // Check for cancellation every block of tuples
+  const vtkIdType blockSize = 1 << 20;
+  for (vtkIdType first = 0; first < tupleCount; first += blockSize)
+    {
+    if (params.Canceled && *params.Canceled)
+      {
+      break;
+      }
+    vtkIdType count = qMin(blockSize, tupleCount - first);
+    switch(params.DataType)
+      {
+      vtkTemplateMacro(ctkVTKHistogramCountTuples<VTK_TT>(
+        params, firstTuple + first * tupleStride, count, tupleStride, bins.data()));
+      }
+    }
+  return bins;
+}
+
+//-----------------------------------------------------------------------------
+/// Count the tuples firstTuple to lastTuple (excluded), every tupleStride
+/// tuples, with numberOfThreads threads. The last two bins count the values
+/// out of range and NaN.
+QVector<qint64> ctkVTKHistogramCount(const ctkVTKHistogramParameters& params,
+                                     vtkIdType firstTuple, vtkIdType lastTuple,
+                                     vtkIdType tupleStride, int numberOfThreads)
+{
+  const vtkIdType tupleCount = (lastTuple - firstTuple + tupleStride - 1) / tupleStride;
+  // Not worth a thread below that
+  const vtkIdType minChunkSize = 65536;
+  const int chunkCount = static_cast<int>(
+    qMax(vtkIdType(1), qMin(vtkIdType(numberOfThreads), tupleCount / minChunkSize)));
+  const vtkIdType chunkSize = tupleCount / chunkCount;
+
+  // The first chunk is counted by the calling thread. Waiting for a chunk
+  // that is not started yet runs it in the waiting thread.
+  QList<QFuture<QVector<qint64> > > chunks;
+  for (int i = 1; i < chunkCount; ++i)
+    {
+    vtkIdType first = i * chunkSize;
+    vtkIdType count = (i == chunkCount - 1) ? tupleCount - first : chunkSize;
+    chunks << QtConcurrent::run(ctkVTKHistogramCountChunk, params,
+                                firstTuple + first * tupleStride, count, tupleStride);
+    }
+  QVector<qint64> bins = ctkVTKHistogramCountChunk(
+    params, firstTuple, chunkCount == 1 ? tupleCount : chunkSize, tupleStride);
+
+  for (int i = 0; i < chunks.count(); ++i)
+    {
+    const QVector<qint64> chunkBins = chunks[i].result();
+    for (int bin = 0; bin < bins.size(); ++bin)
+      {
+      bins[bin] += chunkBins[bin];
+      }
+    }
+  return bins;
+}
+
 //-----------------------------------------------------------------------------
 class ctkVTKHistogramPrivate
 {
 public:
   ctkVTKHistogramPrivate();
   vtkSmartPointer<vtkDataArray> DataArray;
-  vtkSmartPointer<vtkIntArray>  Bins;
+  QVector<qint64>               Bins;
   int                           UserNumberOfBins;
   int                           Component;
   mutable double                Range[2];
-  int                           MinBin;
-  int                           MaxBin;
+  qint64                        MinBin;
+  qint64                        MaxBin;
+
+  int  NumberOfThreads;
+  bool Progressive;
+
+  /// Parameters of the last build
+  ctkVTKHistogramParameters Parameters;
+
+  /// Exact histogram counted in the background
+  QFutureWatcher<QVector<qint64> > BuildWatcher;
+  bool       BuildPending;
+  QAtomicInt BuildCanceled;
+
+  /// Tuples being updated, see beginPartialUpdate()
+  vtkIdType PartialUpdate[2];
 
   int computeNumberOfBins()const;
+  int threadCount()const;
+
+  /// Stop counting in the background and drop the result
+  void cancelBuild();
+
+  /// Set the bins, without the out of range and NaN bins, and their min/max
+  void setBins(const QVector<qint64>& bins);
 };
 
 //-----------------------------------------------------------------------------
 ctkVTKHistogramPrivate::ctkVTKHistogramPrivate()
 {
-  this->Bins = vtkSmartPointer<vtkIntArray>::New();
   this->UserNumberOfBins = -1;
   this->Component = 0;
   this->Range[0] = this->Range[1] = 0.;
   this->MinBin = 0;
   this->MaxBin = 0;
+  this->NumberOfThreads = 0;
+  this->Progressive = false;
+  this->BuildPending = false;
+  this->PartialUpdate[0] = 0;
+  this->PartialUpdate[1] = -1;
 }
 
 //-----------------------------------------------------------------------------
@@ -102,11 +297,53 @@ int ctkVTKHistogramPrivate::computeNumberOfBins()const
   return static_cast<int>(this->Range[1] - this->Range[0]) + 1;
 }
 
+//-----------------------------------------------------------------------------
+int ctkVTKHistogramPrivate::threadCount()const
+{
+  return this->NumberOfThreads > 0 ? this->NumberOfThreads : QThread::idealThreadCount();
+}
+
+//-----------------------------------------------------------------------------
+void ctkVTKHistogramPrivate::cancelBuild()
+{
+  if (!this->BuildPending)
+    {
+    return;
+    }
+  this->BuildCanceled = 1;
+  this->BuildWatcher.waitForFinished();
+  this->BuildCanceled = 0;
+  this->BuildPending = false;
+}
+
+//-----------------------------------------------------------------------------
+void ctkVTKHistogramPrivate::setBins(const QVector<qint64>& bins)
+{
+  this->Bins = bins;
+  this->Bins.resize(this->Parameters.NumberOfBins);
+  this->MinBin = 0;
+  this->MaxBin = 0;
+  if (this->Bins.isEmpty())
+    {
+    return;
+    }
+  this->MinBin = this->Bins.first();
+  this->MaxBin = this->Bins.first();
+  foreach(qint64 bin, this->Bins)
+    {
+    this->MinBin = qMin(bin, this->MinBin);
+    this->MaxBin = qMax(bin, this->MaxBin);
+    }
+}
+
 //-----------------------------------------------------------------------------
 ctkVTKHistogram::ctkVTKHistogram(QObject* parentObject)
   :ctkHistogram(parentObject)
   , d_ptr(new ctkVTKHistogramPrivate)
 {
+  Q_D(ctkVTKHistogram);
+  d->Parameters.Canceled = &d->BuildCanceled;
+  connect(&d->BuildWatcher, SIGNAL(finished()), this, SLOT(onBuildFinished()));
 }
 
 //-----------------------------------------------------------------------------
@@ -115,19 +352,24 @@ ctkVTKHistogram::ctkVTKHistogram(vtkDataArray* dataArray,
   :ctkHistogram(parentObject)
   , d_ptr(new ctkVTKHistogramPrivate)
 {
+  Q_D(ctkVTKHistogram);
+  d->Parameters.Canceled = &d->BuildCanceled;
+  connect(&d->BuildWatcher, SIGNAL(finished()), this, SLOT(onBuildFinished()));
   this->setDataArray(dataArray);
 }
 
 //-----------------------------------------------------------------------------
 ctkVTKHistogram::~ctkVTKHistogram()
 {
+  Q_D(ctkVTKHistogram);
+  d->cancelBuild();
 }
 
 //-----------------------------------------------------------------------------
 int ctkVTKHistogram::count()const
 {
   Q_D(const ctkVTKHistogram);
-  return d->Bins->GetNumberOfTuples();
+  return d->Bins.size();
 }
 
 //-----------------------------------------------------------------------------
@@ -172,7 +414,7 @@ ctkControlPoint* ctkVTKHistogram::controlPoint(int index)const
   Q_D(const ctkVTKHistogram);
   ctkHistogramBar* cp = new ctkHistogramBar();
   cp->P.X = this->indexToPos(index);
-  cp->P.Value = d->Bins->GetValue(index);
+  cp->P.Value = d->Bins.value(index);
   return cp;
 }
 
@@ -203,9 +445,10 @@ int ctkVTKHistogram::posToIndex(qreal pos)const
 void ctkVTKHistogram::setDataArray(vtkDataArray* newDataArray)
 {
   Q_D(ctkVTKHistogram);
+  d->cancelBuild();
   d->DataArray = newDataArray;
   this->qvtkReconnect(d->DataArray,vtkCommand::ModifiedEvent,
-                      this, SIGNAL(changed()));
+                      this, SLOT(onDataArrayModified()));
   emit changed();
 }
 
@@ -239,70 +482,31 @@ void ctkVTKHistogram::setNumberOfBins(int number)
 }
 
 //-----------------------------------------------------------------------------
-template <class T>
-void populateBins(vtkIntArray* bins, const ctkVTKHistogram* histogram)
+void ctkVTKHistogram::setNumberOfThreads(int number)
 {
-  vtkDataArray* scalars = histogram->dataArray();
-  int* binsPtr = bins->WritePointer(0, bins->GetNumberOfTuples());
-
-  // reset bins to 0
-  memset(binsPtr, 0, bins->GetNumberOfComponents()*bins->GetNumberOfTuples()*sizeof(int));
-
-  const vtkIdType componentNumber = scalars->GetNumberOfComponents();
-  const vtkIdType tupleNumber = scalars->GetNumberOfTuples();
-  int component = histogram->component();
-
-  double range[2];
-  histogram->range(range[0], range[1]);
-  T offset = static_cast<T>(range[0]);
-
-  T* ptr = static_cast<T*>(scalars->WriteVoidPointer(0, tupleNumber));
-  T* endPtr = ptr + tupleNumber * componentNumber;
-  ptr += component;
-  for (; ptr < endPtr; ptr += componentNumber)
-    {
-    Q_ASSERT( (static_cast<long long>(*ptr) - offset) == 
-              (static_cast<int>(*ptr) - offset));
-    binsPtr[static_cast<int>(*ptr - offset)]++;
-    }
+  Q_D(ctkVTKHistogram);
+  d->NumberOfThreads = qMax(0, number);
 }
 
 //-----------------------------------------------------------------------------
-template <class T>
-void populateIrregularBins(vtkIntArray* bins, const ctkVTKHistogram* histogram)
+int ctkVTKHistogram::numberOfThreads()const
 {
-  vtkDataArray* scalars = histogram->dataArray();
-
-  int* binsPtr = bins->WritePointer(0, bins->GetNumberOfComponents()*bins->GetNumberOfTuples());
-  // reset bins to 0
-  memset(binsPtr, 0, bins->GetNumberOfTuples() * sizeof(int));
-
-  const vtkIdType componentNumber = scalars->GetNumberOfComponents();
-  const vtkIdType tupleNumber = scalars->GetNumberOfTuples();
-  int component = histogram->component();
-
-  double range[2];
-  histogram->range(range[0], range[1]);
-  double offset = range[0];
+  Q_D(const ctkVTKHistogram);
+  return d->NumberOfThreads;
+}
 
-  double binWidth = 1.;
-  if (range[1] != range[0])
-    {
-    binWidth = static_cast<double>(bins->GetNumberOfTuples()) / (range[1] - range[0]);
-    }
+//-----------------------------------------------------------------------------
+void ctkVTKHistogram::setProgressive(bool progressive)
+{
+  Q_D(ctkVTKHistogram);
+  d->Progressive = progressive;
+}
 
-  T* ptr = static_cast<T*>(scalars->WriteVoidPointer(0, tupleNumber));
-  T* endPtr = ptr + tupleNumber * componentNumber;
-  ptr += component;
-  for (; ptr < endPtr; ptr += componentNumber)
-    {
-    if (std::numeric_limits<T>::has_quiet_NaN && 
-        std::numeric_limits<T>::quiet_NaN() == *ptr)
-      {
-      continue;
-      }
-    binsPtr[vtkMath::Floor((static_cast<double>(*ptr) - offset) * binWidth)]++;
-    }
+//-----------------------------------------------------------------------------
+bool ctkVTKHistogram::progressive()const
+{
+  Q_D(const ctkVTKHistogram);
+  return d->Progressive;
 }
 
 //-----------------------------------------------------------------------------
@@ -310,51 +514,179 @@ void ctkVTKHistogram::build()
 {
   Q_D(ctkVTKHistogram);
 
+  d->cancelBuild();
+
   if (d->DataArray.GetPointer() == 0)
     {
     d->MinBin = 0;
     d->MaxBin = 0;
-    d->Bins->SetNumberOfTuples(0);
+    d->Bins.clear();
     return;
     }
 
   const int binCount = d->computeNumberOfBins();
 
-  d->Bins->SetNumberOfComponents(1);
-  d->Bins->SetNumberOfTuples(binCount);
-
   if (binCount <= 0)
     {
     d->MinBin = 0;
     d->MaxBin = 0;
+    d->Bins.fill(0, qMax(binCount, 0));
     return;
     }
 
+  ctkVTKHistogramParameters& params = d->Parameters;
+  params.Data = d->DataArray->GetVoidPointer(0);
+  params.DataType = d->DataArray->GetDataType();
+  params.NumberOfComponents = d->DataArray->GetNumberOfComponents();
+  params.Component = d->Component;
+  params.Range[0] = d->Range[0];
+  params.Range[1] = d->Range[1];
+  params.NumberOfBins = binCount;
   // What is the type of the array, discrete or reals
-  if (static_cast<double>(binCount) != (d->Range[1] - d->Range[0] + 1))
+  params.Regular = static_cast<double>(binCount) == (d->Range[1] - d->Range[0] + 1);
+  params.BinWidth = 1.;
+  if (!params.Regular && d->Range[1] != d->Range[0])
     {
-    switch(d->DataArray->GetDataType())
+    params.BinWidth = static_cast<double>(binCount) / (d->Range[1] - d->Range[0]);
+    }
+
+  // Lookup table from the values of 8 and 16-bit integers to their bin
+  params.ValueToBin.clear();
+  params.ValueToBinOffset = 0;
+  switch(params.DataType)
+    {
+    case VTK_CHAR:
+    case VTK_SIGNED_CHAR:
+    case VTK_UNSIGNED_CHAR:
+    case VTK_SHORT:
+    case VTK_UNSIGNED_SHORT:
       {
-      vtkTemplateMacro(populateIrregularBins<VTK_TT>(d->Bins, this));
+      const int typeMin = static_cast<int>(d->DataArray->GetDataTypeMin());
+      const int typeMax = static_cast<int>(d->DataArray->GetDataTypeMax());
+      params.ValueToBin.resize(typeMax - typeMin + 1);
+      params.ValueToBinOffset = typeMin;
+      for (int value = typeMin; value <= typeMax; ++value)
+        {
+        params.ValueToBin[value - typeMin] = params.binIndex(value);
+        }
+      break;
       }
+    default:
+      break;
     }
-  else
+
+  const vtkIdType tupleCount = d->DataArray->GetNumberOfTuples();
+
+  // Count about that many tuples for the coarse histogram
+  const vtkIdType progressiveSampleCount = 1 << 20;
+  if (d->Progressive && tupleCount > 4 * progressiveSampleCount)
     {
-    switch(d->DataArray->GetDataType())
+    const vtkIdType stride = tupleCount / progressiveSampleCount;
+    QVector<qint64> bins = ctkVTKHistogramCount(params, 0, tupleCount, stride, d->threadCount());
+    for (int i = 0; i < bins.size(); ++i)
       {
-      vtkTemplateMacro(populateBins<VTK_TT>(d->Bins, this));
+      bins[i] *= stride;
       }
+    d->setBins(bins);
+
+    d->BuildPending = true;
+    d->BuildWatcher.setFuture(QtConcurrent::run(
+      ctkVTKHistogramCount, params, vtkIdType(0), tupleCount, vtkIdType(1), d->threadCount()));
+    emit changed();
+    return;
+    }
+
+  d->setBins(ctkVTKHistogramCount(params, 0, tupleCount, 1, d->threadCount()));
+  emit changed();
+}
+
+//-----------------------------------------------------------------------------
+void ctkVTKHistogram::waitForBuild()
+{
+  Q_D(ctkVTKHistogram);
+  if (!d->BuildPending)
+    {
+    return;
+    }
+  d->BuildWatcher.waitForFinished();
+  this->onBuildFinished();
+}
+
+//-----------------------------------------------------------------------------
+void ctkVTKHistogram::onBuildFinished()
+{
+  Q_D(ctkVTKHistogram);
+  // The result may have been dropped or already taken by waitForBuild()
+  if (!d->BuildPending)
+    {
+    return;
+    }
+  d->BuildPending = false;
+  d->setBins(d->BuildWatcher.result());
+  emit changed();
+}
+
+//-----------------------------------------------------------------------------
+void ctkVTKHistogram::onDataArrayModified()
+{
+  Q_D(ctkVTKHistogram);
+  // The values counted in the background may have changed or moved
+  d->cancelBuild();
+  emit changed();
+}
+
+//-----------------------------------------------------------------------------
+void ctkVTKHistogram::beginPartialUpdate(vtkIdType firstTuple, vtkIdType lastTuple)
+{
+  Q_D(ctkVTKHistogram);
+  this->waitForBuild();
+  d->PartialUpdate[0] = firstTuple;
+  d->PartialUpdate[1] = lastTuple;
+  if (d->DataArray.GetPointer() == 0 || d->Bins.isEmpty() ||
+      firstTuple < 0 || lastTuple < firstTuple ||
+      lastTuple >= d->DataArray->GetNumberOfTuples())
+    {
+    return;
+    }
+  // Remove the values about to change
+  QVector<qint64> removed = ctkVTKHistogramCount(
+    d->Parameters, firstTuple, lastTuple + 1, 1, d->threadCount());
+  for (int i = 0; i < d->Bins.size(); ++i)
+    {
+    d->Bins[i] -= removed[i];
+    }
+}
+
+//-----------------------------------------------------------------------------
+void ctkVTKHistogram::endPartialUpdate()
+{
+  Q_D(ctkVTKHistogram);
+  const vtkIdType firstTuple = d->PartialUpdate[0];
+  const vtkIdType lastTuple = d->PartialUpdate[1];
+  d->PartialUpdate[0] = 0;
+  d->PartialUpdate[1] = -1;
+  if (d->DataArray.GetPointer() == 0 || d->Bins.isEmpty() ||
+      firstTuple < 0 || lastTuple < firstTuple ||
+      lastTuple >= d->DataArray->GetNumberOfTuples() ||
+      d->DataArray->GetVoidPointer(0) != d->Parameters.Data)
+    {
+    this->build();
+    return;
+    }
+  QVector<qint64> added = ctkVTKHistogramCount(
+    d->Parameters, firstTuple, lastTuple + 1, 1, d->threadCount());
+  if (added.at(d->Parameters.NumberOfBins) != 0)
+    {
+    // New values are out of range
+    this->build();
+    return;
     }
-  // update Min/Max values
-  int* binPtr = d->Bins->GetPointer(0);
-  int* endPtr = d->Bins->GetPointer(binCount-1);
-  d->MinBin = *endPtr;
-  d->MaxBin = *endPtr;
-  for (;binPtr < endPtr; ++binPtr)
+  QVector<qint64> bins = d->Bins;
+  for (int i = 0; i < bins.size(); ++i)
     {
-    d->MinBin = qMin(*binPtr, d->MinBin);
-    d->MaxBin = qMax(*binPtr, d->MaxBin);
+    bins[i] += added[i];
     }
+  d->setBins(bins);
   emit changed();
 }
 
@@ -27,13 +27,17 @@
 #include "ctkVisualizationVTKCoreExport.h"
 #include "ctkVTKObject.h"
 
+// VTK includes
+#include <vtkType.h>
+
 class vtkDataArray;
 class ctkVTKHistogramPrivate;
 
 /// \ingroup Visualization_VTK_Core
 ///
-/// Transfer function for a vtkColorTransferFunction. 
-/// The value is an RGB QColor (no alpha supported)
+/// Histogram of a component of a vtkDataArray.
+/// build() splits the array into one chunk per thread, each thread counts
+/// into its own bins and the bins are summed at the end. Counts are 64-bit.
 class CTK_VISUALIZATION_VTK_CORE_EXPORT ctkVTKHistogram: public ctkHistogram
 {
   Q_OBJECT;
@@ -61,9 +65,40 @@ public:
 
   void setNumberOfBins(int number);
 
+  /// Number of threads used by build(), QThread::idealThreadCount() if 0
+  /// (default).
+  void setNumberOfThreads(int number);
+  int numberOfThreads()const;
+
+  /// If progressive, build() first counts a strided subsample of large
+  /// arrays, emits changed() and counts the whole array in the background.
+  /// changed() is emitted again once the exact histogram is available.
+  /// The background count reads the values of the array: call waitForBuild()
+  /// before reallocating them (e.g. SetNumberOfTuples() or Squeeze()). A
+  /// ModifiedEvent of the array drops the pending count.
+  /// False by default.
+  void setProgressive(bool progressive);
+  bool progressive()const;
+
+  /// Wait for the exact histogram being counted in the background, if any.
+  void waitForBuild();
+
+  /// Update the histogram after editing the tuples firstTuple to lastTuple
+  /// (included) of the array, e.g. the rows of a sub-extent of an image,
+  /// instead of building it again: call beginPartialUpdate() before
+  /// modifying the values and endPartialUpdate() after. If the new values
+  /// are out of the range of the histogram, it is built again.
+  void beginPartialUpdate(vtkIdType firstTuple, vtkIdType lastTuple);
+  void endPartialUpdate();
+
   virtual void removeControlPoint( qreal pos );
 
   virtual void build();
+
+protected Q_SLOTS:
+  void onBuildFinished();
+  void onDataArrayModified();
+
 protected:
   qreal indexToPos(int index)const;
   int posToIndex(qreal pos)const;
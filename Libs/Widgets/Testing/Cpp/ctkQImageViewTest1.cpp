@@ -0,0 +1,226 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QApplication>
+#include <QLabel>
+#include <QTime>
+#include <QTimer>
+#include <QVector>
+
+// CTK includes
+#include "ctkQImageView.h"
+
+// STD includes
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+//-----------------------------------------------------------------------------
+// Gray levels displayed in the middle row of \a view at 1/8, 2/8... 7/8 of
+// its width, away from the overlays. \a width is set to the displayed width.
+QList<int> renderedGrays(const ctkQImageView& view, int& width)
+{
+  QList<int> grays;
+  QLabel* label = view.findChild<QLabel*>();
+  if (!label || !label->pixmap())
+    {
+    width = 0;
+    return grays;
+    }
+  QImage image = label->pixmap()->toImage();
+  width = image.width();
+  for (int i = 1; i < 8; ++i)
+    {
+    grays << qGray(image.pixel(i * width / 8, image.height() / 2));
+    }
+  return grays;
+}
+}
+
+//-----------------------------------------------------------------------------
+int ctkQImageViewTest1(int argc, char * argv [] )
+{
+  QApplication app(argc, argv);
+
+  // 4k x 4k slice of 12-bit values
+  const int size = 4096;
+  QVector<unsigned short> pixels(size * size);
+  for (int y = 0; y < size; ++y)
+    {
+    for (int x = 0; x < size; ++x)
+      {
+      pixels[y * size + x] = static_cast<unsigned short>((x + y) % 4096);
+      }
+    }
+
+  ctkQImageView view;
+  view.resize(1024, 1024);
+  view.show();
+  view.addImage(pixels.constData(), size, size, 12);
+
+  if (view.intensityWindow() != 4095 || view.intensityLevel() != 4095 / 2.)
+    {
+    std::cerr << "Line " << __LINE__ << " - Wrong default window/level: "
+              << view.intensityWindow() << "/" << view.intensityLevel() << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Values are kept at full depth
+  view.setPosition(1001, 2);
+  if (view.positionValue() != 1003)
+    {
+    std::cerr << "Line " << __LINE__ << " - Wrong value: "
+              << view.positionValue() << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Interactive window/level
+  const int frameCount = 60;
+  QTime time;
+  time.start();
+  for (int i = 0; i < frameCount; ++i)
+    {
+    view.setIntensityWindowLevel(400 + i * 10, 1000 + i * 20);
+    }
+  int elapsed = qMax(1, time.elapsed());
+  std::cout << frameCount << " window/level updates in " << elapsed << " ms, "
+            << frameCount * 1000 / elapsed << " fps" << std::endl;
+
+  // Rendered values: 256 x 256 slice whose value is 16 times the column
+  QVector<unsigned short> ramp(256 * 256);
+  for (int i = 0; i < ramp.size(); ++i)
+    {
+    ramp[i] = static_cast<unsigned short>((i % 256) * 16);
+    }
+  ctkQImageView rampView;
+  rampView.resize(512, 512);
+  rampView.show();
+  rampView.addImage(ramp.constData(), 256, 256, 12);
+  rampView.setZoom(1);
+  // keep the position lines out of the sampled pixels
+  rampView.setPosition(0, 0);
+  // the column is displayed as is
+  rampView.setIntensityWindowLevel(4080, 2040);
+  int width = 0;
+  QList<int> grays = renderedGrays(rampView, width);
+  if (width < 256)
+    {
+    std::cerr << "Line " << __LINE__ << " - Slice not displayed: "
+              << width << " pixels wide" << std::endl;
+    return EXIT_FAILURE;
+    }
+  for (int i = 0; i < grays.count(); ++i)
+    {
+    int column = static_cast<int>(((i + 1) * width / 8 + 0.5) * 256. / width);
+    if (grays[i] != column)
+      {
+      std::cerr << "Line " << __LINE__ << " - Wrong gray level at column "
+                << column << ": " << grays[i] << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+  rampView.setInvertImage(true);
+  QList<int> invertedGrays = renderedGrays(rampView, width);
+  for (int i = 0; i < grays.count(); ++i)
+    {
+    if (invertedGrays.value(i) != 255 - grays[i])
+      {
+      std::cerr << "Line " << __LINE__ << " - Wrong inverted gray level: "
+                << invertedGrays.value(i) << " instead of " << 255 - grays[i]
+                << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+  rampView.setInvertImage(false);
+  // the middle half of the columns is displayed, from right to left once
+  // flipped
+  rampView.setZoom(2);
+  QList<int> zoomedGrays = renderedGrays(rampView, width);
+  rampView.setFlipXAxis(true);
+  QList<int> flippedGrays = renderedGrays(rampView, width);
+  for (int i = 0; i < zoomedGrays.count(); ++i)
+    {
+    if (zoomedGrays[i] < 64 || zoomedGrays[i] >= 192 ||
+        (i > 0 && zoomedGrays[i] <= zoomedGrays[i - 1]) ||
+        flippedGrays.value(i) + zoomedGrays[i] != 255)
+      {
+      std::cerr << "Line " << __LINE__ << " - Wrong zoomed gray level: "
+                << zoomedGrays[i] << ", flipped: " << flippedGrays.value(i)
+                << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  view.setZoom(4);
+  view.setFlipXAxis(true);
+  view.setInvertImage(true);
+
+  // QImage slices next to raw slices
+  QImage image(200, 100, QImage::Format_RGB32);
+  image.fill(qRgb(0, 0, 255));
+  view.addImage(image);
+  view.setSliceNumber(1);
+  if (view.sliceNumber() != 1)
+    {
+    std::cerr << "Line " << __LINE__ << " - Failed to select QImage slice" << std::endl;
+    return EXIT_FAILURE;
+    }
+  view.setZoom(2);
+  view.setCenter(100, 50);
+  view.setPosition(199, 99);
+  if (view.xPosition() != 199 || view.yPosition() != 99 ||
+      view.positionValue() != 255)
+    {
+    std::cerr << "Line " << __LINE__ << " - Wrong QImage position/value: "
+              << view.xPosition() << "," << view.yPosition() << " "
+              << view.positionValue() << std::endl;
+    return EXIT_FAILURE;
+    }
+  // Out of the QImage slice, inside the raw slice
+  view.setPosition(300, 10);
+  if (view.xPosition() != 199)
+    {
+    std::cerr << "Line " << __LINE__ << " - Position out of the QImage slice: "
+              << view.xPosition() << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  view.addImage(pixels.constData(), size, size, 12);
+  view.setSliceNumber(2);
+  view.setPosition(300, 10);
+  if (view.positionValue() != 310)
+    {
+    std::cerr << "Line " << __LINE__ << " - Wrong raw value after QImage slice: "
+              << view.positionValue() << std::endl;
+    return EXIT_FAILURE;
+    }
+  view.setSliceNumber(1);
+  view.reset();
+  view.setSliceNumber(0);
+  view.reset();
+
+  if (argc < 2 || QString(argv[1]) != "-I")
+    {
+    QTimer::singleShot(200, &app, SLOT(quit()));
+    }
+  return app.exec();
+}
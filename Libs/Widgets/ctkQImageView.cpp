@@ -35,9 +35,23 @@
 #include <QColor>
 #include <QTextEdit>
 #include <QDialog>
+#include <QVector>
 
 #include <cmath>
 
+//--------------------------------------------------------------------------
+/// 12/16-bit pixels of a slice added with ctkQImageView::addImage(), row
+/// after row.
+struct ctkQImageViewRawImage
+{
+  ctkQImageViewRawImage() : Width( 0 ), Height( 0 ), BitsStored( 16 ) {}
+
+  QVector<unsigned short> Pixels;
+  int Width;
+  int Height;
+  int BitsStored;
+};
+
 //--------------------------------------------------------------------------
 class ctkQImageViewPrivate
 {
@@ -72,7 +86,19 @@ public:
   bool FlipYAxis;
   bool TransposeXY;
 
+  /// Raw slices have a null image in ImageList and their pixels in
+  /// RawImageList. QImage slices have empty pixels in RawImageList.
   QList< QImage > ImageList;
+  QList< ctkQImageViewRawImage > RawImageList;
+
+  /// Window/level lookup table of the raw slices, one entry per value
+  QVector< QRgb > Lut;
+  double LutWindow;
+  double LutLevel;
+  bool   LutInvert;
+
+  /// Visible region of a raw slice, at the resolution of the screen
+  QImage RenderedImage;
 
   QPixmap TmpImage;
   int     TmpXMin;
@@ -93,6 +119,16 @@ public:
 
   double clamp( double x, double xMin, double xMax );
 
+  bool hasSlice() const;
+  bool isRawSlice() const;
+  int sliceWidth() const;
+  int sliceHeight() const;
+
+  void updateLut( int bitsStored );
+  /// Map the visible region of the raw slice through the lookup table,
+  /// one sample per pixel of the screen.
+  void renderRawSlice( int width, int height );
+
   void fitImageRectangle( double x0, double y0, double x1, double y1 );
   
 };
@@ -138,6 +174,11 @@ void ctkQImageViewPrivate::init()
   this->TransposeXY = false;
 
   this->ImageList.clear();
+  this->RawImageList.clear();
+
+  this->LutWindow = 0;
+  this->LutLevel = 0;
+  this->LutInvert = false;
 
   this->TmpXMin = 0;
   this->TmpXMax = 0;
@@ -170,6 +211,118 @@ double ctkQImageViewPrivate::clamp( double x, double xMin,
   return x;
 }
 
+//--------------------------------------------------------------------------
+bool ctkQImageViewPrivate::hasSlice() const
+{
+  return this->SliceNumber >= 0 && this->SliceNumber < this->ImageList.size();
+}
+
+//--------------------------------------------------------------------------
+bool ctkQImageViewPrivate::isRawSlice() const
+{
+  return this->hasSlice()
+    && !this->RawImageList[ this->SliceNumber ].Pixels.isEmpty();
+}
+
+//--------------------------------------------------------------------------
+int ctkQImageViewPrivate::sliceWidth() const
+{
+  if( this->isRawSlice() )
+    {
+    return this->RawImageList[ this->SliceNumber ].Width;
+    }
+  return this->ImageList[ this->SliceNumber ].width();
+}
+
+//--------------------------------------------------------------------------
+int ctkQImageViewPrivate::sliceHeight() const
+{
+  if( this->isRawSlice() )
+    {
+    return this->RawImageList[ this->SliceNumber ].Height;
+    }
+  return this->ImageList[ this->SliceNumber ].height();
+}
+
+//--------------------------------------------------------------------------
+void ctkQImageViewPrivate::updateLut( int bitsStored )
+{
+  const int size = 1 << bitsStored;
+  if( this->Lut.size() == size
+    && this->LutWindow == this->IntensityWindow
+    && this->LutLevel == this->IntensityLevel
+    && this->LutInvert == this->InvertImage )
+    {
+    return;
+    }
+  this->Lut.resize( size );
+  this->LutWindow = this->IntensityWindow;
+  this->LutLevel = this->IntensityLevel;
+  this->LutInvert = this->InvertImage;
+
+  const double lower = this->IntensityLevel - this->IntensityWindow / 2.0;
+  const double scale = this->IntensityWindow > 0
+    ? 255.0 / this->IntensityWindow : 0;
+  QRgb * lut = this->Lut.data();
+  for( int i = 0; i < size; ++i )
+    {
+    int gray = 0;
+    if( scale > 0 )
+      {
+      gray = static_cast<int>( this->clamp( ( i - lower ) * scale, 0, 255 ) + 0.5 );
+      }
+    else if( i >= this->IntensityLevel )
+      {
+      gray = 255;
+      }
+    if( this->InvertImage )
+      {
+      gray = 255 - gray;
+      }
+    lut[i] = qRgb( gray, gray, gray );
+    }
+}
+
+//--------------------------------------------------------------------------
+void ctkQImageViewPrivate::renderRawSlice( int width, int height )
+{
+  const ctkQImageViewRawImage & raw = this->RawImageList[ this->SliceNumber ];
+  this->updateLut( raw.BitsStored );
+
+  if( this->RenderedImage.width() != width
+    || this->RenderedImage.height() != height )
+    {
+    this->RenderedImage = QImage( width, height, QImage::Format_RGB32 );
+    }
+
+  // Nearest source column of each column of the screen
+  const double xStep = static_cast<double>( this->TmpXMax - this->TmpXMin ) / width;
+  const double yStep = static_cast<double>( this->TmpYMax - this->TmpYMin ) / height;
+  QVector<int> columns( width );
+  for( int x = 0; x < width; ++x )
+    {
+    int column = static_cast<int>( ( x + 0.5 ) * xStep );
+    column = this->FlipXAxis ? this->TmpXMax - 1 - column : this->TmpXMin + column;
+    columns[x] = qBound( 0, column, raw.Width - 1 );
+    }
+
+  const QRgb * lut = this->Lut.constData();
+  const int * columnIndexes = columns.constData();
+  for( int y = 0; y < height; ++y )
+    {
+    int row = static_cast<int>( ( y + 0.5 ) * yStep );
+    row = this->FlipYAxis ? this->TmpYMax - 1 - row : this->TmpYMin + row;
+    row = qBound( 0, row, raw.Height - 1 );
+
+    const unsigned short * source = raw.Pixels.constData() + row * raw.Width;
+    QRgb * line = reinterpret_cast< QRgb * >( this->RenderedImage.scanLine( y ) );
+    for( int x = 0; x < width; ++x )
+      {
+      line[x] = lut[ source[ columnIndexes[x] ] ];
+      }
+    }
+}
+
 //--------------------------------------------------------------------------
 void ctkQImageViewPrivate::fitImageRectangle( double x0,
   double x1, double y0, double y1 )
@@ -177,13 +330,13 @@ void ctkQImageViewPrivate::fitImageRectangle( double x0,
   if( this->SliceNumber >= 0 && this->SliceNumber < this->ImageList.size() )
     {
     this->TmpXMin = this->clamp( x0, 0,
-      this->ImageList[ this->SliceNumber ].width() );
+      this->sliceWidth() );
     this->TmpXMax = this->clamp( x1, this->TmpXMin,
-      this->ImageList[ this->SliceNumber ].width() );
+      this->sliceWidth() );
     this->TmpYMin = this->clamp( y0, 0,
-      this->ImageList[ this->SliceNumber ].height() );
+      this->sliceHeight() );
     this->TmpYMax = this->clamp( y1, this->TmpYMin,
-      this->ImageList[ this->SliceNumber ].height() );
+      this->sliceHeight() );
     }
 }
 
@@ -219,6 +372,7 @@ void ctkQImageView::addImage( const QImage & image )
 {
   Q_D( ctkQImageView );
   d->ImageList.push_back( image );
+  d->RawImageList.push_back( ctkQImageViewRawImage() );
   d->TmpXMin = 0;
   d->TmpXMax = image.width();
   d->TmpYMin = 0;
@@ -234,11 +388,58 @@ void ctkQImageView::addImage( const QImage & image )
   this->setCenter( image.width()/2.0, image.height()/2.0 );
 }
 
+// -------------------------------------------------------------------------
+void ctkQImageView::addImage( const unsigned short * pixels,
+  int width, int height, int bitsStored )
+{
+  Q_D( ctkQImageView );
+  if( !pixels || width <= 0 || height <= 0 )
+    {
+    return;
+    }
+  bitsStored = qBound( 1, bitsStored, 16 );
+
+  ctkQImageViewRawImage raw;
+  raw.Width = width;
+  raw.Height = height;
+  raw.BitsStored = bitsStored;
+  raw.Pixels.resize( width * height );
+
+  // Bits above bitsStored may hold overlays, they are masked out to index
+  // the lookup table.
+  const unsigned short mask = static_cast<unsigned short>( ( 1 << bitsStored ) - 1 );
+  unsigned short minValue = mask;
+  unsigned short maxValue = 0;
+  unsigned short * destination = raw.Pixels.data();
+  for( int i = 0; i < width * height; ++i )
+    {
+    unsigned short value = pixels[i] & mask;
+    destination[i] = value;
+    minValue = qMin( minValue, value );
+    maxValue = qMax( maxValue, value );
+    }
+
+  d->ImageList.push_back( QImage() );
+  d->RawImageList.push_back( raw );
+  d->TmpXMin = 0;
+  d->TmpXMax = width;
+  d->TmpYMin = 0;
+  d->TmpYMax = height;
+  d->IntensityMin = minValue;
+  d->IntensityMax = maxValue;
+  this->setIntensityWindowLevel(
+    maxValue - minValue, ( maxValue + minValue ) / 2.0 );
+  this->update( true, false );
+  this->setCenter( width/2.0, height/2.0 );
+}
+
 // -------------------------------------------------------------------------
 void ctkQImageView::clearImages( void )
 {
   Q_D( ctkQImageView );
   d->ImageList.clear();
+  d->RawImageList.clear();
+  d->RenderedImage = QImage();
   this->update( true, true );
 }
 
@@ -246,7 +447,7 @@ void ctkQImageView::clearImages( void )
 double ctkQImageView::xSpacing( void )
 {
   Q_D( ctkQImageView );
-  if( d->SliceNumber >= 0 && d->SliceNumber < d->ImageList.size() )
+  if( d->hasSlice() && !d->isRawSlice() )
     {
     return( 1000.0 / d->ImageList[ d->SliceNumber ].dotsPerMeterX() );
     }
@@ -260,7 +461,7 @@ double ctkQImageView::xSpacing( void )
 double ctkQImageView::ySpacing( void )
 {
   Q_D( ctkQImageView );
-  if( d->SliceNumber >= 0 && d->SliceNumber < d->ImageList.size() )
+  if( d->hasSlice() && !d->isRawSlice() )
     {
     return( 1000.0 / d->ImageList[ d->SliceNumber ].dotsPerMeterY() );
     }
@@ -307,6 +508,12 @@ double ctkQImageView::slicePosition( void )
 double ctkQImageView::positionValue( void )
 {
   Q_D( ctkQImageView );
+  if( d->isRawSlice() )
+    {
+    const ctkQImageViewRawImage & raw = d->RawImageList[ d->SliceNumber ];
+    return raw.Pixels[ static_cast<int>( d->PositionY ) * raw.Width
+      + static_cast<int>( d->PositionX ) ];
+    }
   if( d->SliceNumber >= 0 && d->SliceNumber < d->ImageList.size() )
     {
     QColor vc( d->ImageList[ d->SliceNumber ].pixel( d->PositionX,
@@ -475,14 +682,14 @@ void ctkQImageView::setCenter( double x, double y )
   if( d->SliceNumber >= 0 && d->SliceNumber < d->ImageList.size() )
     {
 	  int tmpXRange = d->TmpXMax - d->TmpXMin;
-    if( tmpXRange > d->ImageList[ d->SliceNumber ].width() )
+    if( tmpXRange > d->sliceWidth() )
       {
-      tmpXRange = d->ImageList[ d->SliceNumber ].width();
+      tmpXRange = d->sliceWidth();
       }
     int tmpYRange = d->TmpYMax - d->TmpYMin;
-    if( tmpYRange > d->ImageList[ d->SliceNumber ].height() )
+    if( tmpYRange > d->sliceHeight() )
       {
-      tmpYRange = d->ImageList[ d->SliceNumber ].height();
+      tmpYRange = d->sliceHeight();
       }
   
     int xMin2 = static_cast<int>(x) - tmpXRange/2.0;
@@ -491,9 +698,9 @@ void ctkQImageView::setCenter( double x, double y )
       xMin2 = 0;
       }
     int xMax2 = xMin2 + tmpXRange;
-    if( xMax2 > d->ImageList[ d->SliceNumber ].width() )
+    if( xMax2 > d->sliceWidth() )
       {
-      xMax2 = d->ImageList[ d->SliceNumber ].width();
+      xMax2 = d->sliceWidth();
       xMin2 = xMax2 - tmpXRange;
       }
     int yMin2 = static_cast<int>(y) - tmpYRange/2.0;
@@ -502,9 +709,9 @@ void ctkQImageView::setCenter( double x, double y )
       yMin2 = 0;
       }
     int yMax2 = yMin2 + tmpYRange;
-    if( yMax2 > d->ImageList[ d->SliceNumber ].height() )
+    if( yMax2 > d->sliceHeight() )
       {
-      yMax2 = d->ImageList[ d->SliceNumber ].height();
+      yMax2 = d->sliceHeight();
       yMin2 = yMax2 - tmpYRange;
       }
     d->fitImageRectangle( xMin2, xMax2, yMin2, yMax2 );
@@ -524,8 +731,8 @@ void ctkQImageView::setPosition( double x, double y )
 {
   Q_D( ctkQImageView );
   if( d->SliceNumber >= 0 && d->SliceNumber < d->ImageList.size() 
-    && x >= 0 && y >= 0 && x < d->ImageList[ d->SliceNumber ].width()
-    && y < d->ImageList[ d->SliceNumber ].height() )
+    && x >= 0 && y >= 0 && x < d->sliceWidth()
+    && y < d->sliceHeight() )
     {
     d->PositionX = x;
     d->PositionY = y;
@@ -555,21 +762,22 @@ void ctkQImageView::setZoom( double factor )
   Q_D( ctkQImageView );
   if( d->SliceNumber >= 0 && d->SliceNumber < d->ImageList.size() )
     {
-    const QImage * img = & d->ImageList[ d->SliceNumber ];
-    if( factor < 2.0 / img->width() )
+    const int imageWidth = d->sliceWidth();
+    const int imageHeight = d->sliceHeight();
+    if( factor < 2.0 / imageWidth )
       {
-      factor = 2.0 / img->width();
+      factor = 2.0 / imageWidth;
       }
-    if( factor > img->width()/2.0 )
+    if( factor > imageWidth/2.0 )
       {
-      factor = img->width()/2.0;
+      factor = imageWidth/2.0;
       }
     d->Zoom = factor;
 
     double cx = d->CenterX;
     double cy = d->CenterY;
-    double x2 = img->width() / factor;
-    double y2 = img->height() / factor;
+    double x2 = imageWidth / factor;
+    double y2 = imageHeight / factor;
 	  
     int xMin2 = static_cast<int>(cx) - x2 / 2.0;
     if( xMin2 < 0 )
@@ -577,9 +785,9 @@ void ctkQImageView::setZoom( double factor )
       xMin2 = 0;
       }
     int xMax2 = xMin2 + x2;
-    if( xMax2 > d->ImageList[ d->SliceNumber ].width() )
+    if( xMax2 > d->sliceWidth() )
       {
-      xMax2 = d->ImageList[ d->SliceNumber ].width();
+      xMax2 = d->sliceWidth();
       xMin2 = xMax2 - x2;
       }
     int yMin2 = static_cast<int>(cy) - y2 / 2.0;
@@ -588,9 +796,9 @@ void ctkQImageView::setZoom( double factor )
       yMin2 = 0;
       }
     int yMax2 = yMin2 + y2;
-    if( yMax2 > d->ImageList[ d->SliceNumber ].height() )
+    if( yMax2 > d->sliceHeight() )
       {
-      yMax2 = d->ImageList[ d->SliceNumber ].height();
+      yMax2 = d->sliceHeight();
       yMin2 = yMax2 - y2;
       }
     d->fitImageRectangle( xMin2, xMax2, yMin2, yMax2 );
@@ -616,8 +824,8 @@ void ctkQImageView::reset( )
 
   if( d->SliceNumber >= 0 && d->SliceNumber < d->ImageList.size() )
     {
-    this->setCenter( d->ImageList[ d->SliceNumber ].width()/2,
-      d->ImageList[ d->SliceNumber ].height()/2 );
+    this->setCenter( d->sliceWidth()/2,
+      d->sliceHeight()/2 );
     }
 }
 
@@ -894,7 +1102,10 @@ void ctkQImageView::update( bool zoomChanged,
   Q_D( ctkQImageView );
   if( d->SliceNumber >= 0 && d->SliceNumber < d->ImageList.size() )
     {
-    const QImage * img = & ( d->ImageList[ d->SliceNumber ] );
+    const int imageWidth = d->sliceWidth();
+    const int imageHeight = d->sliceHeight();
+    const bool isGrayscale = d->isRawSlice()
+      || d->ImageList[ d->SliceNumber ].isGrayscale();
     if( zoomChanged || sizeChanged )
       {
       if( this->width() > 0 &&  this->height() > 0 
@@ -908,7 +1119,7 @@ void ctkQImageView::update( bool zoomChanged,
         if( screenAspectRatio > tmpAspectRatio )
           {
           int extraTmpYAbove = d->TmpYMin;
-          int extraTmpYBelow = img->height() - d->TmpYMax;
+          int extraTmpYBelow = imageHeight - d->TmpYMax;
           int extraTmpYNeeded = tmpXRange * screenAspectRatio 
             - tmpYRange;
           int minExtra = extraTmpYAbove;
@@ -932,14 +1143,14 @@ void ctkQImageView::update( bool zoomChanged,
               }
             else
               {
-              d->TmpYMax = img->height();
+              d->TmpYMax = imageHeight;
               d->TmpYMin -= extraTmpYNeeded - extraTmpYBelow;
               }
             }
           else
             {
             d->TmpYMin = 0;
-            d->TmpYMax = img->height();
+            d->TmpYMax = imageHeight;
             }
           d->TmpImage = QPixmap( this->width(),
             static_cast<unsigned int>( 
@@ -950,7 +1161,7 @@ void ctkQImageView::update( bool zoomChanged,
         else if(screenAspectRatio < tmpAspectRatio)
           {
           int extraTmpXLeft = d->TmpXMin;
-          int extraTmpXRight = img->width() - d->TmpXMax;
+          int extraTmpXRight = imageWidth - d->TmpXMax;
           int extraTmpXNeeded = static_cast<double>(tmpYRange) 
             / screenAspectRatio - tmpXRange;
           int minExtra = extraTmpXLeft;
@@ -974,14 +1185,14 @@ void ctkQImageView::update( bool zoomChanged,
               }
             else
               {
-              d->TmpXMax = img->width();
+              d->TmpXMax = imageWidth;
               d->TmpXMin -= extraTmpXNeeded - extraTmpXRight;
               }
             }
            else
             {
             d->TmpXMin = 0;
-            d->TmpXMax = img->width();
+            d->TmpXMax = imageWidth;
             }
           d->TmpImage = QPixmap( static_cast<unsigned int>( this->height()
             / ( static_cast<double>(d->TmpYMax - d->TmpYMin) 
@@ -997,31 +1208,41 @@ void ctkQImageView::update( bool zoomChanged,
 
     if( d->TmpImage.width() > 0 &&  d->TmpImage.height() > 0)
       {
-      QRectF target( 0, 0, d->TmpImage.width(), d->TmpImage.height() );
-      double sourceX = d->TmpXMin;
-      double sourceY = d->TmpYMin;
-      double sourceW = d->TmpXMax - d->TmpXMin;
-      double sourceH = d->TmpYMax - d->TmpYMin;
       QPainter painter( &(d->TmpImage) );
-      QImage tmpI = *img;
-      if( d->InvertImage )
+      if( d->isRawSlice() )
         {
-        tmpI.invertPixels();
+        // Window/level, invert and flips are applied by the lookup table
+        // pass, to the visible pixels only.
+        d->renderRawSlice( d->TmpImage.width(), d->TmpImage.height() );
+        painter.drawImage( QPoint( 0, 0 ), d->RenderedImage );
         }
-      if( d->FlipXAxis || d->FlipYAxis )
+      else
         {
-        tmpI = tmpI.mirrored( d->FlipXAxis, d->FlipYAxis );
-        if( d->FlipXAxis )
+        QRectF target( 0, 0, d->TmpImage.width(), d->TmpImage.height() );
+        double sourceX = d->TmpXMin;
+        double sourceY = d->TmpYMin;
+        double sourceW = d->TmpXMax - d->TmpXMin;
+        double sourceH = d->TmpYMax - d->TmpYMin;
+        QImage tmpI = d->ImageList[ d->SliceNumber ];
+        if( d->InvertImage )
           {
-          sourceX = tmpI.width() - (d->TmpXMax - d->TmpXMin) - d->TmpXMin;
+          tmpI.invertPixels();
           }
-        if( d->FlipYAxis )
+        if( d->FlipXAxis || d->FlipYAxis )
           {
-          sourceY = tmpI.height() - (d->TmpYMax - d->TmpYMin) - d->TmpYMin;
+          tmpI = tmpI.mirrored( d->FlipXAxis, d->FlipYAxis );
+          if( d->FlipXAxis )
+            {
+            sourceX = tmpI.width() - (d->TmpXMax - d->TmpXMin) - d->TmpXMin;
+            }
+          if( d->FlipYAxis )
+            {
+            sourceY = tmpI.height() - (d->TmpYMax - d->TmpYMin) - d->TmpYMin;
+            }
           }
+        QRectF source( sourceX, sourceY, sourceW, sourceH );
+        painter.drawPixmap( target, QPixmap::fromImage( tmpI ), source );
         }
-      QRectF source( sourceX, sourceY, sourceW, sourceH );
-      painter.drawPixmap( target, QPixmap::fromImage( tmpI ), source );
 
       //if( ! sizeChanged )
         {
@@ -1047,7 +1268,7 @@ void ctkQImageView::update( bool zoomChanged,
           QRectF spaceBound = painter.boundingRect( pointRect, textFlags,
             "X" );
     
-          if( img->isGrayscale() )
+          if( isGrayscale )
             {
             QString intString = "Intensity Range = ";
             intString.append( QString::number( d->IntensityMin,
@@ -1100,10 +1321,10 @@ void ctkQImageView::update( bool zoomChanged,
     
           QString dimString = "Size = ";
           dimString.append( 
-            QString::number( d->ImageList[ d->SliceNumber ].width() ) );
+            QString::number( d->sliceWidth() ) );
           dimString.append( ", " );
           dimString.append( 
-            QString::number( d->ImageList[ d->SliceNumber ].height() ) );
+            QString::number( d->sliceHeight() ) );
           dimString.append( ", " );
           dimString.append( 
             QString::number( d->ImageList.size() ) );
@@ -77,6 +77,13 @@ public:
 
   double zoom( void );
 
+  /// Add a slice of \a width x \a height 12/16-bit pixels, row after row.
+  /// Only the lower \a bitsStored bits are kept. The pixels are copied at
+  /// full depth: window/level is applied at display time through a lookup
+  /// table, to the visible region only and at the resolution of the screen.
+  void addImage( const unsigned short * pixels, int width, int height,
+    int bitsStored = 16 );
+
 public Q_SLOTS:
 
   void addImage( const QImage & image );
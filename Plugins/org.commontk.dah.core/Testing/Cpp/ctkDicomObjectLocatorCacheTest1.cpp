@@ -20,10 +20,13 @@
 =============================================================================*/
 
 // Qt includes
+#include <QTemporaryFile>
+#include <QUrl>
 #include <QUuid>
 
 // CTK includes
 #include <ctkDicomObjectLocatorCache.h>
+#include <ctkDicomSharedMemorySegment.h>
 
 // STD includes
 #include <cstdlib>
@@ -212,5 +215,92 @@ int ctkDicomObjectLocatorCacheTest1(int argc, char* argv[])
     return EXIT_FAILURE;
     }
 
+  //----------------------------------------------------------------------------
+  if (!ctkDicomSharedMemorySegment::isSupported())
+    {
+    return EXIT_SUCCESS;
+    }
+
+  QTemporaryFile file;
+  QByteArray content(1024 * 1024, 'x');
+  content.replace(0, 6, "header");
+  if (!file.open() || file.write(content) != content.size() || !file.flush())
+    {
+    std::cerr << "Line " << __LINE__ << " - Failed to write " << qPrintable(file.fileName()) << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Only the object data, without the header, is shared
+  QString objectUuid3 = QUuid::createUuid();
+  ctkDicomAppHosting::ObjectLocator objectLocator3;
+  objectLocator3.offset = 6;
+  objectLocator3.length = content.size() - 6;
+  objectLocator3.URI = QUrl::fromLocalFile(file.fileName()).toString();
+  cache.insert(objectUuid3, objectLocator3);
+
+  QList<ctkDicomAppHosting::ObjectLocator> sharedObjectLocators =
+    cache.getData(QList<QUuid>() << QUuid(objectUuid3), true);
+  if (sharedObjectLocators.size() != 1
+      || !ctkDicomSharedMemorySegment::isSharedMemoryURI(sharedObjectLocators[0].URI)
+      // macOS limits the segment names to 31 characters
+      || sharedObjectLocators[0].URI.size() - QString("shm://").size() > 31
+      || sharedObjectLocators[0].offset != 0
+      || sharedObjectLocators[0].length != objectLocator3.length
+      || !cache.isShared(objectUuid3))
+    {
+    std::cerr << "Line " << __LINE__ << " - Problem with getData() method" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  ctkDicomSharedMemorySegment segment;
+  if (!segment.attach(sharedObjectLocators[0].URI)
+      || segment.size() != objectLocator3.length
+      || QByteArray::fromRawData(reinterpret_cast<const char*>(segment.constData()), segment.size()) != content.mid(6))
+    {
+    std::cerr << "Line " << __LINE__ << " - Problem with share() method: "
+              << qPrintable(segment.errorString()) << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // The mapping stays valid, but the segment can no longer be attached
+  cache.unshare(objectUuid3);
+  ctkDicomSharedMemorySegment segment2;
+  if (cache.isShared(objectUuid3) || segment2.attach(sharedObjectLocators[0].URI)
+      || segment.constData()[0] != 'x')
+    {
+    std::cerr << "Line " << __LINE__ << " - Problem with unshare() method" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Without shared memory, the file locator is returned
+  if (cache.getData(QList<QUuid>() << QUuid(objectUuid3)).value(0) != objectLocator3)
+    {
+    std::cerr << "Line " << __LINE__ << " - Problem with getData() method" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // The published data is shared ahead of getData()
+  ctkDicomAppHosting::ObjectDescriptor objectDescriptor3;
+  objectDescriptor3.descriptorUUID = objectUuid3;
+  ctkDicomAppHosting::Series series3;
+  series3.objectDescriptors << objectDescriptor3;
+  ctkDicomAppHosting::Study study3;
+  study3.series << series3;
+  ctkDicomAppHosting::Patient patient3;
+  patient3.studies << study3;
+  ctkDicomAppHosting::AvailableData availableData3;
+  availableData3.patients << patient3;
+  if (!cache.share(availableData3) || !cache.isShared(objectUuid3))
+    {
+    std::cerr << "Line " << __LINE__ << " - Problem with share() method" << std::endl;
+    return EXIT_FAILURE;
+    }
+  sharedObjectLocators = cache.getData(QList<QUuid>() << QUuid(objectUuid3), true);
+  if (!ctkDicomSharedMemorySegment::isSharedMemoryURI(sharedObjectLocators.value(0).URI))
+    {
+    std::cerr << "Line " << __LINE__ << " - Problem with getData() method" << std::endl;
+    return EXIT_FAILURE;
+    }
+
   return EXIT_SUCCESS;
 }
@@ -19,14 +19,19 @@
 =========================================================================*/
 
 // Qt includes
+#include <QFile>
 #include <QHash>
+#include <QSharedPointer>
+#include <QUrl>
 #include <QUuid>
 #include <QSet>
+#include <QStringList>
 #include <QDebug>
 
 // CTK includes
 #include "ctkDicomAppHostingTypes.h"
 #include "ctkDicomObjectLocatorCache.h"
+#include "ctkDicomSharedMemorySegment.h"
 
 namespace
 {
@@ -35,7 +40,40 @@ struct ObjectLocatorCacheItem
   ObjectLocatorCacheItem():RefCount(1){}
   ctkDicomAppHosting::ObjectLocator ObjectLocator;
   int RefCount;
+  // Shared with the copies of the item, released with the last one
+  QSharedPointer<ctkDicomSharedMemorySegment> Segment;
+  ctkDicomAppHosting::ObjectLocator SharedObjectLocator;
 };
+
+//----------------------------------------------------------------------------
+void appendDescriptorUUIDs(const ctkDicomAppHosting::ArrayOfObjectDescriptors& objectDescriptors,
+                           QStringList& uuids)
+{
+  foreach(const ctkDicomAppHosting::ObjectDescriptor& objectDescriptor, objectDescriptors)
+    {
+    uuids << objectDescriptor.descriptorUUID;
+    }
+}
+
+//----------------------------------------------------------------------------
+QStringList descriptorUUIDs(const ctkDicomAppHosting::AvailableData& availableData)
+{
+  QStringList uuids;
+  appendDescriptorUUIDs(availableData.objectDescriptors, uuids);
+  foreach(const ctkDicomAppHosting::Patient& patient, availableData.patients)
+    {
+    appendDescriptorUUIDs(patient.objectDescriptors, uuids);
+    foreach(const ctkDicomAppHosting::Study& study, patient.studies)
+      {
+      appendDescriptorUUIDs(study.objectDescriptors, uuids);
+      foreach(const ctkDicomAppHosting::Series& series, study.series)
+        {
+        appendDescriptorUUIDs(series.objectDescriptors, uuids);
+        }
+      }
+    }
+  return uuids;
+}
 }
 
 class ctkDicomObjectLocatorCachePrivate
@@ -209,11 +247,116 @@ bool ctkDicomObjectLocatorCache::remove(const QString& objectUuid)
 }
 
 //----------------------------------------------------------------------------
-QList<ctkDicomAppHosting::ObjectLocator> ctkDicomObjectLocatorCache::getData(const QList<QUuid>& objectUUIDs)
+bool ctkDicomObjectLocatorCache::share(const QString& objectUuid)
 {
+  Q_D(ctkDicomObjectLocatorCache);
+  ObjectLocatorCacheItem item;
+  if (!d->find(objectUuid, item))
+    {
+    return false;
+    }
+  if (item.Segment)
+    {
+    return true;
+    }
+  if (!ctkDicomSharedMemorySegment::isSupported())
+    {
+    return false;
+    }
+
+  const ctkDicomAppHosting::ObjectLocator& objectLocator = item.ObjectLocator;
+  QFile file(QUrl(objectLocator.URI).toLocalFile());
+  if (!file.open(QIODevice::ReadOnly))
+    {
+    qDebug() << "ctkDicomObjectLocatorCache::share - Failed to open" << objectLocator.URI;
+    return false;
+    }
+  qint64 length = objectLocator.length;
+  if (length <= 0)
+    {
+    length = file.size() - objectLocator.offset;
+    }
+
+  QSharedPointer<ctkDicomSharedMemorySegment> segment(new ctkDicomSharedMemorySegment());
+  if (!segment->create(length))
+    {
+    qDebug() << "ctkDicomObjectLocatorCache::share -" << segment->errorString();
+    return false;
+    }
+
+  // Read in chunks, reading 2 GB at once is not supported everywhere
+  const qint64 chunkSize = 64 * 1024 * 1024;
+  qint64 done = 0;
+  if (!file.seek(objectLocator.offset))
+    {
+    done = -1;
+    }
+  while (done >= 0 && done < length)
+    {
+    qint64 read = file.read(reinterpret_cast<char*>(segment->data()) + done, qMin(chunkSize, length - done));
+    done = read > 0 ? done + read : -1;
+    }
+  if (done < 0)
+    {
+    qDebug() << "ctkDicomObjectLocatorCache::share - Failed to read" << objectLocator.URI;
+    return false;
+    }
+
+  item.Segment = segment;
+  item.SharedObjectLocator = objectLocator;
+  item.SharedObjectLocator.URI = segment->uri();
+  item.SharedObjectLocator.offset = 0;
+  item.SharedObjectLocator.length = length;
+  d->ObjectLocatorMap.insert(objectUuid, item);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool ctkDicomObjectLocatorCache::share(const ctkDicomAppHosting::AvailableData& availableData)
+{
+  bool shared = true;
+  foreach(const QString& uuid, descriptorUUIDs(availableData))
+    {
+    shared = this->share(uuid) && shared;
+    }
+  return shared;
+}
+
+//----------------------------------------------------------------------------
+void ctkDicomObjectLocatorCache::unshare(const QString& objectUuid)
+{
+  Q_D(ctkDicomObjectLocatorCache);
+  ObjectLocatorCacheItem item;
+  if (!d->find(objectUuid, item) || !item.Segment)
+    {
+    return;
+    }
+  item.Segment.clear();
+  item.SharedObjectLocator = ctkDicomAppHosting::ObjectLocator();
+  d->ObjectLocatorMap.insert(objectUuid, item);
+}
+
+//----------------------------------------------------------------------------
+bool ctkDicomObjectLocatorCache::isShared(const QString& objectUuid)const
+{
+  Q_D(const ctkDicomObjectLocatorCache);
+  ObjectLocatorCacheItem item;
+  return d->find(objectUuid, item) && !item.Segment.isNull();
+}
+
+//----------------------------------------------------------------------------
+QList<ctkDicomAppHosting::ObjectLocator> ctkDicomObjectLocatorCache::getData(const QList<QUuid>& objectUUIDs,
+                                                                             bool useSharedMemory)
+{
+  Q_D(ctkDicomObjectLocatorCache);
   QList<ctkDicomAppHosting::ObjectLocator> objectLocators;
   foreach(const QUuid& uuid, objectUUIDs)
     {
+    if (useSharedMemory && this->share(uuid))
+      {
+      objectLocators << d->ObjectLocatorMap[uuid].SharedObjectLocator;
+      continue;
+      }
     ctkDicomAppHosting::ObjectLocator objectLocator;
     bool found = this->find(uuid, objectLocator);
     if (!found)
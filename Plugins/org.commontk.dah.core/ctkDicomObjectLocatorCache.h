@@ -32,7 +32,12 @@ class ctkDicomObjectLocatorCachePrivate;
 struct QUuid;
 
 /**
+  * Keeps the ObjectLocators of the data published by a host or a hosted
+  * application.
   *
+  * The data of an object can also be copied into a shared memory segment, see
+  * share() and ctkDicomSharedMemorySegment. The segment is owned by the cache
+  * and released with the object or by unshare().
   */
 class org_commontk_dah_core_EXPORT ctkDicomObjectLocatorCache
 {
@@ -51,7 +56,27 @@ public:
 
   bool remove(const QString& objectUuid);
 
-  QList<ctkDicomAppHosting::ObjectLocator> getData(const QList<QUuid>& objectUUIDs);
+  /// Copy the data of the object, read from the file its ObjectLocator refers
+  /// to, into a shared memory segment. Returns true if the object is shared.
+  bool share(const QString& objectUuid);
+
+  /// Share the objects of \a availableData, so that the copies are done
+  /// when the data is published rather than when it is requested. Returns
+  /// true if all the objects are shared.
+  bool share(const ctkDicomAppHosting::AvailableData& availableData);
+
+  /// Release the shared memory segment of the object, if any. Processes that
+  /// attached the segment keep their mapping.
+  void unshare(const QString& objectUuid);
+
+  bool isShared(const QString& objectUuid)const;
+
+  /// Get the ObjectLocators of the objects. If \a useSharedMemory is true,
+  /// the objects not shared yet are shared first and the returned
+  /// ObjectLocators refer to their segment, the objects that can not be
+  /// shared keep their locator.
+  QList<ctkDicomAppHosting::ObjectLocator> getData(const QList<QUuid>& objectUUIDs,
+                                                   bool useSharedMemory = false);
 
 private:
   Q_DECLARE_PRIVATE(ctkDicomObjectLocatorCache)
@@ -0,0 +1,281 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+
+// Qt includes
+#include <QAtomicInt>
+#include <QCoreApplication>
+
+// CTK includes
+#include "ctkDicomSharedMemorySegment.h"
+
+#ifdef Q_OS_UNIX
+// STD includes
+#include <cerrno>
+#include <cstring>
+
+// POSIX includes
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+const char* const SharedMemoryScheme = "shm://";
+
+// Segments created by this process, to make their name unique
+QAtomicInt SegmentCounter;
+
+// POSIX names start with a single slash and contain no other one. They must
+// be short: macOS does not accept names longer than 31 characters.
+QString nextSegmentName()
+{
+  const quint64 id = (quint64(QCoreApplication::applicationPid()) << 32)
+    | quint32(SegmentCounter.fetchAndAddRelaxed(1));
+  return QString("/ctk-%1").arg(id, 16, 16, QChar('0'));
+}
+}
+
+class ctkDicomSharedMemorySegmentPrivate
+{
+public:
+  ctkDicomSharedMemorySegmentPrivate();
+
+  void setSystemError(const QString& function);
+
+  QString Name;
+  uchar* Data;
+  qint64 Size;
+  bool Owner;
+  bool ReadOnly;
+  QString ErrorString;
+};
+
+//----------------------------------------------------------------------------
+// ctkDicomSharedMemorySegmentPrivate methods
+
+//----------------------------------------------------------------------------
+ctkDicomSharedMemorySegmentPrivate::ctkDicomSharedMemorySegmentPrivate()
+  : Data(0), Size(0), Owner(false), ReadOnly(true)
+{
+}
+
+//----------------------------------------------------------------------------
+void ctkDicomSharedMemorySegmentPrivate::setSystemError(const QString& function)
+{
+#ifdef Q_OS_UNIX
+  this->ErrorString = QString("%1 %2: %3").arg(function, this->Name, QString::fromLocal8Bit(strerror(errno)));
+#else
+  this->ErrorString = QString("%1 %2: shared memory is not supported").arg(function, this->Name);
+#endif
+}
+
+//----------------------------------------------------------------------------
+// ctkDicomSharedMemorySegment methods
+
+//----------------------------------------------------------------------------
+ctkDicomSharedMemorySegment::ctkDicomSharedMemorySegment() : d_ptr(new ctkDicomSharedMemorySegmentPrivate())
+{
+}
+
+//----------------------------------------------------------------------------
+ctkDicomSharedMemorySegment::~ctkDicomSharedMemorySegment()
+{
+  this->detach();
+}
+
+//----------------------------------------------------------------------------
+bool ctkDicomSharedMemorySegment::isSupported()
+{
+#ifdef Q_OS_UNIX
+  return true;
+#else
+  return false;
+#endif
+}
+
+//----------------------------------------------------------------------------
+bool ctkDicomSharedMemorySegment::isSharedMemoryURI(const QString& uri)
+{
+  return uri.startsWith(SharedMemoryScheme, Qt::CaseInsensitive);
+}
+
+//----------------------------------------------------------------------------
+bool ctkDicomSharedMemorySegment::create(qint64 size)
+{
+  Q_D(ctkDicomSharedMemorySegment);
+  this->detach();
+
+  d->Name = nextSegmentName();
+
+#ifdef Q_OS_UNIX
+  QByteArray name = d->Name.toLatin1();
+  int fd = shm_open(name.constData(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+  // A segment left by a crashed process with the same pid may use the name
+  for (int attempt = 0; fd < 0 && errno == EEXIST && attempt < 100; ++attempt)
+    {
+    d->Name = nextSegmentName();
+    name = d->Name.toLatin1();
+    fd = shm_open(name.constData(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+    }
+  if (fd < 0)
+    {
+    d->setSystemError("shm_open");
+    return false;
+    }
+  if (ftruncate(fd, size) != 0)
+    {
+    d->setSystemError("ftruncate");
+    close(fd);
+    shm_unlink(name.constData());
+    return false;
+    }
+  void* data = size > 0 ? mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : 0;
+  if (data == MAP_FAILED)
+    {
+    d->setSystemError("mmap");
+    close(fd);
+    shm_unlink(name.constData());
+    return false;
+    }
+  // the mapping keeps the segment alive
+  close(fd);
+
+  d->Data = static_cast<uchar*>(data);
+  d->Size = size;
+  d->Owner = true;
+  d->ReadOnly = false;
+  return true;
+#else
+  Q_UNUSED(size);
+  d->setSystemError("create");
+  return false;
+#endif
+}
+
+//----------------------------------------------------------------------------
+bool ctkDicomSharedMemorySegment::attach(const QString& uri)
+{
+  Q_D(ctkDicomSharedMemorySegment);
+  this->detach();
+
+  if (!isSharedMemoryURI(uri))
+    {
+    d->ErrorString = QString("attach %1: not a shared memory URI").arg(uri);
+    return false;
+    }
+  d->Name = uri.mid(QString(SharedMemoryScheme).size());
+
+#ifdef Q_OS_UNIX
+  const QByteArray name = d->Name.toLatin1();
+  int fd = shm_open(name.constData(), O_RDONLY, 0);
+  if (fd < 0)
+    {
+    d->setSystemError("shm_open");
+    return false;
+    }
+  struct stat status;
+  void* data = MAP_FAILED;
+  if (fstat(fd, &status) == 0)
+    {
+    data = status.st_size > 0 ? mmap(0, status.st_size, PROT_READ, MAP_SHARED, fd, 0) : 0;
+    }
+  if (data == MAP_FAILED)
+    {
+    d->setSystemError("mmap");
+    close(fd);
+    return false;
+    }
+  close(fd);
+
+  d->Data = static_cast<uchar*>(data);
+  d->Size = status.st_size;
+  d->Owner = false;
+  d->ReadOnly = true;
+  return true;
+#else
+  d->setSystemError("attach");
+  return false;
+#endif
+}
+
+//----------------------------------------------------------------------------
+void ctkDicomSharedMemorySegment::detach()
+{
+  Q_D(ctkDicomSharedMemorySegment);
+#ifdef Q_OS_UNIX
+  if (d->Data)
+    {
+    munmap(d->Data, d->Size);
+    }
+  if (d->Owner)
+    {
+    shm_unlink(d->Name.toLatin1().constData());
+    }
+#endif
+  d->Data = 0;
+  d->Size = 0;
+  d->Owner = false;
+  d->ReadOnly = true;
+}
+
+//----------------------------------------------------------------------------
+bool ctkDicomSharedMemorySegment::isAttached()const
+{
+  Q_D(const ctkDicomSharedMemorySegment);
+  return d->Data != 0 || d->Owner;
+}
+
+//----------------------------------------------------------------------------
+QString ctkDicomSharedMemorySegment::uri()const
+{
+  Q_D(const ctkDicomSharedMemorySegment);
+  return QString(SharedMemoryScheme) + d->Name;
+}
+
+//----------------------------------------------------------------------------
+qint64 ctkDicomSharedMemorySegment::size()const
+{
+  Q_D(const ctkDicomSharedMemorySegment);
+  return d->Size;
+}
+
+//----------------------------------------------------------------------------
+uchar* ctkDicomSharedMemorySegment::data()
+{
+  Q_D(ctkDicomSharedMemorySegment);
+  return d->ReadOnly ? 0 : d->Data;
+}
+
+//----------------------------------------------------------------------------
+const uchar* ctkDicomSharedMemorySegment::constData()const
+{
+  Q_D(const ctkDicomSharedMemorySegment);
+  return d->Data;
+}
+
+//----------------------------------------------------------------------------
+QString ctkDicomSharedMemorySegment::errorString()const
+{
+  Q_D(const ctkDicomSharedMemorySegment);
+  return d->ErrorString;
+}
@@ -0,0 +1,91 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+
+#ifndef CTKDICOMSHAREDMEMORYSEGMENT_H
+#define CTKDICOMSHAREDMEMORYSEGMENT_H
+
+// Qt includes
+#include <QScopedPointer>
+#include <QString>
+
+// CTK includes
+#include <org_commontk_dah_core_Export.h>
+
+class ctkDicomSharedMemorySegmentPrivate;
+
+/**
+  * Memory shared between a host and a hosted application running on the same
+  * machine, used to hand over bulk data without writing it to a file.
+  *
+  * A segment is referenced by an ObjectLocator whose URI has the "shm" scheme,
+  * e.g. shm:///ctk-<16 hex digits>, with offset 0 and the segment size as length.
+  * The side creating the segment owns its name: the segment is unlinked when
+  * the creating object is destroyed, the mappings of the other processes stay
+  * valid until they detach.
+  *
+  * POSIX shared memory is used (shm_open), the segment is only identified
+  * by its name and can thus be described in a SOAP message. On other
+  * platforms, isSupported() returns false.
+  */
+class org_commontk_dah_core_EXPORT ctkDicomSharedMemorySegment
+{
+
+public:
+
+  ctkDicomSharedMemorySegment();
+  virtual ~ctkDicomSharedMemorySegment();
+
+  /// Returns true if shared memory segments are available on this platform
+  static bool isSupported();
+
+  /// Returns true if \a uri references a shared memory segment
+  static bool isSharedMemoryURI(const QString& uri);
+
+  /// Create a new segment of \a size bytes, mapped read-write
+  bool create(qint64 size);
+
+  /// Map the segment referenced by \a uri read-only
+  bool attach(const QString& uri);
+
+  /// Unmap the segment, and unlink it if it was created by this object
+  void detach();
+
+  bool isAttached()const;
+
+  /// The URI of the segment, to be used as ObjectLocator::URI
+  QString uri()const;
+
+  qint64 size()const;
+
+  /// The mapped data, NULL if the segment was attached read-only
+  uchar* data();
+  const uchar* constData()const;
+
+  /// The error of the last failed create() or attach()
+  QString errorString()const;
+
+private:
+  Q_DECLARE_PRIVATE(ctkDicomSharedMemorySegment)
+  Q_DISABLE_COPY(ctkDicomSharedMemorySegment)
+  const QScopedPointer<ctkDicomSharedMemorySegmentPrivate> d_ptr;
+};
+
+#endif // CTKDICOMSHAREDMEMORYSEGMENT_H
@@ -26,13 +26,18 @@
 #include <QPushButton>
 #include <QApplication>
 #include <QLabel>
+#include <QScopedPointer>
+#include <QTime>
 
 // CTK includes
 #include "ctkDICOMImage.h"
+#include "ctkDicomSharedMemorySegment.h"
 #include "ctkExampleDicomAppLogic_p.h"
 #include "ctkExampleDicomAppPlugin_p.h"
 
 // DCMTK includes
+#include <dcfilefo.h>
+#include <dcistrmb.h>
 #include <dcmimage.h>
 
 //----------------------------------------------------------------------------
@@ -217,7 +222,10 @@ void ctkExampleDicomAppLogic::buttonClicked()
   QList<QString> transfersyntaxlist;
   transfersyntaxlist.append(transfersyntax);
   QList<ctkDicomAppHosting::ObjectLocator> locators;
+  QTime time;
+  time.start();
   locators = getHostInterface()->getData(uuidlist, transfersyntaxlist, false);
+  const int getDataTime = time.elapsed();
   qDebug() << "got locators! " << QString().setNum(locators.count());
 
   QString s;
@@ -226,12 +234,50 @@ void ctkExampleDicomAppLogic::buttonClicked()
   {
     s=s+" URI: "+locators.begin()->URI +" locatorUUID: "+locators.begin()->locator+" sourceUUID: "+locators.begin()->source;
     qDebug() << "URI: " << locators.begin()->URI;
-    QString filename = locators.begin()->URI;
-    if(filename.startsWith("file:/",Qt::CaseInsensitive))
-      filename=filename.remove(0,8);
-    qDebug()<<filename;
-    DicomImage dcmtkImage(filename.toLatin1().data());
-    ctkDICOMImage ctkImage(&dcmtkImage);
+
+    // the data is either in shared memory or in a file
+    time.start();
+    ctkDicomSharedMemorySegment segment;
+    DcmFileFormat fileFormat;
+    QScopedPointer<DicomImage> dcmtkImage;
+    if(ctkDicomSharedMemorySegment::isSharedMemoryURI(locators.begin()->URI))
+    {
+      if(!segment.attach(locators.begin()->URI))
+      {
+        qCritical() << segment.errorString();
+        return;
+      }
+      // the stream parses the mapping in place, only the element values
+      // are copied into the dataset, as when reading a file
+      DcmInputBufferStream stream;
+      stream.setBuffer(segment.constData(), segment.size());
+      stream.setEos();
+      fileFormat.transferInit();
+      OFCondition condition = fileFormat.read(stream);
+      fileFormat.transferEnd();
+      if(condition.bad())
+      {
+        qCritical() << "Failed to read the shared dataset:" << condition.text();
+        return;
+      }
+      dcmtkImage.reset(new DicomImage(&fileFormat, EXS_Unknown));
+    }
+    else
+    {
+      QString filename = locators.begin()->URI;
+      if(filename.startsWith("file:/",Qt::CaseInsensitive))
+        filename=filename.remove(0,8);
+      qDebug()<<filename;
+      dcmtkImage.reset(new DicomImage(filename.toLatin1().data()));
+    }
+    const int loadTime = time.elapsed();
+    qDebug() << "getData:" << getDataTime << "ms, loading" << locators.begin()->length / (1024 * 1024)
+             << "MB:" << loadTime << "ms from" << locators.begin()->URI;
+
+    // the image is loaded, the host can release its shared memory
+    getHostInterface()->releaseData(uuidlist);
+
+    ctkDICOMImage ctkImage(dcmtkImage.data());
 
     QLabel* qtImage = new QLabel;
     QPixmap pixmap = QPixmap::fromImage(ctkImage.frame(0),Qt::AvoidDither);
@@ -28,6 +28,8 @@
 #include "ctkExampleDicomHost.h"
 #include "ctkDicomAppHostingTypesHelper.h"
 #include "ctkDicomAvailableDataHelper.h"
+#include "ctkDicomObjectLocatorCache.h"
+#include "ctkDicomSharedMemorySegment.h"
 
 // STD includes
 #include <iostream>
@@ -46,6 +48,11 @@ ctkExampleDicomHost::ctkExampleDicomHost(ctkHostedAppPlaceholderWidget* placehol
   connect(this,SIGNAL(suspended()),this,SLOT(onSuspended()));
   connect(this,SIGNAL(canceled()),this,SLOT(onCanceled()));
   connect(this,SIGNAL(exited()),this,SLOT(onExited()));
+
+  // the hosted app runs on the same machine,
+  // set CTK_DAH_NO_SHARED_MEMORY to compare with the file based data exchange
+  this->setSharedMemoryEnabled(ctkDicomSharedMemorySegment::isSupported()
+                               && qgetenv("CTK_DAH_NO_SHARED_MEMORY").isEmpty());
 }
 
 //----------------------------------------------------------------------------
@@ -122,10 +129,17 @@ void ctkExampleDicomHost::onAppReady()
 //----------------------------------------------------------------------------
 void ctkExampleDicomHost::onStartProgress()
 {
+  // CTK_DAH_EXAMPLE_DATA may point to the dataset to publish
+  QString fileName = QString::fromLocal8Bit(qgetenv("CTK_DAH_EXAMPLE_DATA"));
+  if (fileName.isEmpty())
+  {
+    fileName = "C:/XIP/XIPHost/dicom-dataset-demo/1.3.6.1.4.1.9328.50.1.10698.dcm";
+  }
+
   ctkDicomAppHosting::AvailableData data;
   ctkDicomAvailableDataHelper::addToAvailableData(data, 
     this->objectLocatorCache(), 
-    "C:/XIP/XIPHost/dicom-dataset-demo/1.3.6.1.4.1.9328.50.1.10698.dcm");
+    fileName);
 
   qDebug()<<"send dataDescriptors";
   bool success = this->publishData(data, true);
@@ -175,7 +189,10 @@ void ctkExampleDicomHost::onReleaseAvailableResources()
 //----------------------------------------------------------------------------
 void ctkExampleDicomHost::releaseData(const QList<QUuid>& objectUUIDs)
 {
-  Q_UNUSED(objectUUIDs)
+  foreach(const QUuid& uuid, objectUUIDs)
+  {
+    this->objectLocatorCache()->unshare(uuid);
+  }
 }
 
 void ctkExampleDicomHost::exitApplication()
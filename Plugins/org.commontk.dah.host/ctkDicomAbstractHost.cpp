@@ -40,6 +40,7 @@ public:
   ctkDicomAppInterface* AppService;
   ctkDicomAppHosting::State AppState;
   ctkDicomObjectLocatorCache ObjectLocatorCache;
+  bool SharedMemoryEnabled;
   // ctkDicomAppHosting::Status
 
 };
@@ -49,7 +50,8 @@ public:
 
 //----------------------------------------------------------------------------
 ctkDicomAbstractHostPrivate::ctkDicomAbstractHostPrivate(
-  ctkDicomAbstractHost* hostInterface, int hostPort, int appPort) : HostPort(hostPort), AppPort(appPort),AppState(ctkDicomAppHosting::EXIT)
+  ctkDicomAbstractHost* hostInterface, int hostPort, int appPort) : HostPort(hostPort), AppPort(appPort),AppState(ctkDicomAppHosting::EXIT),
+  SharedMemoryEnabled(false)
 {
   // start server
   if (this->HostPort == 0)
@@ -111,6 +113,20 @@ ctkDicomAppInterface* ctkDicomAbstractHost::getDicomAppService() const
   return d->AppService;
 }
 
+//----------------------------------------------------------------------------
+void ctkDicomAbstractHost::setSharedMemoryEnabled(bool enabled)
+{
+  Q_D(ctkDicomAbstractHost);
+  d->SharedMemoryEnabled = enabled;
+}
+
+//----------------------------------------------------------------------------
+bool ctkDicomAbstractHost::isSharedMemoryEnabled() const
+{
+  Q_D(const ctkDicomAbstractHost);
+  return d->SharedMemoryEnabled;
+}
+
 //----------------------------------------------------------------------------
 QList<ctkDicomAppHosting::ObjectLocator> ctkDicomAbstractHost::getData(
   const QList<QUuid>& objectUUIDs,
@@ -119,7 +135,7 @@ QList<ctkDicomAppHosting::ObjectLocator> ctkDicomAbstractHost::getData(
 {
   Q_UNUSED(acceptableTransferSyntaxUIDs);
   Q_UNUSED(includeBulkData);
-  return this->objectLocatorCache()->getData(objectUUIDs);
+  return this->objectLocatorCache()->getData(objectUUIDs, this->isSharedMemoryEnabled());
 }
 
 //----------------------------------------------------------------------------
@@ -136,6 +152,11 @@ bool ctkDicomAbstractHost::publishData(const ctkDicomAppHosting::AvailableData&
   {
     return false;
   }
+  // copy the data into shared memory now, getData() only returns the locators
+  if (this->isSharedMemoryEnabled())
+  {
+    this->objectLocatorCache()->share(availableData);
+  }
   bool success = this->getDicomAppService()->notifyDataAvailable(availableData, lastData);
   if(!success)
   {
@@ -102,8 +102,28 @@ public:
   */
   ctkDicomAppInterface* getDicomAppService() const;
 
+  /**
+   * @brief Sets whether getData() hands the data over in shared memory.
+   * Only for a hosted app running on the same machine and able to read
+   * the "shm" URIs of ctkDicomSharedMemorySegment. Disabled by default.
+   * The data is copied into shared memory by publishData(), ahead of the
+   * getData() calls of the app.
+   *
+   * @param enabled
+  */
+  void setSharedMemoryEnabled(bool enabled);
+
+  /**
+   * @brief Gets whether getData() hands the data over in shared memory.
+   *
+   * @return bool
+  */
+  bool isSharedMemoryEnabled() const;
+
   /**
    * @brief Gets ctkDicomAppHosting::ObjectLocators from the hosted app.
+   * If shared memory is enabled, the data is copied into shared memory
+   * segments owned by the objectLocatorCache().
    *
    * @param objectUUIDs
    * @param acceptableTransferSyntaxUIDs
@@ -123,7 +143,9 @@ public:
   ctkDicomObjectLocatorCache* objectLocatorCache() const;
 
   /**
-   * @brief
+   * @brief Notifies the hosted app of the available data, which has to be
+   * in the objectLocatorCache(). The data is shared first if shared memory
+   * is enabled.
    *
    * @param availableData
    * @param lastData
@@ -42,6 +42,7 @@ const QString ctkEAConfiguration::PROP_TIMEOUT = "org.commontk.eventadmin.Timeou
 const QString ctkEAConfiguration::PROP_REQUIRE_TOPIC = "org.commontk.eventadmin.RequireTopic";
 const QString ctkEAConfiguration::PROP_IGNORE_TIMEOUT = "org.commontk.eventadmin.IgnoreTimeout";
 const QString ctkEAConfiguration::PROP_LOG_LEVEL = "org.commontk.eventadmin.LogLevel";
+const QString ctkEAConfiguration::PROP_COALESCE_EVENTS = "org.commontk.eventadmin.CoalesceEvents";
 
 
 ctkEAConfiguration::ctkEAConfiguration(ctkPluginContext* pluginContext )
@@ -93,11 +94,8 @@ void ctkEAConfiguration::configure(const ctkDictionary& config )
 {
   if (config.isEmpty())
   {
-    // The size of various internal caches. At the moment there are 4
-    // internal caches affected. Each will cache the determined amount of
-    // small but frequently used objects (i.e., in case of the default value
-    // we end-up with a total of 120 small objects being cached). A value of less
-    // then 10 triggers the default value.
+    // Ignored, only read to be reported by the metatype provider: the event
+    // handlers are indexed by topic, see ctkEATopicHandlerIndex.
     cacheSize = getIntProperty(PROP_CACHE_SIZE,
                                pluginContext->getProperty(PROP_CACHE_SIZE), 30, 10);
 
@@ -137,6 +135,11 @@ void ctkEAConfiguration::configure(const ctkDictionary& config )
                               pluginContext->getProperty(PROP_LOG_LEVEL),
                               ctkLogService::LOG_WARNING, // default log level is WARNING
                               ctkLogService::LOG_ERROR);
+
+    // Are posted events marked with EVENT_COALESCE dropped for a handler when
+    // a newer marked event of the same topic is waiting for delivery to it? - The default
+    // is true, events are only coalesced if their sender marked them.
+    coalesceEvents = getBoolProperty(pluginContext->getProperty(PROP_COALESCE_EVENTS), true);
   }
   else
   {
@@ -159,6 +162,7 @@ void ctkEAConfiguration::configure(const ctkDictionary& config )
                               config.value(PROP_LOG_LEVEL),
                               ctkLogService::LOG_WARNING, // default log level is WARNING
                               ctkLogService::LOG_ERROR);
+    coalesceEvents = getBoolProperty(config.value(PROP_COALESCE_EVENTS), true);
   }
   // a timeout less or equals to 100 means : disable timeout
   if (timeout <= 100)
@@ -222,14 +226,8 @@ void ctkEAConfiguration::startOrUpdate()
       << PROP_TIMEOUT << "=" << timeout;
   CTK_DEBUG(ctkEventAdminActivator::getLogService())
       << PROP_REQUIRE_TOPIC << "=" << requireTopic;
-
-  ctkEventAdminService::TopicHandlerFiltersInterface* topicHandlerFilters =
-      new ctkEventAdminService::TopicHandlerFilters(
-        new ctkEventAdminService::TopicCacheMap(cacheSize), requireTopic);
-
-  ctkEventAdminService::FiltersInterface* filters =
-      new ctkEventAdminService::Filters(
-        new ctkEventAdminService::LDAPCacheMap(cacheSize), pluginContext);
+  CTK_DEBUG(ctkEventAdminActivator::getLogService())
+      << PROP_COALESCE_EVENTS << "=" << coalesceEvents;
 
   // Note that this uses a lazy thread pool that will create new threads on
   // demand - in case none of its cached threads is free - until threadPoolSize
@@ -260,12 +258,13 @@ void ctkEAConfiguration::startOrUpdate()
   // below (and not in this HandlerTasks object!)
   ctkEventAdminService::HandlerTasksInterface* handlerTasks =
       new ctkEventAdminService::BlacklistingHandlerTasks(
-        pluginContext, new ctkEventAdminService::BlackList(), topicHandlerFilters, filters);
+        pluginContext, new ctkEventAdminService::BlackList(),
+        new ctkEATopicHandlerIndex(pluginContext, requireTopic));
 
   if (admin == 0)
   {
     admin = new ctkEventAdminService(pluginContext, handlerTasks, sync_pool, async_pool,
-                                     timeout, ignoreTimeout);
+                                     timeout, ignoreTimeout, coalesceEvents);
 
     // Finally, adapt the outside events to our kind of events as per spec
     adaptEvents(admin);
@@ -280,7 +279,7 @@ void ctkEAConfiguration::startOrUpdate()
   }
   else
   {
-    admin->update(handlerTasks, timeout, ignoreTimeout);
+    admin->update(handlerTasks, timeout, ignoreTimeout, coalesceEvents);
   }
 
 }
@@ -298,7 +297,8 @@ QObject* ctkEAConfiguration::tryToCreateMetaTypeProvider(ctkManagedService* mana
   try
   {
     return new ctkEAMetaTypeProvider(managedService, cacheSize, threadPoolSize,
-                                     timeout, requireTopic, ignoreTimeout);
+                                     timeout, requireTopic, ignoreTimeout,
+                                     coalesceEvents);
   }
   catch (...)
   {
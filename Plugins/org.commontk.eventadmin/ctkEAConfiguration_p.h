@@ -40,11 +40,10 @@ class ctkEAAbstractAdapter;
  * The service knows about the following properties which are read at plugin startup:
  * <p>
  * <p>
- *      <tt>org.commontk.eventadmin.CacheSize</tt> - The size of various internal
- *          caches.
- * </p>
- * The default value is 30. Increase in case of a large number (more then 100) of
- * <tt>ctkEventHandler</tt> services. A value less then 10 triggers the default value.
+ *      <tt>org.commontk.eventadmin.CacheSize</tt> - Ignored. It used to be the
+ *          size of the caches of the event handler filters, the handlers are
+ *          now indexed by topic and their filters parsed once. The property is
+ *          still accepted for compatibility with existing configurations.
  * </p>
  * <p>
  * <p>
@@ -89,6 +88,17 @@ class ctkEAAbstractAdapter;
  * pure optimization!
  * The value is a list of strings (separated by comma) which is assumed to define
  * exact class names.
+ * </p>
+ * <p>
+ * <p>
+ *      <tt>org.commontk.eventadmin.CoalesceEvents</tt> - Are posted events marked
+ *          with <tt>ctkEventConstants::EVENT_COALESCE</tt> coalesced?
+ * </p>
+ * The default is <tt>true</tt>. A posted event marked with
+ * <tt>ctkEventConstants::EVENT_COALESCE</tt> is not delivered to a handler if a newer
+ * marked event of the same topic, posted by the same thread, is waiting for delivery
+ * to that handler as well.
+ * Setting this value to <tt>false</tt> delivers all posted events.
  *
  * These properties are read at startup and serve as a default configuration.
  * If a configuration admin is configured, the event admin can be configured
@@ -110,6 +120,7 @@ public:
   static const QString PROP_REQUIRE_TOPIC; // = "org.commontk.eventadmin.RequireTopic"
   static const QString PROP_IGNORE_TIMEOUT; // = "org.commontk.eventadmin.IgnoreTimeout"
   static const QString PROP_LOG_LEVEL; // = "org.commontk.eventadmin.LogLevel"
+  static const QString PROP_COALESCE_EVENTS; // = "org.commontk.eventadmin.CoalesceEvents"
 
 private:
 
@@ -130,6 +141,8 @@ private:
 
   int logLevel;
 
+  bool coalesceEvents;
+
   // The thread pool used - this is a member because we need to close it on stop
   ctkEADefaultThreadPool* sync_pool;
   ctkEADefaultThreadPool* async_pool;
@@ -147,9 +147,10 @@ public:
 
 ctkEAMetaTypeProvider::ctkEAMetaTypeProvider(ctkManagedService* delegatee, int cacheSize,
                                              int threadPoolSize, int timeout, bool requireTopic,
-                                             const QStringList& ignoreTimeout)
+                                             const QStringList& ignoreTimeout, bool coalesceEvents)
   : m_cacheSize(cacheSize), m_threadPoolSize(threadPoolSize), m_timeout(timeout),
-    m_requireTopic(requireTopic), m_ignoreTimeout(ignoreTimeout), m_delegatee(delegatee)
+    m_requireTopic(requireTopic), m_ignoreTimeout(ignoreTimeout),
+    m_coalesceEvents(coalesceEvents), m_delegatee(delegatee)
 {
 }
 
@@ -178,9 +179,8 @@ ctkObjectClassDefinitionPtr ctkEAMetaTypeProvider::getObjectClassDefinition(cons
 
     adList.push_back(ctkAttributeDefinitionPtr(
                        new AttributeDefinitionImpl(ctkEAConfiguration::PROP_CACHE_SIZE, "Cache Size",
-                                                   "The size of various internal caches. The default value is 30. Increase in case "
-                                                   "of a large number (more then 100) of services. A value less then 10 triggers the "
-                                                   "default value.", QVariant::Int, QStringList(QString::number(m_cacheSize)))));
+                                                   "Ignored, kept for compatibility. The event handlers are indexed by topic "
+                                                   "and need no cache.", QVariant::Int, QStringList(QString::number(m_cacheSize)))));
 
     adList.push_back(ctkAttributeDefinitionPtr(
                        new AttributeDefinitionImpl(ctkEAConfiguration::PROP_THREAD_POOL_SIZE, "Thread Pool Size",
@@ -218,6 +218,14 @@ ctkObjectClassDefinitionPtr ctkEAMetaTypeProvider::getObjectClassDefinition(cons
                                                    QVariant::String, m_ignoreTimeout, 0,
                                                    QStringList(QString::number(std::numeric_limits<int>::max())))));
 
+    adList.push_back(ctkAttributeDefinitionPtr(
+                       new AttributeDefinitionImpl(ctkEAConfiguration::PROP_COALESCE_EVENTS, "Coalesce Events",
+                                                   "Are posted events marked with the event.coalesce property coalesced? "
+                                                   "This is enabled by default. A posted event marked with event.coalesce is "
+                                                   "not delivered to a handler if a newer marked event of the same topic, posted by "
+                                                   "the same thread, is waiting for delivery to that handler as well. Disabling this setting delivers all posted events.",
+                                                   QVariant::Bool, m_coalesceEvents ? QStringList("true") : QStringList("false"))));
+
     ocd = ctkObjectClassDefinitionPtr(new ObjectClassDefinitionImpl(adList));
   }
 
@@ -27,7 +27,7 @@ template<class HandlerTasks, class SyncDeliverTasks, class AsyncDeliverTasks>
 ctkEventAdminImpl<HandlerTasks,SyncDeliverTasks,AsyncDeliverTasks>::ctkEventAdminImpl(
   HandlerTasksInterface* managers, ctkEADefaultThreadPool* syncPool,
   ctkEADefaultThreadPool* asyncPool, int timeout,
-  const QStringList& ignoreTimeout)
+  const QStringList& ignoreTimeout, bool coalesceEvents)
   : managers(managers)
 {
   checkNull(managers, "Managers");
@@ -38,7 +38,7 @@ ctkEventAdminImpl<HandlerTasks,SyncDeliverTasks,AsyncDeliverTasks>::ctkEventAdmi
                                      (timeout > 100 ? timeout : 0),
                                      ignoreTimeout);
 
-  postManager = new AsyncDeliverTasks(asyncPool, sendManager);
+  postManager = new AsyncDeliverTasks(asyncPool, sendManager, coalesceEvents);
 }
 
 template<class HandlerTasks, class SyncDeliverTasks, class AsyncDeliverTasks>
@@ -91,11 +91,12 @@ void ctkEventAdminImpl<HandlerTasks,SyncDeliverTasks,AsyncDeliverTasks>::stop()
 
 template<class HandlerTasks, class SyncDeliverTasks, class AsyncDeliverTasks>
 void ctkEventAdminImpl<HandlerTasks,SyncDeliverTasks,AsyncDeliverTasks>::update(HandlerTasksInterface* managers, int timeout,
-                               const QStringList& ignoreTimeout)
+                               const QStringList& ignoreTimeout, bool coalesceEvents)
 {
   HandlerTasksInterface* oldManagers = this->managers.fetchAndStoreOrdered(managers);
   delete oldManagers;
   this->sendManager->update(timeout, ignoreTimeout);
+  this->postManager->update(coalesceEvents);
 }
 
 template<class HandlerTasks, class SyncDeliverTasks, class AsyncDeliverTasks>
@@ -58,7 +58,7 @@ private:
   QAtomicPointer<HandlerTasksInterface> managers;
 
   // The asynchronous event dispatcher
-  AsyncDeliverTaskInterface* postManager;
+  AsyncDeliverTasks* postManager;
 
   // The (interruptible) thread where sync events are handled
   ctkEASyncMasterThread syncMasterThread;
@@ -103,7 +103,8 @@ public:
                     ctkEADefaultThreadPool* syncPool,
                     ctkEADefaultThreadPool* asyncPool,
                     int timeout,
-                    const QStringList& ignoreTimeout);
+                    const QStringList& ignoreTimeout,
+                    bool coalesceEvents);
 
   ~ctkEventAdminImpl();
 
@@ -144,7 +145,7 @@ public:
    * Update the event admin with new configuration.
    */
   void update(HandlerTasksInterface* managers, int timeout,
-              const QStringList& ignoreTimeout);
+              const QStringList& ignoreTimeout, bool coalesceEvents);
 
 private:
 
@@ -31,8 +31,9 @@ ctkEventAdminService::ctkEventAdminService(ctkPluginContext* context,
                                            ctkEADefaultThreadPool* syncPool,
                                            ctkEADefaultThreadPool* asyncPool,
                                            int timeout,
-                                           const QStringList& ignoreTimeout)
-  : impl(managers, syncPool, asyncPool, timeout, ignoreTimeout),
+                                           const QStringList& ignoreTimeout,
+                                           bool coalesceEvents)
+  : impl(managers, syncPool, asyncPool, timeout, ignoreTimeout, coalesceEvents),
     context(context)
 {
 
@@ -197,8 +198,8 @@ void ctkEventAdminService::stop()
 }
 
 void ctkEventAdminService::update(HandlerTasksInterface* managers, int timeout,
-                                  const QStringList& ignoreTimeout)
+                                  const QStringList& ignoreTimeout, bool coalesceEvents)
 {
-  impl.update(managers, timeout, ignoreTimeout);
+  impl.update(managers, timeout, ignoreTimeout, coalesceEvents);
 }
 
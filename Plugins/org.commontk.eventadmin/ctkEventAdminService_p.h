@@ -30,9 +30,7 @@
 #include "ctkEventAdminImpl_p.h"
 
 #include "handler/ctkEACleanBlackList_p.h"
-#include "util/ctkEALeastRecentlyUsedCacheMap_p.h"
-#include "handler/ctkEACacheTopicHandlerFilters_p.h"
-#include "handler/ctkEACacheFilters_p.h"
+#include "handler/ctkEABlacklistingHandlerTasks_p.h"
 #include "tasks/ctkEASyncDeliverTasks_p.h"
 #include "tasks/ctkEAAsyncDeliverTasks_p.h"
 #include "dispatch/ctkEASignalPublisher_p.h"
@@ -49,14 +47,7 @@ public:
   typedef ctkEACleanBlackList BlackList;
   typedef ctkEABlackList<BlackList> BlackListInterface;
 
-  typedef ctkEALeastRecentlyUsedCacheMap<QString, QString> TopicCacheMap;
-  typedef ctkEACacheTopicHandlerFilters<TopicCacheMap> TopicHandlerFilters;
-  typedef ctkEATopicHandlerFilters<TopicHandlerFilters> TopicHandlerFiltersInterface;
-  typedef ctkEALeastRecentlyUsedCacheMap<QString, ctkLDAPSearchFilter> LDAPCacheMap;
-  typedef ctkEACacheFilters<LDAPCacheMap> Filters;
-  typedef ctkEAFilters<Filters> FiltersInterface;
-
-  typedef ctkEABlacklistingHandlerTasks<BlackList, TopicHandlerFilters, Filters> BlacklistingHandlerTasks;
+  typedef ctkEABlacklistingHandlerTasks<BlackList> BlacklistingHandlerTasks;
   typedef ctkEAHandlerTasks<BlacklistingHandlerTasks> HandlerTasksInterface;
 
   typedef ctkEAHandlerTask<BlacklistingHandlerTasks> HandlerTask;
@@ -80,7 +71,8 @@ public:
                        ctkEADefaultThreadPool* syncPool,
                        ctkEADefaultThreadPool* asyncPool,
                        int timeout,
-                       const QStringList& ignoreTimeout);
+                       const QStringList& ignoreTimeout,
+                       bool coalesceEvents);
 
   ~ctkEventAdminService();
 
@@ -113,7 +105,7 @@ public:
    * Update the event admin with new configuration.
    */
   void update(HandlerTasksInterface* managers, int timeout,
-              const QStringList& ignoreTimeout);
+              const QStringList& ignoreTimeout, bool coalesceEvents);
 
 };
 
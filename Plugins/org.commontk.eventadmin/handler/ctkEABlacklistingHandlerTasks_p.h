@@ -30,28 +30,24 @@
 #include <service/event/ctkEventConstants.h>
 #include <service/event/ctkEventHandler.h>
 
-#include "ctkEATopicHandlerFilters_p.h"
-#include "ctkEAFilters_p.h"
+#include "ctkEATopicHandlerIndex_p.h"
 #include "ctkEABlackList_p.h"
 
 /**
  * This class is an implementation of the ctkEAHandlerTasks interface that does provide
- * blacklisting of event handlers. Furthermore, handlers are determined from the
- * framework on any call to <tt>createHandlerTasks()</tt> hence, there is no
- * book-keeping of <tt>ctkEventHandler</tt> services while they come and go but a
- * query for each sent event. In order to do this, an ldap-filter is created that
- * will match applicable <tt>ctkEventHandler</tt> references. In order to ease some of
- * the overhead pains of this approach some light caching is going on.
+ * blacklisting of event handlers. The applicable <tt>ctkEventHandler</tt> services
+ * for an event are taken from a <tt>ctkEATopicHandlerIndex</tt>, which keeps track
+ * of the handlers while they come and go, and whose event filters are parsed
+ * once when the handler is registered or modified.
  */
-template<class BlackList, class TopicHandlerFilters, class Filters>
+template<class BlackList>
 class ctkEABlacklistingHandlerTasks :
-    public ctkEAHandlerTasks<
-    ctkEABlacklistingHandlerTasks<BlackList, TopicHandlerFilters, Filters> >
+    public ctkEAHandlerTasks<ctkEABlacklistingHandlerTasks<BlackList> >
 {
 
 private:
 
-  typedef ctkEABlacklistingHandlerTasks<BlackList, TopicHandlerFilters, Filters> Self;
+  typedef ctkEABlacklistingHandlerTasks<BlackList> Self;
 
   // The blacklist that holds blacklisted event handler service references
   ctkEABlackList<BlackList>* const blackList;
@@ -59,13 +55,8 @@ private:
   // The context of the plugin used to get the actual event handler services
   ctkPluginContext* const context;
 
-  // Used to create the filters that can determine applicable event handlers for
-  // a given event
-  ctkEATopicHandlerFilters<TopicHandlerFilters>* topicHandlerFilters;
-
-  // Used to create the filters that are used to determine whether an applicable
-  // event handler is interested in a particular event
-  ctkEAFilters<Filters>* filters;
+  // Used to determine the applicable event handlers for a given event
+  ctkEATopicHandlerIndex* handlerIndex;
 
 public:
 
@@ -74,13 +65,11 @@ public:
    *
    * @param context The context of the plugin
    * @param blackList The set to use for keeping track of blacklisted references
-   * @param topicHandlerFilters The factory for topic handler filters
-   * @param filters The factory for <tt>ctkLDAPSearchFilter</tt> objects
+   * @param handlerIndex The index of the event handlers by topic
    */
   ctkEABlacklistingHandlerTasks(ctkPluginContext* context,
                                 ctkEABlackList<BlackList>* blackList,
-                                ctkEATopicHandlerFilters<TopicHandlerFilters>* topicHandlerFilters,
-                                ctkEAFilters<Filters>* filters);
+                                ctkEATopicHandlerIndex* handlerIndex);
 
   ~ctkEABlacklistingHandlerTasks();
 
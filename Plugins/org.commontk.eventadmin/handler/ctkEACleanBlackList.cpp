@@ -26,10 +26,18 @@ void ctkEACleanBlackList::add(const ctkServiceReference& ref)
 {
   QMutexLocker lock(&mutex);
   blackList.insert(ref);
+  size.fetchAndStoreOrdered(blackList.size());
 }
 
 bool ctkEACleanBlackList::contains(const ctkServiceReference& ref) const
 {
+  // Called for each handler of each event, usually with no blacklisted
+  // handler at all
+  if (size.fetchAndAddOrdered(0) == 0)
+  {
+    return false;
+  }
+
   QMutexLocker lock(&mutex);
 
   // This removes stale (i.e., unregistered) references on any call to implContains
@@ -40,6 +48,7 @@ bool ctkEACleanBlackList::contains(const ctkServiceReference& ref) const
       blackList.remove(ref);
     }
   }
+  size.fetchAndStoreOrdered(blackList.size());
 
   return blackList.contains(ref);
 }
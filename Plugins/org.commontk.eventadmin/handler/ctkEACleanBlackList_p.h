@@ -23,6 +23,7 @@
 #ifndef CTKEACLEANBLACKLIST_P_H
 #define CTKEACLEANBLACKLIST_P_H
 
+#include <QAtomicInt>
 #include <QMutex>
 #include <QSet>
 
@@ -44,6 +45,9 @@ private:
 
   mutable QSet<ctkServiceReference> blackList;
 
+  // The size of blackList, lets contains() skip the mutex while it is empty
+  mutable QAtomicInt size;
+
 public:
 
   /**
@@ -0,0 +1,276 @@
+/*=============================================================================
+
+  Library: CTK
+
+  Copyright (c) German Cancer Research Center,
+    Division of Medical and Biological Informatics
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+
+#include "ctkEATopicHandlerIndex_p.h"
+
+#include <QHash>
+#include <QVector>
+
+#include <ctkException.h>
+#include <ctkPluginConstants.h>
+#include <ctkPluginContext.h>
+#include <service/event/ctkEventConstants.h>
+#include <service/event/ctkEventHandler.h>
+
+/*
+ * A token of the topics in the trie. Indices refer to
+ * ctkEATopicHandlerTrie::handlers.
+ */
+struct ctkEATopicHandlerNode
+{
+  QHash<QString, ctkEATopicHandlerNode*> children;
+
+  // The handlers of the topic ending with this token
+  QList<int> handlers;
+
+  // The handlers of the topic ending with this token followed by "/*"
+  QList<int> wildcardHandlers;
+
+  ~ctkEATopicHandlerNode()
+  {
+    qDeleteAll(children);
+  }
+
+  ctkEATopicHandlerNode* child(const QString& token)
+  {
+    ctkEATopicHandlerNode*& node = children[token];
+    if (node == 0)
+    {
+      node = new ctkEATopicHandlerNode();
+    }
+    return node;
+  }
+};
+
+struct ctkEATopicHandlerTrie
+{
+  // The handlers by increasing service id
+  QVector<ctkEATopicHandler> handlers;
+
+  // The handlers of all topics, i.e. with the topic "*" and, unless a
+  // topic is required, the ones without EVENT_TOPIC
+  QList<int> anyTopic;
+
+  ctkEATopicHandlerNode root;
+
+  void insert(int index, const QString& topic)
+  {
+    if (topic == "*")
+    {
+      anyTopic.push_back(index);
+      return;
+    }
+
+    const bool wildcard = topic.endsWith("/*");
+    const QStringList tokens = (wildcard ? topic.left(topic.size() - 2) : topic).split('/');
+    ctkEATopicHandlerNode* node = &root;
+    foreach (const QString& token, tokens)
+    {
+      node = node->child(token);
+    }
+
+    (wildcard ? node->wildcardHandlers : node->handlers).push_back(index);
+  }
+};
+
+typedef ctkAtomicSnapshot<ctkEATopicHandlerTrie>::Reader ctkEATopicHandlerIndexReader;
+
+ctkEATopicHandlerIndex::ctkEATopicHandlerIndex(ctkPluginContext* context, bool requireTopic)
+  : context(context), requireTopic(requireTopic), trie(new ctkEATopicHandlerTrie())
+{
+  if (context == 0)
+  {
+    throw ctkInvalidArgumentException("Context may not be null");
+  }
+
+  // Connect before getting the registered handlers to miss none of them,
+  // the events received meanwhile wait for the mutex.
+  QMutexLocker lock(&mutex);
+  context->connectServiceListener(this, "serviceChanged",
+                                  QString("(") + ctkPluginConstants::OBJECTCLASS + "="
+                                  + qobject_interface_iid<ctkEventHandler*>() + ")");
+
+  foreach (const ctkServiceReference& ref, context->getServiceReferences<ctkEventHandler>())
+  {
+    addHandler(ref);
+  }
+  publish();
+}
+
+ctkEATopicHandlerIndex::~ctkEATopicHandlerIndex()
+{
+  try
+  {
+    context->disconnectServiceListener(this, "serviceChanged");
+  }
+  catch (const ctkIllegalStateException&)
+  {
+    // The plugin is stopping, its listeners are gone already
+  }
+
+  // Wait for the service events being processed, the trie is deleted once
+  // the lookups in progress are done
+  QMutexLocker lock(&mutex);
+  trie.publish(0);
+}
+
+QList<ctkEATopicHandler> ctkEATopicHandlerIndex::getHandlers(const QString& topic) const
+{
+  ctkEATopicHandlerIndexReader reader(trie);
+  const ctkEATopicHandlerTrie* t = reader.data();
+
+  QVector<int> matches;
+  matches.reserve(16);
+  foreach (int index, t->anyTopic)
+  {
+    matches.push_back(index);
+  }
+
+  // org/commontk/TEST matches the handlers of *, org/*, org/commontk/*
+  // and org/commontk/TEST
+  const ctkEATopicHandlerNode* node = &t->root;
+  int start = 0;
+  forever
+  {
+    const int end = topic.indexOf('/', start);
+    QHash<QString, ctkEATopicHandlerNode*>::const_iterator child =
+        node->children.find(topic.mid(start, end < 0 ? -1 : end - start));
+    if (child == node->children.end())
+    {
+      break;
+    }
+    node = child.value();
+
+    const QList<int>& handlers = end < 0 ? node->handlers : node->wildcardHandlers;
+    foreach (int index, handlers)
+    {
+      matches.push_back(index);
+    }
+
+    if (end < 0)
+    {
+      break;
+    }
+    start = end + 1;
+  }
+
+  // Indices follow the service ids, a handler subscribed to several of the
+  // topics above is returned once.
+  qSort(matches);
+
+  QList<ctkEATopicHandler> result;
+  int previous = -1;
+  foreach (int index, matches)
+  {
+    if (index != previous)
+    {
+      result.push_back(t->handlers.at(index));
+      previous = index;
+    }
+  }
+
+  return result;
+}
+
+void ctkEATopicHandlerIndex::serviceChanged(const ctkServiceEvent& event)
+{
+  QMutexLocker lock(&mutex);
+
+  switch (event.getType())
+  {
+  case ctkServiceEvent::REGISTERED:
+  case ctkServiceEvent::MODIFIED:
+    addHandler(event.getServiceReference());
+    break;
+  case ctkServiceEvent::MODIFIED_ENDMATCH:
+  case ctkServiceEvent::UNREGISTERING:
+    removeHandler(event.getServiceReference());
+    break;
+  }
+
+  publish();
+}
+
+void ctkEATopicHandlerIndex::addHandler(const ctkServiceReference& ref)
+{
+  ctkEATopicHandler handler;
+  handler.reference = ref;
+
+  const QString filter = ref.getProperty(ctkEventConstants::EVENT_FILTER).toString();
+  if (!filter.isEmpty())
+  {
+    try
+    {
+      handler.filter = ctkLDAPSearchFilter(filter);
+    }
+    catch (const ctkInvalidArgumentException& e)
+    {
+      handler.filterError = e.what();
+    }
+  }
+
+  const QVariant topic = ref.getProperty(ctkEventConstants::EVENT_TOPIC);
+  handler.hasTopic = topic.isValid();
+  if (topic.type() == QVariant::StringList)
+  {
+    handler.topics = topic.toStringList();
+  }
+  else if (handler.hasTopic)
+  {
+    handler.topics.push_back(topic.toString());
+  }
+
+  handlers.insert(ref.getProperty(ctkPluginConstants::SERVICE_ID).toLongLong(), handler);
+}
+
+void ctkEATopicHandlerIndex::removeHandler(const ctkServiceReference& ref)
+{
+  handlers.remove(ref.getProperty(ctkPluginConstants::SERVICE_ID).toLongLong());
+}
+
+void ctkEATopicHandlerIndex::publish()
+{
+  ctkEATopicHandlerTrie* next = new ctkEATopicHandlerTrie();
+  next->handlers.reserve(handlers.size());
+
+  foreach (const ctkEATopicHandler& handler, handlers)
+  {
+    const int index = next->handlers.size();
+    next->handlers.push_back(handler);
+
+    if (!handler.hasTopic)
+    {
+      if (!requireTopic)
+      {
+        next->anyTopic.push_back(index);
+      }
+      continue;
+    }
+
+    foreach (const QString& topic, handler.topics)
+    {
+      next->insert(index, topic);
+    }
+  }
+
+  trie.publish(next);
+}
@@ -0,0 +1,128 @@
+/*=============================================================================
+
+  Library: CTK
+
+  Copyright (c) German Cancer Research Center,
+    Division of Medical and Biological Informatics
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+
+#ifndef CTKEATOPICHANDLERINDEX_P_H
+#define CTKEATOPICHANDLERINDEX_P_H
+
+#include <QObject>
+#include <QMap>
+#include <QMutex>
+#include <QStringList>
+
+#include <ctkAtomicSnapshot.h>
+#include <ctkLDAPSearchFilter.h>
+#include <ctkServiceEvent.h>
+#include <ctkServiceReference.h>
+
+class ctkPluginContext;
+struct ctkEATopicHandlerTrie;
+
+/**
+ * An <tt>ctkEventHandler</tt> service as seen by the <tt>ctkEATopicHandlerIndex</tt>,
+ * with its <tt>EVENT_FILTER</tt> already parsed.
+ */
+struct ctkEATopicHandler
+{
+  ctkServiceReference reference;
+
+  // The EVENT_FILTER of the handler, a null filter if it has none
+  ctkLDAPSearchFilter filter;
+
+  // The error message if the EVENT_FILTER of the handler is invalid
+  QString filterError;
+
+  // The EVENT_TOPIC of the handler
+  QStringList topics;
+
+  // Whether the handler has an EVENT_TOPIC property at all
+  bool hasTopic;
+
+  ctkEATopicHandler() : hasTopic(false) {}
+};
+
+/**
+ * This class keeps track of the registered <tt>ctkEventHandler</tt> services
+ * and indexes them by their <tt>EVENT_TOPIC</tt> in a trie with one node per
+ * topic token. A node holds the handlers of the topic ending there and the
+ * handlers of its sub-topics, i.e. the same topic followed by the wildcard
+ * token <tt>*</tt>. The index is updated
+ * when handlers come and go or change their properties; lookups walk the
+ * tokens of the event topic once and take no lock.
+ */
+class ctkEATopicHandlerIndex : public QObject
+{
+  Q_OBJECT
+
+public:
+
+  /**
+   * Create the index of the <tt>ctkEventHandler</tt> services of the framework.
+   *
+   * @param context The context of the plugin used to track the services
+   * @param requireTopic Whether handlers without <tt>EVENT_TOPIC</tt> are ignored
+   *      or receive all events
+   */
+  ctkEATopicHandlerIndex(ctkPluginContext* context, bool requireTopic);
+
+  ~ctkEATopicHandlerIndex();
+
+  /**
+   * Get the handlers subscribed to the given topic, either with the topic
+   * itself, with one of its parent topics followed by the wildcard token or
+   * with <tt>*</tt>. Each handler is returned once, by increasing service id.
+   *
+   * @param topic The topic of an event
+   * @return The handlers subscribed to the topic
+   */
+  QList<ctkEATopicHandler> getHandlers(const QString& topic) const;
+
+protected Q_SLOTS:
+
+  void serviceChanged(const ctkServiceEvent& event);
+
+private:
+
+  ctkPluginContext* const context;
+  const bool requireTopic;
+
+  // Serializes the updates of the index
+  QMutex mutex;
+
+  // The handlers by service id, guarded by mutex
+  QMap<qlonglong, ctkEATopicHandler> handlers;
+
+  // The current trie, never modified once published
+  ctkAtomicSnapshot<ctkEATopicHandlerTrie> trie;
+
+  void addHandler(const ctkServiceReference& ref);
+
+  void removeHandler(const ctkServiceReference& ref);
+
+  /*
+   * Build a new trie from handlers and replace the current one with it.
+   * The current trie is deleted once the lookups that may still read it
+   * are done. Must be called with mutex held.
+   */
+  void publish();
+};
+
+#endif // CTKEATOPICHANDLERINDEX_P_H
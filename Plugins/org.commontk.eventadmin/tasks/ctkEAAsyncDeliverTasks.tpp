@@ -19,6 +19,68 @@
 
 =============================================================================*/
 
+
+#include <util/ctkEAMpscQueue_p.h>
+
+#include <service/event/ctkEventConstants.h>
+
+#include <QPair>
+#include <QSet>
+
+template<class SyncDeliverTasks, class HandlerTask>
+class ctkEAAsyncDeliverTasks<SyncDeliverTasks, HandlerTask>::SenderQueue
+{
+
+public:
+
+  // The tasks of each posted event
+  ctkEAMpscQueue<QList<HandlerTask> > events;
+
+  // The number of events put and not taken yet. The thread incrementing it
+  // from 0 schedules a TaskExecuter, which drains the queue until it drops
+  // it back to 0.
+  QAtomicInt pending;
+
+  // Held by the posting thread and by the scheduled TaskExecuter
+  QAtomicInt ref;
+
+  SenderQueue() : pending(0), ref(1) {}
+
+  void deref()
+  {
+    if (!ref.deref()) delete this;
+  }
+};
+
+template<class SyncDeliverTasks, class HandlerTask>
+class ctkEAAsyncDeliverTasks<SyncDeliverTasks, HandlerTask>::SenderQueueRef
+{
+
+public:
+
+  typedef ctkEAAsyncDeliverTasks<SyncDeliverTasks, HandlerTask> TopClass;
+
+  SenderQueue* const queue;
+
+  TopClass* const tc;
+
+  SenderQueueRef(TopClass* tc) : queue(new SenderQueue()), tc(tc)
+  {
+    QMutexLocker lock(&tc->senderQueueRefsMutex);
+    tc->senderQueueRefs.insert(this);
+  }
+
+  // Called when the posting thread finishes or by the destructor of tc
+  ~SenderQueueRef()
+  {
+    {
+      QMutexLocker lock(&tc->senderQueueRefsMutex);
+      tc->senderQueueRefs.remove(this);
+    }
+    queue->deref();
+  }
+};
+
 template<class SyncDeliverTasks, class HandlerTask>
 class ctkEAAsyncDeliverTasks<SyncDeliverTasks, HandlerTask>::TaskExecuter
     : public ctkEARunnable
@@ -28,78 +90,138 @@ private:
 
   typedef ctkEAAsyncDeliverTasks<SyncDeliverTasks, HandlerTask> TopClass;
 
+  // The max number of events delivered with one call to the deliver task
+  enum { MaxBatchSize = 256 };
+
   TopClass* tc;
 
-  QList<HandlerTask> tasks;
-  QMutex tasksMutex;
-  QThread* key;
+  SenderQueue* queue;
 
 public:
 
-  TaskExecuter(TopClass* tc, const QList<HandlerTask>& tasks, QThread* key)
-    : tc(tc), tasks(tasks), key(key)
+  TaskExecuter(TopClass* tc, SenderQueue* queue)
+    : tc(tc), queue(queue)
+  {
+    queue->ref.ref();
+  }
+
+  ~TaskExecuter()
   {
+    queue->deref();
   }
 
   void run()
   {
-    bool running = true;
-    do
+    int available = queue->pending;
+    forever
     {
-      QList<HandlerTask> currTasks;
-
+      // The events counted in pending are all linked into the queue
+      const int count = qMin<int>(available, MaxBatchSize);
+      QList<QList<HandlerTask> > batch;
+      QList<HandlerTask> tasks;
+      for (int i = 0; i < count && queue->events.poll(tasks); ++i)
       {
-        QMutexLocker l(&tasksMutex);
-        currTasks.push_back(tasks.takeFirst());
+        batch.push_back(tasks);
       }
-      tc->deliver_task->execute(currTasks);
+
+      tc->deliver_task->execute(tc->coalesceBatch(batch));
+
+      // Once pending drops to 0, the next event put schedules a new executer
+      // and this one must not touch the queue anymore
+      available = queue->pending.fetchAndAddOrdered(-batch.size()) - batch.size();
+      if (available == 0)
       {
-        QMutexLocker l(&tc->running_threads_mutex);
-        running = tasks.size() > 0;
-        if (!running)
-        {
-          ctkEARunnable* runnable = tc->running_threads.take(key);
-          if (runnable->autoDelete() && !--runnable->ref) delete runnable;
-        }
+        break;
       }
-    } while (running);
+    }
   }
+};
 
-  void add(const QList<HandlerTask>& newTasks)
+template<class SyncDeliverTasks, class HandlerTask>
+ctkEAAsyncDeliverTasks<SyncDeliverTasks, HandlerTask>::ctkEAAsyncDeliverTasks(
+  ctkEADefaultThreadPool* pool, DeliverTask* deliverTask, bool coalesce)
+ : pool(pool), deliver_task(deliverTask), coalesce(coalesce ? 1 : 0),
+   senderQueues(new QThreadStorage<SenderQueueRef*>())
+{
+}
+
+template<class SyncDeliverTasks, class HandlerTask>
+ctkEAAsyncDeliverTasks<SyncDeliverTasks, HandlerTask>::~ctkEAAsyncDeliverTasks()
+{
+  // From now on, the finishing threads leave their queue to us
+  delete senderQueues;
+
+  QSet<SenderQueueRef*> refs;
   {
-    QMutexLocker l(&tasksMutex);
-    tasks.append(newTasks);
+    QMutexLocker lock(&senderQueueRefsMutex);
+    refs = senderQueueRefs;
   }
-};
+  qDeleteAll(refs);
+}
+
+template<class SyncDeliverTasks, class HandlerTask>
+void ctkEAAsyncDeliverTasks<SyncDeliverTasks, HandlerTask>::execute(const QList<HandlerTask>& tasks)
+{
+  if (!senderQueues->hasLocalData())
+  {
+    senderQueues->setLocalData(new SenderQueueRef(this));
+  }
+  SenderQueue* queue = senderQueues->localData()->queue;
+
+  queue->events.put(tasks);
+  if (queue->pending.fetchAndAddOrdered(1) == 0)
+  {
+    pool->executeTask(new TaskExecuter(this, queue));
+  }
+}
 
 template<class SyncDeliverTasks, class HandlerTask>
-ctkEAAsyncDeliverTasks<SyncDeliverTasks, HandlerTask>::ctkEAAsyncDeliverTasks(ctkEADefaultThreadPool* pool, DeliverTask* deliverTask)
- : pool(pool), deliver_task(deliverTask)
+void ctkEAAsyncDeliverTasks<SyncDeliverTasks, HandlerTask>::update(bool coalesce)
 {
+  this->coalesce.fetchAndStoreOrdered(coalesce ? 1 : 0);
 }
 
 template<class SyncDeliverTasks, class HandlerTask>
-void ctkEAAsyncDeliverTasks<SyncDeliverTasks, HandlerTask>::execute(const QList<HandlerTask>& tasks)
+QList<HandlerTask> ctkEAAsyncDeliverTasks<SyncDeliverTasks, HandlerTask>::coalesceBatch(
+  QList<QList<HandlerTask> >& batch) const
 {
-  QThread* currentThread = QThread::currentThread();
-  TaskExecuter* executer = 0;
+  if (batch.size() > 1 && coalesce)
   {
-    QMutexLocker l(&running_threads_mutex);
-    TaskExecuter* runningExecutor = dynamic_cast<TaskExecuter*>(running_threads.value(currentThread));
-    if (runningExecutor)
+    // Walk backwards, the newest marked event of each topic is kept for
+    // each handler. A handler whose filter does not match the newer event
+    // still gets the older one.
+    QSet<QPair<QString, ctkServiceReference> > delivered;
+    for (int i = batch.size() - 1; i >= 0; --i)
     {
-      runningExecutor->add(tasks);
-    }
-    else
-    {
-      executer = new TaskExecuter(this, tasks, currentThread);
-      ++executer->ref;
-      running_threads.insert(currentThread, executer);
+      if (batch.at(i).isEmpty())
+      {
+        continue;
+      }
+      const ctkEvent& event = batch.at(i).front().getEvent();
+      if (event.getProperty(ctkEventConstants::EVENT_COALESCE).toBool())
+      {
+        const QString topic = event.getTopic();
+        QList<HandlerTask>& tasks = batch[i];
+        for (int j = tasks.size() - 1; j >= 0; --j)
+        {
+          const QPair<QString, ctkServiceReference> key(topic, tasks.at(j).getEventHandlerRef());
+          if (delivered.contains(key))
+          {
+            tasks.removeAt(j);
+          }
+          else
+          {
+            delivered.insert(key);
+          }
+        }
+      }
     }
   }
-  if (executer)
+
+  QList<HandlerTask> result;
+  for (int i = 0; i < batch.size(); ++i)
   {
-    pool->executeTask(executer);
+    result.append(batch.at(i));
   }
+  return result;
 }
-
@@ -26,10 +26,23 @@
 #include "ctkEADeliverTask_p.h"
 #include <dispatch/ctkEADefaultThreadPool_p.h>
 
+#include <QAtomicInt>
+#include <QMutex>
+#include <QSet>
+#include <QThreadStorage>
+
 class ctkEARunnable;
 
 /**
  * This class does the actual work of the asynchronous event dispatch.
+ *
+ * Each posting thread has its own lock-free queue. The first event put into an
+ * empty queue schedules a task in the thread pool, which delivers the queued
+ * events in batches until the queue is empty, hence events posted by the same
+ * thread are delivered in order. Within a batch, an event marked with
+ * <tt>ctkEventConstants::EVENT_COALESCE</tt> is not delivered to a handler
+ * which gets a newer marked event of the same topic in the same batch,
+ * unless coalescing is disabled.
  */
 template<class SyncDeliverTasks, class HandlerTask>
 class ctkEAAsyncDeliverTasks : public ctkEADeliverTask<ctkEAAsyncDeliverTasks<SyncDeliverTasks,HandlerTask>, HandlerTask>
@@ -48,9 +61,24 @@ private:
   typedef ctkEADeliverTask<SyncDeliverTasks, HandlerTask> DeliverTask;
   DeliverTask* deliver_task;
 
-  /** A map of running threads currently delivering async events. */
-  QHash<QThread*, ctkEARunnable*> running_threads;
-  QMutex running_threads_mutex;
+  /** Whether events marked with EVENT_COALESCE may be dropped. */
+  QAtomicInt coalesce;
+
+  class SenderQueue;
+  class SenderQueueRef;
+  class TaskExecuter;
+
+  /**
+   * The queue of the posting thread. Allocated on the heap to be destroyed
+   * before senderQueueRefs is freed: QThreadStorage does not delete the
+   * data of the other threads when destroyed, and no longer does it when
+   * they finish afterwards.
+   */
+  QThreadStorage<SenderQueueRef*>* senderQueues;
+
+  /** The queues of all the posting threads, freed by the destructor. */
+  QSet<SenderQueueRef*> senderQueueRefs;
+  QMutex senderQueueRefsMutex;
 
 public:
 
@@ -61,8 +89,16 @@ public:
    *        dispatching threads in case of timeout or that the asynchronous event
    *        dispatching thread is used to send a synchronous event
    * @param deliverTask The deliver tasks for dispatching the event.
+   * @param coalesce Whether events marked with EVENT_COALESCE may be dropped
    */
-  ctkEAAsyncDeliverTasks(ctkEADefaultThreadPool* pool, DeliverTask* deliverTask);
+  ctkEAAsyncDeliverTasks(ctkEADefaultThreadPool* pool, DeliverTask* deliverTask,
+                         bool coalesce = true);
+
+  /**
+   * Release the queues of all the posting threads. The events still queued
+   * are delivered by the scheduled tasks, which keep their queue alive.
+   */
+  ~ctkEAAsyncDeliverTasks();
 
   /**
    * This does not block an unrelated thread used to send a synchronous event.
@@ -73,9 +109,18 @@ public:
    */
   void execute(const QList<HandlerTask>& tasks);
 
+  /**
+   * Enable or disable the coalescing of events marked with EVENT_COALESCE.
+   */
+  void update(bool coalesce);
+
 private:
 
-  class TaskExecuter;
+  /*
+   * Remove the tasks superseded by a newer task of the batch, for the same
+   * handler and topic, and return the remaining ones.
+   */
+  QList<HandlerTask> coalesceBatch(QList<QList<HandlerTask> >& batch) const;
 };
 
 #include "ctkEAAsyncDeliverTasks.tpp"
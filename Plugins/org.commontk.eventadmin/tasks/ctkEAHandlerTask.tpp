@@ -91,6 +91,18 @@ QString ctkEAHandlerTask<BlacklistingHandlerTasks>::getHandlerClassName() const
   return handler->metaObject()->className();
 }
 
+template<class BlacklistingHandlerTasks>
+const ctkEvent& ctkEAHandlerTask<BlacklistingHandlerTasks>::getEvent() const
+{
+  return event;
+}
+
+template<class BlacklistingHandlerTasks>
+const ctkServiceReference& ctkEAHandlerTask<BlacklistingHandlerTasks>::getEventHandlerRef() const
+{
+  return eventHandlerRef;
+}
+
 template<class BlacklistingHandlerTasks>
 void ctkEAHandlerTask<BlacklistingHandlerTasks>::execute()
 {
@@ -73,6 +73,16 @@ public:
    */
   QString getHandlerClassName() const;
 
+  /**
+   * Return the event to deliver
+   */
+  const ctkEvent& getEvent() const;
+
+  /**
+   * Return the service reference of the handler
+   */
+  const ctkServiceReference& getEventHandlerRef() const;
+
   /**
    * Deliver the event to the handler.
    */
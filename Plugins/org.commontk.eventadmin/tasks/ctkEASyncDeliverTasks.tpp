@@ -20,14 +20,41 @@
 =============================================================================*/
 
 
-#include "ctkEASyncThread_p.h"
-
 #include <dispatch/ctkEADefaultThreadPool_p.h>
 #include <dispatch/ctkEASyncMasterThread_p.h>
 #include <util/ctkEARendezvous_p.h>
 #include <util/ctkEATimeoutException_p.h>
 
 #include <QDateTime>
+#include <QHash>
+#include <QThread>
+#include <QTime>
+#include <QWaitCondition>
+
+/*
+ * A handler called in isolation by a thread of the pool, registered with
+ * the deliver tasks for the duration of the call.
+ */
+template<class HandlerTask>
+class _IsolatedDelivery
+{
+public:
+
+  _IsolatedDelivery(ctkEASyncDeliverTasks<HandlerTask>* deliverTasks)
+    : deliverTasks(deliverTasks)
+  {
+    deliverTasks->beginIsolatedDelivery();
+  }
+
+  ~_IsolatedDelivery()
+  {
+    deliverTasks->endIsolatedDelivery();
+  }
+
+private:
+
+  ctkEASyncDeliverTasks<HandlerTask>* const deliverTasks;
+};
 
 template<class HandlerTask>
 class _TimeoutRunnable : public ctkEARunnable
@@ -37,8 +64,8 @@ public:
   ctkEARendezvous timerBarrier;
   ctkEARendezvous startBarrier;
 
-  _TimeoutRunnable(HandlerTask* task)
-    : task(task)
+  _TimeoutRunnable(ctkEASyncDeliverTasks<HandlerTask>* deliverTasks, HandlerTask* task)
+    : deliverTasks(deliverTasks), task(task)
   {
 
   }
@@ -50,7 +77,10 @@ public:
       // notify the outer thread to start the timer
       startBarrier.waitForRendezvous();
       // execute the task
-      task->execute();
+      {
+        _IsolatedDelivery<HandlerTask> delivery(deliverTasks);
+        task->execute();
+      }
       // stop the timer
       timerBarrier.waitForRendezvous();
     }
@@ -62,6 +92,7 @@ public:
 
 private:
 
+  ctkEASyncDeliverTasks<HandlerTask>* const deliverTasks;
   HandlerTask* task;
 };
 
@@ -88,13 +119,184 @@ private:
   const QList<HandlerTask>& tasks;
 };
 
+/*
+ * A handler called by the calling thread, registered with the watchdog for
+ * the duration of the call.
+ */
+template<class HandlerTask>
+class _InlineDelivery
+{
+public:
+
+  HandlerTask* const task;
+
+  // Started when the handler is called
+  QTime start;
+
+  // The time spent in deliveries of cascaded events, which does not count
+  // for the timeout of this handler
+  int excluded;
+
+  bool timedOut;
+
+  // The delivery of the same thread this delivery is cascaded from
+  _InlineDelivery* parent;
+
+  _InlineDelivery(_Watchdog<HandlerTask>* watchdog, HandlerTask* task)
+    : task(task), excluded(0), timedOut(false), parent(0), watchdog(watchdog)
+  {
+    start.start();
+    watchdog->begin(this);
+  }
+
+  ~_InlineDelivery()
+  {
+    watchdog->end(this);
+  }
+
+private:
+
+  _Watchdog<HandlerTask>* const watchdog;
+};
+
+/*
+ * The thread checking whether the handlers called by the calling threads
+ * return within the timeout. It wakes up four times per timeout period
+ * while handlers are called, and sleeps until a handler is called otherwise.
+ */
+template<class HandlerTask>
+class _Watchdog : public QThread
+{
+public:
+
+  _Watchdog(ctkEASyncDeliverTasks<HandlerTask>* deliverTasks)
+    : deliverTasks(deliverTasks), timeout(0), stopped(false), idle(false)
+  {
+    setObjectName("ctkEAWatchdog");
+  }
+
+  void begin(_InlineDelivery<HandlerTask>* delivery)
+  {
+    QThread* const thread = QThread::currentThread();
+    QMutexLocker l(&mutex);
+    delivery->parent = deliveries.value(thread);
+    deliveries.insert(thread, delivery);
+    if (idle)
+    {
+      // the deliveries that begin until the watchdog checks them next do
+      // not wake it up again
+      idle = false;
+      waitCond.wakeAll();
+    }
+  }
+
+  void end(_InlineDelivery<HandlerTask>* delivery)
+  {
+    QThread* const thread = QThread::currentThread();
+    QMutexLocker l(&mutex);
+    if (delivery->parent)
+    {
+      // the timeout of the outer handler is stopped for the delivery time
+      // of the cascaded event
+      delivery->parent->excluded += delivery->start.elapsed();
+      deliveries.insert(thread, delivery->parent);
+    }
+    else
+    {
+      deliveries.remove(thread);
+    }
+  }
+
+  void setTimeout(long timeout)
+  {
+    QMutexLocker l(&mutex);
+    this->timeout = timeout;
+    waitCond.wakeAll();
+  }
+
+  void stop()
+  {
+    {
+      QMutexLocker l(&mutex);
+      stopped = true;
+      waitCond.wakeAll();
+    }
+    wait();
+  }
+
+protected:
+
+  void run()
+  {
+    QMutexLocker l(&mutex);
+    while (!stopped)
+    {
+      if (timeout <= 0 || deliveries.isEmpty())
+      {
+        // nothing to watch, begin() wakes us up
+        idle = true;
+        waitCond.wait(&mutex);
+        idle = false;
+        continue;
+      }
+      waitCond.wait(&mutex, qMax(10L, timeout / 4));
+
+      // Only the innermost delivery of each thread is running
+      QList<HandlerTask> timedOut;
+      foreach (_InlineDelivery<HandlerTask>* delivery, deliveries)
+      {
+        if (timeout > 0 && !delivery->timedOut &&
+            delivery->start.elapsed() - delivery->excluded > timeout)
+        {
+          delivery->timedOut = true;
+          timedOut.push_back(*delivery->task);
+        }
+      }
+
+      if (!timedOut.isEmpty())
+      {
+        // The handler is still running, blacklisting gets its service
+        l.unlock();
+        for (int i = 0; i < timedOut.size(); ++i)
+        {
+          deliverTasks->handlerTimedOut(timedOut[i]);
+        }
+        l.relock();
+      }
+    }
+  }
+
+private:
+
+  ctkEASyncDeliverTasks<HandlerTask>* const deliverTasks;
+
+  QMutex mutex;
+  QWaitCondition waitCond;
+  long timeout;
+  bool stopped;
+  bool idle;
+
+  // The innermost delivery of each calling thread
+  QHash<QThread*, _InlineDelivery<HandlerTask>*> deliveries;
+};
+
 template<class HandlerTask>
 ctkEASyncDeliverTasks<HandlerTask>::ctkEASyncDeliverTasks(
   ctkEADefaultThreadPool* pool, ctkEASyncMasterThread* syncMasterThread,
   long timeout, const QList<QString>& ignoreTimeout)
-  : pool(pool), syncMasterThread(syncMasterThread)
+  : pool(pool), syncMasterThread(syncMasterThread),
+    watchdog(new _Watchdog<HandlerTask>(this))
 {
   update(timeout, ignoreTimeout);
+  watchdog->start();
+}
+
+template<class HandlerTask>
+ctkEASyncDeliverTasks<HandlerTask>::~ctkEASyncDeliverTasks()
+{
+  watchdog->stop();
+  delete watchdog;
+  qDeleteAll(ignoreTimeoutMatcher);
 }
 
 template<class HandlerTask>
@@ -104,6 +306,7 @@ void ctkEASyncDeliverTasks<HandlerTask>::update(long timeout, const QList<QStrin
     QMutexLocker l(&mutex);
     this->timeout = timeout;
   }
+  watchdog->setTimeout(timeout);
 
   if (ignoreTimeout.isEmpty())
   {
@@ -134,16 +337,40 @@ void ctkEASyncDeliverTasks<HandlerTask>::update(long timeout, const QList<QStrin
 template<class HandlerTask>
 void ctkEASyncDeliverTasks<HandlerTask>::execute(const QList<HandlerTask>& tasks)
 {
-  _RunInSyncMaster<HandlerTask> runnable(this, tasks);
-  runnable.setAutoDelete(false);
-  syncMasterThread->syncRun(&runnable);
+  if (isIsolatedDelivery())
+  {
+    // a cascaded event of a handler called in isolation, the sync master
+    // thread is waiting for that handler
+    executeInSyncMaster(tasks);
+    return;
+  }
+
+  foreach(HandlerTask task, tasks)
+  {
+    if (!useTimeout(task))
+    {
+      // no timeout, we can directly execute
+      task.execute();
+    }
+    else if (useIsolation(task))
+    {
+      _RunInSyncMaster<HandlerTask> runnable(this, QList<HandlerTask>() << task);
+      runnable.setAutoDelete(false);
+      syncMasterThread->syncRun(&runnable);
+    }
+    else
+    {
+      // the watchdog blacklists the handler if it does not return in time
+      _InlineDelivery<HandlerTask> delivery(watchdog, &task);
+      task.execute();
+    }
+  }
 }
 
 template<class HandlerTask>
 void ctkEASyncDeliverTasks<HandlerTask>::executeInSyncMaster(const QList<HandlerTask>& tasks)
 {
-  QThread* const sleepingThread = QThread::currentThread();
-  ctkEASyncThread* const syncThread = qobject_cast<ctkEASyncThread*>(sleepingThread);
+  const bool cascaded = isIsolatedDelivery();
 
   foreach(HandlerTask task, tasks)
   {
@@ -152,7 +379,7 @@ void ctkEASyncDeliverTasks<HandlerTask>::executeInSyncMaster(const QList<Handler
       // no timeout, we can directly execute
       task.execute();
     }
-    else if (syncThread != 0)
+    else if (cascaded)
     {
       // if this is a cascaded event, we directly use this thread
       // otherwise we could end up in a starvation
@@ -168,7 +395,7 @@ void ctkEASyncDeliverTasks<HandlerTask>::executeInSyncMaster(const QList<Handler
     else
     {
       _TimeoutRunnable<HandlerTask>* timeoutRunnable
-          = new _TimeoutRunnable<HandlerTask>(&task);
+          = new _TimeoutRunnable<HandlerTask>(this, &task);
       ctkEAScopedRunnableReference runnableRef(timeoutRunnable);
 
       ctkEARendezvous* startBarrier = &timeoutRunnable->startBarrier;
@@ -194,6 +421,63 @@ void ctkEASyncDeliverTasks<HandlerTask>::executeInSyncMaster(const QList<Handler
   }
 }
 
+template<class HandlerTask>
+void ctkEASyncDeliverTasks<HandlerTask>::handlerTimedOut(HandlerTask& task)
+{
+  task.blackListHandler();
+
+  const QString className = task.getHandlerClassName();
+  QMutexLocker l(&mutex);
+  isolatedClasses.insert(className);
+  isolatedCount.fetchAndStoreOrdered(isolatedClasses.size());
+}
+
+template<class HandlerTask>
+void ctkEASyncDeliverTasks<HandlerTask>::beginIsolatedDelivery()
+{
+  QThread* const thread = QThread::currentThread();
+  QMutexLocker l(&mutex);
+  ++isolatedDeliveries[thread];
+  isolatedDeliveryCount.ref();
+}
+
+template<class HandlerTask>
+void ctkEASyncDeliverTasks<HandlerTask>::endIsolatedDelivery()
+{
+  QThread* const thread = QThread::currentThread();
+  QMutexLocker l(&mutex);
+  if (--isolatedDeliveries[thread] == 0)
+  {
+    isolatedDeliveries.remove(thread);
+  }
+  isolatedDeliveryCount.deref();
+}
+
+template<class HandlerTask>
+bool ctkEASyncDeliverTasks<HandlerTask>::isIsolatedDelivery()
+{
+  if (isolatedDeliveryCount.fetchAndAddOrdered(0) == 0)
+  {
+    return false;
+  }
+
+  QMutexLocker l(&mutex);
+  return isolatedDeliveries.contains(QThread::currentThread());
+}
+
+template<class HandlerTask>
+bool ctkEASyncDeliverTasks<HandlerTask>::useIsolation(const HandlerTask& task)
+{
+  if (isolatedCount.fetchAndAddOrdered(0) == 0)
+  {
+    return false;
+  }
+
+  const QString className = task.getHandlerClassName();
+  QMutexLocker l(&mutex);
+  return isolatedClasses.contains(className);
+}
+
 template<class HandlerTask>
 bool ctkEASyncDeliverTasks<HandlerTask>::useTimeout(const HandlerTask& task)
 {
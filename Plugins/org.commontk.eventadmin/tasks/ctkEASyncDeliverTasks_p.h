@@ -25,21 +25,28 @@
 
 #include "ctkEADeliverTask_p.h"
 
+#include <QAtomicInt>
+#include <QHash>
 #include <QMutex>
+#include <QSet>
 
 class ctkEADefaultThreadPool;
 class ctkEASyncMasterThread;
+class QThread;
+
+template<class HandlerTask> class _Watchdog;
 
 /**
  * This class does the actual work of the synchronous event delivery.
  *
- * This is the heart of the event delivery. If an event is delivered
- * without timeout handling, the event is directly delivered using
- * the calling thread.
- * If timeout handling is enabled, a new thread is taken from the
- * thread pool and this thread is used to deliver the event.
- * The calling thread is blocked until either the deliver is finished
- * or the timeout occurs.
+ * This is the heart of the event delivery. Events are delivered using
+ * the calling thread. If timeout handling is enabled, a watchdog thread
+ * blacklists the handlers that do not return within the timeout; the
+ * calling thread stays blocked until the handler returns.
+ * The handlers of a class that timed out before are called in isolation
+ * instead: a new thread is taken from the thread pool and this thread is
+ * used to deliver the event. The calling thread is blocked until either
+ * the deliver is finished or the timeout occurs.
  * <p><tt>
  * Note that in case of a timeout while a task is disabled the thread
  * is released and we spin-off a new thread that resumes the disabled
@@ -101,6 +108,20 @@ private:
   /** The matchers for ignore timeout handling. */
   QList<Matcher*> ignoreTimeoutMatcher;
 
+  /** The class names of the handlers that timed out, called in isolation. */
+  QSet<QString> isolatedClasses;
+  QAtomicInt isolatedCount;
+
+  /**
+   * The threads running a handler called in isolation, with the number of
+   * such handlers each one is running.
+   */
+  QHash<QThread*, int> isolatedDeliveries;
+  QAtomicInt isolatedDeliveryCount;
+
+  /** Detects the handlers called by the calling thread that time out. */
+  _Watchdog<HandlerTask>* watchdog;
+
   QMutex mutex;
 
 public:
@@ -113,11 +134,13 @@ public:
   ctkEASyncDeliverTasks(ctkEADefaultThreadPool* pool, ctkEASyncMasterThread* syncMasterThread,
                         long timeout, const QList<QString>& ignoreTimeout);
 
+  ~ctkEASyncDeliverTasks();
+
   void update(long timeout, const QList<QString>& ignoreTimeout);
 
   /**
    * This blocks an unrelated thread used to send a synchronous event until the
-   * event is send (or a timeout occurs).
+   * event is send (or the timeout of a handler called in isolation occurs).
    *
    * @param tasks The event handler dispatch tasks to execute
    *
@@ -127,8 +150,33 @@ public:
 
   void executeInSyncMaster(const QList<HandlerTask>& tasks);
 
+  /**
+   * Blacklist the handler of the task, which did not return within the
+   * timeout, and call the handlers of its class in isolation from now on.
+   * This is a private method and only public due to its usage by the watchdog.
+   *
+   * @param task The task that timed out
+   */
+  void handlerTimedOut(HandlerTask& task);
+
+  /**
+   * Register the calling thread as running a handler called in isolation,
+   * until endIsolatedDelivery() is called. The events it sends meanwhile
+   * are cascaded from that handler, the sync master thread waits for it.
+   * These are private methods and only public due to their usage by the
+   * timeout runnable.
+   */
+  void beginIsolatedDelivery();
+  void endIsolatedDelivery();
+
 private:
 
+  /**
+   * This method defines if the calling thread sends a cascaded event from a
+   * handler called in isolation.
+   */
+  bool isIsolatedDelivery();
+
   /**
    * This method defines if a timeout handling should be used for the
    * task.
@@ -136,6 +184,12 @@ private:
    */
   bool useTimeout(const HandlerTask& task);
 
+  /**
+   * This method defines if the handler of the task is called in isolation,
+   * i.e. if a handler of the same class timed out before.
+   */
+  bool useIsolation(const HandlerTask& task);
+
 };
 
 #include "ctkEASyncDeliverTasks.tpp"
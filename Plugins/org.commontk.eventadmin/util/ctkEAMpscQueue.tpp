@@ -0,0 +1,72 @@
+/*=============================================================================
+
+  Library: CTK
+
+  Copyright (c) German Cancer Research Center,
+    Division of Medical and Biological Informatics
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+
+
+template<typename T>
+ctkEAMpscQueue<T>::ctkEAMpscQueue()
+  : head(new Node())
+{
+  tail = head;
+}
+
+template<typename T>
+ctkEAMpscQueue<T>::~ctkEAMpscQueue()
+{
+  while (tail)
+  {
+    Node* next = tail->next;
+    delete tail;
+    tail = next;
+  }
+}
+
+template<typename T>
+void ctkEAMpscQueue<T>::put(const T& value)
+{
+  Node* node = new Node(value);
+  Node* previous = head.fetchAndStoreOrdered(node);
+  // Until this store, the consumer sees the queue ending at previous
+  previous->next.fetchAndStoreOrdered(node);
+}
+
+template<typename T>
+bool ctkEAMpscQueue<T>::poll(T& value)
+{
+  Node* next = tail->next.fetchAndAddOrdered(0);
+  if (next == 0)
+  {
+    return false;
+  }
+
+  // next becomes the new sentinel, release its value
+  value = next->value;
+  next->value = T();
+  delete tail;
+  tail = next;
+  return true;
+}
+
+template<typename T>
+bool ctkEAMpscQueue<T>::isEmpty() const
+{
+  return tail->next.fetchAndAddOrdered(0) == 0;
+}
@@ -0,0 +1,89 @@
+/*=============================================================================
+
+  Library: CTK
+
+  Copyright (c) German Cancer Research Center,
+    Division of Medical and Biological Informatics
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+
+
+#ifndef CTKEAMPSCQUEUE_P_H
+#define CTKEAMPSCQUEUE_P_H
+
+#include <QAtomicPointer>
+
+/**
+ * This class implements an unbounded queue for multiple producers and a single
+ * consumer that takes no lock. Producers link a new node with one atomic
+ * exchange, the consumer takes the nodes in order. A node put concurrently to
+ * a call of <tt>poll()</tt> may be taken by the next call only.
+ */
+template<typename T>
+class ctkEAMpscQueue
+{
+
+private:
+
+  struct Node
+  {
+    QAtomicPointer<Node> next;
+    T value;
+
+    Node() : next(0) {}
+    Node(const T& value) : next(0), value(value) {}
+  };
+
+  // The most recently put node, producers link their node after it
+  QAtomicPointer<Node> head;
+
+  // The node before the next one to take, only accessed by the consumer
+  Node* tail;
+
+  Q_DISABLE_COPY(ctkEAMpscQueue)
+
+public:
+
+  ctkEAMpscQueue();
+
+  ~ctkEAMpscQueue();
+
+  /**
+   * Put the given value at the end of the queue. This may be called by any
+   * thread.
+   *
+   * @param value The value to put
+   */
+  void put(const T& value);
+
+  /**
+   * Take the value at the front of the queue, if any. This must only be called
+   * by one thread at a time.
+   *
+   * @param value Set to the value taken
+   * @return <tt>true</tt> if a value was taken, <tt>false</tt> if the queue is empty
+   */
+  bool poll(T& value);
+
+  /**
+   * Lookup whether the queue is empty. This must only be called by the consumer.
+   */
+  bool isEmpty() const;
+};
+
+#include "ctkEAMpscQueue.tpp"
+
+#endif // CTKEAMPSCQUEUE_P_H
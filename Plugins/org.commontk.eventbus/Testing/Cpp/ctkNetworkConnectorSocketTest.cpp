@@ -0,0 +1,241 @@
+/*
+ *  ctkNetworkConnectorSocketTest.cpp
+ *  ctkNetworkConnectorSocketTest
+ *
+ *  Created by Daniele Giunchi on 27/03/09.
+ *  Copyright 2009 B3C. All rights reserved.
+ *
+ *  See Licence at: http://tiny.cc/QXJ4D
+ *
+ */
+
+#include "ctkTestSuite.h"
+#include <ctkNetworkConnectorSocket.h>
+#include <ctkNetworkConnectorQXMLRPC.h>
+#include <ctkEventBusManager.h>
+
+#include <QApplication>
+#include <QSignalSpy>
+#include <QTime>
+
+using namespace ctkEventBus;
+
+//-------------------------------------------------------------------------
+/**
+ Class name: ctkObjectCustom
+ Custom object needed for testing.
+ */
+class testObjectCustomForNetworkConnectorSocket : public QObject {
+    Q_OBJECT
+
+public:
+    /// constructor.
+    testObjectCustomForNetworkConnectorSocket();
+
+    /// Return tha var's value.
+    int var() {return m_Var;}
+
+public Q_SLOTS:
+    /// Test slot that will increment the value of m_Var when an UPDATE_OBJECT event is raised.
+    void updateObject();
+    void setObjectValue(int v);
+
+Q_SIGNALS:
+    void valueModified(int v);
+    void objectModified();
+
+private:
+    int m_Var; ///< Test var.
+};
+
+testObjectCustomForNetworkConnectorSocket::testObjectCustomForNetworkConnectorSocket() : m_Var(0) {
+}
+
+void testObjectCustomForNetworkConnectorSocket::updateObject() {
+    m_Var++;
+}
+
+void testObjectCustomForNetworkConnectorSocket::setObjectValue(int v) {
+    m_Var = v;
+}
+
+
+/**
+ Class name: ctkNetworkConnectorSocketTest
+ This class implements the test suite for ctkNetworkConnectorSocket.
+ */
+
+//! <title>
+//ctkNetworkConnectorSocket
+//! </title>
+//! <description>
+//ctkNetworkConnectorSocket provides a binary connection over a persistent TCP socket.
+//Its throughput and latency are compared with ctkNetworkConnectorQXMLRPC.
+//! </description>
+
+class ctkNetworkConnectorSocketTest : public QObject {
+    Q_OBJECT
+
+private Q_SLOTS:
+    /// Initialize test variables
+    void initTestCase() {
+        m_EventBus = ctkEventBusManager::instance();
+        m_NetWorkConnectorSocket = new ctkEventBus::ctkNetworkConnectorSocket();
+        m_ObjectTest = new testObjectCustomForNetworkConnectorSocket();
+
+        // Register callback (done by the remote object).
+        ctkRegisterLocalCallback("ctk/local/eventBus/globalUpdate", m_ObjectTest, "updateObject()");
+    }
+
+    /// Cleanup tes variables memory allocation.
+    void cleanupTestCase() {
+        if(m_ObjectTest) {
+            delete m_ObjectTest;
+            m_ObjectTest = NULL;
+        }
+        delete m_NetWorkConnectorSocket;
+        m_EventBus->shutdown();
+    }
+
+    /// Check the existence of the ctkNetworkConnectorSockete singletone creation.
+    void ctkNetworkConnectorSocketConstructorTest();
+
+    /// Check that the events sent by the client are notified by the server in order.
+    void ctkNetworkConnectorSocketCommunictionTest();
+
+    /// Check that the client reconnects and sends the events queued while the server was down.
+    void ctkNetworkConnectorSocketReconnectTest();
+
+    /// Compare throughput and latency with ctkNetworkConnectorQXMLRPC.
+    void ctkNetworkConnectorSocketBenchmarkTest();
+
+private:
+    /// Send @param count events updating m_ObjectTest through the given connector.
+    void sendEvents(ctkNetworkConnector *connector, const QString &method, int count);
+
+    /// Process the events until m_ObjectTest reaches the @param expected value or the timeout.
+    bool waitForValue(int expected, int msecs = 10000);
+
+    /// Print the events per second and the average latency of a connector.
+    void benchmark(ctkNetworkConnector *connector, const QString &method, int count);
+
+    ctkEventBusManager *m_EventBus; ///< event bus instance
+    ctkNetworkConnectorSocket *m_NetWorkConnectorSocket; ///< EventBus test variable instance.
+    testObjectCustomForNetworkConnectorSocket *m_ObjectTest;
+};
+
+void ctkNetworkConnectorSocketTest::sendEvents(ctkNetworkConnector *connector, const QString &method, int count) {
+    QVariantList eventParameters;
+    eventParameters.append("ctk/local/eventBus/globalUpdate");
+    eventParameters.append(ctkEventTypeLocal);
+    eventParameters.append(ctkSignatureTypeCallback);
+    eventParameters.append("updateObject()");
+
+    QVariantList dataParameters;
+
+    ctkEventArgumentsList listToSend;
+    listToSend.append(ctkEventArgument(QVariantList, eventParameters));
+    listToSend.append(ctkEventArgument(QVariantList, dataParameters));
+
+    for(int i = 0; i < count; ++i) {
+        connector->send(method, &listToSend);
+    }
+}
+
+bool ctkNetworkConnectorSocketTest::waitForValue(int expected, int msecs) {
+    QTime time;
+    time.start();
+    while(m_ObjectTest->var() < expected && time.elapsed() < msecs) {
+       QCoreApplication::processEvents(QEventLoop::AllEvents, 3);
+    }
+    return m_ObjectTest->var() == expected;
+}
+
+void ctkNetworkConnectorSocketTest::benchmark(ctkNetworkConnector *connector, const QString &method, int count) {
+    // warm up the connection
+    m_ObjectTest->setObjectValue(0);
+    sendEvents(connector, method, 1);
+    QVERIFY(waitForValue(1));
+
+    // pipelined events
+    m_ObjectTest->setObjectValue(0);
+    QTime time;
+    time.start();
+    sendEvents(connector, method, count);
+    QVERIFY(waitForValue(count, 60000));
+    const int throughputTime = qMax(1, time.elapsed());
+
+    // one event at a time
+    const int roundTrips = qMin(count, 100);
+    m_ObjectTest->setObjectValue(0);
+    time.start();
+    for(int i = 1; i <= roundTrips; ++i) {
+        sendEvents(connector, method, 1);
+        QVERIFY(waitForValue(i));
+    }
+    const int latencyTime = time.elapsed();
+
+    qDebug() << connector->protocol() << ":" << count * 1000.0 / throughputTime << "events/sec,"
+             << double(latencyTime) / roundTrips << "ms latency";
+}
+
+void ctkNetworkConnectorSocketTest::ctkNetworkConnectorSocketConstructorTest() {
+    QVERIFY(m_NetWorkConnectorSocket != NULL);
+}
+
+
+void ctkNetworkConnectorSocketTest::ctkNetworkConnectorSocketCommunictionTest() {
+    m_NetWorkConnectorSocket->createServer(8010);
+    m_NetWorkConnectorSocket->startListen();
+
+    m_NetWorkConnectorSocket->createClient("localhost", 8010);
+
+    m_ObjectTest->setObjectValue(0);
+    sendEvents(m_NetWorkConnectorSocket, "ctk/remote/eventBus/comunication/send/socket", 100);
+    QVERIFY(waitForValue(100));
+}
+
+void ctkNetworkConnectorSocketTest::ctkNetworkConnectorSocketReconnectTest() {
+    ctkNetworkConnectorSocket client;
+    client.createClient("localhost", 8012);
+
+    // queued until the server is available
+    m_ObjectTest->setObjectValue(0);
+    sendEvents(&client, "ctk/remote/eventBus/comunication/send/socket", 10);
+
+    ctkNetworkConnectorSocket *server = new ctkNetworkConnectorSocket();
+    server->createServer(8012);
+    server->startListen();
+    QVERIFY(waitForValue(10));
+
+    // the server restarts, the events written to the lost connection would be lost
+    QSignalSpy reconnected(&client, SIGNAL(connectedToServer()));
+    delete server;
+    server = new ctkNetworkConnectorSocket();
+    server->createServer(8012);
+    server->startListen();
+    QTime time;
+    time.start();
+    while(reconnected.count() == 0 && time.elapsed() < 10000) {
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 3);
+    }
+    QVERIFY(reconnected.count() > 0);
+
+    sendEvents(&client, "ctk/remote/eventBus/comunication/send/socket", 10);
+    QVERIFY(waitForValue(20));
+    delete server;
+}
+
+void ctkNetworkConnectorSocketTest::ctkNetworkConnectorSocketBenchmarkTest() {
+    // the server of the communication test is still listening
+    benchmark(m_NetWorkConnectorSocket, "ctk/remote/eventBus/comunication/send/socket", 10000);
+
+    ctkNetworkConnectorQXMLRPC xmlrpc;
+    xmlrpc.createServer(8011);
+    xmlrpc.startListen();
+    xmlrpc.createClient("localhost", 8011);
+    benchmark(&xmlrpc, "ctk/remote/eventBus/comunication/send/xmlrpc", 1000);
+}
+
+CTK_REGISTER_TEST(ctkNetworkConnectorSocketTest);
+#include "ctkNetworkConnectorSocketTest.moc"
@@ -0,0 +1,349 @@
+/*
+ *  ctkNetworkConnectorSocket.cpp
+ *  ctkEventBus
+ *
+ *  Created by Daniele Giunchi on 11/04/10.
+ *  Copyright 2009 B3C. All rights reserved.
+ *
+ *  See Licence at: http://tiny.cc/QXJ4D
+ *
+ */
+
+#include "ctkNetworkConnectorSocket.h"
+#include "ctkEventBusManager.h"
+#include "ctkBusEvent.h"
+
+#include <QDataStream>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+
+using namespace ctkEventBus;
+
+namespace {
+// frames are flushed without waiting for the event loop above this size
+const int MaxBatchSize = 64 * 1024;
+// frames larger than this are considered corrupted and close the connection
+const quint32 MaxFrameSize = 256 * 1024 * 1024;
+const int MinReconnectInterval = 100; // ms
+const int MaxReconnectInterval = 5000; // ms
+}
+
+ctkNetworkConnectorSocket::ctkNetworkConnectorSocket() : ctkNetworkConnector(), m_Client(NULL), m_Port(0),
+    m_ReconnectInterval(MinReconnectInterval), m_Server(NULL), m_ServerPort(0),
+    m_ListenAddress(QHostAddress::LocalHost) {
+
+    m_Protocol = "SOCKET";
+
+    m_FlushTimer = new QTimer(this);
+    m_FlushTimer->setSingleShot(true);
+    m_FlushTimer->setInterval(0);
+    connect(m_FlushTimer, SIGNAL(timeout()), this, SLOT(flush()));
+
+    m_ReconnectTimer = new QTimer(this);
+    m_ReconnectTimer->setSingleShot(true);
+    connect(m_ReconnectTimer, SIGNAL(timeout()), this, SLOT(reconnect()));
+}
+
+void ctkNetworkConnectorSocket::initializeForEventBus() {
+    ctkRegisterRemoteSignal("ctk/remote/eventBus/comunication/send/socket", this, "remoteCommunication(const QString, ctkEventArgumentsList *)");
+    ctkRegisterRemoteCallback("ctk/remote/eventBus/comunication/send/socket", this, "send(const QString, ctkEventArgumentsList *)");
+}
+
+ctkNetworkConnectorSocket::~ctkNetworkConnectorSocket() {
+    if(m_Client) {
+        // last chance for the pending events
+        if(!m_Pending.isEmpty() || m_Client->bytesToWrite() > 0) {
+            waitForEventsWritten(1000);
+        }
+        m_Client->disconnect(this);
+        delete m_Client;
+        m_Client = NULL;
+    }
+    if(m_Server) {
+        stopServer();
+    }
+}
+
+//retrieve an instance of the object
+ctkNetworkConnector *ctkNetworkConnectorSocket::clone() {
+    ctkNetworkConnectorSocket *copy = new ctkNetworkConnectorSocket();
+    copy->setListenAddress(m_ListenAddress);
+    return copy;
+}
+
+void ctkNetworkConnectorSocket::createClient(const QString hostName, const unsigned int port) {
+    if(m_Client == NULL) {
+        m_Client = new QTcpSocket(this);
+        connect(m_Client, SIGNAL(connected()), this, SLOT(connected()));
+        connect(m_Client, SIGNAL(disconnected()), this, SLOT(connectionLost()));
+        connect(m_Client, SIGNAL(error(QAbstractSocket::SocketError)),
+                this, SLOT(processError(QAbstractSocket::SocketError)));
+    } else if(m_HostName == hostName && m_Port == port) {
+        return;
+    } else {
+        m_Client->abort();
+    }
+
+    m_HostName = hostName;
+    m_Port = port;
+    m_ReconnectInterval = MinReconnectInterval;
+    m_ReconnectTimer->stop();
+    m_Client->connectToHost(m_HostName, m_Port);
+}
+
+void ctkNetworkConnectorSocket::createServer(const unsigned int port) {
+    if(m_Server != NULL) {
+        if(m_ServerPort == port) {
+            return;
+        }
+        stopServer();
+    }
+    m_Server = new QTcpServer(this);
+    m_ServerPort = port;
+    connect(m_Server, SIGNAL(newConnection()), this, SLOT(acceptConnection()));
+}
+
+void ctkNetworkConnectorSocket::stopServer() {
+    foreach(QTcpSocket *socket, m_FrameSize.keys()) {
+        // the socket may be reading the event that stops the server
+        socket->disconnect(this);
+        socket->setParent(NULL);
+        socket->abort();
+        socket->deleteLater();
+    }
+    m_FrameSize.clear();
+
+    // Delete (and stop) the instance of the server.
+    delete m_Server;
+    m_Server = NULL;
+    m_ServerPort = 0;
+}
+
+
+void ctkNetworkConnectorSocket::setListenAddress(const QHostAddress &address) {
+    m_ListenAddress = address;
+}
+
+QHostAddress ctkNetworkConnectorSocket::listenAddress() const {
+    return m_ListenAddress;
+}
+
+void ctkNetworkConnectorSocket::startListen() {
+    if(m_Server == NULL) {
+        qWarning("%s", tr("Server can not start. Create it first, then call startListen again!!").toAscii().data());
+        return;
+    }
+    if(m_Server->isListening()) {
+        return;
+    }
+
+    if(m_Server->listen(m_ListenAddress, m_ServerPort)) {
+        qDebug() << "Listening for events on" << m_ListenAddress.toString() << "port" << m_ServerPort;
+    } else {
+        qDebug() << "Error listening port" << m_ServerPort << m_Server->errorString();
+    }
+}
+
+void ctkNetworkConnectorSocket::send(const QString event_id, ctkEventArgumentsList *argList) {
+    QVariantList parameters;
+    if(argList != NULL) {
+        int i=0, size = argList->count();
+        for(;i<size;i++) {
+            QString typeArgument;
+            typeArgument = argList->at(i).name();
+            if(typeArgument != "QVariantList") {
+                qWarning("%s", tr("Remote Dispatcher need to have arguments that are QVariantList").toAscii().data());
+                return;
+            }
+
+            parameters.append(QVariant(*static_cast<QVariantList *>(argList->at(i).data())));
+        }
+        if(size == 0) {
+            qWarning("%s", tr("Remote Dispatcher need to have at least one argument that is a QVariantList").toAscii().data());
+            return;
+        }
+    }
+
+    // reserve the size, write the frame and then its size in front of it
+    const int start = m_Pending.size();
+    {
+        QDataStream out(&m_Pending, QIODevice::WriteOnly | QIODevice::Append);
+        out.setVersion(QDataStream::Qt_4_6);
+        out << quint32(0) << event_id << parameters;
+    }
+    const quint32 frameSize = m_Pending.size() - start - int(sizeof(quint32));
+    {
+        QByteArray size;
+        QDataStream out(&size, QIODevice::WriteOnly);
+        out << frameSize;
+        m_Pending.replace(start, size.size(), size);
+    }
+
+    if(m_Pending.size() >= MaxBatchSize) {
+        flush();
+    } else if(!m_FlushTimer->isActive()) {
+        m_FlushTimer->start();
+    }
+}
+
+void ctkNetworkConnectorSocket::flush() {
+    m_FlushTimer->stop();
+    if(m_Client == NULL || m_Client->state() != QAbstractSocket::ConnectedState || m_Pending.isEmpty()) {
+        // kept until connected
+        return;
+    }
+
+    // the socket buffers what it can not write now
+    m_Client->write(m_Pending);
+    m_Pending.clear();
+}
+
+bool ctkNetworkConnectorSocket::waitForEventsWritten(int msecs) {
+    if(m_Client == NULL) {
+        return false;
+    }
+    if(m_Client->state() != QAbstractSocket::ConnectedState && !m_Client->waitForConnected(msecs)) {
+        return false;
+    }
+    flush();
+    while(m_Client->bytesToWrite() > 0) {
+        if(!m_Client->waitForBytesWritten(msecs)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ctkNetworkConnectorSocket::connected() {
+    // small frames must not wait for the acknowledgment of the previous ones
+    m_Client->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    m_ReconnectInterval = MinReconnectInterval;
+    flush();
+    emit connectedToServer();
+}
+
+void ctkNetworkConnectorSocket::connectionLost() {
+    if(!m_ReconnectTimer->isActive()) {
+        m_ReconnectTimer->start(m_ReconnectInterval);
+        m_ReconnectInterval = qMin(2 * m_ReconnectInterval, MaxReconnectInterval);
+    }
+}
+
+void ctkNetworkConnectorSocket::processError(QAbstractSocket::SocketError error) {
+    // Log the error.
+    qDebug("%s", tr("Connection to %1:%2 failed with error %3 - %4").arg(m_HostName, QString::number(m_Port),
+           QString::number(error), m_Client->errorString()).toAscii().data());
+    ctkEventBusManager::instance()->notifyEvent("ctk/local/eventBus/remoteCommunicationFailed", ctkEventTypeLocal);
+    if(m_Client->state() == QAbstractSocket::UnconnectedState) {
+        // no disconnected() signal when the connection could not be established
+        connectionLost();
+    }
+}
+
+void ctkNetworkConnectorSocket::reconnect() {
+    if(m_Client->state() == QAbstractSocket::UnconnectedState) {
+        m_Client->connectToHost(m_HostName, m_Port);
+    }
+}
+
+void ctkNetworkConnectorSocket::acceptConnection() {
+    while(m_Server->hasPendingConnections()) {
+        QTcpSocket *socket = m_Server->nextPendingConnection();
+        m_FrameSize.insert(socket, 0);
+        connect(socket, SIGNAL(readyRead()), this, SLOT(readFrames()));
+        connect(socket, SIGNAL(disconnected()), this, SLOT(dropConnection()));
+    }
+}
+
+void ctkNetworkConnectorSocket::readFrames() {
+    QTcpSocket *socket = qobject_cast<QTcpSocket *>(QObject::sender());
+    if(socket == NULL || !m_FrameSize.contains(socket)) {
+        return;
+    }
+
+    forever {
+        quint32 frameSize = m_FrameSize.value(socket);
+        if(frameSize == 0) {
+            if(socket->bytesAvailable() < qint64(sizeof(quint32))) {
+                break;
+            }
+            QDataStream in(socket);
+            in >> frameSize;
+            if(frameSize == 0 || frameSize > MaxFrameSize) {
+                qWarning("%s", tr("Invalid frame of %1 bytes received, closing the connection").arg(frameSize).toAscii().data());
+                socket->abort();
+                return;
+            }
+            m_FrameSize.insert(socket, frameSize);
+        }
+        if(socket->bytesAvailable() < frameSize) {
+            break;
+        }
+        const QByteArray frame = socket->read(frameSize);
+        m_FrameSize.insert(socket, 0);
+        processFrame(frame);
+        if(!m_FrameSize.contains(socket)) {
+            // the server was stopped by the event
+            return;
+        }
+    }
+}
+
+void ctkNetworkConnectorSocket::dropConnection() {
+    QTcpSocket *socket = qobject_cast<QTcpSocket *>(QObject::sender());
+    if(socket != NULL && m_FrameSize.remove(socket) != 0) {
+        socket->deleteLater();
+    }
+}
+
+void ctkNetworkConnectorSocket::processFrame(const QByteArray &frame) {
+    //first parameter is ctkEventBus message
+    enum {
+      EVENT_PARAMETERS,
+      DATA_PARAMETERS,
+    };
+
+    enum {
+      EVENT_ID,
+      EVENT_ITEM_TYPE,
+      EVENT_SIGNATURE_TYPE,
+      EVENT_METHOD_SIGNATURE,
+    };
+
+    QString method;
+    QVariantList parameters;
+    QDataStream in(frame);
+    in.setVersion(QDataStream::Qt_4_6);
+    in >> method >> parameters;
+    if(in.status() != QDataStream::Ok || parameters.isEmpty() || parameters.at(EVENT_PARAMETERS).toList().isEmpty()) {
+        qDebug("%s", tr("No Command to Execute, command list is empty").toAscii().data());
+        return;
+    }
+
+    //here eventually can be used a filter for events
+
+    //first argument regards local signal to be called.
+    QString id_name = parameters.at(EVENT_PARAMETERS).toList().at(EVENT_ID).toString();
+
+    ctkEventArgumentsList *argList = NULL;
+    QVariantList p;
+    if(parameters.count() > DATA_PARAMETERS) {
+        p = parameters.at(DATA_PARAMETERS).toList();
+    }
+    if(p.count() != 0) {
+        argList = new ctkEventArgumentsList();
+        argList->push_back(Q_ARG(QVariantList, p));
+    }
+
+    if ( ctkEventBusManager::instance()->isLocalSignalPresent(id_name) ) {
+        ctkBusEvent dictionary(id_name,ctkEventTypeLocal,0,NULL,"");
+        ctkEventBusManager::instance()->notifyEvent(dictionary, argList);
+    } else {
+        qDebug("%s", tr("No local signal registered for %1").arg(id_name).toAscii().data());
+    }
+    if(argList){
+        delete argList;
+        argList = NULL;
+    }
+}
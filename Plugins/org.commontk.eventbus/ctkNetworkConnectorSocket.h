@@ -0,0 +1,138 @@
+/*
+ *  ctkNetworkConnectorSocket.h
+ *  ctkEventBus
+ *
+ *  Created by Daniele Giunchi on 11/04/10.
+ *  Copyright 2009 B3C. All rights reserved.
+ *
+ *  See Licence at: http://tiny.cc/QXJ4D
+ *
+ */
+
+#ifndef ctkNetworkConnectorSocket_H
+#define ctkNetworkConnectorSocket_H
+
+// include list
+#include "ctkNetworkConnector.h"
+
+#include <QAbstractSocket>
+#include <QHostAddress>
+
+class QTcpServer;
+class QTcpSocket;
+class QTimer;
+
+namespace ctkEventBus {
+
+/**
+ Class name: ctkNetworkConnectorSocket
+ This class is the implementation class for client/server objects that works over network
+ with a binary protocol on a persistent TCP connection (protocol "SOCKET").
+ Each event is sent as a frame made of its size (quint32) followed by the event id and
+ its parameters written with QDataStream. Sends are pipelined: the client does not wait
+ for the server to process an event before sending the next one, and the events sent
+ during the same iteration of the event loop are written to the socket at once.
+ The client reconnects when the connection is lost; the events sent meanwhile are kept
+ and written once connected again.
+ Delivery is at most once: there is no acknowledgment, the events already written to the
+ socket when the connection is lost are not sent again.
+ The server side notifies the events locally, like ctkNetworkConnectorQXMLRPC. The frames
+ are not authenticated, so the server only listens on the local host by default: see
+ setListenAddress().
+ */
+class org_commontk_eventbus_EXPORT ctkNetworkConnectorSocket : public ctkNetworkConnector {
+    Q_OBJECT
+
+
+public:
+    /// object constructor.
+    ctkNetworkConnectorSocket();
+
+    /// object destructor.
+    /*virtual*/ ~ctkNetworkConnectorSocket();
+
+    /// create the unique instance of the client.
+    /*virtual*/ void createClient(const QString hostName, const unsigned int port);
+
+    /// create the unique instance of the server.
+    /*virtual*/ void createServer(const unsigned int port);
+
+    /// Start the server.
+    /*virtual*/ void startListen();
+
+    /// Address the server listens on, QHostAddress::LocalHost by default.
+    /// Any peer able to connect to it can notify events locally, only listen on
+    /// a network interface if its peers are trusted. Takes effect on startListen().
+    void setListenAddress(const QHostAddress &address);
+    QHostAddress listenAddress() const;
+
+    //retrieve an instance of the object
+    /*virtual*/ ctkNetworkConnector *clone();
+
+    /// register all the signals and slots
+    /*virtual*/ void initializeForEventBus();
+
+    /// Write the events waiting to be sent to the socket and wait until they are written
+    /// or @param msecs elapsed. Returns false if the client is not connected.
+    bool waitForEventsWritten(int msecs = 30000);
+
+Q_SIGNALS:
+    /// Emitted each time the client is connected (or reconnected) to the server.
+    void connectedToServer();
+
+public Q_SLOTS:
+    /// Allow to send a network request.
+    /** Arguments must be QVariantList, like for ctkNetworkConnectorQXMLRPC. The event is
+        queued and written to the socket when the control returns to the event loop. */
+    /*virtual*/ void send(const QString event_id, ctkEventArgumentsList *argList);
+
+private Q_SLOTS:
+    /// write the queued frames to the socket in one batch
+    void flush();
+
+    /// callback for the client when the connection is established
+    void connected();
+
+    /// callback for the client which schedules a reconnection
+    void connectionLost();
+
+    /// callback for the client which manage a fault in the connection
+    void processError(QAbstractSocket::SocketError error);
+
+    /// callback for the client to connect again to the server
+    void reconnect();
+
+    /// callback for the server which accepts the incoming connections
+    void acceptConnection();
+
+    /// callback for the server which reads the frames received by a connection
+    void readFrames();
+
+    /// callback for the server when a client disconnects
+    void dropConnection();
+
+private:
+    /// stop and destroy the server instance.
+    void stopServer();
+
+    /// notify locally the event of a frame received by the server.
+    void processFrame(const QByteArray &frame);
+
+    QTcpSocket *m_Client; ///< persistent connection of the client
+    QString m_HostName; ///< host of the server the client connects to
+    quint16 m_Port; ///< port of the server the client connects to
+    QByteArray m_Pending; ///< frames waiting to be written to the socket
+    QTimer *m_FlushTimer; ///< single shot timer flushing the frames once back in the event loop
+    QTimer *m_ReconnectTimer; ///< single shot timer reconnecting the client
+    int m_ReconnectInterval; ///< delay before the next reconnection, doubled on each failure
+
+    QTcpServer *m_Server; ///< server listening for the clients
+    unsigned int m_ServerPort; ///< port the server listens on
+    QHostAddress m_ListenAddress; ///< address the server listens on
+    QHash<QTcpSocket *, quint32> m_FrameSize; ///< size of the frame being received on each connection, 0 while reading the size
+};
+
+} //namespace ctkEventBus
+
+
+#endif // ctkNetworkConnectorSocket_H